@@ -242,6 +242,27 @@ RECENT REVISION HISTORY:
 // you have issues compiling it, you can disable it entirely by
 // defining STBI_NO_SIMD.
 //
+// On x86 the JPEG IDCT, YCbCr->RGB conversion and 2x2 chroma upsampling
+// also have AVX2 versions, picked at run time when the CPU (and OS) support
+// it. They give bit-identical output to the SSE2 / generic versions. Define
+// STBI_NO_AVX2 to leave them out and stay on SSE2.
+//
+// ===========================================================================
+//
+// Reduced size JPEG decoding
+//
+// For thumbnails and small mip levels a JPEG can be decoded straight to 1/2,
+// 1/4 or 1/8 of its size, the way libjpeg's scale_denom does it:
+//
+//     stbi_set_jpeg_scale(4);   // or stbi_set_jpeg_scale_thread(4)
+//
+// Every 8x8 block of coefficients then goes through a 4x4 (2x2, 1x1) inverse
+// DCT of its low frequencies instead of the full one, so the IDCT, the chroma
+// upsampling, the color conversion and the buffers all shrink with the scale.
+// The entropy decoding still has to read every coefficient. The image comes
+// back (and stbi_info reports it) as ceil(width/N) x ceil(height/N). Other
+// formats ignore the setting.
+//
 // ===========================================================================
 //
 // HDR image support   (disable by defining STBI_NO_HDR)
@@ -491,6 +512,18 @@ STBIDEF void stbi_set_flip_vertically_on_load(int flag_true_if_should_flip);
 // calling it will fail to link if your compiler doesn't
 STBIDEF void stbi_set_flip_vertically_on_load_thread(int flag_true_if_should_flip);
 
+// whether images loaded on the calling thread are flipped now, so it can be put back
+// after a change (needs thread-local variables, like the function above)
+STBIDEF int stbi_get_flip_vertically_on_load_thread(void);
+
+// decode JPEGs at 1/denominator of their size, denominator 1, 2, 4 or 8 (see
+// "Reduced size JPEG decoding" above); anything else means 1
+STBIDEF void stbi_set_jpeg_scale(int denominator);
+
+// as above, for the calling thread only (needs thread-local variables, like
+// stbi_set_flip_vertically_on_load_thread)
+STBIDEF void stbi_set_jpeg_scale_thread(int denominator);
+
 // ZLIB client - used by PNG, available for other purposes
 
 STBIDEF char *stbi_zlib_decode_malloc_guesssize(const char *buffer, int len, int initial_size, int *outlen);
@@ -621,6 +654,8 @@ typedef int32_t  stbi__int32;
 // should produce compiler error if size is wrong
 typedef unsigned char validate_uint32[sizeof(stbi__uint32)==4 ? 1 : -1];
 
+typedef unsigned long long stbi__uint64; // the zlib bit buffer
+
 #ifdef _MSC_VER
 #define STBI_NOTUSED(v)  (void)(v)
 #else
@@ -717,7 +752,7 @@ static int stbi__cpuid3(void)
 
 #define STBI_SIMD_ALIGN(type, name) __declspec(align(16)) type name
 
-#if !defined(STBI_NO_JPEG) && defined(STBI_SSE2)
+#if (!defined(STBI_NO_JPEG) || !defined(STBI_NO_PNG)) && defined(STBI_SSE2)
 static int stbi__sse2_available(void)
 {
    int info3 = stbi__cpuid3();
@@ -728,7 +763,7 @@ static int stbi__sse2_available(void)
 #else // assume GCC-style if not VC++
 #define STBI_SIMD_ALIGN(type, name) type name __attribute__((aligned(16)))
 
-#if !defined(STBI_NO_JPEG) && defined(STBI_SSE2)
+#if (!defined(STBI_NO_JPEG) || !defined(STBI_NO_PNG)) && defined(STBI_SSE2)
 static int stbi__sse2_available(void)
 {
    // If we're even attempting to compile this on GCC/Clang, that means
@@ -741,6 +776,41 @@ static int stbi__sse2_available(void)
 #endif
 #endif
 
+// AVX2, compiled in next to SSE2 and only used after a run time check, so the
+// rest of the file doesn't need to be built with -mavx2
+#if defined(STBI_SSE2) && !defined(STBI_NO_AVX2) && !defined(STBI_NO_JPEG) && \
+    ((defined(__GNUC__) && (__GNUC__ >= 5 || defined(__clang__))) || (defined(_MSC_VER) && _MSC_VER >= 1900))
+#define STBI_AVX2
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+#define STBI__AVX2_TARGET
+static int stbi__avx2_available(void)
+{
+   int info[4];
+   __cpuid(info, 0);
+   if (info[0] < 7) return 0;
+   __cpuid(info, 1);
+   // the CPU has AVX and the OS saves the ymm registers (OSXSAVE, then XCR0 bits 1 and 2)
+   if (((info[2] >> 27) & 1) == 0 || ((info[2] >> 28) & 1) == 0) return 0;
+   if ((_xgetbv(0) & 6) != 6) return 0;
+   __cpuidex(info, 7, 0);
+   return (info[1] >> 5) & 1;
+}
+#else
+#define STBI__AVX2_TARGET __attribute__((target("avx2")))
+static int stbi__avx2_available(void)
+{
+#ifdef __AVX2__
+   return 1;
+#else
+   // checks the OS side (xgetbv) as well as the cpuid bit
+   return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+#endif
+
 // ARM NEON
 #if defined(STBI_NO_SIMD) && defined(STBI_NEON)
 #undef STBI_NEON
@@ -1078,6 +1148,45 @@ STBIDEF void stbi_set_flip_vertically_on_load_thread(int flag_true_if_should_fli
 #define stbi__vertically_flip_on_load  (stbi__vertically_flip_on_load_set       \
                                          ? stbi__vertically_flip_on_load_local  \
                                          : stbi__vertically_flip_on_load_global)
+
+STBIDEF int stbi_get_flip_vertically_on_load_thread(void)
+{
+   return stbi__vertically_flip_on_load;
+}
+#endif // STBI_THREAD_LOCAL
+
+// log2 of the JPEG scale denominator, 0..3
+static int stbi__jpeg_scale_shift_global = 0;
+
+static int stbi__jpeg_scale_to_shift(int denominator)
+{
+   switch (denominator) {
+      case 2: return 1;
+      case 4: return 2;
+      case 8: return 3;
+      default: return 0;
+   }
+}
+
+STBIDEF void stbi_set_jpeg_scale(int denominator)
+{
+   stbi__jpeg_scale_shift_global = stbi__jpeg_scale_to_shift(denominator);
+}
+
+#ifndef STBI_THREAD_LOCAL
+#define stbi__jpeg_scale_shift  stbi__jpeg_scale_shift_global
+#else
+static STBI_THREAD_LOCAL int stbi__jpeg_scale_shift_local, stbi__jpeg_scale_shift_set;
+
+STBIDEF void stbi_set_jpeg_scale_thread(int denominator)
+{
+   stbi__jpeg_scale_shift_local = stbi__jpeg_scale_to_shift(denominator);
+   stbi__jpeg_scale_shift_set = 1;
+}
+
+#define stbi__jpeg_scale_shift  (stbi__jpeg_scale_shift_set        \
+                                  ? stbi__jpeg_scale_shift_local   \
+                                  : stbi__jpeg_scale_shift_global)
 #endif // STBI_THREAD_LOCAL
 
 static void *stbi__load_main(stbi__context *s, int *x, int *y, int *comp, int req_comp, stbi__result_info *ri, int bpc)
@@ -1933,6 +2042,8 @@ typedef struct
    int scan_n, order[4];
    int restart_interval, todo;
 
+   int scale_shift; // decoding at 1/(1 << scale_shift) size: blocks come out (8 >> scale_shift) pixels square
+
 // kernels
    void (*idct_block_kernel)(stbi_uc *out, int out_stride, short data[64]);
    void (*YCbCr_to_RGB_kernel)(stbi_uc *out, const stbi_uc *y, const stbi_uc *pcb, const stbi_uc *pcr, int count, int step);
@@ -2449,6 +2560,64 @@ static void stbi__idct_block(stbi_uc *out, int out_stride, short data[64])
    }
 }
 
+// Reduced size IDCTs (stbi_set_jpeg_scale): an N-point inverse DCT of the
+// low NxN coefficients, scaled like the 8-point one so the DC term still
+// gives the block's average. Each output is roughly the average of the
+// (8/N)x(8/N) pixels the full IDCT would have made there.
+//
+// The 4-point one split into even and odd halves, with c(k) = cos(k pi/8)/2
+// and the DC one also divided by sqrt(2):
+//    x0 = e0 + o0, x3 = e0 - o0, x1 = e1 + o1, x2 = e1 - o1
+//    e0 = (f0 + f2) c(2),     e1 = (f0 - f2) c(2)
+//    o0 = f1 c(1) + f3 c(3),  o1 = f1 c(3) - f3 c(1)
+#define STBI__IDCT_4(s0,s1,s2,s3) \
+   int e0 = ((s0) + (s2)) * stbi__f2f(0.353553391f), e1 = ((s0) - (s2)) * stbi__f2f(0.353553391f); \
+   int o0 = (s1) * stbi__f2f(0.461939766f) + (s3) * stbi__f2f(0.191341716f); \
+   int o1 = (s1) * stbi__f2f(0.191341716f) - (s3) * stbi__f2f(0.461939766f)
+
+static void stbi__idct_block_4x4(stbi_uc *out, int out_stride, short data[64])
+{
+   int i, rows[16];
+   // rows, keeping 3 bits of fraction out of the 12
+   for (i=0; i < 4; ++i) {
+      short *d = data + i*8;
+      STBI__IDCT_4(d[0], d[1], d[2], d[3]);
+      rows[i*4+0] = (e0 + o0 + 256) >> 9;
+      rows[i*4+1] = (e1 + o1 + 256) >> 9;
+      rows[i*4+2] = (e1 - o1 + 256) >> 9;
+      rows[i*4+3] = (e0 - o0 + 256) >> 9;
+   }
+   // columns, then the 12 + 3 bits of scale come off along with the level shift
+   for (i=0; i < 4; ++i) {
+      int *r = rows + i;
+      int bias = (128 << 15) + (1 << 14);
+      STBI__IDCT_4(r[0], r[4], r[8], r[12]);
+      out[i               ] = stbi__clamp((e0 + o0 + bias) >> 15);
+      out[i + out_stride  ] = stbi__clamp((e1 + o1 + bias) >> 15);
+      out[i + out_stride*2] = stbi__clamp((e1 - o1 + bias) >> 15);
+      out[i + out_stride*3] = stbi__clamp((e0 - o0 + bias) >> 15);
+   }
+}
+#undef STBI__IDCT_4
+
+// at N=2 both basis values are 1/(2 sqrt 2), so it's sums and differences over 8
+static void stbi__idct_block_2x2(stbi_uc *out, int out_stride, short data[64])
+{
+   int f00 = data[0], f01 = data[1], f10 = data[8], f11 = data[9];
+   int bias = (128 << 3) + 4;
+   out[0]            = stbi__clamp((f00 + f01 + f10 + f11 + bias) >> 3);
+   out[1]            = stbi__clamp((f00 - f01 + f10 - f11 + bias) >> 3);
+   out[out_stride]   = stbi__clamp((f00 + f01 - f10 - f11 + bias) >> 3);
+   out[out_stride+1] = stbi__clamp((f00 - f01 - f10 + f11 + bias) >> 3);
+}
+
+// 1/8 scale is just the DC term
+static void stbi__idct_block_1x1(stbi_uc *out, int out_stride, short data[64])
+{
+   STBI_NOTUSED(out_stride);
+   out[0] = stbi__clamp((data[0] + (128 << 3) + 4) >> 3);
+}
+
 #ifdef STBI_SSE2
 // sse2 integer IDCT. not the fastest possible implementation but it
 // produces bit-identical results to the generic C version so it's
@@ -2630,6 +2799,179 @@ static void stbi__idct_simd(stbi_uc *out, int out_stride, short data[64])
 
 #endif // STBI_SSE2
 
+#ifdef STBI_AVX2
+// the same integer IDCT as stbi__idct_simd, step for step, but the 32-bit
+// intermediates of a whole row of 8 sit in one ymm register instead of a
+// lo/hi pair of xmm registers, halving the multiply-add and butterfly work.
+// The 16-bit transposes stay 128 bits wide. Bit-identical to the SSE2 version.
+STBI__AVX2_TARGET static void stbi__idct_avx2(stbi_uc *out, int out_stride, short data[64])
+{
+   __m128i row0, row1, row2, row3, row4, row5, row6, row7;
+   __m128i tmp;
+
+   // dot product constant: even elems=x, odd elems=y
+   #define dct_const(x,y)  _mm256_setr_epi16((x),(y),(x),(y),(x),(y),(x),(y),(x),(y),(x),(y),(x),(y),(x),(y))
+
+   // x and y interleaved in column order, ready for madd
+   #define dct_pair(x,y) \
+      _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_unpacklo_epi16((x),(y))), _mm_unpackhi_epi16((x),(y)), 1)
+
+   // out(0) = c0[even]*x + c0[odd]*y   (c0, x, y 16-bit, out 32-bit)
+   // out(1) = c1[even]*x + c1[odd]*y
+   #define dct_rot(out0,out1, x,y,c0,c1) \
+      __m256i c0##xy = dct_pair(x,y); \
+      __m256i out0 = _mm256_madd_epi16(c0##xy, c0); \
+      __m256i out1 = _mm256_madd_epi16(c0##xy, c1)
+
+   // out = in << 12  (in 16-bit, out 32-bit)
+   #define dct_widen(out, in) \
+      __m256i out = _mm256_slli_epi32(_mm256_cvtepi16_epi32(in), 12)
+
+   // 8 32-bit values back to 16 bits, saturating, in order
+   #define dct_pack(v) \
+      _mm_packs_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256((v), 1))
+
+   // butterfly a/b, add bias, then shift by "s" and pack
+   #define dct_bfly32o(out0, out1, a,b,bias,s) \
+      { \
+         __m256i abiased = _mm256_add_epi32(a, bias); \
+         __m256i sum = _mm256_add_epi32(abiased, b); \
+         __m256i dif = _mm256_sub_epi32(abiased, b); \
+         out0 = dct_pack(_mm256_srai_epi32(sum, s)); \
+         out1 = dct_pack(_mm256_srai_epi32(dif, s)); \
+      }
+
+   // 8-bit interleave step (for transposes)
+   #define dct_interleave8(a, b) \
+      tmp = a; \
+      a = _mm_unpacklo_epi8(a, b); \
+      b = _mm_unpackhi_epi8(tmp, b)
+
+   // 16-bit interleave step (for transposes)
+   #define dct_interleave16(a, b) \
+      tmp = a; \
+      a = _mm_unpacklo_epi16(a, b); \
+      b = _mm_unpackhi_epi16(tmp, b)
+
+   #define dct_pass(bias,shift) \
+      { \
+         /* even part */ \
+         dct_rot(t2e,t3e, row2,row6, rot0_0,rot0_1); \
+         __m128i sum04 = _mm_add_epi16(row0, row4); \
+         __m128i dif04 = _mm_sub_epi16(row0, row4); \
+         dct_widen(t0e, sum04); \
+         dct_widen(t1e, dif04); \
+         __m256i x0 = _mm256_add_epi32(t0e, t3e); \
+         __m256i x3 = _mm256_sub_epi32(t0e, t3e); \
+         __m256i x1 = _mm256_add_epi32(t1e, t2e); \
+         __m256i x2 = _mm256_sub_epi32(t1e, t2e); \
+         /* odd part */ \
+         dct_rot(y0o,y2o, row7,row3, rot2_0,rot2_1); \
+         dct_rot(y1o,y3o, row5,row1, rot3_0,rot3_1); \
+         __m128i sum17 = _mm_add_epi16(row1, row7); \
+         __m128i sum35 = _mm_add_epi16(row3, row5); \
+         dct_rot(y4o,y5o, sum17,sum35, rot1_0,rot1_1); \
+         __m256i x4 = _mm256_add_epi32(y0o, y4o); \
+         __m256i x5 = _mm256_add_epi32(y1o, y5o); \
+         __m256i x6 = _mm256_add_epi32(y2o, y5o); \
+         __m256i x7 = _mm256_add_epi32(y3o, y4o); \
+         dct_bfly32o(row0,row7, x0,x7,bias,shift); \
+         dct_bfly32o(row1,row6, x1,x6,bias,shift); \
+         dct_bfly32o(row2,row5, x2,x5,bias,shift); \
+         dct_bfly32o(row3,row4, x3,x4,bias,shift); \
+      }
+
+   __m256i rot0_0 = dct_const(stbi__f2f(0.5411961f), stbi__f2f(0.5411961f) + stbi__f2f(-1.847759065f));
+   __m256i rot0_1 = dct_const(stbi__f2f(0.5411961f) + stbi__f2f( 0.765366865f), stbi__f2f(0.5411961f));
+   __m256i rot1_0 = dct_const(stbi__f2f(1.175875602f) + stbi__f2f(-0.899976223f), stbi__f2f(1.175875602f));
+   __m256i rot1_1 = dct_const(stbi__f2f(1.175875602f), stbi__f2f(1.175875602f) + stbi__f2f(-2.562915447f));
+   __m256i rot2_0 = dct_const(stbi__f2f(-1.961570560f) + stbi__f2f( 0.298631336f), stbi__f2f(-1.961570560f));
+   __m256i rot2_1 = dct_const(stbi__f2f(-1.961570560f), stbi__f2f(-1.961570560f) + stbi__f2f( 3.072711026f));
+   __m256i rot3_0 = dct_const(stbi__f2f(-0.390180644f) + stbi__f2f( 2.053119869f), stbi__f2f(-0.390180644f));
+   __m256i rot3_1 = dct_const(stbi__f2f(-0.390180644f), stbi__f2f(-0.390180644f) + stbi__f2f( 1.501321110f));
+
+   // rounding biases in column/row passes, see stbi__idct_block for explanation.
+   __m256i bias_0 = _mm256_set1_epi32(512);
+   __m256i bias_1 = _mm256_set1_epi32(65536 + (128<<17));
+
+   // load
+   row0 = _mm_load_si128((const __m128i *) (data + 0*8));
+   row1 = _mm_load_si128((const __m128i *) (data + 1*8));
+   row2 = _mm_load_si128((const __m128i *) (data + 2*8));
+   row3 = _mm_load_si128((const __m128i *) (data + 3*8));
+   row4 = _mm_load_si128((const __m128i *) (data + 4*8));
+   row5 = _mm_load_si128((const __m128i *) (data + 5*8));
+   row6 = _mm_load_si128((const __m128i *) (data + 6*8));
+   row7 = _mm_load_si128((const __m128i *) (data + 7*8));
+
+   // column pass
+   dct_pass(bias_0, 10);
+
+   {
+      // 16bit 8x8 transpose pass 1
+      dct_interleave16(row0, row4);
+      dct_interleave16(row1, row5);
+      dct_interleave16(row2, row6);
+      dct_interleave16(row3, row7);
+
+      // transpose pass 2
+      dct_interleave16(row0, row2);
+      dct_interleave16(row1, row3);
+      dct_interleave16(row4, row6);
+      dct_interleave16(row5, row7);
+
+      // transpose pass 3
+      dct_interleave16(row0, row1);
+      dct_interleave16(row2, row3);
+      dct_interleave16(row4, row5);
+      dct_interleave16(row6, row7);
+   }
+
+   // row pass
+   dct_pass(bias_1, 17);
+
+   {
+      // pack
+      __m128i p0 = _mm_packus_epi16(row0, row1); // a0a1a2a3...a7b0b1b2b3...b7
+      __m128i p1 = _mm_packus_epi16(row2, row3);
+      __m128i p2 = _mm_packus_epi16(row4, row5);
+      __m128i p3 = _mm_packus_epi16(row6, row7);
+
+      // 8bit 8x8 transpose pass 1
+      dct_interleave8(p0, p2); // a0e0a1e1...
+      dct_interleave8(p1, p3); // c0g0c1g1...
+
+      // transpose pass 2
+      dct_interleave8(p0, p1); // a0c0e0g0...
+      dct_interleave8(p2, p3); // b0d0f0h0...
+
+      // transpose pass 3
+      dct_interleave8(p0, p2); // a0b0c0d0...
+      dct_interleave8(p1, p3); // a4b4c4d4...
+
+      // store
+      _mm_storel_epi64((__m128i *) out, p0); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, _mm_shuffle_epi32(p0, 0x4e)); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, p2); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, _mm_shuffle_epi32(p2, 0x4e)); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, p1); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, _mm_shuffle_epi32(p1, 0x4e)); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, p3); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, _mm_shuffle_epi32(p3, 0x4e));
+   }
+
+#undef dct_const
+#undef dct_pair
+#undef dct_rot
+#undef dct_widen
+#undef dct_pack
+#undef dct_bfly32o
+#undef dct_interleave8
+#undef dct_interleave16
+#undef dct_pass
+}
+#endif // STBI_AVX2
+
 #ifdef STBI_NEON
 
 // NEON integer IDCT. should produce bit-identical
@@ -2890,7 +3232,7 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
             for (i=0; i < w; ++i) {
                int ha = z->img_comp[n].ha;
                if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
-               z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data);
+               z->idct_block_kernel(z->img_comp[n].data+((z->img_comp[n].w2*j*8+i*8) >> z->scale_shift), z->img_comp[n].w2, data);
                // every data block is an MCU, so countdown the restart interval
                if (--z->todo <= 0) {
                   if (z->code_bits < 24) stbi__grow_buffer_unsafe(z);
@@ -2914,8 +3256,8 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
                   // by the basic H and V specified for the component
                   for (y=0; y < z->img_comp[n].v; ++y) {
                      for (x=0; x < z->img_comp[n].h; ++x) {
-                        int x2 = (i*z->img_comp[n].h + x)*8;
-                        int y2 = (j*z->img_comp[n].v + y)*8;
+                        int x2 = (i*z->img_comp[n].h + x)*(8 >> z->scale_shift);
+                        int y2 = (j*z->img_comp[n].v + y)*(8 >> z->scale_shift);
                         int ha = z->img_comp[n].ha;
                         if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
                         z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*y2+x2, z->img_comp[n].w2, data);
@@ -3015,7 +3357,7 @@ static void stbi__jpeg_finish(stbi__jpeg *z)
             for (i=0; i < w; ++i) {
                short *data = z->img_comp[n].coeff + 64 * (i + j * z->img_comp[n].coeff_w);
                stbi__jpeg_dequantize(data, z->dequant[z->img_comp[n].tq]);
-               z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data);
+               z->idct_block_kernel(z->img_comp[n].data+((z->img_comp[n].w2*j*8+i*8) >> z->scale_shift), z->img_comp[n].w2, data);
             }
          }
       }
@@ -3247,8 +3589,10 @@ static int stbi__process_frame_header(stbi__jpeg *z, int scan)
       //
       // img_mcu_x, img_mcu_y: <=17 bits; comp[i].h and .v are <=4 (checked earlier)
       // so these muls can't overflow with 32-bit ints (which we require)
-      z->img_comp[i].w2 = z->img_mcu_x * z->img_comp[i].h * 8;
-      z->img_comp[i].h2 = z->img_mcu_y * z->img_comp[i].v * 8;
+      //
+      // at a reduced scale the blocks are smaller, so is the buffer
+      z->img_comp[i].w2 = z->img_mcu_x * z->img_comp[i].h * (8 >> z->scale_shift);
+      z->img_comp[i].h2 = z->img_mcu_y * z->img_comp[i].v * (8 >> z->scale_shift);
       z->img_comp[i].coeff = 0;
       z->img_comp[i].raw_coeff = 0;
       z->img_comp[i].linebuf = NULL;
@@ -3258,10 +3602,10 @@ static int stbi__process_frame_header(stbi__jpeg *z, int scan)
       // align blocks for idct using mmx/sse
       z->img_comp[i].data = (stbi_uc*) (((size_t) z->img_comp[i].raw_data + 15) & ~15);
       if (z->progressive) {
-         // w2, h2 are multiples of 8 (see above)
-         z->img_comp[i].coeff_w = z->img_comp[i].w2 / 8;
-         z->img_comp[i].coeff_h = z->img_comp[i].h2 / 8;
-         z->img_comp[i].raw_coeff = stbi__malloc_mad3(z->img_comp[i].w2, z->img_comp[i].h2, sizeof(short), 15);
+         // one block of coefficients for every block of (8 >> scale_shift) samples
+         z->img_comp[i].coeff_w = z->img_mcu_x * z->img_comp[i].h;
+         z->img_comp[i].coeff_h = z->img_mcu_y * z->img_comp[i].v;
+         z->img_comp[i].raw_coeff = stbi__malloc_mad3(z->img_comp[i].coeff_w * 8, z->img_comp[i].coeff_h * 8, sizeof(short), 15);
          if (z->img_comp[i].raw_coeff == NULL)
             return stbi__free_jpeg_components(z, i+1, stbi__err("outofmem", "Out of memory"));
          z->img_comp[i].coeff = (short*) (((size_t) z->img_comp[i].raw_coeff + 15) & ~15);
@@ -3305,6 +3649,22 @@ static int stbi__decode_jpeg_header(stbi__jpeg *z, int scan)
 }
 
 // decode image to YCbCr format
+// skip a scan's entropy coded data without decoding it, up to the next marker
+// that isn't a restart
+static void stbi__jpeg_skip_scan(stbi__jpeg *j)
+{
+   while (!stbi__at_eof(j->s)) {
+      int x = stbi__get8(j->s);
+      if (x == 255) {
+         do x = stbi__get8(j->s); while (x == 255 && !stbi__at_eof(j->s));
+         if (x != 0 && !STBI__RESTART(x)) { // 0 is a stuffed 255 data byte
+            j->marker = (unsigned char) x;
+            return;
+         }
+      }
+   }
+}
+
 static int stbi__decode_jpeg_image(stbi__jpeg *j)
 {
    int m;
@@ -3318,7 +3678,13 @@ static int stbi__decode_jpeg_image(stbi__jpeg *j)
    while (!stbi__EOI(m)) {
       if (stbi__SOS(m)) {
          if (!stbi__process_scan_header(j)) return 0;
-         if (!stbi__parse_entropy_coded_data(j)) return 0;
+         if (j->progressive && j->spec_start > 0 && j->scale_shift == 3) {
+            // an AC scan of a progressive JPEG, when all 1/8 scale wants is the DC.
+            // (1/2 and 1/4 can't skip the high frequencies the same way: a later
+            // refinement scan can cover both them and the ones that are used, and
+            // refining needs to know which coefficients the earlier scans set)
+            stbi__jpeg_skip_scan(j);
+         } else if (!stbi__parse_entropy_coded_data(j)) return 0;
          if (j->marker == STBI__MARKER_none ) {
             // handle 0s at the end of image data from IP Kamera 9060
             while (!stbi__at_eof(j->s)) {
@@ -3542,6 +3908,67 @@ static stbi_uc *stbi__resample_row_hv_2_simd(stbi_uc *out, stbi_uc *in_near, stb
 }
 #endif
 
+#ifdef STBI_AVX2
+// stbi__resample_row_hv_2_simd 16 input pixels (32 output) at a time; the
+// remainder goes through the same scalar code, which gives identical results
+STBI__AVX2_TARGET static stbi_uc *stbi__resample_row_hv_2_avx2(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs)
+{
+   int i=0,t0,t1;
+
+   if (w == 1) {
+      out[0] = out[1] = stbi__div4(3*in_near[0] + in_far[0] + 2);
+      return out;
+   }
+
+   t1 = 3*in_near[0] + in_far[0];
+   for (; i < ((w-1) & ~15); i += 16) {
+      // vertical pass, 3*x + y = 4*x + (y - x)
+      __m256i farw  = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) (in_far + i)));
+      __m256i nearw = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) (in_near + i)));
+      __m256i curr  = _mm256_add_epi16(_mm256_slli_epi16(nearw, 2), _mm256_sub_epi16(farw, nearw));
+
+      // "prev" is curr moved along one pixel with t1 coming in at the start,
+      // "next" the other way with the first pixel of the next 16 at the end.
+      // alignr works within 128-bit lanes, so the lane that crosses over is
+      // brought in with a permute first
+      __m256i lowlane  = _mm256_permute2x128_si256(curr, curr, 0x08); // [0, curr.lo]
+      __m256i highlane = _mm256_permute2x128_si256(curr, curr, 0x81); // [curr.hi, 0]
+      __m256i prev = _mm256_insert_epi16(_mm256_alignr_epi8(curr, lowlane, 14), (short) t1, 0);
+      __m256i next = _mm256_insert_epi16(_mm256_alignr_epi8(highlane, curr, 2), (short) (3*in_near[i+16] + in_far[i+16]), 15);
+
+      // horizontal pass, polyphase: even = 3*cur + prev, odd = 3*cur + next
+      __m256i curb = _mm256_add_epi16(_mm256_slli_epi16(curr, 2), _mm256_set1_epi16(8));
+      __m256i even = _mm256_add_epi16(_mm256_sub_epi16(prev, curr), curb);
+      __m256i odd  = _mm256_add_epi16(_mm256_sub_epi16(next, curr), curb);
+
+      // interleave even and odd pixels, undo scaling; the per-lane unpacks and
+      // pack leave the 32 outputs in order
+      __m256i int0 = _mm256_srli_epi16(_mm256_unpacklo_epi16(even, odd), 4);
+      __m256i int1 = _mm256_srli_epi16(_mm256_unpackhi_epi16(even, odd), 4);
+      _mm256_storeu_si256((__m256i *) (out + i*2), _mm256_packus_epi16(int0, int1));
+
+      // "previous" value for next iter
+      t1 = 3*in_near[i+15] + in_far[i+15];
+   }
+
+   t0 = t1;
+   t1 = 3*in_near[i] + in_far[i];
+   out[i*2] = stbi__div16(3*t1 + t0 + 8);
+
+   for (++i; i < w; ++i) {
+      t0 = t1;
+      t1 = 3*in_near[i]+in_far[i];
+      out[i*2-1] = stbi__div16(3*t0 + t1 + 8);
+      out[i*2  ] = stbi__div16(3*t1 + t0 + 8);
+   }
+   out[w*2-1] = stbi__div4(t1+2);
+
+   STBI_NOTUSED(hs);
+
+   return out;
+}
+#endif
+
 static stbi_uc *stbi__resample_row_generic(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs)
 {
    // resample with nearest-neighbor
@@ -3716,6 +4143,98 @@ static void stbi__YCbCr_to_RGB_simd(stbi_uc *out, stbi_uc const *y, stbi_uc cons
 }
 #endif
 
+#ifdef STBI_AVX2
+// the SSE2 color transform 16 pixels at a time. Unlike the SSE2 version this
+// also handles step == 3 (RGB output, what textures usually ask for): each
+// group of 4 RGBX pixels is squeezed to 12 bytes with a shuffle and the
+// stores overlap, so it stops while there are at least 2 pixels left over.
+// The math is the same fixed point as stbi__YCbCr_to_RGB_row, bit for bit
+STBI__AVX2_TARGET static void stbi__YCbCr_to_RGB_avx2(stbi_uc *out, stbi_uc const *y, stbi_uc const *pcb, stbi_uc const *pcr, int count, int step)
+{
+   int i = 0;
+
+   if (step == 3 || step == 4) {
+      __m128i signflip  = _mm_set1_epi8(-0x80);
+      __m256i cr_const0 = _mm256_set1_epi16(   (short) ( 1.40200f*4096.0f+0.5f));
+      __m256i cr_const1 = _mm256_set1_epi16( - (short) ( 0.71414f*4096.0f+0.5f));
+      __m256i cb_const0 = _mm256_set1_epi16( - (short) ( 0.34414f*4096.0f+0.5f));
+      __m256i cb_const1 = _mm256_set1_epi16(   (short) ( 1.77200f*4096.0f+0.5f));
+      __m256i y_bias = _mm256_set1_epi16(8);
+      __m256i xw = _mm256_set1_epi16(255); // alpha channel
+      // RGBX x4 -> RGB x4, the last 4 bytes are don't care
+      __m128i squeeze = _mm_setr_epi8(0,1,2, 4,5,6, 8,9,10, 12,13,14, -1,-1,-1,-1);
+      int last = step == 4 ? count - 16 : count - 18;
+
+      for (; i <= last; i += 16) {
+         // load and widen; cr and cb get the 128 taken off and move to the top byte
+         __m256i yw  = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) (y+i)));
+         __m256i crw = _mm256_slli_epi16(_mm256_cvtepi8_epi16(_mm_xor_si128(_mm_loadu_si128((__m128i *) (pcr+i)), signflip)), 8);
+         __m256i cbw = _mm256_slli_epi16(_mm256_cvtepi8_epi16(_mm_xor_si128(_mm_loadu_si128((__m128i *) (pcb+i)), signflip)), 8);
+
+         // color transform: (y << 8 | 128) >> 4 is y*16 + 8
+         __m256i yws = _mm256_add_epi16(_mm256_slli_epi16(yw, 4), y_bias);
+         __m256i cr0 = _mm256_mulhi_epi16(cr_const0, crw);
+         __m256i cb0 = _mm256_mulhi_epi16(cb_const0, cbw);
+         __m256i cb1 = _mm256_mulhi_epi16(cbw, cb_const1);
+         __m256i cr1 = _mm256_mulhi_epi16(crw, cr_const1);
+         __m256i rws = _mm256_add_epi16(cr0, yws);
+         __m256i gwt = _mm256_add_epi16(cb0, yws);
+         __m256i bws = _mm256_add_epi16(yws, cb1);
+         __m256i gws = _mm256_add_epi16(gwt, cr1);
+
+         // descale
+         __m256i rw = _mm256_srai_epi16(rws, 4);
+         __m256i bw = _mm256_srai_epi16(bws, 4);
+         __m256i gw = _mm256_srai_epi16(gws, 4);
+
+         // back to byte and interleave, within each 128-bit lane: pixels 0-3
+         // and 8-11 in o0, 4-7 and 12-15 in o1
+         __m256i brb = _mm256_packus_epi16(rw, bw);
+         __m256i gxb = _mm256_packus_epi16(gw, xw);
+         __m256i t0 = _mm256_unpacklo_epi8(brb, gxb);
+         __m256i t1 = _mm256_unpackhi_epi8(brb, gxb);
+         __m256i o0 = _mm256_unpacklo_epi16(t0, t1);
+         __m256i o1 = _mm256_unpackhi_epi16(t0, t1);
+         __m256i first  = _mm256_permute2x128_si256(o0, o1, 0x20); // pixels 0-7
+         __m256i second = _mm256_permute2x128_si256(o0, o1, 0x31); // pixels 8-15
+
+         if (step == 4) {
+            _mm256_storeu_si256((__m256i *) (out + 0), first);
+            _mm256_storeu_si256((__m256i *) (out + 32), second);
+            out += 64;
+         } else {
+            _mm_storeu_si128((__m128i *) (out + 0),  _mm_shuffle_epi8(_mm256_castsi256_si128(first), squeeze));
+            _mm_storeu_si128((__m128i *) (out + 12), _mm_shuffle_epi8(_mm256_extracti128_si256(first, 1), squeeze));
+            _mm_storeu_si128((__m128i *) (out + 24), _mm_shuffle_epi8(_mm256_castsi256_si128(second), squeeze));
+            _mm_storeu_si128((__m128i *) (out + 36), _mm_shuffle_epi8(_mm256_extracti128_si256(second, 1), squeeze));
+            out += 48;
+         }
+      }
+   }
+
+   for (; i < count; ++i) {
+      int y_fixed = (y[i] << 20) + (1<<19); // rounding
+      int r,g,b;
+      int cr = pcr[i] - 128;
+      int cb = pcb[i] - 128;
+      r = y_fixed + cr* stbi__float2fixed(1.40200f);
+      g = y_fixed + cr*-stbi__float2fixed(0.71414f) + ((cb*-stbi__float2fixed(0.34414f)) & 0xffff0000);
+      b = y_fixed                                   +   cb* stbi__float2fixed(1.77200f);
+      r >>= 20;
+      g >>= 20;
+      b >>= 20;
+      if ((unsigned) r > 255) { if (r < 0) r = 0; else r = 255; }
+      if ((unsigned) g > 255) { if (g < 0) g = 0; else g = 255; }
+      if ((unsigned) b > 255) { if (b < 0) b = 0; else b = 255; }
+      out[0] = (stbi_uc)r;
+      out[1] = (stbi_uc)g;
+      out[2] = (stbi_uc)b;
+      out[3] = 255;
+      out += step;
+   }
+}
+#endif
+
 // set up the kernels
 static void stbi__setup_jpeg(stbi__jpeg *j)
 {
@@ -3731,11 +4250,30 @@ static void stbi__setup_jpeg(stbi__jpeg *j)
    }
 #endif
 
+#ifdef STBI_AVX2
+   if (stbi__avx2_available()) {
+      j->idct_block_kernel = stbi__idct_avx2;
+      j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_avx2;
+      j->resample_row_hv_2_kernel = stbi__resample_row_hv_2_avx2;
+   }
+#endif
+
 #ifdef STBI_NEON
    j->idct_block_kernel = stbi__idct_simd;
    j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_simd;
    j->resample_row_hv_2_kernel = stbi__resample_row_hv_2_simd;
 #endif
+
+   j->scale_shift = stbi__jpeg_scale_shift;
+   if (j->scale_shift == 1) j->idct_block_kernel = stbi__idct_block_4x4;
+   if (j->scale_shift == 2) j->idct_block_kernel = stbi__idct_block_2x2;
+   if (j->scale_shift == 3) j->idct_block_kernel = stbi__idct_block_1x1;
+}
+
+// sizes at the scale being decoded: how many of the smaller blocks' samples cover n full ones
+static stbi__uint32 stbi__jpeg_scaled(stbi__jpeg *j, stbi__uint32 n)
+{
+   return (n + (1u << j->scale_shift) - 1) >> j->scale_shift;
 }
 
 // clean up the temporary component buffers
@@ -3772,6 +4310,16 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
    // load a jpeg image from whichever source, but leave in YCbCr format
    if (!stbi__decode_jpeg_image(z)) { stbi__cleanup_jpeg(z); return NULL; }
 
+   // from here on the image and its components are counted in samples at the decoded scale
+   if (z->scale_shift) {
+      z->s->img_x = stbi__jpeg_scaled(z, z->s->img_x);
+      z->s->img_y = stbi__jpeg_scaled(z, z->s->img_y);
+      for (n=0; n < z->s->img_n; ++n) {
+         z->img_comp[n].x = stbi__jpeg_scaled(z, z->img_comp[n].x);
+         z->img_comp[n].y = stbi__jpeg_scaled(z, z->img_comp[n].y);
+      }
+   }
+
    // determine actual number of components to generate
    n = req_comp ? req_comp : z->s->img_n >= 3 ? 3 : 1;
 
@@ -3950,8 +4498,8 @@ static int stbi__jpeg_info_raw(stbi__jpeg *j, int *x, int *y, int *comp)
       stbi__rewind( j->s );
       return 0;
    }
-   if (x) *x = j->s->img_x;
-   if (y) *y = j->s->img_y;
+   if (x) *x = stbi__jpeg_scaled(j, j->s->img_x);
+   if (y) *y = stbi__jpeg_scaled(j, j->s->img_y);
    if (comp) *comp = j->s->img_n >= 3 ? 3 : 1;
    return 1;
 }
@@ -3961,6 +4509,7 @@ static int stbi__jpeg_info(stbi__context *s, int *x, int *y, int *comp)
    int result;
    stbi__jpeg* j = (stbi__jpeg*) (stbi__malloc(sizeof(stbi__jpeg)));
    j->s = s;
+   j->scale_shift = stbi__jpeg_scale_shift;
    result = stbi__jpeg_info_raw(j, x, y, comp);
    STBI_FREE(j);
    return result;
@@ -3973,6 +4522,12 @@ static int stbi__jpeg_info(stbi__context *s, int *x, int *y, int *comp)
 //      - all output is written to a single output buffer (can malloc/realloc)
 //    performance
 //      - fast huffman
+//      - while there is plenty of input and output room left, a fast loop
+//        refills a 64-bit bit buffer 8 bytes at a time, looks literals and
+//        lengths up in an 11-bit table whose entries can hold two literals
+//        (or a length with its base and extra bit count ready), and copies
+//        matches 8 bytes at a time. Near either end it drops back to the
+//        careful one symbol at a time loop, so the output is the same.
 
 #ifndef STBI_NO_ZLIB
 
@@ -3980,6 +4535,10 @@ static int stbi__jpeg_info(stbi__context *s, int *x, int *y, int *comp)
 #define STBI__ZFAST_BITS  9 // accelerate all cases in default tables
 #define STBI__ZFAST_MASK  ((1 << STBI__ZFAST_BITS) - 1)
 
+// the literal/length table of the fast loop
+#define STBI__ZLIT_BITS   11
+#define STBI__ZLIT_MASK   ((1 << STBI__ZLIT_BITS) - 1)
+
 // zlib-style huffman encoding
 // (jpegs packs from left, zlib from right, so can't share code)
 typedef struct
@@ -4066,7 +4625,7 @@ typedef struct
 {
    stbi_uc *zbuffer, *zbuffer_end;
    int num_bits;
-   stbi__uint32 code_buffer;
+   stbi__uint64 code_buffer;
 
    char *zout;
    char *zout_start;
@@ -4074,6 +4633,14 @@ typedef struct
    int   z_expandable;
 
    stbi__zhuffman z_length, z_distance;
+
+   // indexed by the next 11 bits of input:
+   //   bits 0-3   bits used
+   //   bits 4-5   0: not in the table (long code), 1: literals, 3: length or end of block
+   //   bit  6     set when there are two literals
+   //   bits 8-15  first literal, or the length symbol - 256
+   //   bits 16-23 second literal, or for a length: bits 16-24 its base and 25-28 its extra bit count
+   stbi__uint32 z_lit[1 << STBI__ZLIT_BITS];
 } stbi__zbuf;
 
 stbi_inline static int stbi__zeof(stbi__zbuf *z)
@@ -4089,7 +4656,7 @@ stbi_inline static stbi_uc stbi__zget8(stbi__zbuf *z)
 static void stbi__fill_bits(stbi__zbuf *z)
 {
    do {
-      if (z->code_buffer >= (1U << z->num_bits)) {
+      if (z->code_buffer >= ((stbi__uint64) 1 << z->num_bits)) {
         z->zbuffer = z->zbuffer_end;  /* treat this as EOF so we fail. */
         return;
       }
@@ -4102,7 +4669,7 @@ stbi_inline static unsigned int stbi__zreceive(stbi__zbuf *z, int n)
 {
    unsigned int k;
    if (z->num_bits < n) stbi__fill_bits(z);
-   k = z->code_buffer & ((1 << n) - 1);
+   k = (unsigned int) z->code_buffer & ((1 << n) - 1);
    z->code_buffer >>= n;
    z->num_bits -= n;
    return k;
@@ -4113,7 +4680,7 @@ static int stbi__zhuffman_decode_slowpath(stbi__zbuf *a, stbi__zhuffman *z)
    int b,s,k;
    // not resolved by fast table, so compute it the slow way
    // use jpeg approach, which requires MSbits at top
-   k = stbi__bit_reverse(a->code_buffer, 16);
+   k = stbi__bit_reverse((int) (a->code_buffer & 0xffff), 16);
    for (s=STBI__ZFAST_BITS+1; ; ++s)
       if (k < z->maxcode[s])
          break;
@@ -4182,10 +4749,160 @@ static const int stbi__zdist_base[32] = { 1,2,3,4,5,7,9,13,17,25,33,49,65,97,129
 static const int stbi__zdist_extra[32] =
 { 0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13};
 
+// the fast loop's literal/length table (see stbi__zbuf) from z_length
+static void stbi__zbuild_lit_table(stbi__zbuf *a)
+{
+   stbi__zhuffman *z = &a->z_length;
+   stbi__uint32 *t = a->z_lit;
+   int i, j;
+
+   // first every code up to 11 bits long, the same way z->fast is filled
+   memset(t, 0, sizeof(a->z_lit));
+   for (i=1; i <= STBI__ZLIT_BITS; ++i) {
+      // symbols of length i sit at firstsymbol[i] onwards, codes counting up from firstcode[i]
+      int first = z->firstsymbol[i], count = (z->maxcode[i] >> (16-i)) - z->firstcode[i];
+      for (j=0; j < count; ++j) {
+         int sym = z->value[first + j];
+         stbi__uint32 e;
+         int k = stbi__bit_reverse(z->firstcode[i] + j, i);
+         if (sym < 256)
+            e = (stbi__uint32) i | (1 << 4) | (stbi__uint32) sym << 8;
+         else if (sym == 256)
+            e = (stbi__uint32) i | (3 << 4);
+         else if (sym < 286)
+            e = (stbi__uint32) i | (3 << 4) | (stbi__uint32) (sym - 256) << 8 |
+                (stbi__uint32) stbi__zlength_base[sym-257] << 16 | (stbi__uint32) stbi__zlength_extra[sym-257] << 25;
+         else
+            continue; // 286 and 287 are never valid, leave them to the slow path to reject
+         while (k < (1 << STBI__ZLIT_BITS)) {
+            t[k] = e;
+            k += (1 << i);
+         }
+      }
+   }
+
+   // then a second literal behind each literal, when both codes fit in 11 bits.
+   // Backwards, so t[i >> used] is still the single literal entry when it's read
+   for (i=(1 << STBI__ZLIT_BITS)-1; i >= 0; --i) {
+      stbi__uint32 e = t[i], f;
+      int used = e & 15;
+      if (((e >> 4) & 3) != 1) continue;
+      f = t[i >> used];
+      if (((f >> 4) & 3) == 1 && used + (int) (f & 15) <= STBI__ZLIT_BITS)
+         t[i] = (stbi__uint32) (used + (f & 15)) | (1 << 4) | (1 << 6) | (e & 0xff00) | (f & 0xff00) << 8;
+   }
+}
+
 static int stbi__parse_huffman_block(stbi__zbuf *a)
 {
    char *zout = a->zout;
+   stbi__zbuild_lit_table(a);
    for(;;) {
+      // the fast loop: runs while 8 bytes can be read and the longest match
+      // plus an 8 byte overshoot fits in the output, and goes back to the
+      // careful loop below for anything unusual. The bit buffer lives in
+      // locals here, otherwise every byte written through zout could alias it
+      if (a->zbuffer_end - a->zbuffer >= 8 && a->zout_end - zout >= 258 + 8) {
+         stbi__uint64 bits = a->code_buffer;
+         int num_bits = a->num_bits;
+         stbi_uc *in = a->zbuffer, *in_end = a->zbuffer_end;
+         char *out_end = a->zout_end;
+         const stbi__uint32 *lit = a->z_lit;
+         const stbi__uint16 *dist_fast = a->z_distance.fast;
+         int done = 0;
+
+         while (in_end - in >= 8 && out_end - zout >= 258 + 8) {
+            stbi__uint32 e;
+            int len, dist, n;
+            stbi_uc *p;
+
+            // top up to at least 56 bits with one 8 byte read. Only whole bytes are
+            // counted, but the bits above num_bits are the next bytes of input all
+            // the same, and the next read puts the same values there again
+            bits |= ((stbi__uint64) in[0]       | (stbi__uint64) in[1] << 8  | (stbi__uint64) in[2] << 16 | (stbi__uint64) in[3] << 24 |
+                     (stbi__uint64) in[4] << 32 | (stbi__uint64) in[5] << 40 | (stbi__uint64) in[6] << 48 | (stbi__uint64) in[7] << 56) << num_bits;
+            in += (63 - num_bits) >> 3;
+            num_bits |= 56;
+
+            e = lit[bits & STBI__ZLIT_MASK];
+            n = e & 15;
+            if (((e >> 4) & 3) == 1) {
+               // one or two literals; always store two so it doesn't branch on which
+               zout[0] = (char) (e >> 8);
+               zout[1] = (char) (e >> 16);
+               zout += 1 + ((e >> 6) & 1);
+               bits >>= n;
+               num_bits -= n;
+               continue;
+            }
+            if (e == 0) {
+               done = 1; // a code longer than 11 bits
+               break;
+            }
+            bits >>= n;
+            num_bits -= n;
+            if (((e >> 8) & 0xff) == 0) {
+               done = 2; // end of block
+               break;
+            }
+
+            // a match: length code and extra bits (up to 11 + 5), distance code
+            // and extra bits (up to 15 + 13) all fit in the 56 bits
+            len = (e >> 16) & 0x1ff;
+            n = (e >> 25) & 15;
+            len += (int) (bits & ((1 << n) - 1));
+            bits >>= n;
+            num_bits -= n;
+
+            dist = dist_fast[bits & STBI__ZFAST_MASK];
+            if (dist) {
+               n = dist >> 9;
+               dist &= 511;
+               bits >>= n;
+               num_bits -= n;
+            } else {
+               a->code_buffer = bits;
+               a->num_bits = num_bits;
+               dist = stbi__zhuffman_decode_slowpath(a, &a->z_distance);
+               bits = a->code_buffer;
+               num_bits = a->num_bits;
+            }
+            if (dist < 0 || dist >= 30) return stbi__err("bad huffman code","Corrupt PNG");
+            n = stbi__zdist_extra[dist];
+            dist = stbi__zdist_base[dist] + (int) (bits & ((1 << n) - 1));
+            bits >>= n;
+            num_bits -= n;
+
+            if (zout - a->zout_start < dist) return stbi__err("bad dist","Corrupt PNG");
+            p = (stbi_uc *) (zout - dist);
+            if (dist == 1) {
+               memset(zout, *p, len);
+               zout += len;
+            } else if (dist >= 8) {
+               // 8 bytes at a time, running up to 7 past the end (there's room)
+               char *end = zout + len;
+               do {
+                  memcpy(zout, p, 8);
+                  zout += 8;
+                  p += 8;
+               } while (zout < end);
+               zout = end;
+            } else {
+               do *zout++ = *p++; while (--len);
+            }
+         }
+
+         // nothing above num_bits from here on, stbi__fill_bits relies on it
+         a->code_buffer = bits & ~(~(stbi__uint64) 0 << num_bits);
+         a->num_bits = num_bits;
+         a->zbuffer = in;
+         if (done == 2) {
+            a->zout = zout;
+            return 1;
+         }
+      }
+
+      {
       int z = stbi__zhuffman_decode(a, &a->z_length);
       if (z < 256) {
          if (z < 0) return stbi__err("bad huffman code","Corrupt PNG"); // error in huffman codes
@@ -4221,6 +4938,7 @@ static int stbi__parse_huffman_block(stbi__zbuf *a)
             if (len) { do *zout++ = *p++; while (--len); }
          }
       }
+      }
    }
 }
 
@@ -4277,12 +4995,12 @@ static int stbi__compute_huffman_codes(stbi__zbuf *a)
 static int stbi__parse_uncompressed_block(stbi__zbuf *a)
 {
    stbi_uc header[4];
-   int len,nlen,k;
+   int len,nlen,k,buffered;
    if (a->num_bits & 7)
       stbi__zreceive(a, a->num_bits & 7); // discard
    // drain the bit-packed data into header
    k = 0;
-   while (a->num_bits > 0) {
+   while (a->num_bits > 0 && k < 4) {
       header[k++] = (stbi_uc) (a->code_buffer & 255); // suppress MSVC run-time check
       a->code_buffer >>= 8;
       a->num_bits -= 8;
@@ -4294,9 +5012,18 @@ static int stbi__parse_uncompressed_block(stbi__zbuf *a)
    len  = header[1] * 256 + header[0];
    nlen = header[3] * 256 + header[2];
    if (nlen != (len ^ 0xffff)) return stbi__err("zlib corrupt","Corrupt PNG");
-   if (a->zbuffer + len > a->zbuffer_end) return stbi__err("read past buffer","Corrupt PNG");
+   // the fast loop reads ahead, so some of the stored bytes may be in the bit buffer already
+   buffered = a->num_bits >> 3;
+   if (buffered > len) buffered = len;
+   if (a->zbuffer + (len - buffered) > a->zbuffer_end) return stbi__err("read past buffer","Corrupt PNG");
    if (a->zout + len > a->zout_end)
       if (!stbi__zexpand(a, a->zout, len)) return 0;
+   for (k=0; k < buffered; ++k) {
+      *a->zout++ = (char) (a->code_buffer & 255);
+      a->code_buffer >>= 8;
+      a->num_bits -= 8;
+   }
+   len -= buffered;
    memcpy(a->zout, a->zbuffer, len);
    a->zbuffer += len;
    a->zout += len;
@@ -4535,6 +5262,90 @@ static int stbi__paeth(int a, int b, int c)
 
 static const stbi_uc stbi__depth_scale_table[9] = { 0, 0xff, 0x55, 0, 0x11, 0,0,0, 0x01 };
 
+#ifdef STBI_SSE2
+stbi_inline static __m128i stbi__png_load_pixel(const stbi_uc *p, int n)
+{
+   stbi__uint32 v = p[0] | p[1] << 8 | p[2] << 16;
+   if (n == 4) v |= (stbi__uint32) p[3] << 24;
+   return _mm_cvtsi32_si128((int) v);
+}
+
+stbi_inline static void stbi__png_store_pixel(stbi_uc *p, int n, __m128i x)
+{
+   stbi__uint32 v = (stbi__uint32) _mm_cvtsi128_si32(x);
+   p[0] = STBI__BYTECAST(v);
+   p[1] = STBI__BYTECAST(v >> 8);
+   p[2] = STBI__BYTECAST(v >> 16);
+   if (n == 4) p[3] = STBI__BYTECAST(v >> 24);
+}
+
+// undo the filter on all but the first pixel of a row of 8-bit RGB or RGBA pixels
+// (expanding RGB to RGBA if out_n is 4), with the channels of a pixel side by side
+// in one register instead of one byte at a time. The filters still depend on the
+// pixel to the left, so it's one pixel per step, but the per-channel loop and its
+// branches are gone. Avg and paeth are done in 16-bit lanes; paeth picks whichever
+// of a, b, c has the smallest distance, preferring a then b like stbi__paeth.
+static void stbi__unfilter_row_sse2(int filter, stbi_uc *cur, const stbi_uc *prior, const stbi_uc *raw, stbi__uint32 pixels, int img_n, int out_n)
+{
+   __m128i zero = _mm_setzero_si128();
+   __m128i alpha = _mm_cvtsi32_si128(img_n != out_n ? (int) 0xff000000 : 0);
+   __m128i a = stbi__png_load_pixel(cur - out_n, out_n); // the pixel to the left, already done
+   __m128i c = zero;
+   stbi__uint32 i;
+   if (filter == STBI__F_paeth)
+      c = stbi__png_load_pixel(prior - out_n, out_n); // there's no prior row for the first row's filters
+
+   for (i=0; i < pixels; ++i, raw += img_n, cur += out_n, prior += out_n) {
+      __m128i x = stbi__png_load_pixel(raw, img_n);
+      __m128i b, a16, b16, c16;
+      switch (filter) {
+         case STBI__F_none:
+            break;
+         case STBI__F_sub:
+         case STBI__F_paeth_first: // paeth(a,0,0) is a
+            x = _mm_add_epi8(x, a);
+            break;
+         case STBI__F_up:
+            x = _mm_add_epi8(x, stbi__png_load_pixel(prior, out_n));
+            break;
+         case STBI__F_avg:
+            a16 = _mm_unpacklo_epi8(a, zero);
+            b16 = _mm_unpacklo_epi8(stbi__png_load_pixel(prior, out_n), zero);
+            x = _mm_add_epi8(x, _mm_packus_epi16(_mm_srli_epi16(_mm_add_epi16(a16, b16), 1), zero));
+            break;
+         case STBI__F_avg_first:
+            x = _mm_add_epi8(x, _mm_packus_epi16(_mm_srli_epi16(_mm_unpacklo_epi8(a, zero), 1), zero));
+            break;
+         case STBI__F_paeth: {
+            __m128i pa, pb, pc, smallest, pick;
+            b = stbi__png_load_pixel(prior, out_n);
+            a16 = _mm_unpacklo_epi8(a, zero);
+            b16 = _mm_unpacklo_epi8(b, zero);
+            c16 = _mm_unpacklo_epi8(c, zero);
+            // p = a + b - c, so |p-a| = |b-c|, |p-b| = |a-c|, |p-c| = |(b-c) + (a-c)|
+            pa = _mm_sub_epi16(b16, c16);
+            pb = _mm_sub_epi16(a16, c16);
+            pc = _mm_add_epi16(pa, pb);
+            pa = _mm_max_epi16(pa, _mm_sub_epi16(zero, pa));
+            pb = _mm_max_epi16(pb, _mm_sub_epi16(zero, pb));
+            pc = _mm_max_epi16(pc, _mm_sub_epi16(zero, pc));
+            smallest = _mm_min_epi16(_mm_min_epi16(pa, pb), pc);
+            pick = c16;
+            pb = _mm_cmpeq_epi16(pb, smallest);
+            pick = _mm_or_si128(_mm_and_si128(pb, b16), _mm_andnot_si128(pb, pick));
+            pa = _mm_cmpeq_epi16(pa, smallest);
+            pick = _mm_or_si128(_mm_and_si128(pa, a16), _mm_andnot_si128(pa, pick));
+            x = _mm_add_epi8(x, _mm_packus_epi16(pick, zero));
+            c = b;
+            break;
+         }
+      }
+      a = _mm_or_si128(x, alpha);
+      stbi__png_store_pixel(cur, out_n, a);
+   }
+}
+#endif
+
 // create the png data from post-deflated data
 static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 raw_len, int out_n, stbi__uint32 x, stbi__uint32 y, int depth, int color)
 {
@@ -4614,6 +5425,14 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
          prior += 1;
       }
 
+#ifdef STBI_SSE2
+      if (depth == 8 && (img_n == 3 || img_n == 4) && !(filter == STBI__F_none && img_n == out_n) && stbi__sse2_available()) {
+         stbi__unfilter_row_sse2(filter, cur, prior, raw, x-1, img_n, out_n);
+         raw += (x-1)*img_n;
+         continue;
+      }
+#endif
+
       // this is a little gross, so that we don't switch per-pixel or per-component
       if (depth < 8 || img_n == out_n) {
          int nk = (width - 1)*filter_bytes;
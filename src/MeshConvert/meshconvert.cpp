@@ -0,0 +1,166 @@
+//
+// Offline mesh import into .g4mesh files.  No window and no GL.
+//
+//   meshconvert [--threads N] [--as-authored] [--no-lods] [--no-meshlets] [--lossless | --position-error F]
+//               [--normal-error DEGREES] [--uv-error F] [--half-positions] [-o folder] meshes...
+//
+// Every OBJ or binary PLY is imported (see meshimport.h), given a chain of LODs (see
+// meshsimplify.h, --no-lods for none), cut into meshlets for culling and reordered for the
+// vertex cache and vertex fetch meshlet by meshlet (see meshlets.h), or with --no-meshlets
+// reordered for the vertex cache, overdraw and vertex fetch as a whole (see
+// meshoptimize.h, --as-authored leaves it as it was), quantized within the error
+// bounds (see quantizeSettings; the position error is a fraction of the mesh's size,
+// --lossless keeps full floats) and written next to it, or in the -o folder, as a mesh
+// file with the same name (see meshfile.h), which g4g2 maps and draws without parsing
+// anything.  Each one is opened again afterwards and read through once, to show what
+// loading it costs.
+//
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "meshfile.h"
+#include "meshimport.h"
+#include "meshlets.h"
+#include "meshoptimize.h"
+#include "meshsimplify.h"
+
+// open a mesh file and touch every page of it, the way glBufferData would read it
+static double readBack(const std::string& path, std::string& error)
+{
+    auto start = std::chrono::steady_clock::now();
+    meshFile mesh(path);
+    if (!mesh.isOpen()) {
+        error = mesh.error();
+        return 0.0;
+    }
+    unsigned int sum = 0;
+    for (size_t i = 0; i < mesh.vertexBytes(); i += 4096)
+        sum += mesh.vertexData()[i];
+    for (size_t i = 0; i < mesh.indexCount(); i += 1024)
+        sum += mesh.indexData()[i];
+    volatile unsigned int keep = sum;
+    (void)keep;
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv)
+{
+    unsigned threads = 0;
+    bool optimize = true, lods = true, meshlets = true;
+    quantizeSettings quantize;
+    std::string folder;
+    std::vector<std::string> inputs;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--threads") && i + 1 < argc)
+            threads = (unsigned)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--as-authored"))
+            optimize = false;
+        else if (!strcmp(argv[i], "--no-lods"))
+            lods = false;
+        else if (!strcmp(argv[i], "--no-meshlets"))
+            meshlets = false;
+        else if (!strcmp(argv[i], "--lossless"))
+            quantize = quantizeSettings::lossless();
+        else if (!strcmp(argv[i], "--position-error") && i + 1 < argc)
+            quantize.positionError = (float)atof(argv[++i]);
+        else if (!strcmp(argv[i], "--normal-error") && i + 1 < argc)
+            quantize.normalError = (float)atof(argv[++i]);
+        else if (!strcmp(argv[i], "--uv-error") && i + 1 < argc)
+            quantize.uvError = (float)atof(argv[++i]);
+        else if (!strcmp(argv[i], "--half-positions"))
+            quantize.halfPositions = true;
+        else if (!strcmp(argv[i], "-o") && i + 1 < argc)
+            folder = argv[++i];
+        else if (argv[i][0] == '-') {
+            inputs.clear();
+            break;
+        }
+        else
+            inputs.push_back(argv[i]);
+    }
+    if (inputs.empty()) {
+        std::cout << "usage: meshconvert [--threads N] [--as-authored] [--no-lods] [--no-meshlets] [--lossless | --position-error F]\n"
+                     "                   [--normal-error DEGREES] [--uv-error F] [--half-positions] [-o folder] meshes...\n";
+        return 2;
+    }
+
+    threadPool pool(threads);
+
+    int failures = 0;
+    for (const std::string& input : inputs) {
+        meshImportStats stats;
+        cpuMesh mesh = importMesh(input, pool, &stats);
+        if (!mesh.ok()) {
+            std::cout << "FAILED " << mesh.error << "\n";
+            failures++;
+            continue;
+        }
+
+        auto started = std::chrono::steady_clock::now();
+        if (lods)
+            generateLods(mesh, { 0.5f, 0.25f, 0.125f, 0.0625f }, 0.05f, pool);
+        double lodSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+        // buildMeshlets sets the order itself, whatever optimizeMesh had made of it is lost
+        meshOptimizeStats optimized;
+        if (optimize && !meshlets)
+            optimizeMesh(mesh, 1.05f, 16, pool, &optimized);
+
+        meshletStats clusters;
+        vertexCacheStats unclustered, clustered;
+        if (meshlets) {
+            unclustered = analyzeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+            buildMeshlets(mesh, 64, 124, pool, &clusters);
+            clustered = analyzeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+        }
+
+        std::filesystem::path out = std::filesystem::path(input).replace_extension(meshFileExtension);
+        if (!folder.empty())
+            out = std::filesystem::path(folder) / out.filename();
+        packedVertices packed = packVertices(mesh, quantize, pool);
+        if (!writeMeshFile(out.string(), mesh, packed)) {
+            std::cout << "FAILED to write " << out.string() << "\n";
+            failures++;
+            continue;
+        }
+
+        std::string error;
+        double seconds = readBack(out.string(), error);
+        if (!error.empty()) {
+            std::cout << "FAILED " << error << "\n";
+            failures++;
+            continue;
+        }
+
+        double megabytes = std::filesystem::file_size(out) / (1024.0 * 1024.0);
+        std::cout << out.string() << ": " << stats.triangles << " triangles, " << stats.vertices << " vertices, "
+            << mesh.subMeshes.size() << " parts, " << megabytes << " MB; imported in " << stats.seconds * 1000.0
+            << " ms on " << stats.threads << " threads, loads in " << seconds * 1000.0 << " ms\n";
+        if (lods) {
+            std::cout << "    LODs:";
+            for (const meshLod& lod : mesh.lods)
+                std::cout << " " << lod.indexCount / 3 << " (error " << lod.error << ")";
+            std::cout << " triangles in " << lodSeconds * 1000.0 << " ms\n";
+        }
+        if (optimize && !meshlets)
+            std::cout << "    vertex cache: ACMR " << optimized.before.acmr << " -> " << optimized.after.acmr << ", ATVR "
+                << optimized.before.atvr << " -> " << optimized.after.atvr << ", " << optimized.clusters
+                << " overdraw clusters, " << optimized.seconds * 1000.0 << " ms\n";
+        if (meshlets)
+            std::cout << "    meshlets: " << clusters.meshlets << ", " << clusters.vertices << " vertices and "
+                << clusters.triangles << " triangles in each on average, ACMR " << unclustered.acmr << " -> " << clustered.acmr << ", "
+                << clusters.seconds * 1000.0 << " ms\n";
+        std::cout << "    vertices: " << packed.layout.stride << " bytes each (" << sizeof(meshVertex)
+            << " as floats), errors: position " << packed.positionError << " of its size, normal " << packed.normalError
+            << " degrees, uv " << packed.uvError << "\n";
+    }
+
+    return failures ? 1 : 0;
+}
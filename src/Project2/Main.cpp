@@ -21,12 +21,20 @@
 #include <cmath>
 #include <vector>
 #include <filesystem>
+#include <memory>
+#include <chrono>
 
 #include "shader_s.h"
 #include "renderer.h"
-
-#define STB_IMAGE_IMPLEMENTATION
-#include <stb_image.h>
+#include "basics.h"
+#include "demos.h"
+#include "textureupload.h"
+#include "texturestream.h"
+#include "decodearena.h"
+#include "meshfile.h"
+#include "meshrenderer.h"
+#include "vertexarray.h"
+#include "meshgen.h"
 
 glm::mat4 pMat; // perspective matrix
 glm::mat4 vMat; // view matrix
@@ -36,14 +44,17 @@ const unsigned int SCR_WIDTH = 1280;
 const unsigned int SCR_HEIGHT = 720;
 
 unsigned int texture;
+unsigned int unicornTexture, rpiTexture; // loaded from data/, shown in the UI
+unsigned int brickThumbnail;             // data/brick1.jpg decoded at 1/8 size for the UI
+int brickThumbnailHandle, unicornHandle, rpiHandle; // what textureStreamer knows them as
 
-// image buffer used by raster drawing basics.cpp
-extern unsigned char imageBuff[512][512][3];
 
-int myTexture();
+// what the quad's vertices are: three floats of position and nothing else
+using quadVertex = interleavedFormat<vertexAttrib<positionAttribute, componentType::float32, 3>>;
 
 class QuadRenderer : public renderer {
     // ------------------------------------------------------------------
+    static_assert(quadVertex::stride(0) == 3 * sizeof(float), "the vertices below are quadVertex");
     float vertices[12] = {
          0.5f,  0.5f, 0.0f,  // top right
          0.5f, -0.5f, 0.0f,  // bottom right
@@ -64,36 +75,26 @@ protected:
 
         myShader = shader;
 
-        glGenVertexArrays(1, &VAO);
         glGenBuffers(1, &VBO);
         glGenBuffers(1, &EBO);
-        // bind the Vertex Array Object first, then bind and set vertex buffer(s), and then configure vertex attributes(s).
-        glBindVertexArray(VAO);
-
 
-        // vertex buffer object, simple version, just coordinates
+        // vertex buffer object, simple version, just coordinates (see quadVertex)
 
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
         glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
 
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(0);
-
-        // note that this is allowed, the call to glVertexAttribPointer registered VBO as the vertex attribute's bound vertex buffer object so afterwards we can safely unbind
+        // set up the element array buffer containing the vertex indices for the "mesh".  It's filled through
+        // GL_ARRAY_BUFFER because the VAO it belongs to doesn't exist yet
+        glBindBuffer(GL_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
         glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-        // set up the element array buffer containing the vertex indices for the "mesh"
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
         indexCount = sizeof(indices) / sizeof(unsigned int);
 
-        // remember: do NOT unbind the EBO while a VAO is active, as the bound element buffer object IS stored in the VAO; keep the EBO bound.
-        // don't be tempted to do this --->  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-
-        // You can unbind the VAO afterwards so other VAO calls won't accidentally modify this VAO, but this rarely happens. Modifying other
-        // VAOs requires a call to glBindVertexArray anyways so we generally don't unbind VAOs (nor VBOs) when it's not directly necessary.
-        glBindVertexArray(0);
+        // the VAO remembers which buffer each attribute comes from and the element buffer, so drawing is just binding it.
+        // createVertexArray checks the shader wants what quadVertex has, and leaves no VAO bound so other VAO calls
+        // can't accidentally modify this one
+        VAO = createVertexArray(shader->ID, quadVertex::streams(), &VBO, EBO);
     }
 };
 
@@ -123,6 +124,100 @@ void setupTextures()
     glGenerateMipmap(GL_TEXTURE_2D);
 }
 
+// the image files come out of the decoded texture cache (data/textures.cache), mip chains
+// and all; only the ones that are new or have changed get decoded.  All of that happens in
+// the background: this returns at once and the checkerboard stands in until
+// streamTextures() has uploaded the real thing
+void requestTextures(textureStreamer& streamer)
+{
+    // the 64x64 preview in the UI only needs 1/8 of the 512x512 brick, which skips most of
+    // the decode; asked for on its own so it doesn't wait for the full size ones
+    brickThumbnailHandle = streamer.request({ "data/brick1.jpg", 3, true, 8 }, texture);
+
+    std::vector<int> handles = streamer.request({
+        { "data/unicorn.png", 4 },
+        { "data/rpi.png", 4 }
+    }, texture);
+    unicornHandle = handles[0];
+    rpiHandle = handles[1];
+}
+
+// once a frame: upload some more of whatever has finished loading, within the streamer's
+// per frame budget, and pick up the textures that are now complete
+void streamTextures(textureStreamer& streamer)
+{
+    size_t pending = streamer.pending();
+    streamer.update();
+
+    brickThumbnail = streamer.id(brickThumbnailHandle);
+    unicornTexture = streamer.id(unicornHandle);
+    rpiTexture = streamer.id(rpiHandle);
+
+    if (pending > 0 && streamer.pending() == 0) {
+        const streamStats& stats = streamer.stats();
+        for (int handle : { brickThumbnailHandle, unicornHandle, rpiHandle })
+            if (streamer.hasFailed(handle))
+                std::cout << "Failed to load texture: " << streamer.error(handle) << std::endl;
+        std::cout << "textures: " << stats.ready << " streamed in, " << stats.bytes / 1024 << " KB over " << stats.frames
+            << " frames, at most " << stats.peakFrameBytes / 1024 << " KB in one frame\n";
+        decodeArenaStats arena = decodeArena::stats();
+        std::cout << "decoding: " << arena.allocations << " stb_image allocations, " << arena.systemAllocations
+            << " of them from the system, at most " << arena.peakBytes / 1024 << " KB for one image\n";
+    }
+}
+
+// --depth-prepass: the mesh's depth goes down before it is shaded, and the pre-pass is
+// drawn from both vertex layouts (0 interleaved, 1 with the positions on their own) one
+// after the other, each on a cleared depth buffer and timed on the GPU, so the two are
+// compared on the same mesh and view.  The averages are printed every 300 frames
+struct depthPrepassTimes {
+    GLuint queries[2] = { 0, 0 };
+    double milliseconds[2] = { 0.0, 0.0 };
+    int frames = 0;
+    int turn = 0;
+    bool waiting = false;
+};
+
+void depthPrepass(MeshRenderer* layouts[2], depthPrepassTimes& times)
+{
+    if (!times.queries[0])
+        glGenQueries(2, times.queries);
+
+    // last frame's times, in by now or soon after
+    if (times.waiting) {
+        for (int i = 0; i < 2; i++) {
+            GLuint64 ns = 0;
+            glGetQueryObjectui64v(times.queries[i], GL_QUERY_RESULT, &ns);
+            times.milliseconds[i] += ns / 1e6;
+        }
+        if (++times.frames == 300) {
+            std::cout << "depth pre-pass: interleaved " << times.milliseconds[0] / times.frames << " ms, split "
+                << times.milliseconds[1] / times.frames << " ms a frame over " << times.frames << " frames\n";
+            times.milliseconds[0] = times.milliseconds[1] = 0.0;
+            times.frames = 0;
+        }
+    }
+
+    // neither layout always goes first; the second one's depth is what the shading tests against
+    times.turn ^= 1;
+    for (int n = 0; n < 2; n++) {
+        int i = n ^ times.turn;
+        glClear(GL_DEPTH_BUFFER_BIT);
+        glBeginQuery(GL_TIME_ELAPSED, times.queries[i]);
+        layouts[i]->renderDepth(vMat, pMat);
+        glEndQuery(GL_TIME_ELAPSED);
+    }
+    times.waiting = true;
+}
+
+// send the current contents of imageBuff to the texture again after redrawing it
+void updateTexture()
+{
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 512, 512, GL_RGB, GL_UNSIGNED_BYTE, (const void*)imageBuff);
+    glGenerateMipmap(GL_TEXTURE_2D);
+}
+
 void drawIMGUI(Shader *ourShader,renderer *myRenderer) {
     // Show a simple window that we create ourselves. We use a Begin/End pair to created a named window.
     {
@@ -170,6 +265,47 @@ void drawIMGUI(Shader *ourShader,renderer *myRenderer) {
 
         // show the texture that we generated
         ImGui::Image((void*)(intptr_t)texture, ImVec2(64, 64));
+        ImGui::SameLine();
+        ImGui::Image((void*)(intptr_t)brickThumbnail, ImVec2(64, 64), ImVec2(0, 1), ImVec2(1, 0));
+        ImGui::SameLine();
+        ImGui::Image((void*)(intptr_t)unicornTexture, ImVec2(64, 64), ImVec2(0, 1), ImVec2(1, 0));
+        ImGui::SameLine();
+        ImGui::Image((void*)(intptr_t)rpiTexture, ImVec2(64, 64), ImVec2(0, 1), ImVec2(1, 0));
+
+        // redraw the texture with one of the CPU raster experiments (basics.cpp and demos.h)
+        if (ImGui::Button("Checkerboard")) { myTexture(); updateTexture(); }
+        ImGui::SameLine();
+        if (ImGui::Button("Primitives")) { myTexture(); myPrimitives(); updateTexture(); }
+        ImGui::SameLine();
+        if (ImGui::Button("Depth Scene")) { myDepthScene(); updateTexture(); }
+        ImGui::SameLine();
+        if (ImGui::Button("Shaded")) { myShadedTriangles(); updateTexture(); }
+        ImGui::SameLine();
+        if (ImGui::Button("Shading Benchmark")) { myShadingBenchmark(); myShadedTriangles(); updateTexture(); }
+        ImGui::SameLine();
+        if (ImGui::Button("Antialiased")) { myAntialiased(); updateTexture(); }
+        ImGui::SameLine();
+        if (ImGui::Button("AA Benchmark")) { myAntialiasingBenchmark(); myAntialiased(); updateTexture(); }
+        if (ImGui::Button("Filters")) { myFiltered(); updateTexture(); }
+        ImGui::SameLine();
+        if (ImGui::Button("Filter Benchmark")) { myFilterBenchmark(); myFiltered(); updateTexture(); }
+        ImGui::SameLine();
+        if (ImGui::Button("Textured Floor")) { myTexturedFloor("data/brick1.jpg"); updateTexture(); }
+        ImGui::SameLine();
+        if (ImGui::Button("Texture Benchmark")) { myTextureBenchmark(); myTexturedFloor("data/brick1.jpg"); updateTexture(); }
+        if (ImGui::Button("Block Compressed")) { myCompressed(); updateTexture(); }
+        ImGui::SameLine();
+        if (ImGui::Button("Atlas")) { myAtlas(); updateTexture(); }
+        ImGui::SameLine();
+        if (ImGui::Button("Mesh Import")) { myMeshImport(); updateTexture(); }
+        if (ImGui::Button("Mesh Optimize")) { myMeshOptimize(); updateTexture(); }
+        ImGui::SameLine();
+        if (ImGui::Button("Mesh Quantize")) { myMeshQuantize(); updateTexture(); }
+        ImGui::SameLine();
+        if (ImGui::Button("Mesh LOD")) { myMeshLod(); updateTexture(); }
+        if (ImGui::Button("Meshlets")) { myMeshlets(); updateTexture(); }
+        ImGui::SameLine();
+        if (ImGui::Button("Mesh Gen")) { myMeshGen(); updateTexture(); }
 
         //ImGui::ShowDemoWindow(); // easter agg!  show the ImGui demo window
 
@@ -187,9 +323,21 @@ void drawIMGUI(Shader *ourShader,renderer *myRenderer) {
     }
 }
 
-int main()
+// g4g2 [mesh.obj | mesh.ply] adds the mesh to the scene, next to the quad.  With
+// --separate-positions its positions are in a vertex buffer of their own (see MeshRenderer),
+// and --depth-prepass times a position only pass over it both ways (see depthPrepass())
+int main(int argc, char** argv)
 {
     namespace fs = std::filesystem;
+    std::string meshPath; // absolute, before the current path moves
+    bool separatePositions = false, prepass = false;
+    for (int i = 1; i < argc; i++)
+        if (std::string(argv[i]) == "--separate-positions")
+            separatePositions = true;
+        else if (std::string(argv[i]) == "--depth-prepass")
+            prepass = true;
+        else
+            meshPath = fs::absolute(argv[i]).string();
     std::cout << "Current path is " << fs::current_path() << '\n';
 
     fs::file_status s = fs::file_status{};
@@ -246,6 +394,10 @@ int main()
     myTexture();
     setupTextures();
 
+    // textures arrive over the first few frames rather than holding up the first one
+    textureStreamer streamer("data/textures.cache", 4 << 20);
+    requestTextures(streamer);
+
     // set up the perspective and the camera
     pMat = glm::perspective(1.0472f, ((float)SCR_WIDTH / (float)SCR_HEIGHT), 0.0f, 100.0f);	//  1.0472 radians = 60 degrees
     vMat = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f,0.0f,-3.0f));
@@ -257,6 +409,37 @@ int main()
     
     renderers.push_back(&myQuad); // add it to the render list
 
+    std::unique_ptr<MeshRenderer> myMesh;
+    std::unique_ptr<MeshRenderer> otherLayout; // the mesh in the other vertex layout, only for timing the pre-pass
+    glm::mat4 meshPlace = glm::translate(glm::mat4(1.0f), glm::vec3(1.2f, 0.0f, 0.0f));
+    if (!meshPath.empty()) {
+        // an OBJ or PLY is imported once, after that its mesh file is mapped and drawn as it is
+        meshFile mesh;
+        std::string error;
+        auto start = std::chrono::steady_clock::now();
+        bool loaded = fs::path(meshPath).extension() == meshFileExtension ? mesh.open(meshPath) : openMeshCached(meshPath, mesh, error);
+        if (loaded) {
+            glm::mat4 m = meshPlace * fitToBox(mesh.boundsMin(), mesh.boundsMax());
+            myMesh = std::make_unique<MeshRenderer>(&ourShader, mesh, m, separatePositions);
+            if (prepass)
+                otherLayout = std::make_unique<MeshRenderer>(&ourShader, mesh, m, !separatePositions);
+            renderers.push_back(myMesh.get());
+            std::cout << "mesh: " << mesh.indexCount() / 3 << " triangles, " << mesh.vertexCount() << " vertices in "
+                << myMesh->vertexStreamCount() << " vertex buffers ready in " << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * 1000.0 << " ms\n";
+        }
+        else
+            std::cout << (error.empty() ? mesh.error() : error) << std::endl;
+    }
+    else {
+        // nothing to load, so something to look at anyway
+        cpuMesh mesh = makeTorus(96, 48);
+        glm::mat4 m = meshPlace * fitToBox(mesh.boundsMin, mesh.boundsMax);
+        myMesh = std::make_unique<MeshRenderer>(&ourShader, mesh, m, separatePositions);
+        if (prepass)
+            otherLayout = std::make_unique<MeshRenderer>(&ourShader, mesh, m, !separatePositions);
+        renderers.push_back(myMesh.get());
+    }
+
     // easter egg!  add another quad to the render list
     /*
     glm::mat4 tf2 =glm::translate(glm::mat4(1.0f), glm::vec3(-1.5f, 0.0f, 0.0f));
@@ -270,6 +453,9 @@ int main()
     // -----------
 
     double lastTime = glfwGetTime();
+    depthPrepassTimes prepassTimes;
+    MeshRenderer* layouts[2] = { separatePositions ? otherLayout.get() : myMesh.get(),
+                                 separatePositions ? myMesh.get() : otherLayout.get() };
 
     while (!glfwWindowShouldClose(window))
     {
@@ -282,6 +468,8 @@ int main()
         // -------------------------------------------------------------------------------
         glfwPollEvents();
 
+        streamTextures(streamer);
+
         // input
         if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
             glfwSetWindowShouldClose(window, true);
@@ -292,6 +480,28 @@ int main()
         glClear(GL_COLOR_BUFFER_BIT);
         glClear(GL_DEPTH_BUFFER_BIT);
 
+        // the loaded mesh draws whichever of its LODs is right for its size on screen, and
+        // of the full mesh only the meshlets the camera can see
+        if (myMesh)
+        {
+            int width, height;
+            glfwGetFramebufferSize(window, &width, &height);
+            myMesh->selectLod(vMat, pMat, (float)height);
+            myMesh->cullMeshlets(vMat, pMat);
+            if (otherLayout) {
+                otherLayout->selectLod(vMat, pMat, (float)height);
+                otherLayout->cullMeshlets(vMat, pMat);
+            }
+        }
+
+        // the shading only passes where the pre-pass left the nearest depth
+        if (otherLayout) {
+            glEnable(GL_DEPTH_TEST);
+            glDepthFunc(GL_LESS);
+            depthPrepass(layouts, prepassTimes);
+            glDepthFunc(GL_LEQUAL);
+        }
+
         // call each of the queued renderers
         for(renderer *r : renderers)
         {
@@ -304,6 +514,11 @@ int main()
         glfwSwapBuffers(window);
     }
 
+    myMesh.reset(); // its buffers go while there's still a context
+    otherLayout.reset();
+    if (prepassTimes.queries[0])
+        glDeleteQueries(2, prepassTimes.queries);
+
     // glfw: terminate, clearing all previously allocated GLFW resources.
     // ------------------------------------------------------------------
     glfwTerminate();
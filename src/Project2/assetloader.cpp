@@ -0,0 +1,102 @@
+//
+// parallel image decoding with stb_image (see assetloader.h)
+//
+
+#include "assetloader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <filesystem>
+
+#include <stb_image.h>
+
+#include "decodearena.h"
+#include "mappedfile.h"
+
+void decodedImage::stbiFree::operator()(unsigned char* p) const
+{
+    stbi_image_free(p);
+}
+
+namespace {
+
+// stb_image's settings for this request, on the thread that's about to decode it
+void applySettings(const imageRequest& request)
+{
+    stbi_set_flip_vertically_on_load_thread(request.flip);
+    stbi_set_jpeg_scale_thread(request.scale);
+}
+
+// decode one file, mapped rather than read through stdio.  Call inside a decodeArena; the
+// result is in it until kept
+unsigned char* decodeFile(const imageRequest& request, int& width, int& height, int& fileChannels, std::string& error)
+{
+    mappedFile file(request.path);
+    if (!file.isOpen() || file.size() > INT_MAX) {
+        error = file.isOpen() ? "file too big" : "can't open file";
+        return nullptr;
+    }
+
+    applySettings(request);
+    unsigned char* pixels = stbi_load_from_memory(file.data(), (int)file.size(), &width, &height, &fileChannels, request.channels);
+    if (!pixels)
+        error = stbi_failure_reason() ? stbi_failure_reason() : "unknown error";
+    return pixels;
+}
+
+// request indices, biggest file first, so a slow one doesn't start last and hold up the rest
+std::vector<int> biggestFirst(const std::vector<imageRequest>& requests)
+{
+    std::vector<int> order(requests.size());
+    std::vector<std::uintmax_t> sizes(requests.size());
+    for (size_t i = 0; i < requests.size(); i++) {
+        std::error_code missing;
+        order[i] = (int)i;
+        sizes[i] = std::filesystem::file_size(requests[i].path, missing);
+        if (missing)
+            sizes[i] = 0;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return sizes[a] > sizes[b]; });
+    return order;
+}
+
+} // namespace
+
+std::vector<decodedImage> decodeImages(const std::vector<imageRequest>& requests, threadPool& pool, decodeStats* stats)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<decodedImage> images(requests.size());
+    std::vector<int> order = biggestFirst(requests);
+
+    pool.parallelFor((int)order.size(), [&](int n) {
+        int i = order[n];
+        const imageRequest& request = requests[i];
+        decodedImage& image = images[i];
+        auto begin = std::chrono::steady_clock::now();
+
+        int fileChannels = 0;
+        image.path = request.path;
+        decodeArena arena;
+        image.pixels.reset(arena.keep(decodeFile(request, image.width, image.height, fileChannels, image.error)));
+        if (image.pixels)
+            image.channels = request.channels ? request.channels : fileChannels;
+        else
+            image.width = image.height = 0;
+
+        image.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    });
+
+    if (stats) {
+        *stats = decodeStats();
+        for (const decodedImage& image : images) {
+            stats->images++;
+            stats->failed += image.ok() ? 0 : 1;
+            stats->bytes += image.bytes();
+            stats->imageSeconds += image.seconds;
+        }
+        stats->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    return images;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "threadpool.h"
+
+// one image to decode.  'flip' and 'scale' are applied on whichever thread ends up decoding
+// it, since stb_image's per thread settings on the requesting thread don't follow the work
+// onto the pool's workers
+struct imageRequest {
+    std::string path;
+    int channels = 0;   // 0 keeps what the file has, 1..4 converts
+    bool flip = true;   // row 0 at the bottom, the way GL wants it
+    int scale = 1;      // 2, 4 or 8 decodes a JPEG straight to that fraction of its size
+                        // (rounded up), for thumbnails and small mips; other formats ignore it
+};
+
+struct decodedImage {
+    struct stbiFree {
+        void operator()(unsigned char* p) const;
+    };
+
+    std::string path;
+    int width = 0, height = 0;
+    int channels = 0;                                // what 'pixels' holds
+    std::unique_ptr<unsigned char, stbiFree> pixels; // straight from stb_image, no copy
+    std::string error;                               // why it failed, when pixels is null
+    double seconds = 0.0;                            // time this one took to decode
+
+    bool ok() const { return pixels != nullptr; }
+    size_t bytes() const { return (size_t)width * height * channels; }
+};
+
+struct decodeStats {
+    size_t images = 0;
+    size_t failed = 0;
+    size_t bytes = 0;          // decoded pixel bytes
+    double seconds = 0.0;      // wall clock for the lot
+    double imageSeconds = 0.0; // the decode times added up, what one at a time would cost
+};
+
+// Decode a batch of image files with stb_image, all at once on the thread pool.  The
+// results come back in request order; only the decoding happens here so the caller (the
+// thread with the GL context) just has to upload them.
+//
+// Files are memory mapped and handed to stbi_load_from_memory, which skips stdio's
+// buffered reads and the copy out of its buffer.
+//
+// Every thread that decodes something is left with its per thread flip and JPEG scale
+// settings as the request asked, so code that relies on the thread settings elsewhere
+// should set them again.
+std::vector<decodedImage> decodeImages(const std::vector<imageRequest>& requests,
+                                       threadPool& pool = threadPool::shared(), decodeStats* stats = nullptr);
@@ -2,6 +2,10 @@
 #include <cstdio>
 #include <iostream>
 #include <list>
+#include <cstring>
+
+#include "basics.h"
+#include "pixelbuffer.h"
 
 struct myEvent {
 	float time;
@@ -33,4 +37,10 @@ int myTexture()
 		}
 
 	return 0;
-}
\ No newline at end of file
+}
+
+// imageBuff as a pixelBuffer, what the CPU raster code draws through
+pixelBuffer imageBuffer()
+{
+	return pixelBuffer{ &imageBuff[0][0][0], (int)dimy, (int)dimx };
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+// image buffer used by raster drawing basics.cpp
+extern unsigned char imageBuff[512][512][3];
+
+// the checkerboard, the picture the program starts with (the other experiments are in demos.h)
+int myTexture();
@@ -0,0 +1,406 @@
+//
+// BC1 / BC3 block compression on the CPU (see blockcompress.h)
+//
+
+#include "blockcompress.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define G4G_BLOCK_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// a 4x4 block pulled out of the image, one array per channel so 8 texels fill a register
+struct texelBlock {
+    alignas(16) short r[16], g[16], b[16];
+    unsigned char a[16];
+};
+
+struct color {
+    int r, g, b;
+};
+
+// the 4x4 block at (bx, by); blocks hanging over the edge repeat the last row or column
+void gather(const rgba8* pixels, int width, int height, int bx, int by, texelBlock& block)
+{
+    for (int y = 0; y < 4; y++) {
+        const rgba8* row = pixels + (size_t)std::min(by * 4 + y, height - 1) * width;
+        for (int x = 0; x < 4; x++) {
+            const rgba8& p = row[std::min(bx * 4 + x, width - 1)];
+            int i = y * 4 + x;
+            block.r[i] = p.r;
+            block.g[i] = p.g;
+            block.b[i] = p.b;
+            block.a[i] = p.a;
+        }
+    }
+}
+
+inline int clampByte(double v)
+{
+    return (int)std::min(std::max(std::lround(v), 0l), 255l);
+}
+
+inline unsigned short pack565(color c)
+{
+    return (unsigned short)(((c.r * 31 + 127) / 255) << 11 | ((c.g * 63 + 127) / 255) << 5 | ((c.b * 31 + 127) / 255));
+}
+
+// 5 and 6 bit values widened by repeating their top bits, as the hardware does
+inline color unpack565(unsigned short v)
+{
+    int r = v >> 11 & 31, g = v >> 5 & 63, b = v & 31;
+    return { r << 3 | r >> 2, g << 2 | g >> 4, b << 3 | b >> 2 };
+}
+
+// the four colors of a block whose endpoints are in 4 color order (c0 > c1); BC3 always
+// uses these whatever the order
+void fourColors(unsigned short c0, unsigned short c1, color* p)
+{
+    p[0] = unpack565(c0);
+    p[1] = unpack565(c1);
+    p[2] = { (2 * p[0].r + p[1].r) / 3, (2 * p[0].g + p[1].g) / 3, (2 * p[0].b + p[1].b) / 3 };
+    p[3] = { (p[0].r + 2 * p[1].r) / 3, (p[0].g + 2 * p[1].g) / 3, (p[0].b + 2 * p[1].b) / 3 };
+}
+
+// the nearest of the four colors for every texel, ties going to the lower index.  Packs the
+// 2 bit indices (texel 0 in the low bits) and returns the total squared error
+int chooseIndices(const texelBlock& block, const color* p, unsigned int& indices)
+{
+    alignas(16) int distance[16], which[16];
+
+#ifdef G4G_BLOCK_SSE2
+    // differences fit in 16 bits; pairing them up and using madd gives dr*dr + dg*dg and
+    // db*db in 32 bit lanes, four texels per register
+    const __m128i zero = _mm_setzero_si128();
+    for (int half = 0; half < 16; half += 8) {
+        __m128i r = _mm_load_si128((const __m128i*)(block.r + half));
+        __m128i g = _mm_load_si128((const __m128i*)(block.g + half));
+        __m128i b = _mm_load_si128((const __m128i*)(block.b + half));
+        __m128i best[2], index[2];
+
+        for (int k = 0; k < 4; k++) {
+            __m128i dr = _mm_sub_epi16(r, _mm_set1_epi16((short)p[k].r));
+            __m128i dg = _mm_sub_epi16(g, _mm_set1_epi16((short)p[k].g));
+            __m128i db = _mm_sub_epi16(b, _mm_set1_epi16((short)p[k].b));
+
+            __m128i rg = _mm_unpacklo_epi16(dr, dg), bz = _mm_unpacklo_epi16(db, zero);
+            __m128i d[2];
+            d[0] = _mm_add_epi32(_mm_madd_epi16(rg, rg), _mm_madd_epi16(bz, bz));
+            rg = _mm_unpackhi_epi16(dr, dg);
+            bz = _mm_unpackhi_epi16(db, zero);
+            d[1] = _mm_add_epi32(_mm_madd_epi16(rg, rg), _mm_madd_epi16(bz, bz));
+
+            for (int j = 0; j < 2; j++) {
+                if (k == 0) {
+                    best[j] = d[j];
+                    index[j] = zero;
+                    continue;
+                }
+                __m128i closer = _mm_cmplt_epi32(d[j], best[j]);
+                best[j] = _mm_or_si128(_mm_and_si128(closer, d[j]), _mm_andnot_si128(closer, best[j]));
+                index[j] = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(k)), _mm_andnot_si128(closer, index[j]));
+            }
+        }
+        _mm_store_si128((__m128i*)(distance + half), best[0]);
+        _mm_store_si128((__m128i*)(distance + half + 4), best[1]);
+        _mm_store_si128((__m128i*)(which + half), index[0]);
+        _mm_store_si128((__m128i*)(which + half + 4), index[1]);
+    }
+#else
+    for (int i = 0; i < 16; i++) {
+        for (int k = 0; k < 4; k++) {
+            int dr = block.r[i] - p[k].r, dg = block.g[i] - p[k].g, db = block.b[i] - p[k].b;
+            int d = dr * dr + dg * dg + db * db;
+            if (k == 0 || d < distance[i]) {
+                distance[i] = d;
+                which[i] = k;
+            }
+        }
+    }
+#endif
+
+    int error = 0;
+    indices = 0;
+    for (int i = 0; i < 16; i++) {
+        error += distance[i];
+        indices |= (unsigned int)which[i] << (2 * i);
+    }
+    return error;
+}
+
+// endpoints along the block's principal axis: the direction its colors spread furthest,
+// found by power iteration on their covariance.  The extremes are pulled in by 1/16 of the
+// spread, which lands closer to where least squares ends up
+void principalEndpoints(const texelBlock& block, color& high, color& low)
+{
+    float mean[3] = { 0, 0, 0 };
+    for (int i = 0; i < 16; i++) {
+        mean[0] += block.r[i];
+        mean[1] += block.g[i];
+        mean[2] += block.b[i];
+    }
+    for (float& m : mean)
+        m /= 16.0f;
+
+    float cov[6] = { 0, 0, 0, 0, 0, 0 }; // rr rg rb gg gb bb
+    for (int i = 0; i < 16; i++) {
+        float r = block.r[i] - mean[0], g = block.g[i] - mean[1], b = block.b[i] - mean[2];
+        cov[0] += r * r;
+        cov[1] += r * g;
+        cov[2] += r * b;
+        cov[3] += g * g;
+        cov[4] += g * b;
+        cov[5] += b * b;
+    }
+
+    float axis[3] = { 1.0f, 1.0f, 1.0f };
+    for (int iteration = 0; iteration < 8; iteration++) {
+        float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+        float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+        float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+        float length = std::max(std::max(std::fabs(x), std::fabs(y)), std::fabs(z));
+        if (length == 0.0f)
+            break; // a flat block, any axis will do
+        axis[0] = x / length;
+        axis[1] = y / length;
+        axis[2] = z / length;
+    }
+    float norm = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+    for (float& a : axis)
+        a /= norm;
+
+    float lowest = 0.0f, highest = 0.0f;
+    for (int i = 0; i < 16; i++) {
+        float t = (block.r[i] - mean[0]) * axis[0] + (block.g[i] - mean[1]) * axis[1] + (block.b[i] - mean[2]) * axis[2];
+        lowest = std::min(lowest, t);
+        highest = std::max(highest, t);
+    }
+    float inset = (highest - lowest) / 16.0f;
+    lowest += inset;
+    highest -= inset;
+
+    high = { clampByte(mean[0] + axis[0] * highest), clampByte(mean[1] + axis[1] * highest), clampByte(mean[2] + axis[2] * highest) };
+    low = { clampByte(mean[0] + axis[0] * lowest), clampByte(mean[1] + axis[1] * lowest), clampByte(mean[2] + axis[2] * lowest) };
+}
+
+// put the endpoints in 4 color order and pick the indices.  Equal endpoints are left as
+// they are: every index is 0 then, which means the same in both of BC1's modes
+int evaluate(const texelBlock& block, unsigned short& c0, unsigned short& c1, unsigned int& indices)
+{
+    if (c0 < c1)
+        std::swap(c0, c1);
+    color p[4];
+    fourColors(c0, c1, p);
+    return chooseIndices(block, p, indices);
+}
+
+// the endpoints that fit the block best for the indices it has now (least squares).  The
+// weights are in thirds so the sums stay integers.  False when every texel has the same weight
+bool refine(const texelBlock& block, unsigned int indices, unsigned short& c0, unsigned short& c1)
+{
+    static const int weight[4] = { 3, 0, 2, 1 }; // of the first endpoint, out of 3
+
+    long long a = 0, b = 0, c = 0;
+    long long x[3] = { 0, 0, 0 }, y[3] = { 0, 0, 0 };
+    for (int i = 0; i < 16; i++) {
+        long long w = weight[indices >> (2 * i) & 3], v = 3 - w;
+        a += w * w;
+        b += w * v;
+        c += v * v;
+        const short* channel[3] = { block.r, block.g, block.b };
+        for (int k = 0; k < 3; k++) {
+            x[k] += w * channel[k][i];
+            y[k] += v * channel[k][i];
+        }
+    }
+    long long det = a * c - b * b;
+    if (det == 0)
+        return false;
+
+    int first[3], second[3];
+    for (int k = 0; k < 3; k++) {
+        first[k] = clampByte(3.0 * (x[k] * c - y[k] * b) / det);
+        second[k] = clampByte(3.0 * (y[k] * a - x[k] * b) / det);
+    }
+    c0 = pack565({ first[0], first[1], first[2] });
+    c1 = pack565({ second[0], second[1], second[2] });
+    return true;
+}
+
+// 8 bytes: the two endpoints, then the indices
+void encodeColor(const texelBlock& block, unsigned char* out)
+{
+    color high, low;
+    principalEndpoints(block, high, low);
+    unsigned short c0 = pack565(high), c1 = pack565(low);
+    unsigned int indices;
+    int error = evaluate(block, c0, c1, indices);
+
+    for (int pass = 0; pass < 2 && error > 0; pass++) {
+        unsigned short r0, r1;
+        unsigned int refined;
+        if (!refine(block, indices, r0, r1))
+            break;
+        int e = evaluate(block, r0, r1, refined);
+        if (e >= error)
+            break;
+        c0 = r0;
+        c1 = r1;
+        indices = refined;
+        error = e;
+    }
+
+    out[0] = (unsigned char)c0;
+    out[1] = (unsigned char)(c0 >> 8);
+    out[2] = (unsigned char)c1;
+    out[3] = (unsigned char)(c1 >> 8);
+    for (int i = 0; i < 4; i++)
+        out[4 + i] = (unsigned char)(indices >> (8 * i));
+}
+
+// the eight alphas of a BC3 block, or the six plus 0 and 255 when a0 <= a1
+void alphaPalette(int a0, int a1, int* p)
+{
+    p[0] = a0;
+    p[1] = a1;
+    if (a0 > a1) {
+        for (int k = 2; k < 8; k++)
+            p[k] = ((8 - k) * a0 + (k - 1) * a1) / 7;
+    }
+    else {
+        for (int k = 2; k < 6; k++)
+            p[k] = ((6 - k) * a0 + (k - 1) * a1) / 5;
+        p[6] = 0;
+        p[7] = 255;
+    }
+}
+
+// 8 bytes: the alpha endpoints (largest first, for the eight value mode), then 3 bit indices
+void encodeAlpha(const texelBlock& block, unsigned char* out)
+{
+    int high = *std::max_element(block.a, block.a + 16), low = *std::min_element(block.a, block.a + 16);
+    out[0] = (unsigned char)high;
+    out[1] = (unsigned char)low;
+
+    unsigned long long indices = 0;
+    if (high > low) {
+        int p[8];
+        alphaPalette(high, low, p);
+        for (int i = 0; i < 16; i++) {
+            int best = 0;
+            for (int k = 1; k < 8; k++)
+                if (std::abs(block.a[i] - p[k]) < std::abs(block.a[i] - p[best]))
+                    best = k;
+            indices |= (unsigned long long)best << (3 * i);
+        }
+    }
+    for (int i = 0; i < 6; i++)
+        out[2 + i] = (unsigned char)(indices >> (8 * i));
+}
+
+} // namespace
+
+void compressImage(const rgba8* pixels, int width, int height, blockFormat format, unsigned char* blocks, threadPool& pool)
+{
+    int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+    size_t size = blockBytes(format);
+
+    pool.parallelFor(blocksY, [&](int by) {
+        unsigned char* out = blocks + (size_t)by * blocksX * size;
+        texelBlock block;
+        for (int bx = 0; bx < blocksX; bx++, out += size) {
+            gather(pixels, width, height, bx, by, block);
+            if (format == blockFormat::bc3) {
+                encodeAlpha(block, out);
+                encodeColor(block, out + 8);
+            }
+            else {
+                encodeColor(block, out);
+            }
+        }
+    });
+}
+
+void decompressImage(const unsigned char* blocks, int width, int height, blockFormat format, rgba8* pixels)
+{
+    int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+    size_t size = blockBytes(format);
+
+    for (int by = 0; by < blocksY; by++)
+        for (int bx = 0; bx < blocksX; bx++, blocks += size) {
+            const unsigned char* colorBlock = format == blockFormat::bc3 ? blocks + 8 : blocks;
+            unsigned short c0 = (unsigned short)(colorBlock[0] | colorBlock[1] << 8), c1 = (unsigned short)(colorBlock[2] | colorBlock[3] << 8);
+            unsigned int indices = colorBlock[4] | colorBlock[5] << 8 | colorBlock[6] << 16 | (unsigned int)colorBlock[7] << 24;
+
+            rgba8 p[4];
+            color q[4];
+            fourColors(c0, c1, q);
+            for (int k = 0; k < 4; k++)
+                p[k] = rgba8{ (unsigned char)q[k].r, (unsigned char)q[k].g, (unsigned char)q[k].b, 255 };
+            if (format == blockFormat::bc1 && c0 <= c1) {
+                // the three color mode: a midpoint and transparent black
+                p[2] = rgba8{ (unsigned char)((q[0].r + q[1].r) / 2), (unsigned char)((q[0].g + q[1].g) / 2), (unsigned char)((q[0].b + q[1].b) / 2), 255 };
+                p[3] = rgba8{ 0, 0, 0, 0 };
+            }
+
+            int alphas[8];
+            unsigned long long alphaIndices = 0;
+            if (format == blockFormat::bc3) {
+                alphaPalette(blocks[0], blocks[1], alphas);
+                for (int i = 0; i < 6; i++)
+                    alphaIndices |= (unsigned long long)blocks[2 + i] << (8 * i);
+            }
+
+            for (int i = 0; i < 16; i++) {
+                int x = bx * 4 + (i & 3), y = by * 4 + (i >> 2);
+                if (x >= width || y >= height)
+                    continue;
+                rgba8 texel = p[indices >> (2 * i) & 3];
+                if (format == blockFormat::bc3)
+                    texel.a = (unsigned char)alphas[alphaIndices >> (3 * i) & 7];
+                pixels[(size_t)y * width + x] = texel;
+            }
+        }
+}
+
+compressedTexture compressTexture(const rgba8* pixels, int width, int height, blockFormat format, bool mips,
+                                  threadPool& pool, compressStats* stats)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    compressedTexture result;
+    result.format = format;
+    result.width = width;
+    result.height = height;
+    if (width <= 0 || height <= 0)
+        return result;
+
+    size_t blocks = 0;
+    auto compressLevel = [&](const rgba8* texels, int w, int h) {
+        result.levels.emplace_back(compressedSize(w, h, format));
+        compressImage(texels, w, h, format, result.levels.back().data(), pool);
+        blocks += compressedSize(w, h, format) / blockBytes(format);
+    };
+
+    if (mips) {
+        cpuTexture chain(pixels, width, height, texelLayout::linear);
+        for (int i = 0; i < chain.levels(); i++)
+            compressLevel(chain.levelTexels(i), chain.level(i).width, chain.level(i).height);
+    }
+    else {
+        compressLevel(pixels, width, height);
+    }
+
+    if (stats) {
+        stats->blocks = blocks;
+        stats->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    return result;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "cputexture.h"
+#include "threadpool.h"
+
+// the block compressed formats the encoder writes.  Each 4x4 block of texels becomes
+// two 5:6:5 endpoint colors and a 2 bit index per texel (BC1, 8 bytes, 6:1 against RGB),
+// and BC3 adds two 8 bit alpha endpoints with a 3 bit index per texel (16 bytes, 4:1
+// against RGBA)
+enum class blockFormat { bc1, bc3 };
+
+// the GL names for them, from EXT_texture_compression_s3tc (glad here only has core GL)
+const unsigned glCompressedRGB_DXT1 = 0x83F0;
+const unsigned glCompressedRGBA_DXT5 = 0x83F3;
+
+inline unsigned glInternalFormat(blockFormat format)
+{
+    return format == blockFormat::bc1 ? glCompressedRGB_DXT1 : glCompressedRGBA_DXT5;
+}
+
+inline size_t blockBytes(blockFormat format)
+{
+    return format == blockFormat::bc1 ? 8 : 16;
+}
+
+// bytes for one image; partial blocks at the right and top edges still take a whole block
+inline size_t compressedSize(int width, int height, blockFormat format)
+{
+    return (size_t)((width + 3) / 4) * ((height + 3) / 4) * blockBytes(format);
+}
+
+// a texture with every mip level compressed, level 0 first
+struct compressedTexture {
+    blockFormat format = blockFormat::bc1;
+    int width = 0, height = 0;
+    std::vector<std::vector<unsigned char>> levels;
+
+    int levelWidth(int i) const { return width >> i > 0 ? width >> i : 1; }
+    int levelHeight(int i) const { return height >> i > 0 ? height >> i : 1; }
+    size_t bytes() const
+    {
+        size_t total = 0;
+        for (const std::vector<unsigned char>& level : levels)
+            total += level.size();
+        return total;
+    }
+};
+
+struct compressStats {
+    size_t blocks = 0;
+    double seconds = 0.0;
+};
+
+// Encode RGBA texels (rows as they are, row 0 first) into 4x4 blocks.
+//
+// The endpoints start from the block's principal axis (the line through its colors that
+// fits best), pulled in a little from the extremes, then get two rounds of least squares
+// refinement against the indices they produced.  Choosing the indices - the part run
+// per texel - is done 8 texels at a time with SSE2 16 bit math, exact integers so the
+// scalar fallback picks the same ones.  Rows of blocks are spread over the pool.
+void compressImage(const rgba8* pixels, int width, int height, blockFormat format, unsigned char* blocks,
+                   threadPool& pool = threadPool::shared());
+
+// and back again, the way the hardware does it (for checking the encoder)
+void decompressImage(const unsigned char* blocks, int width, int height, blockFormat format, rgba8* pixels);
+
+// the image and its whole mip chain (2x2 box filter, see cpuTexture), each level compressed
+compressedTexture compressTexture(const rgba8* pixels, int width, int height, blockFormat format, bool mips = true,
+                                  threadPool& pool = threadPool::shared(), compressStats* stats = nullptr);
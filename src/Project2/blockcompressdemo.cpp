@@ -0,0 +1,47 @@
+//
+// the block compression demo (see blockcompress.h)
+//
+
+#include "demos.h"
+
+#include <vector>
+
+#include "blockcompress.h"
+
+// the antialiased scene through the block compressor and back: BC1 on the left, and on the
+// right BC3 with an alpha ramp running up the picture, blended over the checkerboard
+int myCompressed(threadPool& pool)
+{
+    myAntialiased(pool);
+
+    std::vector<rgba8> pixels((size_t)dimx * dimy), decoded(pixels.size());
+    for (unsigned y = 0; y < dimx; y++)
+        for (unsigned x = 0; x < dimy; x++) {
+            const unsigned char* p = imageBuff[y][x];
+            pixels[(size_t)y * dimy + x] = rgba8{ p[0], p[1], p[2], (unsigned char)(y * 255 / (dimx - 1)) };
+        }
+
+    std::vector<unsigned char> blocks(compressedSize(dimy, dimx, blockFormat::bc3));
+    compressImage(pixels.data(), dimy, dimx, blockFormat::bc1, blocks.data(), pool);
+    decompressImage(blocks.data(), dimy, dimx, blockFormat::bc1, decoded.data());
+    for (unsigned y = 0; y < dimx; y++)
+        for (unsigned x = 0; x < dimy / 2; x++) {
+            const rgba8& t = decoded[(size_t)y * dimy + x];
+            imageBuff[y][x][0] = t.r;
+            imageBuff[y][x][1] = t.g;
+            imageBuff[y][x][2] = t.b;
+        }
+
+    compressImage(pixels.data(), dimy, dimx, blockFormat::bc3, blocks.data(), pool);
+    decompressImage(blocks.data(), dimy, dimx, blockFormat::bc3, decoded.data());
+    for (unsigned y = 0; y < dimx; y++)
+        for (unsigned x = dimy / 2; x < dimy; x++) {
+            const rgba8& t = decoded[(size_t)y * dimy + x];
+            int under = ((x / 16) % 2) == ((y / 16) % 2) ? 255 : 0;
+            imageBuff[y][x][0] = (unsigned char)((t.r * t.a + under * (255 - t.a) + 127) / 255);
+            imageBuff[y][x][1] = (unsigned char)((t.g * t.a + under * (255 - t.a) + 127) / 255);
+            imageBuff[y][x][2] = (unsigned char)((t.b * t.a + under * (255 - t.a) + 127) / 255);
+        }
+
+    return 0;
+}
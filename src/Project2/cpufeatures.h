@@ -0,0 +1,45 @@
+#pragma once
+
+// Instruction sets beyond what the build targets, checked at run time.  A hot loop can
+// have an AVX2 version compiled in next to its SSE2 one (G4G_AVX2_TARGET on the function,
+// when G4G_AVX2 is defined) and use it only when hasAVX2() says so, without building the
+// rest of the program with -mavx2.  stb_image does the same for its JPEG kernels.
+
+#if (defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)) && \
+    ((defined(__GNUC__) && (__GNUC__ >= 5 || defined(__clang__))) || (defined(_MSC_VER) && _MSC_VER >= 1900))
+#define G4G_AVX2
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define G4G_AVX2_TARGET
+#else
+#define G4G_AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#endif
+
+// the CPU has AVX2 and the OS saves the ymm registers
+inline bool hasAVX2()
+{
+#if !defined(G4G_AVX2)
+    return false;
+#elif defined(__AVX2__)
+    return true;
+#elif defined(_MSC_VER)
+    static const bool avx2 = [] {
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7)
+            return false;
+        __cpuid(info, 1);
+        // AVX and OSXSAVE, then the OS has XCR0 bits 1 and 2 (xmm and ymm state) set
+        if (((info[2] >> 27) & 1) == 0 || ((info[2] >> 28) & 1) == 0 || (_xgetbv(0) & 6) != 6)
+            return false;
+        __cpuidex(info, 7, 0);
+        return ((info[1] >> 5) & 1) != 0;
+    }();
+    return avx2;
+#else
+    static const bool avx2 = __builtin_cpu_supports("avx2"); // checks the OS side too
+    return avx2;
+#endif
+}
@@ -0,0 +1,76 @@
+//
+// things to do to a whole cpuMesh (see cpumesh.h)
+//
+
+#include "cpumesh.h"
+
+#include <algorithm>
+#include <cfloat>
+
+void computeNormals(cpuMesh& mesh, threadPool& pool)
+{
+    // each job owns a range of vertices and goes through every triangle, adding to the
+    // corners that are its own; nothing is shared, and a vertex always sees the triangles
+    // in the same order so the result doesn't depend on the thread count
+    int jobs = (int)std::min<size_t>(pool.size(), mesh.vertices.size() / 4096 + 1);
+    size_t count = mesh.vertices.size();
+    const unsigned int* idx = mesh.indices.data();
+    size_t triangles = mesh.triangleCount();
+
+    pool.parallelFor(jobs, [&](int job) {
+        unsigned int first = (unsigned int)(count * job / jobs), last = (unsigned int)(count * (job + 1) / jobs);
+        for (unsigned int i = first; i < last; i++)
+            mesh.vertices[i].normal = glm::vec3(0.0f);
+
+        for (size_t t = 0; t < triangles; t++) {
+            unsigned int a = idx[t * 3], b = idx[t * 3 + 1], c = idx[t * 3 + 2];
+            bool hasA = a >= first && a < last, hasB = b >= first && b < last, hasC = c >= first && c < last;
+            if (!(hasA || hasB || hasC))
+                continue;
+            // the cross product is twice the area, which is the weight wanted
+            glm::vec3 pa = mesh.vertices[a].position;
+            glm::vec3 n = glm::cross(mesh.vertices[b].position - pa, mesh.vertices[c].position - pa);
+            if (hasA)
+                mesh.vertices[a].normal += n;
+            if (hasB)
+                mesh.vertices[b].normal += n;
+            if (hasC)
+                mesh.vertices[c].normal += n;
+        }
+
+        for (unsigned int i = first; i < last; i++) {
+            glm::vec3& n = mesh.vertices[i].normal;
+            float length = glm::length(n);
+            n = length > 0.0f ? n / length : glm::vec3(0.0f, 0.0f, 1.0f);
+        }
+    });
+}
+
+void computeBounds(cpuMesh& mesh, threadPool& pool)
+{
+    if (mesh.vertices.empty()) {
+        mesh.boundsMin = mesh.boundsMax = glm::vec3(0.0f);
+        return;
+    }
+
+    int jobs = (int)std::min<size_t>(pool.size(), mesh.vertices.size() / 65536 + 1);
+    std::vector<glm::vec3> lows(jobs, glm::vec3(FLT_MAX)), highs(jobs, glm::vec3(-FLT_MAX));
+    size_t count = mesh.vertices.size();
+
+    pool.parallelFor(jobs, [&](int job) {
+        glm::vec3 low(FLT_MAX), high(-FLT_MAX);
+        for (size_t i = count * job / jobs; i < count * (job + 1) / jobs; i++) {
+            low = glm::min(low, mesh.vertices[i].position);
+            high = glm::max(high, mesh.vertices[i].position);
+        }
+        lows[job] = low;
+        highs[job] = high;
+    });
+
+    mesh.boundsMin = lows[0];
+    mesh.boundsMax = highs[0];
+    for (int j = 1; j < jobs; j++) {
+        mesh.boundsMin = glm::min(mesh.boundsMin, lows[j]);
+        mesh.boundsMax = glm::max(mesh.boundsMax, highs[j]);
+    }
+}
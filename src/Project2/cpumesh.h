@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "threadpool.h"
+#include "vertexlayout.h"
+
+// std::allocator, but resize() leaves new elements uninitialized rather than zeroing
+// them, so whoever fills them in first touches the pages, e.g. the generators' row bands
+// on their own threads
+template <class T>
+struct defaultInitAllocator : std::allocator<T> {
+    template <class U>
+    struct rebind {
+        using other = defaultInitAllocator<U>;
+    };
+    using std::allocator<T>::allocator;
+
+    template <class U>
+    void construct(U* p)
+    {
+        // default initialized isn't enough for meshVertex: glm's vectors zero themselves
+        // (GLM_FORCE_NO_CTOR_INIT isn't set), so plain data isn't constructed at all
+        if constexpr (!std::is_trivially_copyable<U>::value || !std::is_trivially_destructible<U>::value)
+            ::new ((void*)p) U;
+    }
+    template <class U, class... Args>
+    void construct(U* p, Args&&... args)
+    {
+        ::new ((void*)p) U(std::forward<Args>(args)...);
+    }
+};
+
+// one vertex of a cpuMesh, interleaved the way MeshRenderer hands it to GL
+struct meshVertex {
+    glm::vec3 position;
+    glm::vec3 normal;
+    glm::vec2 uv;
+};
+
+using meshVertexBuffer = std::vector<meshVertex, defaultInitAllocator<meshVertex>>;
+using meshIndexBuffer = std::vector<unsigned int, defaultInitAllocator<unsigned int>>;
+
+// meshVertex as a vertexFormat: three floats of position, three of normal, two of uv
+using meshVertexFormat = interleavedFormat<vertexAttrib<positionAttribute, componentType::float32, 3>,
+                                           vertexAttrib<normalAttribute, componentType::float32, 3>,
+                                           vertexAttrib<uvAttribute, componentType::float32, 2>>;
+static_assert(meshVertexFormat::stride(0) == sizeof(meshVertex) && meshVertexFormat::offset(1) == offsetof(meshVertex, normal)
+                  && meshVertexFormat::offset(2) == offsetof(meshVertex, uv),
+              "meshVertexFormat has to match meshVertex");
+
+// and as a vertexLayout
+inline vertexLayout meshVertexLayout()
+{
+    return meshVertexFormat::streams()[0].layout;
+}
+
+// a range of the index buffer that goes together (an OBJ usemtl, o or g)
+struct subMesh {
+    std::string name;
+    unsigned int firstIndex = 0, indexCount = 0;
+};
+
+// a simpler version of the whole mesh (see generateLods): a range of cpuMesh::lodIndices,
+// drawn with the same vertices as the full mesh
+struct meshLod {
+    unsigned int firstIndex = 0, indexCount = 0;
+    float error = 0.0f; // how far it strays from the full mesh at worst, in the mesh's units
+};
+
+// a cluster of the full mesh's neighbouring triangles (see buildMeshlets): a range of
+// cpuMesh::indices with what's needed to cull it whole
+struct meshlet {
+    unsigned int firstIndex = 0, indexCount = 0;
+    unsigned int vertexCount = 0; // how many different vertices its triangles use
+    glm::vec3 center = glm::vec3(0.0f);
+    float radius = 0.0f;
+    // every triangle faces away from a camera at e when
+    // dot(normalize(coneApex - e), coneAxis) >= coneCutoff; a cutoff over 1 never does
+    glm::vec3 coneApex = glm::vec3(0.0f), coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+    float coneCutoff = 2.0f;
+};
+
+// Triangles in memory: shared vertices and 32 bit indices, three to a triangle, which
+// is what glDrawElements(GL_TRIANGLES, ..., GL_UNSIGNED_INT) wants.  Every index is in
+// one of the subMeshes.  The LODs, if it has any, are coarser and coarser; the meshlets,
+// if it has any, cover the full mesh's indices.
+struct cpuMesh {
+    meshVertexBuffer vertices;
+    meshIndexBuffer indices;
+    std::vector<subMesh> subMeshes;
+    meshIndexBuffer lodIndices;
+    std::vector<meshLod> lods;
+    std::vector<meshlet> meshlets;
+    glm::vec3 boundsMin = glm::vec3(0.0f), boundsMax = glm::vec3(0.0f);
+    bool hasNormals = false; // false when the normals were made up from the faces
+    bool hasUVs = false;     // false when they are all 0
+    std::string error;       // why it couldn't be loaded, empty when all is well
+
+    bool ok() const { return error.empty(); }
+    size_t triangleCount() const { return indices.size() / 3; }
+};
+
+// smooth normals from the faces, each weighted by its area
+void computeNormals(cpuMesh& mesh, threadPool& pool = threadPool::shared());
+void computeBounds(cpuMesh& mesh, threadPool& pool = threadPool::shared());
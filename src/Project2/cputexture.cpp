@@ -0,0 +1,312 @@
+//
+// mip mapped CPU textures in row-major, 4x4 tiled or Morton order (see cputexture.h)
+//
+
+#include "cputexture.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <glm/glm.hpp>
+
+#include <stb_image.h>
+
+#include "decodearena.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define G4G_TEXTURE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// x's low 16 bits moved to the even bit positions
+inline size_t spreadBits(unsigned int x)
+{
+    x &= 0xffff;
+    x = (x | (x << 8)) & 0x00ff00ff;
+    x = (x | (x << 4)) & 0x0f0f0f0f;
+    x = (x | (x << 2)) & 0x33333333;
+    x = (x | (x << 1)) & 0x55555555;
+    return x;
+}
+
+template <texelLayout L>
+inline size_t texelIndex(const mipLevel& m, unsigned int x, unsigned int y)
+{
+    if constexpr (L == texelLayout::linear)
+        return (size_t)y * m.width + x;
+    else if constexpr (L == texelLayout::tiled)
+        return ((size_t)(y >> 2) * m.tilesX + (x >> 2)) * 16 + ((y & 3) << 2) + (x & 3);
+    else {
+        // interleave as many bits as the shorter side has, above that only the longer side is left
+        unsigned int low = (1u << m.mortonBits) - 1;
+        return (spreadBits(x & low) | (spreadBits(y & low) << 1)) + ((size_t)((x | y) >> m.mortonBits) << (2 * m.mortonBits));
+    }
+}
+
+inline int wrapCoord(int c, int size, textureWrap wrap)
+{
+    if (wrap == textureWrap::clamp)
+        return std::min(std::max(c, 0), size - 1);
+    if ((size & (size - 1)) == 0)
+        return c & (size - 1); // powers of two, the usual case, skip the divide
+    c %= size;
+    return c < 0 ? c + size : c;
+}
+
+int ceilLog2(int v)
+{
+    int bits = 0;
+    while ((1 << bits) < v)
+        bits++;
+    return bits;
+}
+
+// one mip level down, each texel the average of a 2x2 block.  An odd width or height
+// leaves its last column or row out, and a side of 1 averages its one texel with itself.
+// Both averages round up, the scalar code does the same as SSE2
+void halve(const rgba8* src, int w, int h, rgba8* dst)
+{
+    int dw = std::max(w / 2, 1), dh = std::max(h / 2, 1);
+    std::vector<rgba8> rows(w);
+
+    for (int y = 0; y < dh; y++) {
+        const unsigned char* a = (const unsigned char*)(src + (size_t)std::min(2 * y, h - 1) * w);
+        const unsigned char* b = (const unsigned char*)(src + (size_t)std::min(2 * y + 1, h - 1) * w);
+        unsigned char* v = (unsigned char*)rows.data();
+
+        int i = 0;
+#ifdef G4G_TEXTURE_SSE2
+        for (; i + 16 <= w * 4; i += 16)
+            _mm_storeu_si128((__m128i*)(v + i), _mm_avg_epu8(_mm_loadu_si128((const __m128i*)(a + i)), _mm_loadu_si128((const __m128i*)(b + i))));
+#endif
+        for (; i < w * 4; i++)
+            v[i] = (unsigned char)((a[i] + b[i] + 1) >> 1);
+
+        rgba8* out = dst + (size_t)y * dw;
+        int x = 0;
+#ifdef G4G_TEXTURE_SSE2
+        // eight texels in, the even and odd ones split apart and averaged, four out
+        for (; w >= 2 && x + 4 <= dw; x += 4) {
+            __m128 lo = _mm_castsi128_ps(_mm_loadu_si128((const __m128i*)&rows[2 * x]));
+            __m128 hi = _mm_castsi128_ps(_mm_loadu_si128((const __m128i*)&rows[2 * x + 4]));
+            __m128i even = _mm_castps_si128(_mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)));
+            __m128i odd = _mm_castps_si128(_mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1)));
+            _mm_storeu_si128((__m128i*)(out + x), _mm_avg_epu8(even, odd));
+        }
+#endif
+        for (; x < dw; x++) {
+            const unsigned char* p = (const unsigned char*)&rows[std::min(2 * x, w - 1)];
+            const unsigned char* q = (const unsigned char*)&rows[std::min(2 * x + 1, w - 1)];
+            unsigned char* o = (unsigned char*)(out + x);
+            for (int c = 0; c < 4; c++)
+                o[c] = (unsigned char)((p[c] + q[c] + 1) >> 1);
+        }
+    }
+}
+
+template <texelLayout L>
+void store(const rgba8* src, const mipLevel& m, rgba8* dst)
+{
+    for (int y = 0; y < m.height; y++)
+        for (int x = 0; x < m.width; x++)
+            dst[texelIndex<L>(m, x, y)] = src[(size_t)y * m.width + x];
+}
+
+// N lanes: pick the level(s), work out the texels and weights, fetch, blend
+template <texelLayout L, int N>
+void sampleLanes(const std::vector<mipLevel>& mips, const rgba8* texels, textureWrap wrap,
+                 const float* u, const float* v, const float* lod, textureFilter filter, rgba8* out)
+{
+    const int passes = filter == textureFilter::trilinear ? 2 : 1;
+    const float top = (float)(mips.size() - 1);
+
+    int level[2][N];
+    float levelWeight[2][N];
+    for (int i = 0; i < N; i++) {
+        float l = std::min(std::max(lod[i], 0.0f), top);
+        if (filter == textureFilter::trilinear) {
+            int l0 = (int)l;
+            level[0][i] = l0;
+            level[1][i] = std::min(l0 + 1, (int)top);
+            levelWeight[1][i] = l - l0;
+            levelWeight[0][i] = 1.0f - levelWeight[1][i];
+        }
+        else {
+            level[0][i] = (int)(l + 0.5f);
+            levelWeight[0][i] = 1.0f;
+        }
+    }
+
+    float acc[4][N] = {};
+    for (int pass = 0; pass < passes; pass++) {
+        if (filter == textureFilter::nearest) {
+            const rgba8* t[N];
+            for (int i = 0; i < N; i++) {
+                const mipLevel& m = mips[level[pass][i]];
+                int x = wrapCoord((int)std::floor(u[i] * m.width), m.width, wrap);
+                int y = wrapCoord((int)std::floor(v[i] * m.height), m.height, wrap);
+                t[i] = texels + m.offset + texelIndex<L>(m, x, y);
+            }
+            for (int i = 0; i < N; i++) {
+                acc[0][i] += t[i]->r * levelWeight[pass][i];
+                acc[1][i] += t[i]->g * levelWeight[pass][i];
+                acc[2][i] += t[i]->b * levelWeight[pass][i];
+                acc[3][i] += t[i]->a * levelWeight[pass][i];
+            }
+            continue;
+        }
+
+        // texel centres sit at +0.5, so the 2x2 block starts half a texel back
+        float fx[N], fy[N];
+        int x0[N], y0[N];
+        for (int i = 0; i < N; i++) {
+            const mipLevel& m = mips[level[pass][i]];
+            float x = u[i] * m.width - 0.5f, y = v[i] * m.height - 0.5f;
+            float bx = std::floor(x), by = std::floor(y);
+            fx[i] = x - bx;
+            fy[i] = y - by;
+            x0[i] = (int)bx;
+            y0[i] = (int)by;
+        }
+
+        const rgba8* t[4][N];
+        for (int i = 0; i < N; i++) {
+            const mipLevel& m = mips[level[pass][i]];
+            const rgba8* base = texels + m.offset;
+            int xa = wrapCoord(x0[i], m.width, wrap), xb = wrapCoord(x0[i] + 1, m.width, wrap);
+            int ya = wrapCoord(y0[i], m.height, wrap), yb = wrapCoord(y0[i] + 1, m.height, wrap);
+            t[0][i] = base + texelIndex<L>(m, xa, ya);
+            t[1][i] = base + texelIndex<L>(m, xb, ya);
+            t[2][i] = base + texelIndex<L>(m, xa, yb);
+            t[3][i] = base + texelIndex<L>(m, xb, yb);
+        }
+
+        for (int i = 0; i < N; i++) {
+            float w[4] = { (1.0f - fx[i]) * (1.0f - fy[i]), fx[i] * (1.0f - fy[i]), (1.0f - fx[i]) * fy[i], fx[i] * fy[i] };
+            for (int k = 0; k < 4; k++) {
+                float wk = w[k] * levelWeight[pass][i];
+                acc[0][i] += t[k][i]->r * wk;
+                acc[1][i] += t[k][i]->g * wk;
+                acc[2][i] += t[k][i]->b * wk;
+                acc[3][i] += t[k][i]->a * wk;
+            }
+        }
+    }
+
+    for (int i = 0; i < N; i++)
+        out[i] = rgba8{ (unsigned char)(acc[0][i] + 0.5f), (unsigned char)(acc[1][i] + 0.5f),
+                        (unsigned char)(acc[2][i] + 0.5f), (unsigned char)(acc[3][i] + 0.5f) };
+}
+
+} // namespace
+
+cpuTexture::cpuTexture(const rgba8* pixels, int width, int height, texelLayout layout)
+    : order(layout)
+{
+    if (width <= 0 || height <= 0)
+        return;
+
+    // the whole chain row by row first, each level built from the one above
+    std::vector<std::vector<rgba8>> chain(1, std::vector<rgba8>(pixels, pixels + (size_t)width * height));
+    std::vector<glm::ivec2> sizes(1, glm::ivec2(width, height));
+    while (sizes.back().x > 1 || sizes.back().y > 1) {
+        glm::ivec2 s = sizes.back(), half(std::max(s.x / 2, 1), std::max(s.y / 2, 1));
+        chain.emplace_back((size_t)half.x * half.y);
+        halve(chain[chain.size() - 2].data(), s.x, s.y, chain.back().data());
+        sizes.push_back(half);
+    }
+
+    size_t total = 0;
+    for (glm::ivec2 s : sizes) {
+        mipLevel m{ s.x, s.y, (s.x + 3) / 4, std::min(ceilLog2(s.x), ceilLog2(s.y)), total };
+        if (layout == texelLayout::linear)
+            total += (size_t)s.x * s.y;
+        else if (layout == texelLayout::tiled)
+            total += (size_t)m.tilesX * ((s.y + 3) / 4) * 16;
+        else
+            total += (size_t)1 << (ceilLog2(s.x) + ceilLog2(s.y)); // padded out to powers of two
+        mips.push_back(m);
+    }
+
+    texels.assign(total, rgba8{ 0, 0, 0, 0 });
+    for (size_t i = 0; i < mips.size(); i++) {
+        rgba8* dst = &texels[mips[i].offset];
+        switch (layout) {
+        case texelLayout::linear: store<texelLayout::linear>(chain[i].data(), mips[i], dst); break;
+        case texelLayout::tiled: store<texelLayout::tiled>(chain[i].data(), mips[i], dst); break;
+        case texelLayout::morton: store<texelLayout::morton>(chain[i].data(), mips[i], dst); break;
+        }
+    }
+}
+
+static std::vector<rgba8> expand(pixelBuffer rgb)
+{
+    std::vector<rgba8> pixels((size_t)rgb.width * rgb.height);
+    for (int y = 0; y < rgb.height; y++)
+        for (int x = 0; x < rgb.width; x++) {
+            const unsigned char* p = rgb.at(x, y);
+            pixels[(size_t)y * rgb.width + x] = rgba8{ p[0], p[1], p[2], 255 };
+        }
+    return pixels;
+}
+
+cpuTexture::cpuTexture(pixelBuffer rgb, texelLayout layout)
+    : cpuTexture(expand(rgb).data(), rgb.width, rgb.height, layout)
+{
+}
+
+bool cpuTexture::load(const char* path, cpuTexture& texture, texelLayout layout)
+{
+    int w, h, channels;
+    decodeArena arena; // the copy below is all that's wanted of the pixels
+    stbi_set_flip_vertically_on_load_thread(1);
+    unsigned char* data = stbi_load(path, &w, &h, &channels, 4);
+    if (!data)
+        return false;
+    texture = cpuTexture((const rgba8*)data, w, h, layout);
+    stbi_image_free(data);
+    return true;
+}
+
+rgba8 cpuTexture::texel(int lvl, int x, int y) const
+{
+    const mipLevel& m = mips[lvl];
+    switch (order) {
+    case texelLayout::linear: return texels[m.offset + texelIndex<texelLayout::linear>(m, x, y)];
+    case texelLayout::tiled: return texels[m.offset + texelIndex<texelLayout::tiled>(m, x, y)];
+    default: return texels[m.offset + texelIndex<texelLayout::morton>(m, x, y)];
+    }
+}
+
+float cpuTexture::lod(float dudx, float dvdx, float dudy, float dvdy) const
+{
+    // the GL spec's approximation: the longer of the two texel space steps
+    float w = (float)width(), h = (float)height();
+    float x = (dudx * w) * (dudx * w) + (dvdx * h) * (dvdx * h);
+    float y = (dudy * w) * (dudy * w) + (dvdy * h) * (dvdy * h);
+    return 0.5f * std::log2(std::max(std::max(x, y), 1e-12f));
+}
+
+template <int N>
+void cpuTexture::sample(const float* u, const float* v, const float* lodPerLane, textureFilter filter, rgba8* out) const
+{
+    if (mips.empty())
+        return;
+    switch (order) {
+    case texelLayout::linear: sampleLanes<texelLayout::linear, N>(mips, texels.data(), wrap, u, v, lodPerLane, filter, out); break;
+    case texelLayout::tiled: sampleLanes<texelLayout::tiled, N>(mips, texels.data(), wrap, u, v, lodPerLane, filter, out); break;
+    case texelLayout::morton: sampleLanes<texelLayout::morton, N>(mips, texels.data(), wrap, u, v, lodPerLane, filter, out); break;
+    }
+}
+
+void cpuTexture::sample4(const float* u, const float* v, const float* lodPerLane, textureFilter filter, rgba8* out) const
+{
+    sample<4>(u, v, lodPerLane, filter, out);
+}
+
+void cpuTexture::sample8(const float* u, const float* v, const float* lodPerLane, textureFilter filter, rgba8* out) const
+{
+    sample<8>(u, v, lodPerLane, filter, out);
+}
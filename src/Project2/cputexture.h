@@ -0,0 +1,83 @@
+#pragma once
+
+#include <vector>
+
+#include "pixelbuffer.h"
+
+// 8 bit RGBA, what a cpuTexture stores per texel (4 bytes so texels never straddle a line)
+struct rgba8 {
+    unsigned char r, g, b, a;
+};
+static_assert(sizeof(rgba8) == 4, "rgba8 must be 4 bytes");
+
+// how the texels of each mip level are ordered in memory
+enum class texelLayout {
+    linear,  // row by row, like the decoded image
+    tiled,   // 4x4 blocks of texels stored together (one 64 byte cache line per block)
+    morton   // Z-order, neighbours in x and y stay close at every scale
+};
+
+enum class textureFilter {
+    nearest,   // closest texel of the closest mip level
+    bilinear,  // 2x2 texels of the closest mip level
+    trilinear  // bilinear in the two mip levels around the lod, blended
+};
+
+enum class textureWrap { repeat, clamp };
+
+struct mipLevel {
+    int width, height;
+    int tilesX;      // 4x4 tiles per row (tiled)
+    int mortonBits;  // bits interleaved before the longer side carries on alone (morton)
+    size_t offset;   // first texel of the level
+};
+
+// A texture the CPU code can sample, with its whole mip chain.
+//
+// Row-major images are fine when they are read row by row, but texturing walks across them
+// in any direction and at any scale, and then nearly every texel fetch is a cache miss.  The
+// tiled and Morton layouts keep texels that are close in 2D close in memory too.  The mips
+// are built with a 2x2 box filter (SSE2, averaging bytes 16 at a time) before being put in
+// the chosen layout.
+//
+// Sampling takes 4 or 8 texture coordinates at once (GL style, 0..1 across the texture,
+// row 0 at v = 0) with a level of detail each; the coordinate and blend loops have a fixed
+// trip count so the compiler can keep them in vector registers, and it leaves a run of
+// independent texel fetches in flight.  The result does not depend on the layout.
+class cpuTexture {
+public:
+    cpuTexture() = default;
+    cpuTexture(const rgba8* pixels, int width, int height, texelLayout layout = texelLayout::morton);
+    explicit cpuTexture(pixelBuffer rgb, texelLayout layout = texelLayout::morton);
+
+    // decode an image file with stb_image, false if it can't be read.  Rows are flipped so
+    // the last one is at v = 0, as GL has it; the calling thread is left with stb_image's
+    // per thread flip turned on
+    static bool load(const char* path, cpuTexture& texture, texelLayout layout = texelLayout::morton);
+
+    int width() const { return mips.empty() ? 0 : mips[0].width; }
+    int height() const { return mips.empty() ? 0 : mips[0].height; }
+    int levels() const { return (int)mips.size(); }
+    texelLayout layout() const { return order; }
+    const mipLevel& level(int i) const { return mips[i]; }
+
+    rgba8 texel(int level, int x, int y) const;
+    // a level's texels in the texture's own layout (row by row for texelLayout::linear)
+    const rgba8* levelTexels(int level) const { return &texels[mips[level].offset]; }
+
+    // the level of detail for a pixel whose texture coordinates change by these per pixel step
+    float lod(float dudx, float dvdx, float dudy, float dvdy) const;
+
+    void sample4(const float* u, const float* v, const float* lod, textureFilter filter, rgba8* out) const;
+    void sample8(const float* u, const float* v, const float* lod, textureFilter filter, rgba8* out) const;
+
+    textureWrap wrap = textureWrap::repeat;
+
+private:
+    texelLayout order = texelLayout::morton;
+    std::vector<mipLevel> mips;
+    std::vector<rgba8> texels;
+
+    template <int N>
+    void sample(const float* u, const float* v, const float* lod, textureFilter filter, rgba8* out) const;
+};
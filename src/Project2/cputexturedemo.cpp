@@ -0,0 +1,105 @@
+//
+// the CPU texture demo and benchmark (see cputexture.h)
+//
+
+#include "demos.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "cputexture.h"
+
+// a floor and a ceiling running off to the horizon, textured on the CPU with the image
+// (or the antialiased scene): nearest on the left, bilinear in the middle, trilinear on the right
+int myTexturedFloor(const char* image, threadPool& pool)
+{
+    cpuTexture texture;
+    if (!image || !cpuTexture::load(image, texture)) {
+        if (image)
+            std::cout << "textured floor: can't read " << image << ", using the antialiased scene\n";
+        myAntialiased(pool);
+        texture = cpuTexture(imageBuffer());
+    }
+
+    memset(imageBuff, 0, sizeof(imageBuff));
+
+    const float focal = 256.0f, eye = 1.0f, scale = 0.25f, horizon = dimx / 2.0f;
+    const int bandHeight = 32;
+
+    pool.parallelFor(dimx / bandHeight, [&](int band) {
+        for (int y = band * bandHeight; y < (band + 1) * bandHeight; y++) {
+            float d = std::abs(y + 0.5f - horizon);
+            float distance = eye * focal / d;
+            float dvdy = scale * eye * focal / (d * d);
+
+            for (unsigned x0 = 0; x0 < dimy; x0 += 8) {
+                float u[8], v[8], lod[8];
+                for (int i = 0; i < 8; i++) {
+                    u[i] = (x0 + i + 0.5f - dimy / 2.0f) * distance / focal * scale + 0.5f;
+                    v[i] = distance * scale;
+                    lod[i] = texture.lod(distance / focal * scale, 0.0f, 0.0f, dvdy);
+                }
+
+                textureFilter filter = x0 < 168 ? textureFilter::nearest : x0 < 344 ? textureFilter::bilinear : textureFilter::trilinear;
+                rgba8 texels[8];
+                texture.sample8(u, v, lod, filter, texels);
+                for (int i = 0; i < 8; i++) {
+                    imageBuff[y][x0 + i][0] = texels[i].r;
+                    imageBuff[y][x0 + i][1] = texels[i].g;
+                    imageBuff[y][x0 + i][2] = texels[i].b;
+                }
+            }
+        }
+    });
+
+    return 0;
+}
+
+// sampling a 2048x2048 texture turned on its side (so a row of pixels walks down a column
+// of texels) in each of the three layouts
+int myTextureBenchmark()
+{
+    myAntialiased();
+
+    const int size = 2048;
+    std::vector<rgba8> pixels((size_t)size * size);
+    for (int y = 0; y < size; y++)
+        for (int x = 0; x < size; x++) {
+            const unsigned char* p = imageBuff[y % dimx][x % dimy];
+            pixels[(size_t)y * size + x] = rgba8{ p[0], p[1], p[2], 255 };
+        }
+
+    std::vector<rgba8> first;
+    for (texelLayout layout : { texelLayout::linear, texelLayout::tiled, texelLayout::morton }) {
+        auto start = std::chrono::steady_clock::now();
+        cpuTexture texture(pixels.data(), size, size, layout);
+        double build = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::vector<rgba8> out((size_t)size * size);
+        start = std::chrono::steady_clock::now();
+        for (int y = 0; y < size; y++)
+            for (int x = 0; x < size; x += 8) {
+                float u[8], v[8], lod[8];
+                for (int i = 0; i < 8; i++) {
+                    u[i] = (y + 0.5f) / size;
+                    v[i] = (x + i + 0.5f) / size;
+                    lod[i] = 0.0f;
+                }
+                texture.sample8(u, v, lod, textureFilter::bilinear, &out[(size_t)y * size + x]);
+            }
+        double sampling = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        const char* name = layout == texelLayout::linear ? "row-major" : layout == texelLayout::tiled ? "4x4 tiled" : "morton";
+        std::cout << name << ": mips built in " << build * 1000.0 << " ms, " << size * size / sampling / 1e6 << " M bilinear samples/s";
+        if (first.empty())
+            first = out;
+        else
+            std::cout << (memcmp(out.data(), first.data(), out.size() * sizeof(rgba8)) == 0 ? " (same result)" : " (DIFFERENT result)");
+        std::cout << "\n";
+    }
+
+    return 0;
+}
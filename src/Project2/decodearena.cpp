@@ -0,0 +1,372 @@
+//
+// per thread memory for stb_image's temporary buffers (see decodearena.h)
+//
+
+#include "decodearena.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+// what a block of memory is, so free and realloc know where it came from
+enum blockKind : unsigned {
+    heapBlock = 0x5ca1ab1e, // straight from malloc, outside an arena or kept
+    chunkBlock,             // bumped out of a chunk, goes when the arena does
+    bigBlock,               // a block of its own, in use by the current decode
+    spareBlock,             // a big block waiting on the thread's list for the next decode
+};
+
+// in front of every allocation, keeping what comes after it 16 byte aligned
+struct alignas(16) blockHeader {
+    size_t size;     // what was asked for
+    size_t capacity; // what there's room for
+    unsigned kind;
+};
+
+const size_t chunkSize = 256 * 1024;
+const size_t bigSize = 32 * 1024;      // anything bigger gets a block of its own...
+const size_t bigGranule = 64 * 1024;   // ... rounded up to this, so similar sizes can share
+const size_t keptChunks = 4;           // chunks a thread holds on to between decodes
+const size_t minimumSpare = 1u << 20;  // big blocks it holds on to, at least, see reset()
+
+size_t roundUp(size_t n, size_t multiple)
+{
+    return (n + multiple - 1) / multiple * multiple;
+}
+
+blockHeader* headerOf(void* p)
+{
+    return (blockHeader*)p - 1;
+}
+
+struct chunk {
+    char* base;
+    size_t used;
+    blockHeader* last; // the newest block in it, which can still be given back or grown
+};
+
+struct atomicStats {
+    std::atomic<size_t> decodes{ 0 }, allocations{ 0 }, systemAllocations{ 0 }, bytesRequested{ 0 };
+    std::atomic<size_t> keptBytes{ 0 }, copiedBytes{ 0 }, peakBytes{ 0 }, reservedBytes{ 0 };
+};
+
+atomicStats totals;
+
+struct threadArena {
+    int depth = 0;
+    std::vector<chunk> chunks;
+    size_t current = 0;               // chunks after this one are empty
+    std::vector<blockHeader*> live;   // big blocks the current decode has
+    std::vector<blockHeader*> spare;  // oldest first
+    size_t spareBytes = 0;
+
+    // the current decode, added to the totals when it ends
+    decodeArenaStats counts;
+    size_t inUse = 0;
+
+    ~threadArena()
+    {
+        for (chunk& c : chunks)
+            release(c);
+        for (blockHeader* h : live)
+            dropBig(h);
+        for (blockHeader* h : spare)
+            dropBig(h);
+    }
+
+    void* fromSystem(size_t bytes)
+    {
+        counts.systemAllocations++;
+        return malloc(bytes);
+    }
+
+    void release(chunk& c)
+    {
+        free(c.base);
+        totals.reservedBytes -= chunkSize;
+    }
+
+    void dropBig(blockHeader* h)
+    {
+        totals.reservedBytes -= h->capacity;
+        free(h);
+    }
+
+    void* allocate(size_t size)
+    {
+        return size > bigSize ? allocateBig(size) : allocateSmall(size);
+    }
+
+    void* allocateSmall(size_t size)
+    {
+        size_t need = sizeof(blockHeader) + roundUp(size, alignof(blockHeader));
+        while (current < chunks.size() && chunks[current].used + need > chunkSize)
+            current++;
+        if (current == chunks.size()) {
+            char* base = (char*)fromSystem(chunkSize);
+            if (!base)
+                return nullptr;
+            totals.reservedBytes += chunkSize;
+            chunks.push_back({ base, 0, nullptr });
+        }
+
+        chunk& c = chunks[current];
+        blockHeader* h = (blockHeader*)(c.base + c.used);
+        h->size = size;
+        h->capacity = need - sizeof(blockHeader);
+        h->kind = chunkBlock;
+        c.used += need;
+        c.last = h;
+        grew(need);
+        return h + 1;
+    }
+
+    void* allocateBig(size_t size)
+    {
+        // the smallest spare that will do, as long as it isn't wildly too big
+        size_t best = spare.size();
+        for (size_t i = 0; i < spare.size(); i++)
+            if (spare[i]->capacity >= size && spare[i]->capacity <= 4 * size + bigGranule
+                && (best == spare.size() || spare[i]->capacity < spare[best]->capacity))
+                best = i;
+
+        blockHeader* h;
+        if (best < spare.size()) {
+            h = spare[best];
+            spare.erase(spare.begin() + best);
+            spareBytes -= h->capacity;
+        }
+        else {
+            size_t capacity = roundUp(size, bigGranule);
+            h = (blockHeader*)fromSystem(sizeof(blockHeader) + capacity);
+            if (!h)
+                return nullptr;
+            h->capacity = capacity;
+            totals.reservedBytes += capacity;
+        }
+        h->size = size;
+        h->kind = bigBlock;
+        live.push_back(h);
+        grew(h->capacity);
+        return h + 1;
+    }
+
+    // give a block back to the arena before the decode ends, if it's any use to
+    void giveBack(blockHeader* h)
+    {
+        if (h->kind == chunkBlock) {
+            chunk& c = chunks[current];
+            if (c.last == h) {
+                size_t bytes = sizeof(blockHeader) + h->capacity;
+                c.used -= bytes;
+                c.last = nullptr;
+                inUse -= bytes;
+            }
+        }
+        else if (h->kind == bigBlock) {
+            live.erase(std::find(live.begin(), live.end(), h));
+            inUse -= h->capacity;
+            h->kind = spareBlock;
+            spare.push_back(h);
+            spareBytes += h->capacity;
+        }
+    }
+
+    void* reallocate(blockHeader* h, size_t size)
+    {
+        if (size <= h->capacity) {
+            h->size = size;
+            return h + 1;
+        }
+
+        // the newest block in the chunk can grow where it is
+        if (h->kind == chunkBlock && size <= bigSize && chunks[current].last == h) {
+            chunk& c = chunks[current];
+            size_t more = roundUp(size, alignof(blockHeader)) - h->capacity;
+            if (c.used + more <= chunkSize) {
+                c.used += more;
+                h->capacity += more;
+                h->size = size;
+                grew(more);
+                return h + 1;
+            }
+        }
+
+        void* moved = allocate(size);
+        if (moved) {
+            memcpy(moved, h + 1, h->size);
+            giveBack(h);
+        }
+        return moved;
+    }
+
+    void grew(size_t bytes)
+    {
+        inUse += bytes;
+        counts.peakBytes = std::max(counts.peakBytes, inUse);
+    }
+
+    // the decode is over: everything goes back at once
+    void reset()
+    {
+        for (blockHeader* h : live) {
+            h->kind = spareBlock;
+            spare.push_back(h);
+            spareBytes += h->capacity;
+        }
+        live.clear();
+
+        // keep enough big blocks to do this decode again, less what it kept; the loader goes
+        // biggest first, so that lets go of memory as the images get smaller
+        size_t limit = std::max(counts.peakBytes - std::min(counts.peakBytes, counts.keptBytes), minimumSpare);
+        size_t dropped = 0;
+        while (spareBytes > limit && dropped < spare.size()) {
+            spareBytes -= spare[dropped]->capacity;
+            dropBig(spare[dropped++]);
+        }
+        spare.erase(spare.begin(), spare.begin() + dropped);
+
+        while (chunks.size() > keptChunks) {
+            release(chunks.back());
+            chunks.pop_back();
+        }
+        for (chunk& c : chunks) {
+            c.used = 0;
+            c.last = nullptr;
+        }
+        current = 0;
+        inUse = 0;
+
+        totals.decodes++;
+        totals.allocations += counts.allocations;
+        totals.systemAllocations += counts.systemAllocations;
+        totals.bytesRequested += counts.bytesRequested;
+        totals.keptBytes += counts.keptBytes;
+        totals.copiedBytes += counts.copiedBytes;
+        size_t peak = totals.peakBytes;
+        while (counts.peakBytes > peak && !totals.peakBytes.compare_exchange_weak(peak, counts.peakBytes))
+            ;
+        counts = decodeArenaStats();
+    }
+};
+
+thread_local threadArena arena;
+
+void* heapAllocate(size_t size)
+{
+    blockHeader* h = (blockHeader*)malloc(sizeof(blockHeader) + size);
+    if (!h)
+        return nullptr;
+    h->size = h->capacity = size;
+    h->kind = heapBlock;
+    return h + 1;
+}
+
+} // namespace
+
+decodeArena::decodeArena()
+{
+    arena.depth++;
+}
+
+decodeArena::~decodeArena()
+{
+    if (--arena.depth == 0)
+        arena.reset();
+}
+
+unsigned char* decodeArena::keep(unsigned char* pixels)
+{
+    if (!pixels)
+        return nullptr;
+
+    threadArena& a = arena;
+    blockHeader* h = headerOf(pixels);
+    if (h->kind == bigBlock) {
+        // the block itself goes to the caller, given back to malloc when they free it.  A
+        // spare that was a lot too big is shrunk first (in place, as a rule)
+        a.live.erase(std::find(a.live.begin(), a.live.end(), h));
+        a.inUse -= h->capacity;
+        totals.reservedBytes -= h->capacity;
+        h->kind = heapBlock;
+        if (h->capacity > h->size + h->size / 2) {
+            if (blockHeader* smaller = (blockHeader*)realloc(h, sizeof(blockHeader) + h->size))
+                h = smaller;
+        }
+        h->capacity = h->size;
+        a.counts.keptBytes += h->size;
+        return (unsigned char*)(h + 1);
+    }
+    if (h->kind == chunkBlock) {
+        a.counts.systemAllocations++;
+        unsigned char* copy = (unsigned char*)heapAllocate(h->size);
+        if (copy) {
+            memcpy(copy, pixels, h->size);
+            a.counts.keptBytes += h->size;
+            a.counts.copiedBytes += h->size;
+        }
+        a.giveBack(h);
+        return copy;
+    }
+    return pixels;
+}
+
+decodeArenaStats decodeArena::stats()
+{
+    decodeArenaStats s;
+    s.decodes = totals.decodes;
+    s.allocations = totals.allocations;
+    s.systemAllocations = totals.systemAllocations;
+    s.bytesRequested = totals.bytesRequested;
+    s.keptBytes = totals.keptBytes;
+    s.copiedBytes = totals.copiedBytes;
+    s.peakBytes = totals.peakBytes;
+    s.reservedBytes = totals.reservedBytes;
+    return s;
+}
+
+void* decodeArenaMalloc(size_t size)
+{
+    threadArena& a = arena;
+    if (a.depth == 0)
+        return heapAllocate(size);
+    a.counts.allocations++;
+    a.counts.bytesRequested += size;
+    return a.allocate(size);
+}
+
+void* decodeArenaRealloc(void* p, size_t size)
+{
+    if (!p)
+        return decodeArenaMalloc(size);
+
+    blockHeader* h = headerOf(p);
+    if (h->kind == heapBlock) {
+        h = (blockHeader*)realloc(h, sizeof(blockHeader) + size);
+        if (!h)
+            return nullptr;
+        h->size = h->capacity = size;
+        return h + 1;
+    }
+
+    threadArena& a = arena;
+    a.counts.allocations++;
+    a.counts.bytesRequested += size;
+    return a.reallocate(h, size);
+}
+
+void decodeArenaFree(void* p)
+{
+    if (!p)
+        return;
+    blockHeader* h = headerOf(p);
+    if (h->kind == heapBlock)
+        free(h);
+    else if (arena.depth > 0)
+        arena.giveBack(h);
+    // anything else is arena memory freed after its arena went, which it already got back
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+
+// what the decode arenas have done, added up over every thread since the program started
+struct decodeArenaStats {
+    size_t decodes = 0;           // arenas that have come and gone
+    size_t allocations = 0;       // mallocs and reallocs stb_image made inside them
+    size_t systemAllocations = 0; // mallocs the arenas had to make for those, kept pixels included
+    size_t bytesRequested = 0;    // what stb_image asked for inside them
+    size_t keptBytes = 0;         // pixels handed out by keep()
+    size_t copiedBytes = 0;       // the part of that which had to be copied out of a chunk
+    size_t peakBytes = 0;         // the most one decode had live at once
+    size_t reservedBytes = 0;     // memory the arenas are holding on to right now, for the next decode
+};
+
+// Temporary memory for stb_image, one arena per thread.
+//
+// Decoding one image makes a dozen or so allocations, most of them big (zlib's output
+// growing by doubling, the PNG scanlines, the JPEG component planes) and all but one freed
+// again before stbi_load returns.  Loading many images like that on many threads keeps
+// malloc busy and leaves the heap in pieces.  Inside a decodeArena the allocations come
+// from the thread's own memory instead: small ones are bumped out of 256 KB chunks, big
+// ones get blocks that go back on a per thread list when freed, to be picked up again by
+// the next decode that needs one that size.  Once a thread has decoded an image or two it
+// mostly stops asking the system for memory at all.
+//
+// Put one around each decode, on the thread doing it, and pass the result through keep()
+// before the arena goes: that hands the pixel buffer over to the caller (to be freed with
+// stbi_image_free as usual) and lets everything else go back at once.  Anything stb_image
+// allocates outside an arena goes to malloc as it always did.  Arenas can nest, only the
+// outermost one lets go of the memory.
+class decodeArena {
+public:
+    decodeArena();
+    ~decodeArena();
+    decodeArena(const decodeArena&) = delete;
+    decodeArena& operator=(const decodeArena&) = delete;
+
+    // the decoded image, moved out of the arena so it outlives it.  Big images keep their
+    // block (no copy), small ones are copied out of the chunk they were bumped from
+    unsigned char* keep(unsigned char* pixels);
+
+    static decodeArenaStats stats();
+};
+
+// stb_image's STBI_MALLOC, STBI_REALLOC and STBI_FREE (see stbimage.cpp)
+void* decodeArenaMalloc(size_t size);
+void* decodeArenaRealloc(void* p, size_t size);
+void decodeArenaFree(void* p);
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <random>
+
+#include "basics.h"
+#include "cpumesh.h"
+#include "pixelbuffer.h"
+#include "threadpool.h"
+
+// The CPU pixel demos behind the buttons in the UI, each drawing into imageBuff.  rastertest
+// checks every one of them against its golden image (tests/golden), so they must draw the
+// same picture on any thread count.  Each lives next to what it shows off, in
+// <feature>demo.cpp; the ones that spread work over threads take the pool to use (handy
+// for timing 1..N threads).
+
+// imageBuff's size, rows (dimx) by columns (dimy)
+constexpr auto dimx = 512u, dimy = 512u;
+
+// std::rand differs between C libraries, this gives the same pictures everywhere
+inline unsigned int nextRandom(std::mt19937& gen, unsigned int n)
+{
+    return gen() % n;
+}
+
+// batched lines, circles, ellipses and polygons over the checkerboard (raster2ddemo.cpp)
+int myPrimitives(threadPool& pool = threadPool::shared());
+
+// a wall of cubes hiding a crowd of cubes, most of them rejected by hierarchical Z
+// (depthrasterdemo.cpp)
+int myDepthScene(threadPool& pool = threadPool::shared());
+
+// flat, Gouraud and textured triangles through the template pipeline (fragpipedemo.cpp)
+int myShadedTriangles(threadPool& pool = threadPool::shared());
+
+// prints the template vs virtual shading comparison, leaves imageBuff scribbled on
+int myShadingBenchmark();
+
+// 8x multisampled polygons over the checkerboard (msaarasterdemo.cpp)
+int myAntialiased(threadPool& pool = threadPool::shared());
+
+// prints 4x / 8x multisampling against 4x supersampling, leaves imageBuff scribbled on
+int myAntialiasingBenchmark();
+
+// the antialiased scene four times over at half size: as is, blurred, Sobel edges and
+// graded (imagefilterdemo.cpp)
+int myFiltered(threadPool& pool = threadPool::shared());
+
+// prints the fused SIMD filter pipeline against one plain pass per filter step
+int myFilterBenchmark();
+
+// a floor and a ceiling running off to the horizon, textured on the CPU with nearest,
+// bilinear and trilinear filtering.  The texture is the image file when one is given and
+// can be read, the antialiased scene otherwise (cputexturedemo.cpp)
+int myTexturedFloor(const char* image = nullptr, threadPool& pool = threadPool::shared());
+
+// prints texture sampling speed for the row-major, tiled and Morton layouts
+int myTextureBenchmark();
+
+// the antialiased scene through BC1 and BC3 and back (blockcompressdemo.cpp)
+int myCompressed(threadPool& pool = threadPool::shared());
+
+// a few dozen small images packed into an atlas page in two batches (textureatlasdemo.cpp)
+int myAtlas();
+
+// a torus written out as OBJ text, imported again and drawn (meshimportdemo.cpp)
+int myMeshImport(threadPool& pool = threadPool::shared());
+
+// the torus the mesh demos share, rows of quads around the ring, uvs 0..1 both ways
+// (meshoptimizedemo.cpp)
+cpuMesh torusMesh(int around, int across);
+
+// a shuffled torus before and after optimizeMesh, coloured by vertex cache misses
+// (meshoptimizedemo.cpp)
+int myMeshOptimize(threadPool& pool = threadPool::shared());
+
+// a torus quantized two ways and unpacked again, lit and checkered (meshquantizedemo.cpp)
+int myMeshQuantize(threadPool& pool = threadPool::shared());
+
+// a torus and its LODs drawn going away from the camera, each with the LOD its size
+// calls for (meshloddemo.cpp)
+int myMeshLod(threadPool& pool = threadPool::shared());
+
+// a torus cut into meshlets and culled for a camera close in on one side of it
+// (meshletsdemo.cpp)
+int myMeshlets(threadPool& pool = threadPool::shared());
+
+// a torus through openMeshCached with no mesh file, a damaged one and a stale one, each
+// made again (meshfiledemo.cpp)
+int myMeshCache(threadPool& pool = threadPool::shared());
+
+// every generator in meshgen.h lit and drawn in one picture, then timed at sizes worth
+// timing (meshgendemo.cpp)
+int myMeshGen(threadPool& pool = threadPool::shared());
@@ -0,0 +1,273 @@
+//
+// depth tested CPU triangles with tile level hierarchical Z rejection (see depthraster.h)
+//
+
+#include "depthraster.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+depthBuffer::depthBuffer(int width, int height)
+    : w(width), h(height),
+      tx((width + tileSize - 1) / tileSize), ty((height + tileSize - 1) / tileSize),
+      values((size_t)width * height), minZ((size_t)tx * ty), maxZ((size_t)tx * ty)
+{
+    clear();
+}
+
+void depthBuffer::clear(float value)
+{
+    std::fill(values.begin(), values.end(), value);
+    std::fill(minZ.begin(), minZ.end(), value);
+    std::fill(maxZ.begin(), maxZ.end(), value);
+}
+
+void depthBuffer::refreshTile(int x, int y)
+{
+    int x0 = x * tileSize, x1 = std::min(x0 + tileSize, w);
+    int y0 = y * tileSize, y1 = std::min(y0 + tileSize, h);
+
+    float lo = 1e30f, hi = -1e30f;
+    for (int py = y0; py < y1; py++) {
+        const float* z = &values[(size_t)py * w];
+        for (int px = x0; px < x1; px++) {
+            lo = std::min(lo, z[px]);
+            hi = std::max(hi, z[px]);
+        }
+    }
+    minZ[(size_t)y * tx + x] = lo;
+    maxZ[(size_t)y * tx + x] = hi;
+}
+
+namespace {
+
+struct clipVertex {
+    glm::vec4 pos;
+    glm::vec3 color;
+};
+
+// a triangle after clipping and the viewport transform, ready for the tile loop
+struct screenTriangle {
+    glm::vec2 p[3];       // window position (pixel units, y up)
+    float z[3];           // window depth 0..1, affine in screen space
+    float invW[3];        // 1/w, for perspective correct attributes
+    glm::vec3 cOverW[3];  // color/w
+    float area;           // twice the signed area (> 0 after setup)
+    float zmin, zmax;
+    int x0, y0, x1, y1;   // pixel bounds, inclusive
+};
+
+// edge function, > 0 when p is on the left of a->b (inside for a counter clockwise triangle)
+inline float edge(glm::vec2 a, glm::vec2 b, glm::vec2 p)
+{
+    return (b.x - a.x) * (p.y - a.y) - (b.y - a.y) * (p.x - a.x);
+}
+
+// top-left fill rule (y up): pixels exactly on a left or top edge belong to the triangle
+inline bool topLeft(glm::vec2 a, glm::vec2 b)
+{
+    return (b.y < a.y) || (b.y == a.y && b.x < a.x);
+}
+
+// clip a polygon against z >= -w (the GL near plane), Sutherland-Hodgman style
+int clipNear(const clipVertex* in, int count, clipVertex* out)
+{
+    int n = 0;
+    for (int i = 0; i < count; i++) {
+        const clipVertex& a = in[i];
+        const clipVertex& b = in[(i + 1) % count];
+        float da = a.pos.z + a.pos.w, db = b.pos.z + b.pos.w;
+
+        if (da >= 0.0f)
+            out[n++] = a;
+        if ((da >= 0.0f) != (db >= 0.0f)) {
+            float t = da / (da - db);
+            out[n++] = { a.pos + (b.pos - a.pos) * t, a.color + (b.color - a.color) * t };
+        }
+    }
+    return n;
+}
+
+} // namespace
+
+depthStats depthRasterizer::drawTriangles(const glm::vec3* positions, const glm::vec3* colors,
+                                          const unsigned int* indices, int indexCount, const glm::mat4& mvp,
+                                          threadPool& pool)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    depthStats stats;
+    stats.triangles = indexCount / 3;
+
+    // ---- setup: clip, project, cull and bound every triangle
+    std::vector<screenTriangle> tris;
+    tris.reserve(stats.triangles);
+
+    glm::vec2 half(target.width * 0.5f, target.height * 0.5f);
+
+    for (int t = 0; t + 2 < indexCount; t += 3) {
+        clipVertex in[3], poly[4];
+        for (int k = 0; k < 3; k++) {
+            unsigned int v = indices[t + k];
+            in[k] = { mvp * glm::vec4(positions[v], 1.0f), colors[v] };
+        }
+
+        int n = clipNear(in, 3, poly);
+        if (n < 3) {
+            stats.culled++;
+            continue;
+        }
+
+        // window coordinates of the clipped polygon
+        glm::vec2 win[4];
+        float wz[4], iw[4];
+        for (int k = 0; k < n; k++) {
+            iw[k] = 1.0f / std::max(poly[k].pos.w, 1e-6f);
+            glm::vec3 ndc = glm::vec3(poly[k].pos) * iw[k];
+            win[k] = (glm::vec2(ndc) + 1.0f) * half;
+            wz[k] = ndc.z * 0.5f + 0.5f;
+        }
+
+        bool kept = false;
+        for (int k = 1; k + 1 < n; k++) { // fan
+            int i0 = 0, i1 = k, i2 = k + 1;
+            float area = edge(win[i0], win[i1], win[i2]);
+            if (area == 0.0f || (cullBackFaces && area < 0.0f))
+                continue;
+            if (area < 0.0f) {
+                std::swap(i1, i2);
+                area = -area;
+            }
+
+            screenTriangle s;
+            int ids[3] = { i0, i1, i2 };
+            glm::vec2 lo(1e30f), hi(-1e30f);
+            for (int j = 0; j < 3; j++) {
+                s.p[j] = win[ids[j]];
+                s.z[j] = wz[ids[j]];
+                s.invW[j] = iw[ids[j]];
+                s.cOverW[j] = poly[ids[j]].color * iw[ids[j]];
+                lo = glm::min(lo, s.p[j]);
+                hi = glm::max(hi, s.p[j]);
+            }
+            s.area = area;
+            s.zmin = std::min({ s.z[0], s.z[1], s.z[2] });
+            s.zmax = std::max({ s.z[0], s.z[1], s.z[2] });
+
+            // pixel centres are at +0.5
+            s.x0 = std::max(0, (int)std::ceil(lo.x - 0.5f));
+            s.y0 = std::max(0, (int)std::ceil(lo.y - 0.5f));
+            s.x1 = std::min(target.width - 1, (int)std::floor(hi.x - 0.5f));
+            s.y1 = std::min(target.height - 1, (int)std::floor(hi.y - 0.5f));
+
+            if (s.x0 > s.x1 || s.y0 > s.y1 || s.zmin >= 1.0f)
+                continue;
+
+            tris.push_back(s);
+            kept = true;
+        }
+        if (!kept)
+            stats.culled++;
+    }
+
+    // ---- bin into bands of tile rows
+    const int ts = depthBuffer::tileSize;
+    const int bandTiles = 4;
+    int bandCount = (depth.tilesY() + bandTiles - 1) / bandTiles;
+
+    std::vector<std::vector<int>> bands(bandCount);
+    for (int i = 0; i < (int)tris.size(); i++)
+        for (int b = tris[i].y0 / (ts * bandTiles); b <= tris[i].y1 / (ts * bandTiles); b++)
+            bands[b].push_back(i);
+
+    std::vector<depthStats> bandStats(bandCount);
+
+    // ---- draw: per tile hi-Z test, then per pixel depth test
+    pool.parallelFor(bandCount, [&](int b) {
+        depthStats& st = bandStats[b];
+        int bandY0 = b * bandTiles * ts, bandY1 = std::min((b + 1) * bandTiles * ts, target.height) - 1;
+
+        for (int i : bands[b]) {
+            const screenTriangle& s = tris[i];
+
+            glm::vec2 e[3][2] = { { s.p[1], s.p[2] }, { s.p[2], s.p[0] }, { s.p[0], s.p[1] } };
+            bool tl[3] = { topLeft(s.p[1], s.p[2]), topLeft(s.p[2], s.p[0]), topLeft(s.p[0], s.p[1]) };
+            auto inside = [&tl](float w, int k) { return w > 0.0f || (w == 0.0f && tl[k]); };
+
+            int ty0 = std::max(s.y0, bandY0) / ts, ty1 = std::min(s.y1, bandY1) / ts;
+            int tx0 = s.x0 / ts, tx1 = s.x1 / ts;
+
+            for (int ty = ty0; ty <= ty1; ty++) {
+                for (int tx = tx0; tx <= tx1; tx++) {
+                    int px0 = std::max(tx * ts, s.x0), px1 = std::min(tx * ts + ts - 1, s.x1);
+                    int py0 = std::max(ty * ts, s.y0), py1 = std::min(ty * ts + ts - 1, s.y1);
+
+                    // skip tiles that lie completely outside one of the edges
+                    bool outside = false;
+                    for (int k = 0; k < 3 && !outside; k++) {
+                        glm::vec2 a = e[k][0], c = e[k][1];
+                        float best = std::max(std::max(edge(a, c, glm::vec2(px0 + 0.5f, py0 + 0.5f)), edge(a, c, glm::vec2(px1 + 0.5f, py0 + 0.5f))),
+                                              std::max(edge(a, c, glm::vec2(px0 + 0.5f, py1 + 0.5f)), edge(a, c, glm::vec2(px1 + 0.5f, py1 + 0.5f))));
+                        outside = best < 0.0f;
+                    }
+                    if (outside)
+                        continue;
+
+                    st.tilesTested++;
+
+                    // hierarchical Z: the nearest point of the triangle is behind everything in the tile
+                    if (s.zmin >= depth.tileMax(tx, ty)) {
+                        st.tilesRejected++;
+                        continue;
+                    }
+                    // ... or its farthest point is in front of everything, so skip the compares
+                    bool alwaysPasses = s.zmax < depth.tileMin(tx, ty);
+
+                    bool wrote = false;
+                    float invArea = 1.0f / s.area;
+
+                    for (int y = py0; y <= py1; y++) {
+                        float* zrow = depth.row(y);
+                        for (int x = px0; x <= px1; x++) {
+                            glm::vec2 p(x + 0.5f, y + 0.5f);
+                            float w0 = edge(s.p[1], s.p[2], p);
+                            float w1 = edge(s.p[2], s.p[0], p);
+                            float w2 = edge(s.p[0], s.p[1], p);
+                            if (!inside(w0, 0) || !inside(w1, 1) || !inside(w2, 2))
+                                continue;
+
+                            w0 *= invArea; w1 *= invArea; w2 *= invArea;
+
+                            st.pixelsTested++;
+                            float z = w0 * s.z[0] + w1 * s.z[1] + w2 * s.z[2];
+                            if (!alwaysPasses && !(z < zrow[x]))
+                                continue;
+
+                            zrow[x] = z;
+                            wrote = true;
+                            st.pixelsWritten++;
+
+                            float iw = w0 * s.invW[0] + w1 * s.invW[1] + w2 * s.invW[2];
+                            glm::vec3 c = (w0 * s.cOverW[0] + w1 * s.cOverW[1] + w2 * s.cOverW[2]) / iw;
+                            c = glm::clamp(c, 0.0f, 1.0f) * 255.0f + 0.5f;
+                            target.put(x, y, rgb8{ (unsigned char)c.r, (unsigned char)c.g, (unsigned char)c.b });
+                        }
+                    }
+
+                    if (wrote)
+                        depth.refreshTile(tx, ty);
+                }
+            }
+        }
+    });
+
+    for (const depthStats& st : bandStats) {
+        stats.tilesTested += st.tilesTested;
+        stats.tilesRejected += st.tilesRejected;
+        stats.pixelsTested += st.pixelsTested;
+        stats.pixelsWritten += st.pixelsWritten;
+    }
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
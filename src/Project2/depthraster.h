@@ -0,0 +1,72 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "pixelbuffer.h"
+#include "threadpool.h"
+
+// A float depth buffer that matches a pixelBuffer, plus a coarse min/max depth per
+// 8x8 tile (a one level hierarchical Z).  Depth runs 0 (near) to 1 (far) like GL's
+// default depth range, and the test is GL_LESS.
+class depthBuffer {
+public:
+    static constexpr int tileSize = 8;
+
+    depthBuffer(int width, int height);
+    explicit depthBuffer(pixelBuffer target) : depthBuffer(target.width, target.height) {}
+
+    void clear(float value = 1.0f);
+
+    int width() const { return w; }
+    int height() const { return h; }
+    int tilesX() const { return tx; }
+    int tilesY() const { return ty; }
+
+    float* row(int y) { return &values[(size_t)y * w]; }
+    float at(int x, int y) const { return values[(size_t)y * w + x]; }
+
+    float tileMin(int x, int y) const { return minZ[(size_t)y * tx + x]; }
+    float tileMax(int x, int y) const { return maxZ[(size_t)y * tx + x]; }
+
+    // recompute the min/max of one tile after pixels in it were written
+    void refreshTile(int x, int y);
+
+private:
+    int w, h, tx, ty;
+    std::vector<float> values;
+    std::vector<float> minZ, maxZ;
+};
+
+// what the depth tested triangle path did, handy for seeing how much work hi-Z saved
+struct depthStats {
+    size_t triangles = 0;      // submitted
+    size_t culled = 0;         // back facing, clipped away or zero area
+    size_t tilesTested = 0;    // triangle / tile pairs that got past the edge tests
+    size_t tilesRejected = 0;  // ... of which hierarchical Z threw away before any pixel work
+    size_t pixelsTested = 0;   // pixels inside a triangle that ran the depth test
+    size_t pixelsWritten = 0;  // pixels that passed it
+    double seconds = 0.0;
+};
+
+// Depth tested CPU triangles.  Vertices are transformed by the mvp matrix, clipped
+// against the near plane and mapped to the target the same way GL maps the viewport
+// (row 0 at the bottom, which is also how imageBuff is shown as a texture).
+// Colors are interpolated perspective correctly.
+//
+// Like primitiveBatch the screen is split into horizontal bands of tile rows that are
+// drawn in parallel; triangles keep their order inside a band so results are stable.
+class depthRasterizer {
+public:
+    depthRasterizer(pixelBuffer target, depthBuffer& depth) : target(target), depth(depth) {}
+
+    bool cullBackFaces = true; // counter clockwise is front, as in GL
+
+    depthStats drawTriangles(const glm::vec3* positions, const glm::vec3* colors,
+                             const unsigned int* indices, int indexCount, const glm::mat4& mvp,
+                             threadPool& pool = threadPool::shared());
+
+private:
+    pixelBuffer target;
+    depthBuffer& depth;
+};
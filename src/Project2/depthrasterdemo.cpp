@@ -0,0 +1,71 @@
+//
+// the depth tested triangle demo (see depthraster.h)
+//
+
+#include "demos.h"
+
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "depthraster.h"
+
+// a wall of cubes hiding a crowd of cubes, drawn front to back through the depth tested path
+// most of the hidden cubes never get past the hierarchical Z tile test
+int myDepthScene(threadPool& pool)
+{
+    static const glm::vec3 cubePos[8] = {
+        { -0.5f, -0.5f, -0.5f }, { 0.5f, -0.5f, -0.5f }, { 0.5f, 0.5f, -0.5f }, { -0.5f, 0.5f, -0.5f },
+        { -0.5f, -0.5f,  0.5f }, { 0.5f, -0.5f,  0.5f }, { 0.5f, 0.5f,  0.5f }, { -0.5f, 0.5f,  0.5f }
+    };
+    static const unsigned int cubeIdx[36] = {
+        4, 5, 6,  4, 6, 7,  // +z
+        1, 0, 3,  1, 3, 2,  // -z
+        5, 1, 2,  5, 2, 6,  // +x
+        0, 4, 7,  0, 7, 3,  // -x
+        7, 6, 2,  7, 2, 3,  // +y
+        0, 1, 5,  0, 5, 4   // -y
+    };
+
+    std::vector<glm::vec3> positions, colors;
+    std::vector<unsigned int> indices;
+
+    auto addCube = [&](glm::vec3 centre, float size, glm::vec3 color) {
+        unsigned int base = (unsigned int)positions.size();
+        for (int k = 0; k < 8; k++) {
+            positions.push_back(centre + cubePos[k] * size);
+            colors.push_back(color * (0.6f + 0.4f * (cubePos[k].y + 0.5f)));
+        }
+        for (int k = 0; k < 36; k++)
+            indices.push_back(base + cubeIdx[k]);
+    };
+
+    std::mt19937 gen(4321);
+    auto rnd = [&]() { return nextRandom(gen, 1000) / 1000.0f; };
+
+    // the wall, nearest first
+    for (int y = -2; y <= 2; y++)
+        for (int x = -2; x <= 2; x++)
+            addCube(glm::vec3(x * 0.5f, y * 0.5f, -3.0f), 0.45f, glm::vec3(0.9f, 0.8f, 0.3f));
+
+    // the crowd behind it
+    for (int i = 0; i < 2000; i++)
+        addCube(glm::vec3(rnd() * 16.0f - 8.0f, rnd() * 16.0f - 8.0f, -4.0f - rnd() * 20.0f), 0.3f + rnd() * 0.5f,
+            glm::vec3(rnd(), rnd(), rnd()));
+
+    glm::mat4 proj = glm::perspective(1.0472f, 1.0f, 0.1f, 100.0f);
+    glm::mat4 view = glm::rotate(glm::mat4(1.0f), 0.2f, glm::vec3(0.0f, 1.0f, 0.0f));
+
+    memset(imageBuff, 0, sizeof(imageBuff));
+
+    depthBuffer depth(imageBuffer());
+    depthRasterizer raster(imageBuffer(), depth);
+
+    depthStats stats = raster.drawTriangles(positions.data(), colors.data(), indices.data(), (int)indices.size(), proj * view, pool);
+
+    std::cout << "depth scene: " << stats.triangles << " triangles, " << stats.tilesRejected << " of " << stats.tilesTested
+        << " tiles rejected by hi-Z, " << stats.pixelsWritten << " pixels written in " << stats.seconds * 1000.0 << " ms\n";
+
+    return 0;
+}
@@ -0,0 +1,155 @@
+//
+// runtime polymorphic triangle shading, the baseline the template pipeline in fragpipe.h
+// is measured against.  It rasterizes exactly like the template version but loops over a
+// runtime attribute count, branches on the interpolation mode per pixel and calls the
+// shader through a virtual function.
+//
+
+#include "fragpipe.h"
+
+namespace {
+
+struct dynamicSetup {
+    float e[3][3];
+    bool tl[3];
+    std::vector<float> base, dx, dy, flatValue; // attrCount + 1 entries, the last one is 1/w
+    int x0, y0, x1, y1;
+};
+
+bool setupDynamic(pixelBuffer target, const glm::vec4* pos[3], const float* attr[3], int n, interpolation mode, dynamicSetup& s)
+{
+    glm::vec2 p[3];
+    std::vector<float> f[3];
+
+    for (int k = 0; k < 3; k++) {
+        if (pos[k]->w <= 0.0f)
+            return false;
+        float iw = 1.0f / pos[k]->w;
+        p[k] = (glm::vec2(*pos[k]) * iw + 1.0f) * glm::vec2(target.width * 0.5f, target.height * 0.5f);
+        f[k].resize(n + 1);
+        for (int a = 0; a < n; a++)
+            f[k][a] = mode == interpolation::perspective ? attr[k][a] * iw : attr[k][a];
+        f[k][n] = iw;
+    }
+
+    glm::vec2 d1 = p[1] - p[0], d2 = p[2] - p[0];
+    float area = d1.x * d2.y - d2.x * d1.y;
+    if (area == 0.0f)
+        return false;
+
+    if (area < 0.0f) {
+        std::swap(p[1], p[2]);
+        std::swap(f[1], f[2]);
+        std::swap(d1, d2);
+        area = -area;
+    }
+    s.flatValue.assign(attr[2], attr[2] + n);
+
+    for (int k = 0; k < 3; k++) {
+        glm::vec2 a = p[(k + 1) % 3], b = p[(k + 2) % 3];
+        s.e[k][0] = -(b.y - a.y);
+        s.e[k][1] = b.x - a.x;
+        s.e[k][2] = (b.y - a.y) * a.x - (b.x - a.x) * a.y;
+        s.tl[k] = fragpipe::isTopLeft(a, b);
+    }
+
+    s.base.resize(n + 1);
+    s.dx.resize(n + 1);
+    s.dy.resize(n + 1);
+    float inv = 1.0f / area;
+    for (int a = 0; a <= n; a++) {
+        float df1 = f[1][a] - f[0][a], df2 = f[2][a] - f[0][a];
+        s.dx[a] = (df1 * d2.y - df2 * d1.y) * inv;
+        s.dy[a] = (d1.x * df2 - d2.x * df1) * inv;
+        s.base[a] = f[0][a] - s.dx[a] * p[0].x - s.dy[a] * p[0].y;
+    }
+
+    glm::vec2 lo = glm::min(glm::min(p[0], p[1]), p[2]), hi = glm::max(glm::max(p[0], p[1]), p[2]);
+    s.x0 = std::max(0, (int)std::ceil(lo.x - 0.5f));
+    s.y0 = std::max(0, (int)std::ceil(lo.y - 0.5f));
+    s.x1 = std::min(target.width - 1, (int)std::floor(hi.x - 0.5f));
+    s.y1 = std::min(target.height - 1, (int)std::floor(hi.y - 0.5f));
+    return s.x0 <= s.x1 && s.y0 <= s.y1;
+}
+
+size_t shadeRowsDynamic(const dynamicSetup& s, pixelBuffer target, int y0, int y1, int n, interpolation mode, const fragmentShader& shader)
+{
+    size_t pixels = 0;
+    std::vector<float> f(n + 1), in(n + 1);
+
+    for (int y = std::max(y0, s.y0); y <= std::min(y1, s.y1); y++) {
+        float py = y + 0.5f;
+        int xa = s.x0, xb = s.x1;
+        if (!fragpipe::rowSpan(s.e, s.tl, py, xa, xb))
+            continue;
+
+        float px = xa + 0.5f;
+        for (int a = 0; a <= n; a++)
+            f[a] = s.base[a] + s.dx[a] * px + s.dy[a] * py;
+
+        unsigned char* out = target.at(xa, y);
+
+        for (int x = xa; x <= xb; x++, out += 3) {
+            rgb8 c;
+            if (mode == interpolation::flat)
+                c = shader.shade(s.flatValue.data(), n);
+            else {
+                float wcorr = mode == interpolation::perspective ? 1.0f / f[n] : 1.0f;
+                for (int a = 0; a < n; a++)
+                    in[a] = f[a] * wcorr;
+                c = shader.shade(in.data(), n);
+            }
+            out[0] = c.r; out[1] = c.g; out[2] = c.b;
+            pixels++;
+
+            for (int a = 0; a <= n; a++)
+                f[a] += s.dx[a];
+        }
+    }
+    return pixels;
+}
+
+} // namespace
+
+shadingStats drawShadedTrianglesDynamic(pixelBuffer target, const glm::vec4* positions, const float* attrs, int attrCount,
+                                        interpolation mode, const unsigned int* indices, int indexCount,
+                                        const fragmentShader& shader, threadPool& pool)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    shadingStats stats;
+    stats.triangles = indexCount / 3;
+
+    std::vector<dynamicSetup> tris;
+    tris.reserve(stats.triangles);
+    for (int t = 0; t + 2 < indexCount; t += 3) {
+        const glm::vec4* pos[3];
+        const float* attr[3];
+        for (int k = 0; k < 3; k++) {
+            pos[k] = &positions[indices[t + k]];
+            attr[k] = &attrs[(size_t)indices[t + k] * attrCount];
+        }
+        dynamicSetup s;
+        if (setupDynamic(target, pos, attr, attrCount, mode, s))
+            tris.push_back(std::move(s));
+    }
+
+    const int bandHeight = 32;
+    int bandCount = (target.height + bandHeight - 1) / bandHeight;
+    std::vector<std::vector<int>> bands(bandCount);
+    for (int i = 0; i < (int)tris.size(); i++)
+        for (int b = tris[i].y0 / bandHeight; b <= tris[i].y1 / bandHeight; b++)
+            bands[b].push_back(i);
+
+    std::vector<size_t> pixels(bandCount, 0);
+    pool.parallelFor(bandCount, [&](int b) {
+        int y0 = b * bandHeight, y1 = std::min(y0 + bandHeight, target.height) - 1;
+        for (int i : bands[b])
+            pixels[b] += shadeRowsDynamic(tris[i], target, y0, y1, attrCount, mode, shader);
+    });
+
+    for (size_t p : pixels)
+        stats.pixels += p;
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
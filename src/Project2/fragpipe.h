@@ -0,0 +1,342 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "pixelbuffer.h"
+#include "threadpool.h"
+
+// A CPU triangle pipeline whose fragment stage is any C++ callable.
+//
+// What gets interpolated is described at compile time by an attributeLayout, so the
+// pixel loop is stamped out per layout and shader: the attribute loops have a fixed
+// trip count, the interpolation mode is an 'if constexpr' and the shader call is inlined.
+// There is no virtual dispatch and no per pixel branching on the attribute count.
+//
+// Vertices are in clip space; triangles with a vertex behind the eye (w <= 0) are dropped
+// rather than clipped, and there's no depth test (use depthRasterizer for that).  Pixels
+// land in the target the same way GL's viewport maps them, row 0 at the bottom.
+
+enum class interpolation {
+    flat,        // every pixel gets the attributes of the last (provoking) vertex, as in GL
+    linear,      // affine in screen space (noperspective)
+    perspective  // perspective correct (smooth, GL's default)
+};
+
+template <int Count, interpolation Mode = interpolation::perspective>
+struct attributeLayout {
+    static constexpr int count = Count;
+    static constexpr interpolation mode = Mode;
+};
+
+// the interpolated values handed to a fragment shader
+template <int Count>
+struct attributes {
+    float v[Count > 0 ? Count : 1];
+
+    float& operator[](int i) { return v[i]; }
+    float operator[](int i) const { return v[i]; }
+};
+
+template <typename Layout>
+struct shadedVertex {
+    using layout = Layout;
+
+    glm::vec4 position; // clip space
+    attributes<Layout::count> attr;
+};
+
+struct shadingStats {
+    size_t triangles = 0;
+    size_t pixels = 0;
+    double seconds = 0.0;
+
+    double megapixelsPerSecond() const { return seconds > 0.0 ? pixels / seconds / 1e6 : 0.0; }
+};
+
+// ---- the shaders that ship with the pipeline
+
+inline unsigned char toByte(float v)
+{
+    return (unsigned char)(std::min(std::max(v, 0.0f), 1.0f) * 255.0f + 0.5f);
+}
+
+// one color per triangle, taken from the provoking vertex
+struct flatShader {
+    using layout = attributeLayout<3, interpolation::flat>;
+
+    rgb8 operator()(const attributes<3>& a) const { return rgb8{ toByte(a[0]), toByte(a[1]), toByte(a[2]) }; }
+};
+
+// vertex colors blended across the triangle
+struct gouraudShader {
+    using layout = attributeLayout<3, interpolation::perspective>;
+
+    rgb8 operator()(const attributes<3>& a) const { return rgb8{ toByte(a[0]), toByte(a[1]), toByte(a[2]) }; }
+};
+
+// nearest neighbour lookup of an RGB image, wrapping like GL_REPEAT.  The texel is found
+// in integers: the coordinate scaled to texels, rounded down and wrapped with a mask when
+// the size is a power of two (a remainder otherwise)
+struct texturedShader {
+    using layout = attributeLayout<2, interpolation::perspective>;
+
+    pixelBuffer texture;
+    float width, height;
+    int wrapX, wrapY; // size - 1 for a power of two, 0 otherwise
+
+    explicit texturedShader(pixelBuffer t)
+        : texture(t), width((float)t.width), height((float)t.height), wrapX(powerOfTwoMask(t.width)), wrapY(powerOfTwoMask(t.height))
+    {
+    }
+
+    rgb8 operator()(const attributes<2>& a) const
+    {
+        int x = wrap(floorToInt(a[0] * width), texture.width, wrapX);
+        int y = wrap(floorToInt(a[1] * height), texture.height, wrapY);
+        const unsigned char* p = texture.pixels + ((size_t)y * texture.width + x) * 3;
+        return rgb8{ p[0], p[1], p[2] };
+    }
+
+    static int powerOfTwoMask(int size) { return (size & (size - 1)) == 0 ? size - 1 : 0; }
+    static int floorToInt(float v)
+    {
+        int i = (int)v;
+        return i - (v < (float)i);
+    }
+    static int wrap(int i, int size, int mask)
+    {
+        if (mask)
+            return i & mask;
+        i %= size;
+        return i < 0 ? i + size : i;
+    }
+};
+
+// ---- the runtime polymorphic version, kept around as a baseline to measure against
+
+class fragmentShader {
+public:
+    virtual ~fragmentShader() {}
+    virtual rgb8 shade(const float* attr, int count) const = 0;
+};
+
+// same rasterization as drawShadedTriangles but the attribute count and interpolation mode
+// are runtime values and the shader is called through a virtual function (fragpipe.cpp)
+shadingStats drawShadedTrianglesDynamic(pixelBuffer target, const glm::vec4* positions, const float* attrs, int attrCount,
+                                        interpolation mode, const unsigned int* indices, int indexCount,
+                                        const fragmentShader& shader, threadPool& pool = threadPool::shared());
+
+// ---- the specialized pipeline
+
+namespace fragpipe {
+
+// screen space triangle with a plane equation per attribute: f(x,y) = base + dx*x + dy*y
+template <typename Layout>
+struct triangleSetup {
+    static constexpr int N = Layout::count;
+
+    glm::vec2 p[3];
+    float e[3][3];          // edge equations a*x + b*y + c, >= 0 inside
+    bool tl[3];             // top-left fill rule per edge
+    float base[N + 1], dx[N + 1], dy[N + 1]; // attributes (divided by w when perspective), then 1/w
+    attributes<N> flatValue;
+    int x0, y0, x1, y1;
+};
+
+inline bool isTopLeft(glm::vec2 a, glm::vec2 b) { return (b.y < a.y) || (b.y == a.y && b.x < a.x); }
+
+// project, cull and prepare one triangle, false if there's nothing to draw
+template <typename Layout>
+bool setupTriangle(const shadedVertex<Layout>* v[3], pixelBuffer target, triangleSetup<Layout>& s)
+{
+    constexpr int N = Layout::count;
+    float f[3][N + 1];
+
+    for (int k = 0; k < 3; k++) {
+        if (v[k]->position.w <= 0.0f)
+            return false;
+        float iw = 1.0f / v[k]->position.w;
+        s.p[k] = (glm::vec2(v[k]->position) * iw + 1.0f) * glm::vec2(target.width * 0.5f, target.height * 0.5f);
+        for (int a = 0; a < N; a++)
+            f[k][a] = Layout::mode == interpolation::perspective ? v[k]->attr[a] * iw : v[k]->attr[a];
+        f[k][N] = iw;
+    }
+
+    glm::vec2 d1 = s.p[1] - s.p[0], d2 = s.p[2] - s.p[0];
+    float area = d1.x * d2.y - d2.x * d1.y;
+    if (area == 0.0f)
+        return false;
+
+    // either winding is drawn, flip to counter clockwise
+    if (area < 0.0f) {
+        std::swap(s.p[1], s.p[2]);
+        std::swap(f[1], f[2]);
+        std::swap(d1, d2);
+        area = -area;
+    }
+    s.flatValue = v[2]->attr; // provoking vertex, before any flip
+
+    for (int k = 0; k < 3; k++) {
+        glm::vec2 a = s.p[(k + 1) % 3], b = s.p[(k + 2) % 3];
+        s.e[k][0] = -(b.y - a.y);
+        s.e[k][1] = b.x - a.x;
+        s.e[k][2] = (b.y - a.y) * a.x - (b.x - a.x) * a.y;
+        s.tl[k] = isTopLeft(a, b);
+    }
+
+    float inv = 1.0f / area;
+    for (int a = 0; a <= N; a++) {
+        float df1 = f[1][a] - f[0][a], df2 = f[2][a] - f[0][a];
+        s.dx[a] = (df1 * d2.y - df2 * d1.y) * inv;
+        s.dy[a] = (d1.x * df2 - d2.x * df1) * inv;
+        s.base[a] = f[0][a] - s.dx[a] * s.p[0].x - s.dy[a] * s.p[0].y;
+    }
+
+    glm::vec2 lo = glm::min(glm::min(s.p[0], s.p[1]), s.p[2]), hi = glm::max(glm::max(s.p[0], s.p[1]), s.p[2]);
+    s.x0 = std::max(0, (int)std::ceil(lo.x - 0.5f));
+    s.y0 = std::max(0, (int)std::ceil(lo.y - 0.5f));
+    s.x1 = std::min(target.width - 1, (int)std::floor(hi.x - 0.5f));
+    s.y1 = std::min(target.height - 1, (int)std::floor(hi.y - 0.5f));
+    return s.x0 <= s.x1 && s.y0 <= s.y1;
+}
+
+// the covered pixels [xa, xb] of the row at pixel centre height py, narrowed from the
+// bounding box one edge at a time.  Both pipelines share this so they cover the same pixels.
+inline bool rowSpan(const float (&e)[3][3], const bool (&tl)[3], float py, int& xa, int& xb)
+{
+    for (int k = 0; k < 3; k++) {
+        float a = e[k][0], c = e[k][1] * py + e[k][2];
+        auto inside = [&](int x) {
+            float w = a * (x + 0.5f) + c;
+            return w > 0.0f || (w == 0.0f && tl[k]);
+        };
+
+        if (a == 0.0f) {
+            if (!inside(xa))
+                return false;
+            continue;
+        }
+
+        // the edge crosses zero near xr, step to the exact pixel from there
+        float xr = std::min(std::max(-c / a - 0.5f, xa - 1.0f), xb + 1.0f);
+        if (a > 0.0f) {
+            int x = std::max(xa, (int)std::floor(xr));
+            while (x <= xb && !inside(x))
+                x++;
+            while (x > xa && inside(x - 1))
+                x--;
+            xa = x;
+        }
+        else {
+            int x = std::min(xb, (int)std::ceil(xr));
+            while (x >= xa && !inside(x))
+                x--;
+            while (x < xb && inside(x + 1))
+                x++;
+            xb = x;
+        }
+        if (xa > xb)
+            return false;
+    }
+    return true;
+}
+
+// the inner loop, one instance per layout and shader
+template <typename Layout, typename Shader>
+size_t shadeRows(const triangleSetup<Layout>& s, pixelBuffer target, int y0, int y1, const Shader& sharedShader)
+{
+    constexpr int N = Layout::count;
+    size_t pixels = 0;
+    // a copy of its own, so the pixel writes (unsigned char, which may alias anything)
+    // don't make the compiler load the shader's fields again for every fragment
+    const Shader shader = sharedShader;
+
+    for (int y = std::max(y0, s.y0); y <= std::min(y1, s.y1); y++) {
+        float py = y + 0.5f;
+        int xa = s.x0, xb = s.x1;
+        if (!rowSpan(s.e, s.tl, py, xa, xb))
+            continue;
+
+        unsigned char* out = target.at(xa, y);
+        pixels += xb - xa + 1;
+
+        if constexpr (Layout::mode == interpolation::flat) {
+            for (int x = xa; x <= xb; x++, out += 3) {
+                rgb8 c = shader(s.flatValue);
+                out[0] = c.r; out[1] = c.g; out[2] = c.b;
+            }
+        }
+        else {
+            float px = xa + 0.5f;
+            float f[N + 1];
+            for (int a = 0; a <= N; a++)
+                f[a] = s.base[a] + s.dx[a] * px + s.dy[a] * py;
+
+            for (int x = xa; x <= xb; x++, out += 3) {
+                attributes<N> in;
+                if constexpr (Layout::mode == interpolation::perspective) {
+                    float wcorr = 1.0f / f[N];
+                    for (int a = 0; a < N; a++)
+                        in[a] = f[a] * wcorr;
+                }
+                else {
+                    for (int a = 0; a < N; a++)
+                        in[a] = f[a];
+                }
+
+                rgb8 c = shader(in);
+                out[0] = c.r; out[1] = c.g; out[2] = c.b;
+
+                for (int a = 0; a <= N; a++)
+                    f[a] += s.dx[a];
+            }
+        }
+    }
+    return pixels;
+}
+
+} // namespace fragpipe
+
+// Draw indexed triangles, running 'shader' for every covered pixel.  Works in horizontal
+// bands on the pool like the other CPU raster paths.
+template <typename Layout, typename Shader>
+shadingStats drawShadedTriangles(pixelBuffer target, const shadedVertex<Layout>* vertices, const unsigned int* indices,
+                                 int indexCount, const Shader& shader, threadPool& pool = threadPool::shared())
+{
+    auto start = std::chrono::steady_clock::now();
+
+    shadingStats stats;
+    stats.triangles = indexCount / 3;
+
+    std::vector<fragpipe::triangleSetup<Layout>> tris;
+    tris.reserve(stats.triangles);
+    for (int t = 0; t + 2 < indexCount; t += 3) {
+        const shadedVertex<Layout>* v[3] = { &vertices[indices[t]], &vertices[indices[t + 1]], &vertices[indices[t + 2]] };
+        fragpipe::triangleSetup<Layout> s;
+        if (fragpipe::setupTriangle(v, target, s))
+            tris.push_back(s);
+    }
+
+    const int bandHeight = 32;
+    int bandCount = (target.height + bandHeight - 1) / bandHeight;
+    std::vector<std::vector<int>> bands(bandCount);
+    for (int i = 0; i < (int)tris.size(); i++)
+        for (int b = tris[i].y0 / bandHeight; b <= tris[i].y1 / bandHeight; b++)
+            bands[b].push_back(i);
+
+    std::vector<size_t> pixels(bandCount, 0);
+    pool.parallelFor(bandCount, [&](int b) {
+        int y0 = b * bandHeight, y1 = std::min(y0 + bandHeight, target.height) - 1;
+        for (int i : bands[b])
+            pixels[b] += fragpipe::shadeRows(tris[i], target, y0, y1, shader);
+    });
+
+    for (size_t p : pixels)
+        stats.pixels += p;
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
@@ -0,0 +1,168 @@
+//
+// the fragment shading pipeline demo and benchmark (see fragpipe.h)
+//
+
+#include "demos.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "fragpipe.h"
+
+// a small RGB checker texture for the textured shader experiments
+static std::vector<unsigned char> checkerTexels(int size, int check)
+{
+    std::vector<unsigned char> texels((size_t)size * size * 3);
+    for (int y = 0; y < size; y++)
+        for (int x = 0; x < size; x++) {
+            unsigned char* p = &texels[((size_t)y * size + x) * 3];
+            bool light = ((x / check) + (y / check)) % 2 == 0;
+            p[0] = light ? 240 : 40;
+            p[1] = light ? 200 : 60;
+            p[2] = light ? 120 : 160;
+        }
+    return texels;
+}
+
+// flat, Gouraud and textured triangles through the template pipeline
+int myShadedTriangles(threadPool& pool)
+{
+    memset(imageBuff, 0, sizeof(imageBuff));
+
+    // a textured floor in perspective across the bottom
+    std::vector<unsigned char> texels = checkerTexels(64, 8);
+    texturedShader textured{ pixelBuffer{ texels.data(), 64, 64 } };
+
+    glm::mat4 mvp = glm::perspective(1.0472f, 1.0f, 0.1f, 100.0f) * glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -1.0f, 0.0f));
+    shadedVertex<texturedShader::layout> floor[4] = {
+        { mvp * glm::vec4(-4.0f, 0.0f, -1.0f, 1.0f), { 0.0f, 0.0f } },
+        { mvp * glm::vec4( 4.0f, 0.0f, -1.0f, 1.0f), { 8.0f, 0.0f } },
+        { mvp * glm::vec4( 4.0f, 0.0f, -30.0f, 1.0f), { 8.0f, 30.0f } },
+        { mvp * glm::vec4(-4.0f, 0.0f, -30.0f, 1.0f), { 0.0f, 30.0f } }
+    };
+    unsigned int quad[6] = { 0, 1, 2, 0, 2, 3 };
+    drawShadedTriangles(imageBuffer(), floor, quad, 6, textured, pool);
+
+    // a fan of flat shaded and a fan of Gouraud shaded triangles above it
+    std::vector<shadedVertex<flatShader::layout>> flatFan;
+    std::vector<shadedVertex<gouraudShader::layout>> smoothFan;
+    std::vector<unsigned int> fan;
+
+    const int slices = 12;
+    for (int i = 0; i <= slices; i++) {
+        float a = i * 6.2831853f / slices;
+        glm::vec3 c(0.5f + 0.5f * std::cos(a), 0.5f + 0.5f * std::cos(a + 2.094f), 0.5f + 0.5f * std::cos(a + 4.189f));
+        flatFan.push_back({ glm::vec4(-0.5f + 0.35f * std::cos(a), 0.5f + 0.35f * std::sin(a), 0.0f, 1.0f), { c.r, c.g, c.b } });
+        smoothFan.push_back({ glm::vec4(0.5f + 0.35f * std::cos(a), 0.5f + 0.35f * std::sin(a), 0.0f, 1.0f), { c.r, c.g, c.b } });
+    }
+    flatFan.push_back({ glm::vec4(-0.5f, 0.5f, 0.0f, 1.0f), { 1.0f, 1.0f, 1.0f } });
+    smoothFan.push_back({ glm::vec4(0.5f, 0.5f, 0.0f, 1.0f), { 1.0f, 1.0f, 1.0f } });
+    for (int i = 0; i < slices; i++) {
+        fan.push_back(slices + 1);
+        fan.push_back(i);
+        fan.push_back(i + 1);
+    }
+
+    drawShadedTriangles(imageBuffer(), flatFan.data(), fan.data(), (int)fan.size(), flatShader(), pool);
+    drawShadedTriangles(imageBuffer(), smoothFan.data(), fan.data(), (int)fan.size(), gouraudShader(), pool);
+
+    return 0;
+}
+
+// the same three shaders written the old fashioned way, for the benchmark below
+struct dynamicColorShader : fragmentShader {
+    rgb8 shade(const float* attr, int count) const override
+    {
+        float c[3] = { 0.0f, 0.0f, 0.0f };
+        for (int i = 0; i < count && i < 3; i++)
+            c[i] = attr[i];
+        return rgb8{ toByte(c[0]), toByte(c[1]), toByte(c[2]) };
+    }
+};
+
+struct dynamicTextureShader : fragmentShader {
+    texturedShader lookup;
+    explicit dynamicTextureShader(pixelBuffer texture) : lookup{ texture } {}
+
+    rgb8 shade(const float* attr, int count) const override
+    {
+        attributes<2> uv{ { count > 0 ? attr[0] : 0.0f, count > 1 ? attr[1] : 0.0f } };
+        return lookup(uv);
+    }
+};
+
+// template specialized shading against the virtual call baseline, single threaded so
+// the numbers are per pixel cost
+int myShadingBenchmark()
+{
+    threadPool oneThread(1);
+
+    // a few layers of overlapping triangles, about 8 screens worth of pixels
+    std::mt19937 gen(99);
+    auto rnd = [&]() { return nextRandom(gen, 2000) / 1000.0f - 1.0f; };
+
+    const int triCount = 4000;
+    std::vector<glm::vec4> positions;
+    std::vector<float> colors, uvs;
+    std::vector<unsigned int> indices;
+    for (int i = 0; i < triCount * 3; i++) {
+        glm::vec2 centre(rnd(), rnd());
+        if (i % 3 != 0)
+            centre = glm::vec2(positions[i - i % 3]) + glm::vec2(rnd(), rnd()) * 0.35f;
+        float w = 1.0f + 0.5f * (rnd() + 1.0f);
+        positions.push_back(glm::vec4(centre * w, 0.0f, w));
+        colors.insert(colors.end(), { (rnd() + 1.0f) * 0.5f, (rnd() + 1.0f) * 0.5f, (rnd() + 1.0f) * 0.5f });
+        uvs.insert(uvs.end(), { rnd() * 4.0f, rnd() * 4.0f });
+        indices.push_back(i);
+    }
+
+    std::vector<shadedVertex<flatShader::layout>> flatVerts;
+    std::vector<shadedVertex<gouraudShader::layout>> smoothVerts;
+    std::vector<shadedVertex<texturedShader::layout>> texVerts;
+    for (size_t i = 0; i < positions.size(); i++) {
+        flatVerts.push_back({ positions[i], { colors[i * 3], colors[i * 3 + 1], colors[i * 3 + 2] } });
+        smoothVerts.push_back({ positions[i], { colors[i * 3], colors[i * 3 + 1], colors[i * 3 + 2] } });
+        texVerts.push_back({ positions[i], { uvs[i * 2], uvs[i * 2 + 1] } });
+    }
+
+    std::vector<unsigned char> texels = checkerTexels(256, 16);
+    pixelBuffer texture{ texels.data(), 256, 256 };
+    int n = (int)indices.size();
+
+    // best of a few runs
+    auto best = [](auto run) {
+        shadingStats result = run();
+        for (int i = 0; i < 4; i++) {
+            shadingStats s = run();
+            if (s.seconds < result.seconds)
+                result = s;
+        }
+        return result;
+    };
+
+    auto report = [](const char* name, shadingStats specialized, shadingStats dynamic) {
+        std::cout << name << ": template " << specialized.megapixelsPerSecond() << " Mpix/s, virtual "
+            << dynamic.megapixelsPerSecond() << " Mpix/s, " << dynamic.seconds / specialized.seconds << "x\n";
+    };
+
+    dynamicColorShader dynColor;
+    dynamicTextureShader dynTexture(texture);
+
+    report("flat",
+        best([&] { return drawShadedTriangles(imageBuffer(), flatVerts.data(), indices.data(), n, flatShader(), oneThread); }),
+        best([&] { return drawShadedTrianglesDynamic(imageBuffer(), positions.data(), colors.data(), 3, interpolation::flat, indices.data(), n, dynColor, oneThread); }));
+
+    report("gouraud",
+        best([&] { return drawShadedTriangles(imageBuffer(), smoothVerts.data(), indices.data(), n, gouraudShader(), oneThread); }),
+        best([&] { return drawShadedTrianglesDynamic(imageBuffer(), positions.data(), colors.data(), 3, interpolation::perspective, indices.data(), n, dynColor, oneThread); }));
+
+    report("textured",
+        best([&] { return drawShadedTriangles(imageBuffer(), texVerts.data(), indices.data(), n, texturedShader{ texture }, oneThread); }),
+        best([&] { return drawShadedTrianglesDynamic(imageBuffer(), positions.data(), uvs.data(), 2, interpolation::perspective, indices.data(), n, dynTexture, oneThread); }));
+
+    return 0;
+}
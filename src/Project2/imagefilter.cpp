@@ -0,0 +1,391 @@
+//
+// separable blurs, Sobel, color grading and downsampling over RGB pictures (see imagefilter.h)
+//
+
+#include "imagefilter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#include "cpufeatures.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define G4G_FILTER_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+unsigned char clampByte(float v)
+{
+    return (unsigned char)std::min(std::max(v + 0.5f, 0.0f), 255.0f);
+}
+
+#ifdef G4G_AVX2
+// the 32 byte blocks of weightedSum() below, returns how far it got
+G4G_AVX2_TARGET int weightedSumAVX2(const unsigned char* const* taps, const unsigned short* weights, int count, unsigned char* out, int n)
+{
+    const __m256i zero = _mm256_setzero_si256(), half = _mm256_set1_epi16(128);
+    int i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i lo = half, hi = half;
+        for (int k = 0; k < count; k++) {
+            __m256i v = _mm256_loadu_si256((const __m256i*)(taps[k] + i));
+            __m256i w = _mm256_set1_epi16((short)weights[k]);
+            lo = _mm256_add_epi16(lo, _mm256_mullo_epi16(_mm256_unpacklo_epi8(v, zero), w));
+            hi = _mm256_add_epi16(hi, _mm256_mullo_epi16(_mm256_unpackhi_epi8(v, zero), w));
+        }
+        // unpack and pack both work within 128 bit lanes, so the bytes come back in order
+        _mm256_storeu_si256((__m256i*)(out + i), _mm256_packus_epi16(_mm256_srli_epi16(lo, 8), _mm256_srli_epi16(hi, 8)));
+    }
+    return i;
+}
+#endif
+
+// out[i] = (sum of weights[k] * taps[k][i] + 128) >> 8 for n bytes, with the weights summing
+// to 256.  That never goes past 65535, so the sums fit in 16 bit lanes.  Both blur passes
+// come down to this: the horizontal one has taps a pixel (3 bytes) apart in one row, the
+// vertical one has a tap per row.
+void weightedSum(const unsigned char* const* taps, const unsigned short* weights, int count, unsigned char* out, int n)
+{
+    int i = 0;
+#ifdef G4G_AVX2
+    if (hasAVX2())
+        i = weightedSumAVX2(taps, weights, count, out, n);
+#endif
+#ifdef G4G_FILTER_SSE2
+    const __m128i zero = _mm_setzero_si128(), half = _mm_set1_epi16(128);
+    for (; i + 16 <= n; i += 16) {
+        __m128i lo = half, hi = half;
+        for (int k = 0; k < count; k++) {
+            __m128i v = _mm_loadu_si128((const __m128i*)(taps[k] + i));
+            __m128i w = _mm_set1_epi16((short)weights[k]);
+            lo = _mm_add_epi16(lo, _mm_mullo_epi16(_mm_unpacklo_epi8(v, zero), w));
+            hi = _mm_add_epi16(hi, _mm_mullo_epi16(_mm_unpackhi_epi8(v, zero), w));
+        }
+        _mm_storeu_si128((__m128i*)(out + i), _mm_packus_epi16(_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8)));
+    }
+#endif
+    for (; i < n; i++) {
+        unsigned int sum = 128;
+        for (int k = 0; k < count; k++)
+            sum += weights[k] * taps[k][i];
+        out[i] = (unsigned char)(sum >> 8);
+    }
+}
+
+// out[i] = rounded up average of a[i] and b[i]
+void average(const unsigned char* a, const unsigned char* b, unsigned char* out, int n)
+{
+    int i = 0;
+#ifdef G4G_FILTER_SSE2
+    for (; i + 16 <= n; i += 16)
+        _mm_storeu_si128((__m128i*)(out + i), _mm_avg_epu8(_mm_loadu_si128((const __m128i*)(a + i)), _mm_loadu_si128((const __m128i*)(b + i))));
+#endif
+    for (; i < n; i++)
+        out[i] = (unsigned char)((a[i] + b[i] + 1) >> 1);
+}
+
+// Sobel magnitude (|gx| + |gy|) / 4, capped at 255, for n pixels.  The three brightness
+// rows are padded with a pixel on each side, so pixel x reads [x, x + 2].
+void sobelRow(const unsigned char* above, const unsigned char* row, const unsigned char* below, unsigned char* out, int n)
+{
+    int x = 0;
+#ifdef G4G_FILTER_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    auto load = [&](const unsigned char* p) { return _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)p), zero); };
+    for (; x + 8 <= n; x += 8) {
+        __m128i a0 = load(above + x), a1 = load(above + x + 1), a2 = load(above + x + 2);
+        __m128i b0 = load(row + x), b2 = load(row + x + 2);
+        __m128i c0 = load(below + x), c1 = load(below + x + 1), c2 = load(below + x + 2);
+
+        __m128i gx = _mm_add_epi16(_mm_sub_epi16(a2, a0), _mm_sub_epi16(c2, c0));
+        gx = _mm_add_epi16(gx, _mm_slli_epi16(_mm_sub_epi16(b2, b0), 1));
+        __m128i gy = _mm_add_epi16(_mm_sub_epi16(c0, a0), _mm_sub_epi16(c2, a2));
+        gy = _mm_add_epi16(gy, _mm_slli_epi16(_mm_sub_epi16(c1, a1), 1));
+
+        __m128i mag = _mm_add_epi16(_mm_max_epi16(gx, _mm_sub_epi16(zero, gx)), _mm_max_epi16(gy, _mm_sub_epi16(zero, gy)));
+        _mm_storel_epi64((__m128i*)(out + x), _mm_packus_epi16(_mm_srli_epi16(mag, 2), zero));
+    }
+#endif
+    for (; x < n; x++) {
+        int gx = (above[x + 2] - above[x]) + 2 * (row[x + 2] - row[x]) + (below[x + 2] - below[x]);
+        int gy = (below[x] + 2 * below[x + 1] + below[x + 2]) - (above[x] + 2 * above[x + 1] + above[x + 2]);
+        out[x] = (unsigned char)std::min((std::abs(gx) + std::abs(gy)) >> 2, 255);
+    }
+}
+
+void applyLut(const colorLut& lut, unsigned char* p, int pixels)
+{
+    for (int x = 0; x < pixels; x++, p += 3) {
+        p[0] = lut.r[p[0]];
+        p[1] = lut.g[p[1]];
+        p[2] = lut.b[p[2]];
+    }
+}
+
+// rows per strip, so that a strip with 'halo' extra rows above and below stays within
+// 256KB (a typical L2) and there are still enough strips to go round the threads
+int stripRows(int width, int halo)
+{
+    return std::min(std::max(256 * 1024 / (width * 3) - 2 * halo, 8), 64);
+}
+
+// ---- one strip [y0, y1] of the output per call.  'lut' is the folded grading, or null
+
+void blurStrip(pixelBuffer in, pixelBuffer out, const std::vector<unsigned short>& weights, const colorLut* lut, int y0, int y1)
+{
+    int r = (int)weights.size() / 2, stride = in.width * 3;
+    int rows = y1 - y0 + 1 + 2 * r;
+
+    std::vector<unsigned char> padded((size_t)(in.width + 2 * r) * 3), horizontal((size_t)rows * stride);
+    std::vector<const unsigned char*> taps(weights.size());
+
+    // horizontal pass over the rows the strip needs, the edges repeat the outermost pixel
+    for (int j = 0; j < rows; j++) {
+        const unsigned char* src = in.row(std::min(std::max(y0 - r + j, 0), in.height - 1));
+        memcpy(&padded[(size_t)r * 3], src, stride);
+        for (int k = 0; k < r; k++) {
+            memcpy(&padded[(size_t)k * 3], src, 3);
+            memcpy(&padded[(size_t)(in.width + r + k) * 3], src + stride - 3, 3);
+        }
+        for (int k = 0; k < (int)taps.size(); k++)
+            taps[k] = &padded[(size_t)k * 3];
+        weightedSum(taps.data(), weights.data(), (int)taps.size(), &horizontal[(size_t)j * stride], stride);
+    }
+
+    // vertical pass straight out of the strip
+    for (int y = y0; y <= y1; y++) {
+        for (int k = 0; k < (int)taps.size(); k++)
+            taps[k] = &horizontal[(size_t)(y - y0 + k) * stride];
+        weightedSum(taps.data(), weights.data(), (int)taps.size(), out.row(y), stride);
+        if (lut)
+            applyLut(*lut, out.row(y), out.width);
+    }
+}
+
+void sobelStrip(pixelBuffer in, pixelBuffer out, const colorLut* lut, int y0, int y1)
+{
+    int w = in.width, rows = y1 - y0 + 3;
+    std::vector<unsigned char> luma((size_t)rows * (w + 2)), magnitude(w);
+
+    for (int j = 0; j < rows; j++) {
+        const unsigned char* src = in.row(std::min(std::max(y0 - 1 + j, 0), in.height - 1));
+        unsigned char* l = &luma[(size_t)j * (w + 2)];
+        for (int x = 0; x < w; x++, src += 3)
+            l[x + 1] = (unsigned char)((77 * src[0] + 150 * src[1] + 29 * src[2] + 128) >> 8);
+        l[0] = l[1];
+        l[w + 1] = l[w];
+    }
+
+    for (int y = y0; y <= y1; y++) {
+        const unsigned char* l = &luma[(size_t)(y - y0) * (w + 2)];
+        sobelRow(l, l + (w + 2), l + 2 * (w + 2), magnitude.data(), w);
+
+        unsigned char* dst = out.row(y);
+        for (int x = 0; x < w; x++, dst += 3) {
+            unsigned char m = magnitude[x];
+            dst[0] = lut ? lut->r[m] : m;
+            dst[1] = lut ? lut->g[m] : m;
+            dst[2] = lut ? lut->b[m] : m;
+        }
+    }
+}
+
+void downsampleStrip(pixelBuffer in, pixelBuffer out, const colorLut* lut, int y0, int y1)
+{
+    std::vector<unsigned char> vertical((size_t)in.width * 3);
+
+    for (int y = y0; y <= y1; y++) {
+        average(in.row(2 * y), in.row(std::min(2 * y + 1, in.height - 1)), vertical.data(), in.width * 3);
+
+        unsigned char* dst = out.row(y);
+        for (int x = 0; x < out.width; x++) {
+            const unsigned char* a = &vertical[(size_t)x * 6];
+            const unsigned char* b = &vertical[(size_t)std::min(2 * x + 1, in.width - 1) * 3];
+            for (int c = 0; c < 3; c++)
+                dst[x * 3 + c] = (unsigned char)((a[c] + b[c] + 1) >> 1);
+        }
+        if (lut)
+            applyLut(*lut, dst, out.width);
+    }
+}
+
+void gradeStrip(pixelBuffer in, pixelBuffer out, const colorLut& lut, int y0, int y1)
+{
+    for (int y = y0; y <= y1; y++) {
+        memcpy(out.row(y), in.row(y), (size_t)in.width * 3);
+        applyLut(lut, out.row(y), out.width);
+    }
+}
+
+} // namespace
+
+// ---- color tables
+
+colorLut colorLut::identity()
+{
+    colorLut lut;
+    for (int i = 0; i < 256; i++)
+        lut.r[i] = lut.g[i] = lut.b[i] = (unsigned char)i;
+    return lut;
+}
+
+colorLut colorLut::contrast(float amount)
+{
+    colorLut lut;
+    for (int i = 0; i < 256; i++)
+        lut.r[i] = lut.g[i] = lut.b[i] = clampByte((i - 127.5f) * amount + 127.5f);
+    return lut;
+}
+
+colorLut colorLut::gamma(float g)
+{
+    colorLut lut;
+    for (int i = 0; i < 256; i++)
+        lut.r[i] = lut.g[i] = lut.b[i] = clampByte(255.0f * std::pow(i / 255.0f, 1.0f / g));
+    return lut;
+}
+
+colorLut colorLut::tint(rgb8 shadows, rgb8 highlights)
+{
+    colorLut lut;
+    for (int i = 0; i < 256; i++) {
+        float t = i / 255.0f;
+        lut.r[i] = clampByte(shadows.r + (highlights.r - shadows.r) * t);
+        lut.g[i] = clampByte(shadows.g + (highlights.g - shadows.g) * t);
+        lut.b[i] = clampByte(shadows.b + (highlights.b - shadows.b) * t);
+    }
+    return lut;
+}
+
+colorLut colorLut::then(const colorLut& next) const
+{
+    colorLut lut;
+    for (int i = 0; i < 256; i++) {
+        lut.r[i] = next.r[r[i]];
+        lut.g[i] = next.g[g[i]];
+        lut.b[i] = next.b[b[i]];
+    }
+    return lut;
+}
+
+// ---- building the pipeline
+
+void filterPipeline::gaussianBlur(float sigma)
+{
+    if (sigma <= 0.0f)
+        return;
+
+    int r = std::max(1, (int)std::ceil(3.0f * sigma));
+    std::vector<float> g(2 * r + 1);
+    float total = 0.0f;
+    for (int k = -r; k <= r; k++)
+        total += g[k + r] = std::exp(-(k * k) / (2.0f * sigma * sigma));
+
+    // to 8 bit fixed point, whatever rounding lost goes to the centre tap
+    step s{ kind::blur, std::vector<unsigned short>(2 * r + 1), colorLut() };
+    int sum = 0;
+    for (int k = 0; k <= 2 * r; k++)
+        sum += s.weights[k] = (unsigned short)std::lround(256.0f * g[k] / total);
+    s.weights[r] = (unsigned short)(s.weights[r] + 256 - sum);
+
+    // taps that rounded to nothing only cost time
+    while (s.weights.size() > 1 && s.weights.front() == 0) {
+        s.weights.erase(s.weights.begin());
+        s.weights.pop_back();
+    }
+    steps.push_back(s);
+}
+
+void filterPipeline::boxBlur(int radius)
+{
+    radius = std::min(radius, 127); // each tap needs a weight of at least 1
+    if (radius <= 0)
+        return;
+
+    int n = 2 * radius + 1;
+    step s{ kind::blur, std::vector<unsigned short>(n, (unsigned short)(256 / n)), colorLut() };
+    s.weights[radius] = (unsigned short)(s.weights[radius] + 256 % n);
+    steps.push_back(s);
+}
+
+void filterPipeline::sobel()
+{
+    steps.push_back({ kind::sobel, {}, colorLut() });
+}
+
+void filterPipeline::grade(const colorLut& lut)
+{
+    steps.push_back({ kind::grade, {}, lut });
+}
+
+void filterPipeline::downsample()
+{
+    steps.push_back({ kind::downsample, {}, colorLut() });
+}
+
+// ---- running it
+
+filterStats filterPipeline::run(pixelBuffer source, rgbImage& result, threadPool& pool) const
+{
+    auto start = std::chrono::steady_clock::now();
+
+    filterStats stats;
+    rgbImage scratch[2];
+    pixelBuffer in = source;
+    int next = 0;
+
+    if (steps.empty()) {
+        result.resize(source.width, source.height);
+        memcpy(result.pixels.data(), source.pixels, result.pixels.size());
+    }
+
+    for (size_t i = 0; i < steps.size(); next ^= 1) {
+        // a filter (or nothing, when grading comes first) and the grading right after it
+        const step* filter = steps[i].type != kind::grade ? &steps[i++] : nullptr;
+        colorLut lut;
+        bool graded = false;
+        for (; i < steps.size() && steps[i].type == kind::grade; i++) {
+            lut = graded ? lut.then(steps[i].lut) : steps[i].lut;
+            graded = true;
+        }
+
+        kind type = filter ? filter->type : kind::grade;
+        int w = in.width, h = in.height, halo = 0;
+        if (type == kind::downsample) {
+            w = (w + 1) / 2;
+            h = (h + 1) / 2;
+        }
+        else if (type == kind::blur)
+            halo = (int)filter->weights.size() / 2;
+        else if (type == kind::sobel)
+            halo = 1;
+
+        rgbImage& target = i == steps.size() ? result : scratch[next];
+        target.resize(w, h);
+        pixelBuffer out = target.view();
+
+        int rowsPerStrip = stripRows(in.width, halo);
+        int strips = (h + rowsPerStrip - 1) / rowsPerStrip;
+        pool.parallelFor(strips, [&](int n) {
+            int y0 = n * rowsPerStrip, y1 = std::min(y0 + rowsPerStrip, h) - 1;
+            const colorLut* folded = graded ? &lut : nullptr;
+            switch (type) {
+            case kind::blur: blurStrip(in, out, filter->weights, folded, y0, y1); break;
+            case kind::sobel: sobelStrip(in, out, folded, y0, y1); break;
+            case kind::downsample: downsampleStrip(in, out, folded, y0, y1); break;
+            case kind::grade: gradeStrip(in, out, lut, y0, y1); break;
+            }
+        });
+
+        stats.sweeps++;
+        stats.pixels += (size_t)w * h;
+        in = out;
+    }
+
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <vector>
+
+#include "pixelbuffer.h"
+#include "threadpool.h"
+
+// an RGB picture that owns its pixels, for results that don't go straight into imageBuff
+struct rgbImage {
+    std::vector<unsigned char> pixels;
+    int width = 0;
+    int height = 0;
+
+    rgbImage() = default;
+    rgbImage(int w, int h) : pixels((size_t)w * h * 3), width(w), height(h) {}
+
+    void resize(int w, int h) { pixels.resize((size_t)w * h * 3); width = w; height = h; }
+    pixelBuffer view() { return pixelBuffer{ pixels.data(), width, height }; }
+};
+
+// a per channel color lookup table, the color grading step of a filterPipeline
+struct colorLut {
+    unsigned char r[256], g[256], b[256];
+
+    static colorLut identity();
+    static colorLut contrast(float amount);  // 1 leaves it alone, > 1 pushes away from mid grey
+    static colorLut gamma(float g);          // out = in^(1/g)
+    static colorLut tint(rgb8 shadows, rgb8 highlights); // maps black and white to these two
+
+    // the table that does this one and then 'next', so two grading steps cost one lookup
+    colorLut then(const colorLut& next) const;
+};
+
+struct filterStats {
+    int sweeps = 0;     // times the pipeline went over the whole picture
+    size_t pixels = 0;  // pixels written over all sweeps
+    double seconds = 0.0;
+
+    double megapixelsPerSecond() const { return seconds > 0.0 ? pixels / seconds / 1e6 : 0.0; }
+};
+
+// A chain of image filters run over an RGB picture on the CPU.
+//
+// Add the steps in the order they should happen, then run() it.  Every filter works on
+// horizontal strips sized so that a strip and its intermediate rows stay in L2, and the
+// strips go out to the thread pool.  The separable blurs do their horizontal and vertical
+// pass within a strip, so the half blurred picture never goes out to memory, and grading
+// steps that follow a filter are folded into one table applied to each output row while it
+// is still in cache.  The inner loops work on 16 (SSE2) or 32 (AVX2, when the CPU has it,
+// see cpufeatures.h) channels at a time; all arithmetic is integer so every path gives the
+// same bytes.
+class filterPipeline {
+public:
+    void gaussianBlur(float sigma);
+    void boxBlur(int radius);
+    void sobel();        // gradient magnitude of the brightness, as grey
+    void grade(const colorLut& lut);
+    void downsample();   // half the size, 2x2 box filter
+    void clear() { steps.clear(); }
+
+    filterStats run(pixelBuffer source, rgbImage& result, threadPool& pool = threadPool::shared()) const;
+
+private:
+    enum class kind { blur, sobel, grade, downsample };
+    struct step {
+        kind type;
+        std::vector<unsigned short> weights; // blur taps, 8 bit fixed point summing to 256
+        colorLut lut;
+    };
+
+    std::vector<step> steps;
+};
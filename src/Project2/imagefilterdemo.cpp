@@ -0,0 +1,135 @@
+//
+// the filter pipeline demo and benchmark (see imagefilter.h)
+//
+
+#include "demos.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "cpufeatures.h"
+#include "imagefilter.h"
+
+// the antialiased scene four times over at half size: as is, blurred, Sobel edges and graded
+int myFiltered(threadPool& pool)
+{
+    myAntialiased(pool);
+
+    filterPipeline pipelines[4];
+    pipelines[1].gaussianBlur(3.0f);
+    pipelines[1].grade(colorLut::contrast(1.3f));
+    pipelines[2].sobel();
+    pipelines[2].grade(colorLut::tint(rgb8{ 10, 10, 60 }, rgb8{ 255, 230, 120 }));
+    pipelines[3].boxBlur(2);
+    pipelines[3].grade(colorLut::gamma(1.8f));
+    pipelines[3].grade(colorLut::tint(rgb8{ 40, 20, 0 }, rgb8{ 255, 235, 200 }));
+
+    rgbImage results[4];
+    for (int i = 0; i < 4; i++) {
+        pipelines[i].downsample();
+        filterStats stats = pipelines[i].run(imageBuffer(), results[i], pool);
+        std::cout << "filter pipeline " << i << ": " << stats.sweeps << " sweeps in " << stats.seconds * 1000.0 << " ms\n";
+    }
+
+    // top left, top right, bottom left, bottom right (row 0 is the bottom)
+    for (int i = 0; i < 4; i++) {
+        unsigned x0 = (i % 2) * dimy / 2, y0 = (i < 2) ? dimx / 2 : 0;
+        for (int y = 0; y < results[i].height; y++)
+            memcpy(imageBuff[y0 + y][x0], results[i].view().row(y), (size_t)results[i].width * 3);
+    }
+
+    return 0;
+}
+
+// blur and two grading steps as a fused pipeline against one full frame pass per step in
+// plain float code, on a 2048x2048 picture so it doesn't all fit in cache
+int myFilterBenchmark()
+{
+    myAntialiased();
+
+    const int size = 2048;
+    rgbImage source(size, size), reference(size, size), result;
+    for (int y = 0; y < size; y++)
+        for (int x = 0; x < size; x += dimy)
+            memcpy(source.view().at(x, y), imageBuff[y % dimx], dimy * 3);
+
+    const float sigma = 2.0f;
+    colorLut contrast = colorLut::contrast(1.2f), gamma = colorLut::gamma(1.4f);
+
+    auto best = [](auto run) {
+        double t = 1e30;
+        for (int i = 0; i < 3; i++) {
+            auto start = std::chrono::steady_clock::now();
+            run();
+            t = std::min(t, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+        return t;
+    };
+
+    std::vector<float> horizontal((size_t)size * size * 3);
+    double naive = best([&] {
+        int r = (int)std::ceil(3.0f * sigma);
+        std::vector<float> weights;
+        float total = 0.0f;
+        for (int k = -r; k <= r; k++) {
+            weights.push_back(std::exp(-(k * k) / (2.0f * sigma * sigma)));
+            total += weights.back();
+        }
+        for (float& w : weights)
+            w /= total;
+
+        pixelBuffer in = source.view(), out = reference.view();
+        for (int y = 0; y < size; y++)
+            for (int x = 0; x < size; x++)
+                for (int c = 0; c < 3; c++) {
+                    float sum = 0.0f;
+                    for (int k = -r; k <= r; k++)
+                        sum += weights[k + r] * in.at(std::min(std::max(x + k, 0), size - 1), y)[c];
+                    horizontal[((size_t)y * size + x) * 3 + c] = sum;
+                }
+        for (int y = 0; y < size; y++)
+            for (int x = 0; x < size; x++)
+                for (int c = 0; c < 3; c++) {
+                    float sum = 0.0f;
+                    for (int k = -r; k <= r; k++)
+                        sum += weights[k + r] * horizontal[((size_t)std::min(std::max(y + k, 0), size - 1) * size + x) * 3 + c];
+                    out.at(x, y)[c] = (unsigned char)std::min(sum + 0.5f, 255.0f);
+                }
+        for (const colorLut* lut : { &contrast, &gamma })
+            for (int y = 0; y < size; y++)
+                for (int x = 0; x < size; x++) {
+                    unsigned char* p = out.at(x, y);
+                    p[0] = lut->r[p[0]];
+                    p[1] = lut->g[p[1]];
+                    p[2] = lut->b[p[2]];
+                }
+    });
+
+    filterPipeline pipeline;
+    pipeline.gaussianBlur(sigma);
+    pipeline.grade(contrast);
+    pipeline.grade(gamma);
+
+    threadPool oneThread(1);
+    filterStats stats;
+    double fused = best([&] { stats = pipeline.run(source.view(), result, oneThread); });
+    double threaded = best([&] { pipeline.run(source.view(), result); });
+
+    int worst = 0;
+    for (size_t i = 0; i < result.pixels.size(); i++)
+        worst = std::max(worst, std::abs(result.pixels[i] - reference.pixels[i]));
+
+    std::cout << "blur + 2 grades, " << size << "x" << size << ":\n";
+    std::cout << "  one pass per step, float: " << naive * 1000.0 << " ms\n";
+    std::cout << "  fused pipeline (" << stats.sweeps << " sweep" << (hasAVX2() ? ", AVX2" : "") << "), 1 thread: " << fused * 1000.0 << " ms (" << naive / fused << "x)\n";
+    std::cout << "  fused pipeline, " << threadPool::shared().size() << " threads: " << threaded * 1000.0 << " ms (" << naive / threaded << "x)\n";
+    // the blur alone stays within 2, the contrast and gamma tables stretch that a little
+    std::cout << "  largest difference to the float version: " << worst << "\n";
+
+    return 0;
+}
@@ -0,0 +1,123 @@
+//
+// KTX (version 1) compressed texture files (see ktxfile.h)
+//
+
+#include "ktxfile.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+
+namespace {
+
+const unsigned char ktxIdentifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+const std::uint32_t ktxEndianness = 0x04030201;
+
+const unsigned glRGB = 0x1907, glRGBA = 0x1908;
+
+// everything after the identifier, in file order
+struct ktxHeader {
+    std::uint32_t endianness;
+    std::uint32_t glType, glTypeSize, glFormat;
+    std::uint32_t glInternalFormat, glBaseInternalFormat;
+    std::uint32_t pixelWidth, pixelHeight, pixelDepth;
+    std::uint32_t numberOfArrayElements, numberOfFaces, numberOfMipmapLevels;
+    std::uint32_t bytesOfKeyValueData;
+};
+static_assert(sizeof(ktxHeader) == 52, "the KTX header is read and written as raw bytes");
+
+size_t align4(size_t n)
+{
+    return (n + 3) & ~(size_t)3;
+}
+
+} // namespace
+
+bool writeKTX(const std::string& path, const compressedTexture& texture)
+{
+    ktxHeader header = {};
+    header.endianness = ktxEndianness;
+    header.glTypeSize = 1; // compressed data has no type, 1 by convention
+    header.glInternalFormat = glInternalFormat(texture.format);
+    header.glBaseInternalFormat = texture.format == blockFormat::bc1 ? glRGB : glRGBA;
+    header.pixelWidth = (std::uint32_t)texture.width;
+    header.pixelHeight = (std::uint32_t)texture.height;
+    header.numberOfFaces = 1;
+    header.numberOfMipmapLevels = (std::uint32_t)texture.levels.size();
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write((const char*)ktxIdentifier, sizeof(ktxIdentifier));
+    out.write((const char*)&header, sizeof(header));
+
+    const char padding[4] = { 0, 0, 0, 0 };
+    for (const std::vector<unsigned char>& level : texture.levels) {
+        std::uint32_t size = (std::uint32_t)level.size();
+        out.write((const char*)&size, sizeof(size));
+        out.write((const char*)level.data(), level.size());
+        out.write(padding, align4(level.size()) - level.size());
+    }
+    return (bool)out;
+}
+
+bool ktxFile::open(const std::string& path)
+{
+    offsets.clear();
+    sizes.clear();
+    why.clear();
+
+    if (!file.open(path)) {
+        why = "can't open " + path;
+        return false;
+    }
+
+    ktxHeader header;
+    if (file.size() < sizeof(ktxIdentifier) + sizeof(header) || memcmp(file.data(), ktxIdentifier, sizeof(ktxIdentifier)) != 0) {
+        why = path + " isn't a KTX file";
+        return false;
+    }
+    memcpy(&header, file.data() + sizeof(ktxIdentifier), sizeof(header));
+
+    if (header.endianness != ktxEndianness)
+        why = path + " was written big endian";
+    else if (header.glType != 0 || header.glFormat != 0)
+        why = path + " isn't block compressed";
+    else if (header.pixelDepth > 1 || header.numberOfArrayElements > 0 || header.pixelHeight == 0)
+        why = path + " is an array or 3D texture";
+    else if (header.numberOfFaces != 1 && header.numberOfFaces != 6)
+        why = path + " has " + std::to_string(header.numberOfFaces) + " faces";
+    if (!why.empty())
+        return false;
+
+    format = header.glInternalFormat;
+    base = header.glBaseInternalFormat;
+    w = (int)header.pixelWidth;
+    h = (int)header.pixelHeight;
+    faceCount = (int)header.numberOfFaces;
+    int levelCount = header.numberOfMipmapLevels ? (int)header.numberOfMipmapLevels : 1; // 0 asks GL to make them
+
+    size_t at = sizeof(ktxIdentifier) + sizeof(header) + header.bytesOfKeyValueData;
+    for (int level = 0; level < levelCount; level++) {
+        std::uint32_t size;
+        if (at + sizeof(size) > file.size())
+            break;
+        memcpy(&size, file.data() + at, sizeof(size));
+        at += sizeof(size);
+
+        // cube map faces are padded to 4 bytes each, the level as a whole too
+        if (at + align4(size) * (faceCount - 1) + size > file.size())
+            break;
+        for (int face = 0; face < faceCount; face++) {
+            offsets.push_back(at);
+            at += align4(size);
+        }
+        sizes.push_back(size);
+    }
+
+    if ((int)sizes.size() != levelCount) {
+        why = path + " is cut short";
+        offsets.clear();
+        sizes.clear();
+        return false;
+    }
+    return true;
+}
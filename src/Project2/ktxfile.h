@@ -0,0 +1,47 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "blockcompress.h"
+#include "mappedfile.h"
+
+// write a compressed texture as a KTX (version 1) file: the 64 byte header with the GL
+// format names, no key/value data, then each mip level's size and blocks.  False if the
+// file couldn't be written
+bool writeKTX(const std::string& path, const compressedTexture& texture);
+
+// A KTX (version 1) file holding a compressed 2D texture or cube map, memory mapped so
+// the levels can go to glCompressedTexImage2D without being read or copied first.  Only
+// what the GL loader needs is checked: the file has to be compressed (glType 0), little
+// endian and not an array or 3D texture.
+class ktxFile {
+public:
+    ktxFile() = default;
+    explicit ktxFile(const std::string& path) { open(path); }
+
+    // false, with error() saying why, if it isn't a KTX file we can use
+    bool open(const std::string& path);
+    bool isOpen() const { return !offsets.empty(); }
+    const std::string& error() const { return why; }
+
+    unsigned internalFormat() const { return format; }
+    unsigned baseFormat() const { return base; }
+    int width() const { return w; }
+    int height() const { return h; }
+    int levels() const { return (int)offsets.size() / faceCount; }
+    int faces() const { return faceCount; } // 6 for a cube map
+
+    int levelWidth(int i) const { return w >> i > 0 ? w >> i : 1; }
+    int levelHeight(int i) const { return h >> i > 0 ? h >> i : 1; }
+    const unsigned char* image(int level, int face = 0) const { return file.data() + offsets[(size_t)level * faceCount + face]; }
+    size_t imageBytes(int level) const { return sizes[level]; }
+
+private:
+    mappedFile file;
+    std::string why;
+    unsigned format = 0, base = 0;
+    int w = 0, h = 0, faceCount = 1;
+    std::vector<size_t> offsets; // level by level, face by face
+    std::vector<size_t> sizes;   // one per level, the same for every face
+};
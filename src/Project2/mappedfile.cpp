@@ -0,0 +1,111 @@
+//
+// read only memory mapped files (see mappedfile.h)
+//
+
+#include "mappedfile.h"
+
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+mappedFile& mappedFile::operator=(mappedFile&& other) noexcept
+{
+    if (this != &other) {
+        close();
+        std::swap(bytes, other.bytes);
+        std::swap(length, other.length);
+#ifdef _WIN32
+        std::swap(file, other.file);
+        std::swap(mapping, other.mapping);
+#endif
+    }
+    return *this;
+}
+
+#ifdef _WIN32
+
+bool mappedFile::open(const std::string& path)
+{
+    close();
+
+    HANDLE f = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (f == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size;
+    HANDLE m = nullptr;
+    if (GetFileSizeEx(f, &size) && size.QuadPart > 0)
+        m = CreateFileMappingA(f, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    const void* view = m ? MapViewOfFile(m, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!view) {
+        if (m)
+            CloseHandle(m);
+        CloseHandle(f);
+        return false;
+    }
+
+    file = f;
+    mapping = m;
+    bytes = (const unsigned char*)view;
+    length = (size_t)size.QuadPart;
+    return true;
+}
+
+void mappedFile::close()
+{
+    if (bytes)
+        UnmapViewOfFile(bytes);
+    if (mapping)
+        CloseHandle(mapping);
+    if (file)
+        CloseHandle(file);
+    bytes = nullptr;
+    length = 0;
+    file = mapping = nullptr;
+}
+
+#else
+
+bool mappedFile::open(const std::string& path)
+{
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat info;
+    void* view = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && info.st_size > 0)
+        view = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // the mapping keeps the file alive
+    if (view == MAP_FAILED)
+        return false;
+
+    // these are advice values, not flags, so one call each
+    madvise(view, (size_t)info.st_size, MADV_SEQUENTIAL);
+    madvise(view, (size_t)info.st_size, MADV_WILLNEED);
+
+    bytes = (const unsigned char*)view;
+    length = (size_t)info.st_size;
+    return true;
+}
+
+void mappedFile::close()
+{
+    if (bytes)
+        munmap((void*)bytes, length);
+    bytes = nullptr;
+    length = 0;
+}
+
+#endif
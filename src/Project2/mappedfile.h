@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <utility>
+
+// A read only view of a whole file, mapped into memory (mmap, or a file mapping on
+// Windows) so it can be handed to a decoder without reading it through stdio first.
+// The kernel is told the file will be read front to back so it reads ahead.
+class mappedFile {
+public:
+    mappedFile() = default;
+    explicit mappedFile(const std::string& path) { open(path); }
+    ~mappedFile() { close(); }
+
+    mappedFile(const mappedFile&) = delete;
+    mappedFile& operator=(const mappedFile&) = delete;
+    mappedFile(mappedFile&& other) noexcept { *this = std::move(other); }
+    mappedFile& operator=(mappedFile&& other) noexcept;
+
+    bool open(const std::string& path); // false if it can't be opened or is empty
+    void close();
+
+    bool isOpen() const { return bytes != nullptr; }
+    const unsigned char* data() const { return bytes; }
+    size_t size() const { return length; }
+
+private:
+    const unsigned char* bytes = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    void* file = nullptr;
+    void* mapping = nullptr;
+#endif
+};
@@ -0,0 +1,347 @@
+//
+// mesh files, meshes ready to be mapped and drawn (see meshfile.h)
+//
+
+#include "meshfile.h"
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include "meshimport.h"
+#include "meshlets.h"
+#include "meshoptimize.h"
+#include "meshquantize.h"
+#include "meshsimplify.h"
+
+namespace {
+
+const char meshMagic[8] = { 'G', '4', 'G', 'M', 'E', 'S', 'H', 0 };
+// 2: the triangles and vertices are put in drawing order (see optimizeMesh) when written
+// 3: quantized vertices (see packVertices), and the position transform that undoes them
+// 4: LODs (see generateLods), the header grows to 192 bytes
+// 5: meshlets (see buildMeshlets)
+const std::uint32_t meshVersion = 5;
+
+enum : std::uint32_t { hasNormalsFlag = 1, hasUVsFlag = 2 };
+
+struct meshFileHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t headerBytes;
+    std::uint32_t flags;
+    std::uint32_t vertexCount, indexCount, vertexStride;
+    std::uint32_t attributeCount, subMeshCount;
+    float boundsMin[3], boundsMax[3];
+    std::uint64_t attributeOffset, subMeshOffset, nameOffset, vertexOffset, indexOffset;
+    std::uint64_t fileBytes;
+    float positionOffset[3], positionScale; // see packedVertices
+    std::uint32_t lodCount, lodIndexCount;  // the LOD indices follow the full mesh's
+    std::uint64_t lodOffset;
+    std::uint32_t meshletCount, reserved0;
+    std::uint64_t meshletOffset;
+    std::uint32_t reserved[8];
+};
+static_assert(sizeof(meshFileHeader) == 192, "the mesh file header is read and written as raw bytes");
+
+// a subMesh, its name somewhere in the block of names
+struct meshFileRange {
+    std::uint32_t firstIndex, indexCount;
+    std::uint32_t nameOffset, nameLength;
+};
+
+// a meshLod, its firstIndex counted from the first LOD index
+struct meshFileLod {
+    std::uint32_t firstIndex, indexCount;
+    float error;
+    std::uint32_t reserved;
+};
+
+// a meshlet, as it is in memory but with room to grow
+struct meshFileMeshlet {
+    std::uint32_t firstIndex, indexCount, vertexCount;
+    float center[3], radius;
+    float coneApex[3], coneAxis[3], coneCutoff;
+    std::uint32_t reserved[2];
+};
+static_assert(sizeof(meshFileMeshlet) == 64, "meshlets are read and written as raw bytes");
+
+std::uint64_t align64(std::uint64_t n)
+{
+    return (n + 63) & ~(std::uint64_t)63;
+}
+
+} // namespace
+
+bool writeMeshFile(const std::string& path, const cpuMesh& mesh, const quantizeSettings& settings, threadPool& pool)
+{
+    return writeMeshFile(path, mesh, packVertices(mesh, settings, pool));
+}
+
+bool writeMeshFile(const std::string& path, const cpuMesh& mesh, const packedVertices& vertices)
+{
+    const vertexLayout& layout = vertices.layout;
+
+    std::string names;
+    std::vector<meshFileRange> ranges;
+    for (const subMesh& part : mesh.subMeshes) {
+        ranges.push_back({ part.firstIndex, part.indexCount, (std::uint32_t)names.size(), (std::uint32_t)part.name.size() });
+        names += part.name;
+    }
+
+    meshFileHeader header = {};
+    memcpy(header.magic, meshMagic, sizeof(meshMagic));
+    header.version = meshVersion;
+    header.headerBytes = sizeof(header);
+    header.flags = (mesh.hasNormals ? (std::uint32_t)hasNormalsFlag : 0u) | (mesh.hasUVs ? (std::uint32_t)hasUVsFlag : 0u);
+    header.vertexCount = (std::uint32_t)vertices.count;
+    header.indexCount = (std::uint32_t)mesh.indices.size();
+    header.vertexStride = layout.stride;
+    header.attributeCount = (std::uint32_t)layout.attributes.size();
+    header.subMeshCount = (std::uint32_t)ranges.size();
+    memcpy(header.boundsMin, &mesh.boundsMin.x, sizeof(header.boundsMin));
+    memcpy(header.boundsMax, &mesh.boundsMax.x, sizeof(header.boundsMax));
+    header.attributeOffset = align64(sizeof(header));
+    header.lodCount = (std::uint32_t)mesh.lods.size();
+    header.lodIndexCount = (std::uint32_t)mesh.lodIndices.size();
+    header.subMeshOffset = align64(header.attributeOffset + layout.attributes.size() * sizeof(vertexAttribute));
+    header.lodOffset = align64(header.subMeshOffset + ranges.size() * sizeof(meshFileRange));
+    header.meshletCount = (std::uint32_t)mesh.meshlets.size();
+    header.meshletOffset = align64(header.lodOffset + mesh.lods.size() * sizeof(meshFileLod));
+    header.nameOffset = align64(header.meshletOffset + mesh.meshlets.size() * sizeof(meshFileMeshlet));
+    header.vertexOffset = align64(header.nameOffset + names.size());
+    header.indexOffset = align64(header.vertexOffset + vertices.data.size());
+    header.fileBytes = header.indexOffset + ((std::uint64_t)mesh.indices.size() + mesh.lodIndices.size()) * sizeof(unsigned int);
+    memcpy(header.positionOffset, &vertices.positionOffset.x, sizeof(header.positionOffset));
+    header.positionScale = vertices.positionScale;
+
+    // written under a temporary name and renamed over 'path' once it's all there, so a
+    // failed write (or a crash part way) leaves whatever was there before
+    std::string temporary = path + ".tmp";
+    std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+    auto write = [&](std::uint64_t at, const void* data, size_t bytes) {
+        static const char zeros[64] = {};
+        if (!out)
+            return;
+        out.write(zeros, (std::streamsize)(at - (std::uint64_t)out.tellp()));
+        out.write((const char*)data, (std::streamsize)bytes);
+    };
+    out.write((const char*)&header, sizeof(header));
+    write(header.attributeOffset, layout.attributes.data(), layout.attributes.size() * sizeof(vertexAttribute));
+    write(header.subMeshOffset, ranges.data(), ranges.size() * sizeof(meshFileRange));
+    std::vector<meshFileLod> lods;
+    for (const meshLod& lod : mesh.lods)
+        lods.push_back({ lod.firstIndex, lod.indexCount, lod.error, 0 });
+    write(header.lodOffset, lods.data(), lods.size() * sizeof(meshFileLod));
+    std::vector<meshFileMeshlet> meshlets;
+    for (const meshlet& m : mesh.meshlets) {
+        meshFileMeshlet record = {};
+        record.firstIndex = m.firstIndex;
+        record.indexCount = m.indexCount;
+        record.vertexCount = m.vertexCount;
+        memcpy(record.center, &m.center.x, sizeof(record.center));
+        record.radius = m.radius;
+        memcpy(record.coneApex, &m.coneApex.x, sizeof(record.coneApex));
+        memcpy(record.coneAxis, &m.coneAxis.x, sizeof(record.coneAxis));
+        record.coneCutoff = m.coneCutoff;
+        meshlets.push_back(record);
+    }
+    write(header.meshletOffset, meshlets.data(), meshlets.size() * sizeof(meshFileMeshlet));
+    write(header.nameOffset, names.data(), names.size());
+    write(header.vertexOffset, vertices.data.data(), vertices.data.size());
+    write(header.indexOffset, mesh.indices.data(), mesh.indices.size() * sizeof(unsigned int));
+    write(header.indexOffset + mesh.indices.size() * sizeof(unsigned int), mesh.lodIndices.data(),
+          mesh.lodIndices.size() * sizeof(unsigned int));
+    out.close();
+
+    std::error_code error;
+    if (out)
+        std::filesystem::rename(temporary, path, error);
+    if (!out || error) {
+        std::filesystem::remove(temporary, error);
+        return false;
+    }
+    return true;
+}
+
+void meshFile::close()
+{
+    vertices = nullptr;
+    indices = nullptr;
+    numVertices = numIndices = numLodIndices = 0;
+    parts.clear();
+    levels.clear();
+    clusters.clear();
+    format = vertexLayout();
+    file.close();
+}
+
+bool meshFile::open(const std::string& path)
+{
+    close();
+    why.clear();
+    if (!file.open(path)) {
+        why = "can't open " + path;
+        return false;
+    }
+    // not even a bad file stays mapped: on Windows it couldn't be written over while it is
+    if (!read(path)) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+// the checks and tables of a freshly mapped file, false with 'why' set if it can't be used
+bool meshFile::read(const std::string& path)
+{
+    meshFileHeader header;
+    if (file.size() < sizeof(header) || memcmp(file.data(), meshMagic, sizeof(meshMagic)) != 0) {
+        why = path + " isn't a mesh file";
+        return false;
+    }
+    memcpy(&header, file.data(), sizeof(header));
+
+    auto inside = [&](std::uint64_t offset, std::uint64_t bytes) { return offset <= file.size() && bytes <= file.size() - offset; };
+    if (header.version != meshVersion)
+        why = path + " is version " + std::to_string(header.version) + ", make it again";
+    else if (header.headerBytes != sizeof(header) || header.fileBytes != file.size())
+        why = path + " is cut short";
+    else if (!inside(header.attributeOffset, header.attributeCount * (std::uint64_t)sizeof(vertexAttribute))
+             || !inside(header.subMeshOffset, header.subMeshCount * (std::uint64_t)sizeof(meshFileRange))
+             || !inside(header.vertexOffset, header.vertexCount * (std::uint64_t)header.vertexStride)
+             || !inside(header.lodOffset, header.lodCount * (std::uint64_t)sizeof(meshFileLod))
+             || !inside(header.meshletOffset, header.meshletCount * (std::uint64_t)sizeof(meshFileMeshlet))
+             || !inside(header.indexOffset, ((std::uint64_t)header.indexCount + header.lodIndexCount) * sizeof(unsigned int))
+             || header.vertexOffset % 64 || header.indexOffset % 64)
+        why = path + " is damaged";
+    if (!why.empty())
+        return false;
+
+    format.stride = header.vertexStride;
+    format.attributes.resize(header.attributeCount);
+    memcpy(format.attributes.data(), file.data() + header.attributeOffset, header.attributeCount * sizeof(vertexAttribute));
+    for (const vertexAttribute& a : format.attributes)
+        if (attributeBytes(a) == 0 || a.offset + (std::uint64_t)attributeBytes(a) > header.vertexStride) {
+            why = path + " has a vertex attribute that doesn't fit";
+            return false;
+        }
+
+    for (std::uint32_t i = 0; i < header.subMeshCount; i++) {
+        meshFileRange range;
+        memcpy(&range, file.data() + header.subMeshOffset + i * sizeof(range), sizeof(range));
+        if ((std::uint64_t)range.firstIndex + range.indexCount > header.indexCount
+            || !inside(header.nameOffset + range.nameOffset, range.nameLength)) {
+            why = path + " has a bad subMesh";
+            return false;
+        }
+        parts.push_back({ std::string((const char*)file.data() + header.nameOffset + range.nameOffset, range.nameLength),
+                          range.firstIndex, range.indexCount });
+    }
+
+    for (std::uint32_t i = 0; i < header.lodCount; i++) {
+        meshFileLod lod;
+        memcpy(&lod, file.data() + header.lodOffset + i * sizeof(lod), sizeof(lod));
+        if ((std::uint64_t)lod.firstIndex + lod.indexCount > header.lodIndexCount) {
+            why = path + " has a bad LOD";
+            return false;
+        }
+        meshLod level;
+        level.firstIndex = lod.firstIndex;
+        level.indexCount = lod.indexCount;
+        level.error = lod.error;
+        levels.push_back(level);
+    }
+
+    for (std::uint32_t i = 0; i < header.meshletCount; i++) {
+        meshFileMeshlet in;
+        memcpy(&in, file.data() + header.meshletOffset + i * sizeof(in), sizeof(in));
+        if ((std::uint64_t)in.firstIndex + in.indexCount > header.indexCount) {
+            why = path + " has a bad meshlet";
+            return false;
+        }
+        meshlet m;
+        m.firstIndex = in.firstIndex;
+        m.indexCount = in.indexCount;
+        m.vertexCount = in.vertexCount;
+        memcpy(&m.center.x, in.center, sizeof(in.center));
+        m.radius = in.radius;
+        memcpy(&m.coneApex.x, in.coneApex, sizeof(in.coneApex));
+        memcpy(&m.coneAxis.x, in.coneAxis, sizeof(in.coneAxis));
+        m.coneCutoff = in.coneCutoff;
+        clusters.push_back(m);
+    }
+
+    numVertices = header.vertexCount;
+    numIndices = header.indexCount;
+    numLodIndices = header.lodIndexCount;
+    memcpy(&low.x, header.boundsMin, sizeof(header.boundsMin));
+    memcpy(&high.x, header.boundsMax, sizeof(header.boundsMax));
+    memcpy(&positionOffset.x, header.positionOffset, sizeof(header.positionOffset));
+    positionScale = header.positionScale;
+    normals = (header.flags & hasNormalsFlag) != 0;
+    uvs = (header.flags & hasUVsFlag) != 0;
+    indices = (const unsigned int*)(file.data() + header.indexOffset);
+    vertices = file.data() + header.vertexOffset;
+    return true;
+}
+
+cpuMesh meshFile::toMesh() const
+{
+    cpuMesh mesh;
+    if (!isOpen()) {
+        mesh.error = why;
+        return mesh;
+    }
+    if (!unpackVertices(format, vertices, numVertices, positionOffset, positionScale, mesh.vertices)) {
+        mesh.error = "the vertices are in a layout that can't be unpacked";
+        return mesh;
+    }
+
+    mesh.indices.assign(indices, indices + numIndices);
+    mesh.lodIndices.assign(indices + numIndices, indices + numIndices + numLodIndices);
+    for (const meshIndexBuffer* some : { &mesh.indices, &mesh.lodIndices })
+        for (unsigned int index : *some)
+            if (index >= numVertices) {
+                mesh.error = "index out of range";
+                mesh.vertices.clear();
+                mesh.indices.clear();
+                mesh.lodIndices.clear();
+                return mesh;
+            }
+    mesh.subMeshes = parts;
+    mesh.lods = levels;
+    mesh.meshlets = clusters;
+    mesh.boundsMin = low;
+    mesh.boundsMax = high;
+    mesh.hasNormals = normals;
+    mesh.hasUVs = uvs;
+    return mesh;
+}
+
+bool openMeshCached(const std::string& source, meshFile& mesh, std::string& error, const quantizeSettings& settings,
+                    threadPool& pool)
+{
+    namespace fs = std::filesystem;
+    std::string cached = fs::path(source).replace_extension(meshFileExtension).string();
+
+    std::error_code missing;
+    fs::file_time_type made = fs::last_write_time(cached, missing);
+    if (!missing && made >= fs::last_write_time(source, missing) && mesh.open(cached))
+        return true;
+    mesh.close(); // it may still have the old file mapped, which is about to be replaced
+
+    cpuMesh imported = importMesh(source, pool);
+    if (!imported.ok()) {
+        error = imported.error;
+        return false;
+    }
+    generateLods(imported, { 0.5f, 0.25f, 0.125f, 0.0625f }, 0.05f, pool);
+    buildMeshlets(imported, 64, 124, pool); // the drawing order too, see buildMeshlets
+    if (!writeMeshFile(cached, imported, settings, pool) || !mesh.open(cached)) {
+        error = "can't write " + cached;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "cpumesh.h"
+#include "mappedfile.h"
+#include "meshquantize.h"
+#include "vertexlayout.h"
+
+// what mesh files are called, next to the OBJ or PLY they were made from
+const char* const meshFileExtension = ".g4mesh";
+
+// write a mesh as a mesh file (see meshFile), its vertices quantized as the settings allow
+// (see packVertices).  False if the file couldn't be written, and then any file already
+// at 'path' is left as it was (the new one is written beside it and renamed over it)
+bool writeMeshFile(const std::string& path, const cpuMesh& mesh, const quantizeSettings& settings = quantizeSettings(),
+                   threadPool& pool = threadPool::shared());
+// the same with the vertices already packed, 'mesh' only gives the indices and subMeshes
+bool writeMeshFile(const std::string& path, const cpuMesh& mesh, const packedVertices& vertices);
+
+// A mesh that has been through the importer once, saved as it will be drawn so loading
+// it again is a memory mapping and nothing else.
+//
+// The file is a 192 byte header, then the vertex layout (the attributes as they are in
+// a vertexLayout), the subMesh ranges, the LOD ranges, the meshlets, the subMesh names,
+// the interleaved vertices and the 32 bit indices (the full mesh's then the LODs'), each
+// part starting on a 64 byte boundary.  The vertices are usually quantized (see
+// packedVertices), so positionTransform() has to go in the model matrix; MeshRenderer
+// does that.  The header has a version, which goes up whenever the format changes; files
+// of any other version don't open and have to be made again (meshconvert does that).
+//
+// The vertices and indices are used where they are in the mapping: MeshRenderer sends
+// them to glBufferData straight from it, so the only copy made is the driver's.  Opening
+// checks the header and that every part is inside the file, nothing more, however big
+// the mesh is.
+class meshFile {
+public:
+    meshFile() = default;
+    explicit meshFile(const std::string& path) { open(path); }
+
+    // false, with error() saying why, if it isn't a mesh file we can use; the file isn't
+    // kept mapped then
+    bool open(const std::string& path);
+    // lets go of the mapping (and everything pointing into it), so the file can be replaced
+    void close();
+    bool isOpen() const { return vertices != nullptr; }
+    const std::string& error() const { return why; }
+
+    const vertexLayout& layout() const { return format; }
+    size_t vertexCount() const { return numVertices; }
+    size_t indexCount() const { return numIndices; }
+    const unsigned char* vertexData() const { return vertices; }
+    size_t vertexBytes() const { return numVertices * format.stride; }
+    // the full mesh's indices, and straight after them the LODs'
+    const unsigned int* indexData() const { return indices; }
+    size_t lodIndexCount() const { return numLodIndices; }
+    const std::vector<subMesh>& subMeshes() const { return parts; }
+    // ranges of the LOD indices, which start at indexData() + indexCount()
+    const std::vector<meshLod>& lods() const { return levels; }
+    // ranges of the full mesh's indices, with their bounds (see buildMeshlets)
+    const std::vector<meshlet>& meshlets() const { return clusters; }
+
+    glm::vec3 boundsMin() const { return low; }
+    glm::vec3 boundsMax() const { return high; }
+    bool hasNormals() const { return normals; }
+    bool hasUVs() const { return uvs; }
+    // takes the stored positions to the mesh's own, identity unless they're snorm16
+    glm::mat4 positionTransform() const { return ::positionTransform(positionOffset, positionScale); }
+
+    // a copy to work on, back in meshVertex; empty with error set if it can't be unpacked
+    cpuMesh toMesh() const;
+
+private:
+    bool read(const std::string& path);
+
+    mappedFile file;
+    std::string why;
+    vertexLayout format;
+    size_t numVertices = 0, numIndices = 0, numLodIndices = 0;
+    const unsigned char* vertices = nullptr;
+    const unsigned int* indices = nullptr;
+    std::vector<subMesh> parts;
+    std::vector<meshLod> levels;
+    std::vector<meshlet> clusters;
+    glm::vec3 low = glm::vec3(0.0f), high = glm::vec3(0.0f);
+    glm::vec3 positionOffset = glm::vec3(0.0f);
+    float positionScale = 1.0f;
+    bool normals = false, uvs = false;
+};
+
+// the mesh file for an OBJ or PLY if there is one at least as new as it, otherwise import
+// it, make its LODs (see generateLods), cut it into meshlets (see buildMeshlets, which
+// also puts it in drawing order, so optimizeMesh is left out) and write the mesh file for
+// next time, quantized as the settings allow.  Either way the mesh file is opened
+bool openMeshCached(const std::string& source, meshFile& mesh, std::string& error,
+                    const quantizeSettings& settings = quantizeSettings(), threadPool& pool = threadPool::shared());
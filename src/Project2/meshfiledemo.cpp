@@ -0,0 +1,108 @@
+//
+// the mesh file cache demo (see meshfile.h)
+//
+
+#include "demos.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "depthraster.h"
+#include "meshfile.h"
+
+// a torus written out as an OBJ and opened through openMeshCached three times: with no
+// mesh file, with one that is damaged (an old version) and with one older than the OBJ.
+// Both bad ones have to be made again, while the meshFile still has the last one mapped
+// in the third case, and whatever the last one opened is drawn shaded by its normals.
+// Nothing is drawn if any step goes wrong
+int myMeshCache(threadPool& pool)
+{
+    namespace fs = std::filesystem;
+    memset(imageBuff, 0, sizeof(imageBuff));
+
+    std::error_code ignored;
+    fs::path folder = fs::temp_directory_path(ignored) / "g4g2-meshcache";
+    fs::create_directories(folder, ignored);
+    std::string obj = (folder / "torus.obj").string(), cached = (folder / "torus.g4mesh").string();
+    fs::remove(cached, ignored);
+
+    cpuMesh torus = torusMesh(48, 24);
+    {
+        std::ofstream out(obj, std::ios::binary);
+        char line[128];
+        for (const meshVertex& v : torus.vertices) {
+            snprintf(line, sizeof(line), "v %.5f %.5f %.5f\nvn %.4f %.4f %.4f\nvt %.4f %.4f\n", v.position.x, v.position.y,
+                     v.position.z, v.normal.x, v.normal.y, v.normal.z, v.uv.x, v.uv.y);
+            out << line;
+        }
+        for (size_t k = 0; k < torus.indices.size(); k += 3) {
+            unsigned int a = torus.indices[k] + 1, b = torus.indices[k + 1] + 1, c = torus.indices[k + 2] + 1;
+            snprintf(line, sizeof(line), "f %u/%u/%u %u/%u/%u %u/%u/%u\n", a, a, a, b, b, b, c, c, c);
+            out << line;
+        }
+    }
+
+    auto failed = [](const std::string& why) {
+        memset(imageBuff, 0, sizeof(imageBuff));
+        std::cout << "mesh cache: " << why << "\n";
+        return 1;
+    };
+
+    std::string error;
+    meshFile mesh;
+    if (!openMeshCached(obj, mesh, error, quantizeSettings(), pool))
+        return failed(error);
+    size_t bytes = (size_t)fs::file_size(cached, ignored);
+    mesh.close();
+
+    // the version straight after the magic, one no build has made
+    std::vector<char> file;
+    {
+        std::ifstream in(cached, std::ios::binary);
+        file.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    std::uint32_t version = 0xffffffffu;
+    memcpy(file.data() + 8, &version, sizeof(version));
+    std::ofstream(cached, std::ios::binary).write(file.data(), (std::streamsize)file.size());
+    if (mesh.open(cached) || mesh.isOpen())
+        return failed("a damaged mesh file opened");
+    if (!openMeshCached(obj, mesh, error, quantizeSettings(), pool))
+        return failed("the damaged mesh file wasn't made again: " + error);
+
+    // a mesh file older than its OBJ, and still open
+    fs::last_write_time(cached, fs::last_write_time(obj, ignored) - std::chrono::hours(1), ignored);
+    if (!openMeshCached(obj, mesh, error, quantizeSettings(), pool))
+        return failed("the stale mesh file wasn't made again: " + error);
+    if (fs::last_write_time(cached, ignored) < fs::last_write_time(obj, ignored) || fs::file_size(cached, ignored) != bytes)
+        return failed("the stale mesh file is still there");
+
+    cpuMesh loaded = mesh.toMesh();
+    if (!loaded.ok())
+        return failed(loaded.error);
+    glm::vec3 light = glm::normalize(glm::vec3(0.3f, 1.0f, 0.6f));
+    std::vector<glm::vec3> positions, colors;
+    for (const meshVertex& v : loaded.vertices) {
+        positions.push_back(v.position);
+        colors.push_back(glm::vec3(0.9f, 0.6f, 0.3f) * (0.35f + 0.65f * std::max(0.0f, glm::dot(v.normal, light))));
+    }
+    std::vector<unsigned int> indices(loaded.indices.begin(), loaded.indices.end());
+
+    glm::mat4 proj = glm::perspective(1.0472f, 1.0f, 0.1f, 100.0f);
+    glm::mat4 view = glm::rotate(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -2.2f)), 0.6f, glm::vec3(1.0f, 0.0f, 0.0f));
+    depthBuffer depth(imageBuffer());
+    depthRasterizer raster(imageBuffer(), depth);
+    raster.drawTriangles(positions.data(), colors.data(), indices.data(), (int)indices.size(), proj * view, pool);
+
+    std::cout << "mesh cache: " << bytes / 1024 << " KB mesh file, made again when damaged and when stale\n";
+    return 0;
+}
@@ -0,0 +1,391 @@
+//
+// procedural meshes, filled in place a band of rows per job (see meshgen.h)
+//
+
+#include "meshgen.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <utility>
+
+namespace {
+
+const float PI = 3.14159265358979f;
+
+// fn(first, last) for bands of [0, rows) spread over the pool: a few bands a thread so
+// they even out, none so thin the job costs more than the rows
+template <typename F>
+void forRows(int rows, threadPool& pool, F&& fn)
+{
+    int bands = std::max(1, std::min((int)pool.size() * 4, rows / 16));
+    pool.parallelFor(bands, [&](int band) {
+        fn((int)((long long)rows * band / bands), (int)((long long)rows * (band + 1) / bands));
+    });
+}
+
+// A surface of columns x rows quads on (columns + 1) x (rows + 1) vertices, put at
+// 'vertexBase' and 'indexBase' in the mesh's arrays, which are already big enough.
+// vertex(i, j, v) fills in the vertex in column i of row j; going along a column is
+// turning left from going along a row as seen from the front.  With 'poles' the first and
+// last rows of vertices all sit at one point, so their quads are single triangles.
+template <typename F>
+void fillGrid(cpuMesh& mesh, size_t vertexBase, size_t indexBase, int columns, int rows, bool poles, threadPool& pool,
+              F&& vertex)
+{
+    unsigned int stride = columns + 1;
+    meshVertex* vertices = mesh.vertices.data() + vertexBase;
+    unsigned int* indices = mesh.indices.data() + indexBase;
+    auto rowStart = [&](int j) { return poles && j > 0 ? (size_t)columns * 3 + (size_t)(j - 1) * columns * 6 : (size_t)j * columns * 6; };
+
+    forRows(rows + 1, pool, [&](int first, int last) {
+        for (int j = first; j < last; j++) {
+            meshVertex* row = vertices + (size_t)j * stride;
+            for (int i = 0; i <= columns; i++)
+                vertex(i, j, row[i]);
+            if (j == rows)
+                continue;
+
+            unsigned int* out = indices + rowStart(j);
+            auto triangle = [&out](unsigned int a, unsigned int b, unsigned int c) {
+                out[0] = a;
+                out[1] = b;
+                out[2] = c;
+                out += 3;
+            };
+            bool top = poles && j == 0, bottom = poles && j == rows - 1;
+            for (int i = 0; i < columns; i++) {
+                unsigned int a = (unsigned int)vertexBase + j * stride + i, b = a + stride, c = b + 1, d = a + 1;
+                if (!bottom)
+                    triangle(a, b, c);
+                if (!top)
+                    triangle(a, c, d);
+            }
+        }
+    });
+}
+
+// the sine and cosine of 'steps' + 1 angles from 0 to 'turn', the last exactly the first
+// again when it's a whole turn
+void angles(int steps, float turn, std::vector<float>& sines, std::vector<float>& cosines)
+{
+    sines.resize(steps + 1);
+    cosines.resize(steps + 1);
+    for (int k = 0; k <= steps; k++) {
+        float angle = turn * k / steps;
+        sines[k] = std::sin(angle);
+        cosines[k] = std::cos(angle);
+    }
+    if (turn == 2.0f * PI) {
+        sines[steps] = sines[0];
+        cosines[steps] = cosines[0];
+    }
+}
+
+cpuMesh sized(const char* name, size_t vertices, size_t indices)
+{
+    cpuMesh mesh;
+    mesh.vertices.resize(vertices);
+    mesh.indices.resize(indices);
+    mesh.subMeshes.push_back({ name, 0, (unsigned int)indices });
+    mesh.hasNormals = true;
+    mesh.hasUVs = true;
+    return mesh;
+}
+
+// a value on the noise lattice, 0..1
+float lattice(int x, int y, unsigned int seed)
+{
+    unsigned int h = (unsigned int)x * 374761393u + (unsigned int)y * 668265263u + seed * 2246822519u;
+    h = (h ^ (h >> 13)) * 1274126177u;
+    h ^= h >> 16;
+    return (float)(h & 0xffffff) / 16777215.0f;
+}
+
+} // namespace
+
+cpuMesh makeGrid(int columns, int rows, glm::vec2 size, threadPool& pool)
+{
+    columns = std::max(columns, 1);
+    rows = std::max(rows, 1);
+    cpuMesh mesh = sized("grid", (size_t)(columns + 1) * (rows + 1), (size_t)columns * rows * 6);
+    fillGrid(mesh, 0, 0, columns, rows, false, pool, [&](int i, int j, meshVertex& v) {
+        glm::vec2 uv((float)i / columns, (float)j / rows);
+        v = { glm::vec3((uv.x - 0.5f) * size.x, 0.0f, (uv.y - 0.5f) * size.y), glm::vec3(0.0f, 1.0f, 0.0f), uv };
+    });
+    mesh.boundsMin = glm::vec3(-0.5f * size.x, 0.0f, -0.5f * size.y);
+    mesh.boundsMax = glm::vec3(0.5f * size.x, 0.0f, 0.5f * size.y);
+    return mesh;
+}
+
+cpuMesh makeUVSphere(int segments, int rings, float radius, threadPool& pool)
+{
+    segments = std::max(segments, 3);
+    rings = std::max(rings, 2);
+    cpuMesh mesh = sized("sphere", (size_t)(segments + 1) * (rings + 1), (size_t)segments * (rings - 1) * 6);
+    std::vector<float> sinLong, cosLong, sinLat, cosLat;
+    angles(segments, 2.0f * PI, sinLong, cosLong);
+    angles(rings, PI, sinLat, cosLat);
+    // exactly on the poles, not a rounding error away
+    sinLat[0] = sinLat[rings] = 0.0f;
+    cosLat[0] = 1.0f;
+    cosLat[rings] = -1.0f;
+
+    fillGrid(mesh, 0, 0, segments, rings, true, pool, [&](int i, int j, meshVertex& v) {
+        glm::vec3 n(sinLat[j] * cosLong[i], cosLat[j], -sinLat[j] * sinLong[i]);
+        v = { n * radius, n, glm::vec2((float)i / segments, 1.0f - (float)j / rings) };
+    });
+    computeBounds(mesh, pool);
+    return mesh;
+}
+
+cpuMesh makeIcoSphere(int divisions, float radius, threadPool& pool)
+{
+    const int n = std::max(divisions, 1);
+    const float t = (1.0f + std::sqrt(5.0f)) * 0.5f;
+    const glm::vec3 corners[12] = { { -1, t, 0 }, { 1, t, 0 }, { -1, -t, 0 }, { 1, -t, 0 }, { 0, -1, t }, { 0, 1, t },
+                                    { 0, -1, -t }, { 0, 1, -t }, { t, 0, -1 }, { t, 0, 1 }, { -t, 0, -1 }, { -t, 0, 1 } };
+    unsigned int faces[20][3] = { { 0, 11, 5 }, { 0, 5, 1 }, { 0, 1, 7 }, { 0, 7, 10 }, { 0, 10, 11 },
+                                  { 1, 5, 9 }, { 5, 11, 4 }, { 11, 10, 2 }, { 10, 7, 6 }, { 7, 1, 8 },
+                                  { 3, 9, 4 }, { 3, 4, 2 }, { 3, 2, 6 }, { 3, 6, 8 }, { 3, 8, 9 },
+                                  { 4, 9, 5 }, { 2, 4, 11 }, { 6, 2, 10 }, { 8, 6, 7 }, { 9, 8, 1 } };
+    for (auto& f : faces)
+        if (glm::dot(glm::cross(corners[f[1]] - corners[f[0]], corners[f[2]] - corners[f[0]]),
+                     corners[f[0]] + corners[f[1]] + corners[f[2]]) < 0.0f)
+            std::swap(f[1], f[2]);
+
+    // the 12 corners, then n - 1 vertices along each of the 30 edges (from the lower
+    // numbered corner), then the ones inside each face
+    std::map<std::pair<unsigned int, unsigned int>, unsigned int> edgeOf;
+    std::vector<std::pair<unsigned int, unsigned int>> edges;
+    for (const auto& f : faces)
+        for (int k = 0; k < 3; k++) {
+            std::pair<unsigned int, unsigned int> e(std::min(f[k], f[(k + 1) % 3]), std::max(f[k], f[(k + 1) % 3]));
+            if (edgeOf.emplace(e, (unsigned int)edges.size()).second)
+                edges.push_back(e);
+        }
+    const size_t perEdge = n - 1, perFace = (size_t)(n - 1) * (n - 2) / 2;
+    const size_t edgeBase = 12, faceBase = edgeBase + edges.size() * perEdge;
+    cpuMesh mesh = sized("icosphere", faceBase + 20 * perFace, (size_t)20 * n * n * 3);
+    mesh.hasUVs = false;
+
+    auto place = [&](size_t at, glm::vec3 p) {
+        glm::vec3 direction = glm::normalize(p);
+        mesh.vertices[at] = { direction * radius, direction, glm::vec2(0.0f) };
+    };
+    for (int c = 0; c < 12; c++)
+        place(c, corners[c]);
+    pool.parallelFor((int)edges.size(), [&](int e) {
+        glm::vec3 from = corners[edges[e].first], to = corners[edges[e].second];
+        for (int k = 1; k < n; k++)
+            place(edgeBase + e * perEdge + (k - 1), from + (to - from) * ((float)k / n));
+    });
+
+    pool.parallelFor(20, [&](int face) {
+        const unsigned int* f = faces[face];
+        glm::vec3 a = corners[f[0]], b = corners[f[1]], c = corners[f[2]];
+        // vertex k of the n steps along one of the face's sides, from corner 'from' to 'to'
+        struct side {
+            unsigned int from, to, base;
+            bool forwards;
+        };
+        side sides[3];
+        const int ends[3][2] = { { 0, 1 }, { 0, 2 }, { 1, 2 } };
+        for (int k = 0; k < 3; k++) {
+            unsigned int from = f[ends[k][0]], to = f[ends[k][1]];
+            unsigned int e = edgeOf.at(std::make_pair(std::min(from, to), std::max(from, to)));
+            sides[k] = { from, to, (unsigned int)(edgeBase + e * perEdge), from < to };
+        }
+        auto along = [&](const side& s, int k) -> unsigned int {
+            if (k == 0)
+                return s.from;
+            if (k == n)
+                return s.to;
+            return s.base + (s.forwards ? k - 1 : n - k - 1);
+        };
+        // the vertex i of the way from a to b and j from a to c
+        auto at = [&](int i, int j) -> unsigned int {
+            if (j == 0)
+                return along(sides[0], i);
+            if (i == 0)
+                return along(sides[1], j);
+            if (i + j == n)
+                return along(sides[2], j);
+            return (unsigned int)(faceBase + face * perFace + (size_t)(j - 1) * (n - 1) - (size_t)(j - 1) * j / 2 + (i - 1));
+        };
+
+        for (int j = 1; j < n; j++)
+            for (int i = 1; i + j < n; i++)
+                place(at(i, j), a + (b - a) * ((float)i / n) + (c - a) * ((float)j / n));
+
+        unsigned int* out = mesh.indices.data() + (size_t)face * n * n * 3;
+        for (int j = 0; j < n; j++)
+            for (int i = 0; i + j < n; i++) {
+                *out++ = at(i, j);
+                *out++ = at(i + 1, j);
+                *out++ = at(i, j + 1);
+                if (i + j + 1 < n) {
+                    *out++ = at(i + 1, j);
+                    *out++ = at(i + 1, j + 1);
+                    *out++ = at(i, j + 1);
+                }
+            }
+    });
+    computeBounds(mesh, pool);
+    return mesh;
+}
+
+cpuMesh makeTorus(int around, int across, float radius, float thickness, threadPool& pool)
+{
+    around = std::max(around, 3);
+    across = std::max(across, 3);
+    cpuMesh mesh = sized("torus", (size_t)(around + 1) * (across + 1), (size_t)around * across * 6);
+    std::vector<float> sinRing, cosRing, sinTube, cosTube;
+    angles(around, 2.0f * PI, sinRing, cosRing);
+    angles(across, 2.0f * PI, sinTube, cosTube);
+
+    fillGrid(mesh, 0, 0, around, across, false, pool, [&](int i, int j, meshVertex& v) {
+        glm::vec3 n(cosTube[j] * cosRing[i], sinTube[j], cosTube[j] * sinRing[i]);
+        v = { glm::vec3(cosRing[i], 0.0f, sinRing[i]) * radius + n * thickness, n,
+              glm::vec2((float)i / around, (float)j / across) };
+    });
+    computeBounds(mesh, pool);
+    return mesh;
+}
+
+cpuMesh makeCylinder(int segments, int rows, float radius, float height, bool caps, threadPool& pool)
+{
+    segments = std::max(segments, 3);
+    rows = std::max(rows, 1);
+    size_t sideVertices = (size_t)(segments + 1) * (rows + 1), sideIndices = (size_t)segments * rows * 6;
+    cpuMesh mesh = sized("cylinder", sideVertices + (caps ? 2 * (segments + 1) : 0), sideIndices + (caps ? 2 * segments * 3 : 0));
+    std::vector<float> sines, cosines;
+    angles(segments, 2.0f * PI, sines, cosines);
+
+    fillGrid(mesh, 0, 0, segments, rows, false, pool, [&](int i, int j, meshVertex& v) {
+        glm::vec3 n(cosines[i], 0.0f, sines[i]);
+        v = { glm::vec3(n.x * radius, height * ((float)j / rows - 0.5f), n.z * radius), n,
+              glm::vec2((float)i / segments, (float)j / rows) };
+    });
+
+    // each cap is a fan around its middle, uvs as if the texture were laid on it from above
+    if (caps)
+        for (int cap = 0; cap < 2; cap++) {
+            float y = cap ? -0.5f * height : 0.5f * height;
+            glm::vec3 n(0.0f, cap ? -1.0f : 1.0f, 0.0f);
+            unsigned int middle = (unsigned int)(sideVertices + cap * (segments + 1));
+            mesh.vertices[middle] = { glm::vec3(0.0f, y, 0.0f), n, glm::vec2(0.5f) };
+            for (int i = 0; i < segments; i++)
+                mesh.vertices[middle + 1 + i] = { glm::vec3(cosines[i] * radius, y, sines[i] * radius), n,
+                                                  glm::vec2(0.5f + 0.5f * cosines[i], 0.5f + 0.5f * sines[i]) };
+            unsigned int* out = mesh.indices.data() + sideIndices + (size_t)cap * segments * 3;
+            for (int i = 0; i < segments; i++) {
+                unsigned int here = middle + 1 + i, next = middle + 1 + (i + 1) % segments;
+                *out++ = middle;
+                *out++ = cap ? here : next;
+                *out++ = cap ? next : here;
+            }
+        }
+    computeBounds(mesh, pool);
+    return mesh;
+}
+
+cpuMesh makeHeightfield(const float* heights, int columns, int rows, glm::vec2 size, float height, threadPool& pool)
+{
+    columns = std::max(columns, 1);
+    rows = std::max(rows, 1);
+    cpuMesh mesh = sized("terrain", (size_t)(columns + 1) * (rows + 1), (size_t)columns * rows * 6);
+    size_t stride = columns + 1;
+    glm::vec2 spacing(size.x / columns, size.y / rows);
+
+    fillGrid(mesh, 0, 0, columns, rows, false, pool, [&](int i, int j, meshVertex& v) {
+        const float* here = heights + j * stride + i;
+        // the slope either side, one sided at the edges
+        int left = i > 0, right = i < columns, up = j > 0, down = j < rows;
+        float dx = (here[right] - here[-left]) * height / ((left + right) * spacing.x);
+        float dz = (here[down * stride] - here[-(long long)(up * stride)]) * height / ((up + down) * spacing.y);
+        glm::vec2 uv((float)i / columns, (float)j / rows);
+        v = { glm::vec3((uv.x - 0.5f) * size.x, here[0] * height, (uv.y - 0.5f) * size.y),
+              glm::normalize(glm::vec3(-dx, 1.0f, -dz)), uv };
+    });
+
+    auto range = std::minmax_element(heights, heights + stride * (rows + 1));
+    mesh.boundsMin = glm::vec3(-0.5f * size.x, *range.first * height, -0.5f * size.y);
+    mesh.boundsMax = glm::vec3(0.5f * size.x, *range.second * height, 0.5f * size.y);
+    return mesh;
+}
+
+std::vector<float> terrainHeights(int columns, int rows, unsigned int seed, int octaves, threadPool& pool)
+{
+    columns = std::max(columns, 1);
+    rows = std::max(rows, 1);
+    octaves = std::max(octaves, 1);
+    std::vector<float> heights((size_t)(columns + 1) * (rows + 1));
+
+    // Each octave's lattice is small (four cells across the first, twice as many each
+    // octave after) so it's worked out once up front; a sample is then a bilinear lookup
+    // per octave with smoothed weights.  The cells are a fraction of the whole, so the
+    // same seed gives the same hills at any resolution
+    struct octave {
+        int cells;
+        float strength;
+        std::vector<float> values; // (cells + 1) x (cells + 1)
+    };
+    std::vector<octave> layers(octaves);
+    float total = 0.0f;
+    for (int k = 0; k < octaves; k++) {
+        octave& layer = layers[k];
+        layer.cells = 4 << k;
+        layer.strength = 1.0f / (float)(1 << k);
+        total += layer.strength;
+        layer.values.resize((size_t)(layer.cells + 1) * (layer.cells + 1));
+        for (int y = 0; y <= layer.cells; y++)
+            for (int x = 0; x <= layer.cells; x++)
+                layer.values[(size_t)y * (layer.cells + 1) + x] = lattice(x, y, seed * 131u + k);
+    }
+    for (octave& layer : layers)
+        layer.strength /= total;
+
+    // where each column falls in each octave's lattice, the same for every row
+    int largest = std::max(columns, rows);
+    std::vector<int> cellX((size_t)octaves * (columns + 1));
+    std::vector<float> weightX((size_t)octaves * (columns + 1));
+    auto smooth = [](float f) { return f * f * (3.0f - 2.0f * f); };
+    for (int k = 0; k < octaves; k++)
+        for (int i = 0; i <= columns; i++) {
+            float x = (float)i * layers[k].cells / largest;
+            int cell = std::min((int)x, layers[k].cells - 1);
+            cellX[(size_t)k * (columns + 1) + i] = cell;
+            weightX[(size_t)k * (columns + 1) + i] = smooth(x - cell);
+        }
+
+    forRows(rows + 1, pool, [&](int first, int last) {
+        for (int j = first; j < last; j++) {
+            float* row = heights.data() + (size_t)j * (columns + 1);
+            std::fill(row, row + columns + 1, 0.0f);
+            for (int k = 0; k < octaves; k++) {
+                const octave& layer = layers[k];
+                float y = (float)j * layer.cells / largest;
+                int cellY = std::min((int)y, layer.cells - 1);
+                float wy = smooth(y - cellY);
+                const float* above = layer.values.data() + (size_t)cellY * (layer.cells + 1);
+                const float* below = above + layer.cells + 1;
+                const int* cells = cellX.data() + (size_t)k * (columns + 1);
+                const float* weights = weightX.data() + (size_t)k * (columns + 1);
+                for (int i = 0; i <= columns; i++) {
+                    int x = cells[i];
+                    float top = above[x] + (above[x + 1] - above[x]) * weights[i];
+                    float bottom = below[x] + (below[x + 1] - below[x]) * weights[i];
+                    row[i] += (top + (bottom - top) * wy) * layer.strength;
+                }
+            }
+        }
+    });
+    return heights;
+}
+
+cpuMesh makeTerrain(int columns, int rows, glm::vec2 size, float height, unsigned int seed, threadPool& pool)
+{
+    std::vector<float> heights = terrainHeights(columns, rows, seed, 6, pool);
+    return makeHeightfield(heights.data(), std::max(columns, 1), std::max(rows, 1), size, height, pool);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "cpumesh.h"
+#include "threadpool.h"
+
+// Meshes made from nothing: planes, spheres, tori, cylinders and terrain, as cpuMeshes
+// ready for MeshRenderer (or optimizeMesh, generateLods, writeMeshFile...).
+//
+// Each one works out how many vertices and indices it will make, sizes the arrays once
+// and then fills them in place, bands of rows at a time on the pool's threads; a row
+// never needs another band's results, so nothing is locked or merged afterwards.  The
+// vertices are shared between the triangles around them (a grid of columns x rows quads
+// has (columns + 1) x (rows + 1) vertices), except along a UV seam, where there's a
+// second column of them so the UVs can run 0..1.  The sine and cosine a row or column
+// needs are worked out once for it, not once a vertex.
+//
+// Everything is one subMesh named after the shape, faces wind counter-clockwise seen from
+// outside (GL's front faces) with the normals pointing out, and it's centred on the
+// origin with y up.
+
+// a flat grid in the xz plane, 'size' across, facing up; uvs go 0..1 with x and z
+cpuMesh makeGrid(int columns, int rows, glm::vec2 size = glm::vec2(1.0f), threadPool& pool = threadPool::shared());
+
+// a sphere of 'segments' around by 'rings' from pole to pole; the rows next to the poles
+// are single triangles.  uvs are longitude, latitude
+cpuMesh makeUVSphere(int segments, int rings, float radius = 0.5f, threadPool& pool = threadPool::shared());
+
+// a sphere from an icosahedron, each of its 20 faces cut into divisions x divisions
+// triangles: 20 * divisions^2 triangles of nearly the same size everywhere, no poles.  No
+// uvs, there's nowhere to put a seam that doesn't cut through triangles
+cpuMesh makeIcoSphere(int divisions, float radius = 0.5f, threadPool& pool = threadPool::shared());
+
+// a ring in the xz plane: 'around' the ring by 'across' round the tube.  uvs go 0..1 both ways
+cpuMesh makeTorus(int around, int across, float radius = 0.35f, float thickness = 0.15f,
+                  threadPool& pool = threadPool::shared());
+
+// a tube along y, 'segments' around by 'rows' up, closed at both ends by flat caps with
+// their own vertices (so the edges stay sharp) unless 'caps' is false
+cpuMesh makeCylinder(int segments, int rows, float radius = 0.5f, float height = 1.0f, bool caps = true,
+                     threadPool& pool = threadPool::shared());
+
+// terrain from a height map of (columns + 1) x (rows + 1) samples, row after row, each 0..1
+// and scaled by 'height'.  Normals are from the neighbouring samples
+cpuMesh makeHeightfield(const float* heights, int columns, int rows, glm::vec2 size = glm::vec2(1.0f), float height = 0.2f,
+                        threadPool& pool = threadPool::shared());
+
+// (columns + 1) x (rows + 1) heights for makeHeightfield, 0..1: value noise, 'octaves' of
+// it each twice as fine and half as strong as the one before.  The same seed gives the
+// same hills whatever the thread count
+std::vector<float> terrainHeights(int columns, int rows, unsigned int seed = 1, int octaves = 6,
+                                  threadPool& pool = threadPool::shared());
+
+// the two together
+cpuMesh makeTerrain(int columns, int rows, glm::vec2 size = glm::vec2(1.0f), float height = 0.2f, unsigned int seed = 1,
+                    threadPool& pool = threadPool::shared());
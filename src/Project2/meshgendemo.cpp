@@ -0,0 +1,67 @@
+//
+// the procedural mesh demo (see meshgen.h)
+//
+
+#include "demos.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "depthraster.h"
+#include "meshgen.h"
+
+int myMeshGen(threadPool& pool)
+{
+    // each of the generators, lit and tinted and drawn in one picture: a patch of terrain
+    // with the four solids standing on it, then the time each takes at a size worth timing
+    glm::vec3 light = glm::normalize(glm::vec3(0.3f, 1.0f, 0.6f));
+    std::vector<unsigned int> indices;
+    std::vector<glm::vec3> positions, colors;
+    auto add = [&](const cpuMesh& mesh, glm::vec3 offset, glm::vec3 tint) {
+        unsigned int base = (unsigned int)positions.size();
+        for (const meshVertex& v : mesh.vertices) {
+            positions.push_back(v.position + offset);
+            colors.push_back(tint * (0.3f + 0.7f * std::max(0.0f, glm::dot(v.normal, light))));
+        }
+        for (unsigned int i : mesh.indices)
+            indices.push_back(base + i);
+    };
+
+    cpuMesh terrain = makeTerrain(64, 64, glm::vec2(2.4f), 0.3f, 7, pool);
+    cpuMesh shapes[4] = { makeUVSphere(24, 12, 0.3f, pool), makeIcoSphere(4, 0.3f, pool),
+                          makeTorus(32, 16, 0.22f, 0.09f, pool), makeCylinder(20, 2, 0.22f, 0.5f, true, pool) };
+    glm::vec3 places[4] = { glm::vec3(-0.55f, 0.5f, -0.45f), glm::vec3(0.55f, 0.5f, -0.45f), glm::vec3(-0.55f, 0.45f, 0.45f),
+                            glm::vec3(0.55f, 0.5f, 0.45f) };
+    glm::vec3 tints[4] = { glm::vec3(0.9f, 0.35f, 0.3f), glm::vec3(0.3f, 0.55f, 0.95f), glm::vec3(0.95f, 0.8f, 0.3f),
+                           glm::vec3(0.7f, 0.4f, 0.9f) };
+    add(terrain, glm::vec3(0.0f, -0.2f, 0.0f), glm::vec3(0.45f, 0.75f, 0.4f));
+    for (int s = 0; s < 4; s++)
+        add(shapes[s], places[s], tints[s]);
+
+    glm::mat4 proj = glm::perspective(1.0472f, 1.0f, 0.1f, 100.0f);
+    glm::mat4 view = glm::rotate(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -0.1f, -2.4f)), 0.6f, glm::vec3(1.0f, 0.0f, 0.0f));
+
+    memset(imageBuff, 0, sizeof(imageBuff));
+    depthBuffer depth(imageBuffer());
+    depthRasterizer raster(imageBuffer(), depth);
+    raster.drawTriangles(positions.data(), colors.data(), indices.data(), (int)indices.size(), proj * view, pool);
+
+    auto timed = [&](const char* name, auto make) {
+        auto start = std::chrono::steady_clock::now();
+        cpuMesh mesh = make();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "meshgen: " << name << ", " << mesh.vertices.size() << " vertices and " << mesh.triangleCount()
+            << " triangles in " << seconds * 1000.0 << " ms\n";
+    };
+    timed("grid 1024 x 1024", [&] { return makeGrid(1024, 1024, glm::vec2(1.0f), pool); });
+    timed("uv sphere 1024 x 512", [&] { return makeUVSphere(1024, 512, 0.5f, pool); });
+    timed("ico sphere 128", [&] { return makeIcoSphere(128, 0.5f, pool); });
+    timed("torus 1024 x 512", [&] { return makeTorus(1024, 512, 0.35f, 0.15f, pool); });
+    timed("cylinder 1024 x 512", [&] { return makeCylinder(1024, 512, 0.5f, 1.0f, true, pool); });
+    timed("terrain 4096 x 4096", [&] { return makeTerrain(4096, 4096, glm::vec2(1.0f), 0.2f, 1, pool); });
+    return 0;
+}
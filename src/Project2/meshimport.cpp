@@ -0,0 +1,803 @@
+//
+// parallel OBJ and binary PLY loading (see meshimport.h)
+//
+
+#include "meshimport.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <mutex>
+
+#include "mappedfile.h"
+
+namespace {
+
+double secondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// the first error any job runs into, the rest are dropped
+struct firstError {
+    std::mutex lock;
+    std::string message;
+
+    void set(const std::string& what)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (message.empty())
+            message = what;
+    }
+};
+
+cpuMesh failed(const std::string& error)
+{
+    cpuMesh mesh;
+    mesh.error = error;
+    return mesh;
+}
+
+// --- OBJ ---------------------------------------------------------------------------
+
+const int noIndex = INT_MIN;
+
+// a face corner.  While a piece is being parsed, a positive index is the file's own (1
+// based) and a relative one is kept as an index into the piece's own list (the bit in
+// 'relative' says which); after stitching all three are 0 based, -1 when missing
+struct objCorner {
+    int v, t, n;
+    unsigned char relative;
+};
+
+struct objPart {
+    std::string name;
+    size_t firstCorner;
+};
+
+struct objPiece {
+    const char* begin;
+    const char* end;
+    std::vector<glm::vec3> positions, normals;
+    std::vector<glm::vec2> uvs;
+    std::vector<objCorner> corners; // three to a triangle
+    std::vector<objPart> parts;
+    bool anyUV = false, anyNormal = false;
+    std::string error;
+
+    // where its lists start in the whole file's
+    size_t positionBase = 0, uvBase = 0, normalBase = 0, cornerBase = 0;
+};
+
+const char* skipSpaces(const char* p, const char* end)
+{
+    while (p < end && (*p == ' ' || *p == '\t'))
+        p++;
+    return p;
+}
+
+bool isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+// null if there's no number there.  Numbers too small for a float come out as 0
+const char* readFloat(const char* p, const char* end, float& value)
+{
+    p = skipSpaces(p, end);
+    if (p < end && *p == '+')
+        p++;
+    std::from_chars_result r = std::from_chars(p, end, value);
+    if (r.ec == std::errc::invalid_argument)
+        return nullptr;
+    if (r.ec == std::errc::result_out_of_range)
+        value = 0.0f;
+    return r.ptr;
+}
+
+// up to 'most' floats, the ones not there are left alone
+const char* readFloats(const char* p, const char* end, float* values, int most)
+{
+    for (int i = 0; i < most; i++) {
+        const char* next = readFloat(p, end, values[i]);
+        if (!next)
+            break;
+        p = next;
+    }
+    return p;
+}
+
+// one index of a corner, into a list that has 'count' entries in this piece so far
+const char* readIndex(const char* p, const char* end, size_t count, int& index, unsigned char& relative, unsigned char bit)
+{
+    int value = 0;
+    std::from_chars_result r = std::from_chars(p, end, value);
+    if (r.ec != std::errc() || value == 0)
+        return nullptr;
+    if (value > 0)
+        index = value;
+    else {
+        index = (int)count + value;
+        relative |= bit;
+    }
+    return r.ptr;
+}
+
+std::string lineName(const char* p, const char* end)
+{
+    p = skipSpaces(p, end);
+    while (end > p && isSpace(end[-1]))
+        end--;
+    return std::string(p, end);
+}
+
+bool startsWord(const char* p, const char* end, const char* word)
+{
+    size_t n = strlen(word);
+    return (size_t)(end - p) > n && !memcmp(p, word, n) && (p[n] == ' ' || p[n] == '\t');
+}
+
+void parsePiece(objPiece& piece)
+{
+    std::vector<objCorner> polygon;
+
+    for (const char* p = piece.begin; p < piece.end;) {
+        const char* eol = (const char*)memchr(p, '\n', piece.end - p);
+        if (!eol)
+            eol = piece.end;
+        const char* line = skipSpaces(p, eol);
+        p = eol + 1;
+        if (eol - line < 2)
+            continue;
+
+        if (line[0] == 'v') {
+            if (isSpace(line[1])) {
+                glm::vec3 v(0.0f);
+                readFloats(line + 1, eol, &v.x, 3);
+                piece.positions.push_back(v);
+            }
+            else if (line[1] == 't' && eol - line >= 3 && isSpace(line[2])) {
+                glm::vec2 t(0.0f);
+                readFloats(line + 2, eol, &t.x, 2);
+                piece.uvs.push_back(t);
+            }
+            else if (line[1] == 'n' && eol - line >= 3 && isSpace(line[2])) {
+                glm::vec3 n(0.0f);
+                readFloats(line + 2, eol, &n.x, 3);
+                piece.normals.push_back(n);
+            }
+        }
+        else if (line[0] == 'f' && isSpace(line[1])) {
+            // v, v/vt, v//vn or v/vt/vn, as many as there are
+            polygon.clear();
+            const char* q = line + 1;
+            for (;;) {
+                q = skipSpaces(q, eol);
+                if (q == eol || *q == '\r')
+                    break;
+                objCorner c = { 0, noIndex, noIndex, 0 };
+                q = readIndex(q, eol, piece.positions.size(), c.v, c.relative, 1);
+                if (q && q < eol && *q == '/') {
+                    q++;
+                    if (q < eol && *q != '/') {
+                        q = readIndex(q, eol, piece.uvs.size(), c.t, c.relative, 2);
+                        piece.anyUV = true;
+                    }
+                    if (q && q < eol && *q == '/') {
+                        q = readIndex(q + 1, eol, piece.normals.size(), c.n, c.relative, 4);
+                        piece.anyNormal = true;
+                    }
+                }
+                if (!q || (q < eol && !isSpace(*q))) {
+                    piece.error = "bad face: " + std::string(line, eol);
+                    return;
+                }
+                polygon.push_back(c);
+            }
+            for (size_t i = 2; i < polygon.size(); i++) {
+                piece.corners.push_back(polygon[0]);
+                piece.corners.push_back(polygon[i - 1]);
+                piece.corners.push_back(polygon[i]);
+            }
+        }
+        else if (startsWord(line, eol, "usemtl"))
+            piece.parts.push_back({ lineName(line + 6, eol), piece.corners.size() });
+        else if ((line[0] == 'o' || line[0] == 'g') && isSpace(line[1]))
+            piece.parts.push_back({ lineName(line + 1, eol), piece.corners.size() });
+    }
+}
+
+// a corner's three indices as they end up, the key the vertices are welded on
+struct cornerKey {
+    int v, t, n;
+
+    bool operator==(const cornerKey& o) const { return v == o.v && t == o.t && n == o.n; }
+};
+
+size_t hashKey(const cornerKey& k)
+{
+    size_t h = (size_t)(unsigned)k.v * 0x9e3779b97f4a7c15ull;
+    h ^= ((size_t)(unsigned)k.t + 0x632be59bd9b4e019ull) * 0xbf58476d1ce4e5b9ull;
+    h ^= ((size_t)(unsigned)k.n + 0x8cb92ba72f3d8dd7ull) * 0x94d049bb133111ebull;
+    return h ^ (h >> 29);
+}
+
+// open addressing map from keys to the vertex they became, for one range of positions
+class weldMap {
+public:
+    explicit weldMap(size_t expected)
+    {
+        size_t size = 16;
+        while (size < expected * 2)
+            size *= 2;
+        slots.assign(size, slot{ { 0, 0, 0 }, UINT_MAX });
+        mask = size - 1;
+    }
+
+    // the key's vertex, adding it as vertex 'next' if it isn't there yet
+    unsigned int find(const cornerKey& key, unsigned int next, bool& added)
+    {
+        for (size_t i = hashKey(key) & mask;; i = (i + 1) & mask) {
+            slot& s = slots[i];
+            if (s.vertex == UINT_MAX) {
+                s = slot{ key, next };
+                added = true;
+                return next;
+            }
+            if (s.key == key) {
+                added = false;
+                return s.vertex;
+            }
+        }
+    }
+
+private:
+    struct slot {
+        cornerKey key;
+        unsigned int vertex;
+    };
+    std::vector<slot> slots;
+    size_t mask;
+};
+
+// every distinct v/vt/vn of the faces becomes a vertex.  The positions are split into
+// ranges and the corners sorted into them (keeping their order), then each range gets
+// its own map; the vertices come out range by range, in the order the faces first use
+// them inside a range
+void weldCorners(cpuMesh& mesh, const std::vector<cornerKey>& corners, const std::vector<glm::vec3>& positions,
+                 const std::vector<glm::vec2>& uvs, const std::vector<glm::vec3>& normals, threadPool& pool)
+{
+    size_t cornerCount = corners.size();
+    int ranges = (int)std::min<size_t>(std::max<size_t>(positions.size() / 8192, 1), 256);
+    auto rangeOf = [&](int v) { return (int)((unsigned long long)v * ranges / positions.size()); };
+
+    const size_t blockSize = 1 << 16;
+    int blocks = (int)((cornerCount + blockSize - 1) / blockSize);
+    std::vector<size_t> start((size_t)blocks * ranges + 1, 0);
+
+    pool.parallelFor(blocks, [&](int b) {
+        size_t* counts = &start[(size_t)b * ranges];
+        for (size_t c = b * blockSize; c < std::min(cornerCount, (b + 1) * blockSize); c++)
+            counts[rangeOf(corners[c].v)]++;
+    });
+
+    // range major, so each range's corners end up together and in file order
+    std::vector<size_t> offsets((size_t)blocks * ranges);
+    std::vector<size_t> rangeStart(ranges + 1, 0);
+    size_t total = 0;
+    for (int r = 0; r < ranges; r++) {
+        rangeStart[r] = total;
+        for (int b = 0; b < blocks; b++) {
+            offsets[(size_t)b * ranges + r] = total;
+            total += start[(size_t)b * ranges + r];
+        }
+    }
+    rangeStart[ranges] = total;
+
+    std::vector<unsigned int> order(cornerCount);
+    pool.parallelFor(blocks, [&](int b) {
+        size_t* next = &offsets[(size_t)b * ranges];
+        for (size_t c = b * blockSize; c < std::min(cornerCount, (b + 1) * blockSize); c++)
+            order[next[rangeOf(corners[c].v)]++] = (unsigned int)c;
+    });
+
+    std::vector<std::vector<cornerKey>> unique(ranges);
+    mesh.indices.resize(cornerCount);
+    pool.parallelFor(ranges, [&](int r) {
+        weldMap map(rangeStart[r + 1] - rangeStart[r]);
+        for (size_t i = rangeStart[r]; i < rangeStart[r + 1]; i++) {
+            unsigned int c = order[i];
+            bool added;
+            mesh.indices[c] = map.find(corners[c], (unsigned int)unique[r].size(), added);
+            if (added)
+                unique[r].push_back(corners[c]);
+        }
+    });
+
+    std::vector<unsigned int> vertexBase(ranges + 1, 0);
+    for (int r = 0; r < ranges; r++)
+        vertexBase[r + 1] = vertexBase[r] + (unsigned int)unique[r].size();
+    mesh.vertices.resize(vertexBase[ranges]);
+
+    pool.parallelFor(ranges, [&](int r) {
+        meshVertex* out = &mesh.vertices[vertexBase[r]];
+        for (const cornerKey& k : unique[r]) {
+            out->position = positions[k.v];
+            out->uv = k.t >= 0 ? uvs[k.t] : glm::vec2(0.0f);
+            out->normal = k.n >= 0 ? normals[k.n] : glm::vec3(0.0f);
+            out++;
+        }
+    });
+    pool.parallelFor(blocks, [&](int b) {
+        for (size_t c = b * blockSize; c < std::min(cornerCount, (b + 1) * blockSize); c++)
+            mesh.indices[c] += vertexBase[rangeOf(corners[c].v)];
+    });
+}
+
+// --- PLY ---------------------------------------------------------------------------
+
+enum plyType { plyNone, plyInt8, plyUint8, plyInt16, plyUint16, plyInt32, plyUint32, plyFloat32, plyFloat64 };
+
+int plySize(plyType type)
+{
+    static const int sizes[] = { 0, 1, 1, 2, 2, 4, 4, 4, 8 };
+    return sizes[type];
+}
+
+plyType plyTypeNamed(const std::string& name)
+{
+    static const struct { const char* name; plyType type; } names[] = {
+        { "char", plyInt8 }, { "int8", plyInt8 }, { "uchar", plyUint8 }, { "uint8", plyUint8 },
+        { "short", plyInt16 }, { "int16", plyInt16 }, { "ushort", plyUint16 }, { "uint16", plyUint16 },
+        { "int", plyInt32 }, { "int32", plyInt32 }, { "uint", plyUint32 }, { "uint32", plyUint32 },
+        { "float", plyFloat32 }, { "float32", plyFloat32 }, { "double", plyFloat64 }, { "float64", plyFloat64 },
+    };
+    for (const auto& n : names)
+        if (name == n.name)
+            return n.type;
+    return plyNone;
+}
+
+// one value of any type as a double, swapping the bytes for a big endian file
+double plyValue(const unsigned char* p, plyType type, bool swap)
+{
+    unsigned char b[8];
+    int size = plySize(type);
+    for (int i = 0; i < size; i++)
+        b[i] = swap ? p[size - 1 - i] : p[i];
+
+    switch (type) {
+    case plyInt8: return (double)(signed char)b[0];
+    case plyUint8: return (double)b[0];
+    case plyInt16: { short v; memcpy(&v, b, 2); return v; }
+    case plyUint16: { unsigned short v; memcpy(&v, b, 2); return v; }
+    case plyInt32: { int v; memcpy(&v, b, 4); return v; }
+    case plyUint32: { unsigned int v; memcpy(&v, b, 4); return v; }
+    case plyFloat32: { float v; memcpy(&v, b, 4); return v; }
+    case plyFloat64: { double v; memcpy(&v, b, 8); return v; }
+    default: return 0.0;
+    }
+}
+
+struct plyProperty {
+    std::string name;
+    plyType type = plyNone;      // the value's, or a list's entries'
+    plyType countType = plyNone; // a list's count, plyNone when it isn't a list
+    int offset = 0;              // from the start of the record, for the scalars before any list
+};
+
+struct plyElement {
+    std::string name;
+    size_t count = 0;
+    std::vector<plyProperty> properties;
+
+    // bytes a record takes, -1 when there's a list in it
+    int fixedSize() const
+    {
+        int size = 0;
+        for (const plyProperty& p : properties) {
+            if (p.countType != plyNone)
+                return -1;
+            size += plySize(p.type);
+        }
+        return size;
+    }
+};
+
+} // namespace
+
+cpuMesh importOBJ(const char* text, size_t size, threadPool& pool, meshImportStats* stats)
+{
+    auto begin = std::chrono::steady_clock::now();
+
+    // pieces of about a megabyte, a few per thread, each ending at a line end
+    int count = (int)std::max<size_t>(1, std::min<size_t>(size / (1 << 20) + 1, pool.size() * 4));
+    std::vector<objPiece> pieces(count);
+    const char* end = text + size;
+    const char* from = text;
+    for (int i = 0; i < count; i++) {
+        const char* to = i + 1 == count ? end : text + size * (i + 1) / count;
+        if (to < from)
+            to = from;
+        const char* eol = (const char*)memchr(to, '\n', end - to);
+        to = i + 1 == count || !eol ? end : eol + 1;
+        pieces[i].begin = from;
+        pieces[i].end = to;
+        from = to;
+    }
+
+    pool.parallelFor(count, [&](int i) { parsePiece(pieces[i]); });
+    for (const objPiece& piece : pieces)
+        if (!piece.error.empty())
+            return failed(piece.error);
+    double parseSeconds = secondsSince(begin);
+
+    // stitch the pieces together: where each one's lists go, then copy them there
+    size_t positionCount = 0, uvCount = 0, normalCount = 0, cornerCount = 0;
+    bool anyUV = false, anyNormal = false;
+    for (objPiece& piece : pieces) {
+        piece.positionBase = positionCount;
+        piece.uvBase = uvCount;
+        piece.normalBase = normalCount;
+        piece.cornerBase = cornerCount;
+        positionCount += piece.positions.size();
+        uvCount += piece.uvs.size();
+        normalCount += piece.normals.size();
+        cornerCount += piece.corners.size();
+        anyUV |= piece.anyUV;
+        anyNormal |= piece.anyNormal;
+    }
+    if (cornerCount == 0)
+        return failed("no faces");
+    if (positionCount > INT_MAX || cornerCount > UINT_MAX)
+        return failed("too big");
+
+    std::vector<glm::vec3> positions(positionCount), normals(normalCount);
+    std::vector<glm::vec2> uvs(uvCount);
+    std::vector<cornerKey> corners(cornerCount);
+    firstError error;
+
+    pool.parallelFor(count, [&](int i) {
+        objPiece& piece = pieces[i];
+        std::copy(piece.positions.begin(), piece.positions.end(), positions.begin() + piece.positionBase);
+        std::copy(piece.uvs.begin(), piece.uvs.end(), uvs.begin() + piece.uvBase);
+        std::copy(piece.normals.begin(), piece.normals.end(), normals.begin() + piece.normalBase);
+
+        auto resolve = [](int index, bool relative, size_t base, size_t count) {
+            if (index == noIndex)
+                return -1;
+            long long at = relative ? (long long)base + index : (long long)index - 1;
+            return at >= 0 && at < (long long)count ? (int)at : INT_MIN;
+        };
+        cornerKey* out = &corners[piece.cornerBase];
+        for (const objCorner& c : piece.corners) {
+            *out = { resolve(c.v, c.relative & 1, piece.positionBase, positionCount),
+                     resolve(c.t, c.relative & 2, piece.uvBase, uvCount),
+                     resolve(c.n, c.relative & 4, piece.normalBase, normalCount) };
+            if (out->v < 0 || out->t == INT_MIN || out->n == INT_MIN) {
+                error.set("face index out of range");
+                return;
+            }
+            out++;
+        }
+        std::vector<objCorner>().swap(piece.corners);
+    });
+    if (!error.message.empty())
+        return failed(error.message);
+
+    cpuMesh mesh;
+    auto weldStart = std::chrono::steady_clock::now();
+    if (anyUV || anyNormal)
+        weldCorners(mesh, corners, positions, uvs, normals, pool);
+    else {
+        // nothing to weld: the positions are the vertices
+        mesh.vertices.resize(positionCount);
+        mesh.indices.resize(cornerCount);
+        pool.parallelFor(count, [&](int i) {
+            const objPiece& piece = pieces[i];
+            for (size_t v = piece.positionBase; v < piece.positionBase + piece.positions.size(); v++)
+                mesh.vertices[v] = meshVertex{ positions[v], glm::vec3(0.0f), glm::vec2(0.0f) };
+            size_t first = piece.cornerBase, last = i + 1 < count ? pieces[i + 1].cornerBase : cornerCount;
+            for (size_t c = first; c < last; c++)
+                mesh.indices[c] = (unsigned int)corners[c].v;
+        });
+    }
+    double weldSeconds = secondsSince(weldStart);
+
+    // the o, g and usemtl lines split the triangles up; ranges that came out empty go
+    subMesh current;
+    for (const objPiece& piece : pieces)
+        for (const objPart& part : piece.parts) {
+            unsigned int at = (unsigned int)(piece.cornerBase + part.firstCorner);
+            current.indexCount = at - current.firstIndex;
+            if (current.indexCount > 0)
+                mesh.subMeshes.push_back(current);
+            current = subMesh{ part.name, at, 0 };
+        }
+    current.indexCount = (unsigned int)cornerCount - current.firstIndex;
+    if (current.indexCount > 0)
+        mesh.subMeshes.push_back(current);
+
+    mesh.hasUVs = anyUV;
+    mesh.hasNormals = anyNormal;
+    if (!anyNormal)
+        computeNormals(mesh, pool);
+    computeBounds(mesh, pool);
+
+    if (stats) {
+        *stats = meshImportStats();
+        stats->bytes = size;
+        stats->triangles = mesh.triangleCount();
+        stats->vertices = mesh.vertices.size();
+        stats->threads = pool.size();
+        stats->parseSeconds = parseSeconds;
+        stats->weldSeconds = weldSeconds;
+        stats->seconds = secondsSince(begin);
+    }
+    return mesh;
+}
+
+cpuMesh importPLY(const unsigned char* data, size_t size, threadPool& pool, meshImportStats* stats)
+{
+    auto begin = std::chrono::steady_clock::now();
+
+    // the header is text, one line at a time up to end_header
+    const char* text = (const char*)data;
+    const char* headerEnd = nullptr;
+    for (size_t i = 0; i + 10 <= size && !headerEnd; i++)
+        if (!memcmp(text + i, "end_header", 10)) {
+            const char* eol = (const char*)memchr(text + i, '\n', size - i);
+            if (eol)
+                headerEnd = eol + 1;
+        }
+    if (size < 4 || memcmp(data, "ply", 3) || !headerEnd)
+        return failed("not a PLY file");
+
+    std::vector<plyElement> elements;
+    bool swap = false, binary = false;
+    for (const char* p = text; p < headerEnd;) {
+        const char* eol = (const char*)memchr(p, '\n', headerEnd - p);
+        std::string line(p, eol);
+        p = eol + 1;
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+
+        std::vector<std::string> words;
+        for (size_t at = 0; at < line.size();) {
+            size_t next = line.find(' ', at);
+            if (next == std::string::npos)
+                next = line.size();
+            if (next > at)
+                words.push_back(line.substr(at, next - at));
+            at = next + 1;
+        }
+        if (words.empty())
+            continue;
+
+        if (words[0] == "format" && words.size() > 1) {
+            binary = words[1] == "binary_little_endian" || words[1] == "binary_big_endian";
+            swap = words[1] == "binary_big_endian"; // every machine this builds for is little endian
+            if (!binary)
+                return failed("only binary PLY files are supported");
+        }
+        else if (words[0] == "element" && words.size() == 3)
+            elements.push_back({ words[1], (size_t)std::strtoull(words[2].c_str(), nullptr, 10), {} });
+        else if (words[0] == "property" && !elements.empty()) {
+            plyProperty property;
+            if (words.size() == 5 && words[1] == "list") {
+                property.countType = plyTypeNamed(words[2]);
+                property.type = plyTypeNamed(words[3]);
+                property.name = words[4];
+                if (property.countType == plyNone || property.countType >= plyFloat32 || property.type == plyNone)
+                    return failed("bad list property: " + line);
+            }
+            else if (words.size() == 3) {
+                property.type = plyTypeNamed(words[1]);
+                property.name = words[2];
+                if (property.type == plyNone)
+                    return failed("bad property: " + line);
+            }
+            else
+                return failed("bad property: " + line);
+
+            std::vector<plyProperty>& list = elements.back().properties;
+            property.offset = list.empty() ? 0 : list.back().offset + plySize(list.back().type);
+            list.push_back(property);
+        }
+    }
+    if (!binary)
+        return failed("no format line");
+    const unsigned char* p = (const unsigned char*)headerEnd;
+    const unsigned char* end = data + size;
+    const plyElement* vertexElement = nullptr;
+    const plyElement* faceElement = nullptr;
+    const unsigned char *vertexData = nullptr, *faceData = nullptr;
+
+    // find the vertex and face records, stepping over any fixed size elements before them
+    for (const plyElement& e : elements) {
+        if (e.name == "vertex") {
+            if (e.fixedSize() < 0)
+                return failed("lists in vertices aren't supported");
+            vertexElement = &e;
+            vertexData = p;
+        }
+        else if (e.name == "face") {
+            faceElement = &e;
+            faceData = p;
+            break;
+        }
+        if (e.fixedSize() < 0)
+            return failed("can't step over element " + e.name);
+        if ((size_t)(end - p) / std::max(e.fixedSize(), 1) < e.count)
+            return failed("file is cut short");
+        p += e.count * e.fixedSize();
+    }
+    if (!vertexElement || !faceElement)
+        return failed("no vertex or face element");
+
+    // which vertex properties are which
+    int x = -1, y = -1, z = -1, nx = -1, ny = -1, nz = -1, u = -1, v = -1;
+    for (int i = 0; i < (int)vertexElement->properties.size(); i++) {
+        const std::string& name = vertexElement->properties[i].name;
+        int* which = name == "x" ? &x : name == "y" ? &y : name == "z" ? &z : name == "nx" ? &nx : name == "ny" ? &ny
+            : name == "nz" ? &nz : (name == "u" || name == "s" || name == "texture_u" || name == "texture_s") ? &u
+            : (name == "v" || name == "t" || name == "texture_v" || name == "texture_t") ? &v : nullptr;
+        if (which)
+            *which = i;
+    }
+    if (x < 0 || y < 0 || z < 0)
+        return failed("vertices have no x, y and z");
+    if (vertexElement->count > UINT_MAX)
+        return failed("too big");
+
+    cpuMesh mesh;
+    mesh.hasNormals = nx >= 0 && ny >= 0 && nz >= 0;
+    mesh.hasUVs = u >= 0 && v >= 0;
+    mesh.vertices.resize(vertexElement->count);
+
+    int stride = vertexElement->fixedSize();
+    const std::vector<plyProperty>& props = vertexElement->properties;
+    auto read = [&](const unsigned char* record, int which) {
+        return which < 0 ? 0.0f : (float)plyValue(record + props[which].offset, props[which].type, swap);
+    };
+    const size_t rangeSize = 1 << 16;
+    int vertexRanges = (int)((vertexElement->count + rangeSize - 1) / rangeSize);
+    pool.parallelFor(vertexRanges, [&](int r) {
+        size_t last = std::min(vertexElement->count, (r + 1) * rangeSize);
+        for (size_t i = r * rangeSize; i < last; i++) {
+            const unsigned char* record = vertexData + i * stride;
+            mesh.vertices[i] = meshVertex{ glm::vec3(read(record, x), read(record, y), read(record, z)),
+                                           glm::vec3(read(record, nx), read(record, ny), read(record, nz)),
+                                           glm::vec2(read(record, u), read(record, v)) };
+        }
+    });
+
+    // the faces: a list of corner indices, maybe with fixed size values either side
+    int list = -1, before = 0, after = 0;
+    for (int i = 0; i < (int)faceElement->properties.size(); i++) {
+        const plyProperty& prop = faceElement->properties[i];
+        if (prop.countType != plyNone) {
+            if (list >= 0 || (prop.name != "vertex_indices" && prop.name != "vertex_index"))
+                return failed("unsupported face property " + prop.name);
+            list = i;
+        }
+        else if (list < 0)
+            before += plySize(prop.type);
+        else
+            after += plySize(prop.type);
+    }
+    if (list < 0)
+        return failed("faces have no vertex_indices");
+    plyType countType = faceElement->properties[list].countType, indexType = faceElement->properties[list].type;
+    int countSize = plySize(countType), indexSize = plySize(indexType);
+    size_t faceCount = faceElement->count;
+    size_t vertexCount = mesh.vertices.size();
+    std::atomic<bool> badIndex{ false };
+
+    auto readFace = [&](const unsigned char* record, int corners, unsigned int* out) {
+        const unsigned char* at = record + before + countSize;
+        unsigned int first = 0, previous = 0;
+        for (int k = 0; k < corners; k++) {
+            double value = plyValue(at + k * indexSize, indexType, swap);
+            if (!(value >= 0 && value < (double)vertexCount)) {
+                badIndex = true;
+                value = 0;
+            }
+            unsigned int index = (unsigned int)value;
+            if (k == 0)
+                first = index;
+            else if (k >= 2) {
+                *out++ = first;
+                *out++ = previous;
+                *out++ = index;
+            }
+            previous = index;
+        }
+    };
+
+    // every face the same size (all triangles, as a rule): fixed size records, in parallel
+    int corners = faceCount && (size_t)(end - faceData) >= (size_t)before + countSize
+        ? (int)plyValue(faceData + before, countType, swap) : 0;
+    size_t faceStride = (size_t)before + countSize + (size_t)corners * indexSize + after;
+    std::atomic<bool> sameSize{ corners >= 3 && (size_t)(end - faceData) / faceStride >= faceCount };
+    if (sameSize) {
+        size_t perFace = (size_t)(corners - 2) * 3;
+        mesh.indices.resize(faceCount * perFace);
+        int faceRanges = (int)((faceCount + rangeSize - 1) / rangeSize);
+        pool.parallelFor(faceRanges, [&](int r) {
+            size_t last = std::min(faceCount, (r + 1) * rangeSize);
+            for (size_t f = r * rangeSize; f < last && sameSize; f++) {
+                const unsigned char* record = faceData + f * faceStride;
+                if ((int)plyValue(record + before, countType, swap) != corners)
+                    sameSize = false;
+                else
+                    readFace(record, corners, &mesh.indices[f * perFace]);
+            }
+        });
+    }
+    if (!sameSize) {
+        // mixed polygons: one record after another
+        mesh.indices.clear();
+        badIndex = false;
+        const unsigned char* at = faceData;
+        std::vector<unsigned int> fan;
+        for (size_t f = 0; f < faceCount; f++) {
+            if ((size_t)(end - at) < (size_t)before + countSize)
+                return failed("file is cut short");
+            int n = (int)plyValue(at + before, countType, swap);
+            size_t bytes = (size_t)before + countSize + (size_t)std::max(n, 0) * indexSize + after;
+            if (n < 0 || (size_t)(end - at) < bytes)
+                return failed("file is cut short");
+            fan.resize((size_t)std::max(n - 2, 0) * 3);
+            readFace(at, n, fan.data());
+            mesh.indices.insert(mesh.indices.end(), fan.begin(), fan.end());
+            at += bytes;
+        }
+    }
+    if (badIndex)
+        return failed("face index out of range");
+    double parseSeconds = secondsSince(begin);
+
+    mesh.subMeshes.push_back({ "", 0, (unsigned int)mesh.indices.size() });
+    if (!mesh.hasNormals)
+        computeNormals(mesh, pool);
+    computeBounds(mesh, pool);
+
+    if (stats) {
+        *stats = meshImportStats();
+        stats->bytes = size;
+        stats->triangles = mesh.triangleCount();
+        stats->vertices = mesh.vertices.size();
+        stats->threads = pool.size();
+        stats->parseSeconds = parseSeconds;
+        stats->seconds = secondsSince(begin);
+    }
+    return mesh;
+}
+
+cpuMesh importMesh(const std::string& path, threadPool& pool, meshImportStats* stats)
+{
+    mappedFile file(path);
+    if (!file.isOpen())
+        return failed("can't open " + path);
+
+    std::string extension = path.substr(path.find_last_of('.') + 1);
+    for (char& c : extension)
+        c = (char)tolower((unsigned char)c);
+
+    cpuMesh mesh;
+    if (extension == "obj")
+        mesh = importOBJ((const char*)file.data(), file.size(), pool, stats);
+    else if (extension == "ply")
+        mesh = importPLY(file.data(), file.size(), pool, stats);
+    else
+        return failed("not an OBJ or PLY file: " + path);
+
+    if (!mesh.ok())
+        mesh.error = path + ": " + mesh.error;
+    return mesh;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+
+#include "cpumesh.h"
+#include "threadpool.h"
+
+struct meshImportStats {
+    size_t bytes = 0;          // the file
+    size_t triangles = 0;
+    size_t vertices = 0;       // after welding
+    unsigned threads = 0;
+    double seconds = 0.0;      // the whole import
+    double parseSeconds = 0.0; // reading the text or the records
+    double weldSeconds = 0.0;  // turning OBJ v/vt/vn triples into shared vertices
+};
+
+// Load an OBJ or binary PLY file (by its extension) as a cpuMesh, on the thread pool.
+//
+// The file is memory mapped and cut into pieces at line ends, which are parsed at the
+// same time (numbers with std::from_chars, which doesn't care about locales and doesn't
+// copy).  Each piece keeps its own v, vt, vn and f lines, and once they are all done the
+// pieces are stitched together with the OBJ's relative (negative) indices resolved.
+// Polygons are fanned into triangles.
+//
+// An OBJ corner is a position, a texture coordinate and a normal, each with its own
+// index, where GL wants one index per vertex.  Corners are welded through hash maps:
+// the positions are split into ranges, each with its own map, so the ranges can be done
+// in parallel and the result is the same whatever the thread count.  A file whose faces
+// only ever give positions skips that, the positions are the vertices.
+//
+// Binary PLY (either byte order) is already indexed.  Its vertices and faces are read
+// in parallel ranges, as long as every face has the same corner count, one at a time
+// otherwise.  ASCII PLY isn't supported.
+//
+// Normals missing from the file are made up with computeNormals().  On failure the mesh
+// is empty and error says why.
+cpuMesh importMesh(const std::string& path, threadPool& pool = threadPool::shared(), meshImportStats* stats = nullptr);
+
+// the same from memory, for files that are already loaded
+cpuMesh importOBJ(const char* text, size_t size, threadPool& pool = threadPool::shared(), meshImportStats* stats = nullptr);
+cpuMesh importPLY(const unsigned char* data, size_t size, threadPool& pool = threadPool::shared(), meshImportStats* stats = nullptr);
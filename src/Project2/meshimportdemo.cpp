@@ -0,0 +1,100 @@
+//
+// the OBJ import demo (see meshimport.h)
+//
+
+#include "demos.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "depthraster.h"
+#include "meshimport.h"
+
+// writes a torus out as OBJ text the way exporters do (quads, v/vt/vn with the texture seam
+// doubled up, the back half of the faces with relative indices, two materials), reads it
+// back with importOBJ and draws it with the depth tested rasterizer, shaded by its normals
+// and tinted by material
+int myMeshImport(threadPool& pool)
+{
+    const int around = 48, across = 24;
+    const float PI = 3.14159265f;
+    char line[128];
+    std::string obj = "# torus\no torus\n";
+    for (int i = 0; i < around; i++)
+        for (int j = 0; j < across; j++) {
+            float a = 2.0f * PI * i / around, b = 2.0f * PI * j / across;
+            glm::vec3 n(std::cos(a) * std::cos(b), std::sin(b), std::sin(a) * std::cos(b));
+            glm::vec3 v = glm::vec3(std::cos(a), 0.0f, std::sin(a)) * 0.6f + n * 0.25f;
+            snprintf(line, sizeof(line), "v %.5f %.5f %.5f\nvn %.4f %.4f %.4f\n", v.x, v.y, v.z, n.x, n.y, n.z);
+            obj += line;
+        }
+    for (int i = 0; i <= around; i++)
+        for (int j = 0; j <= across; j++) {
+            snprintf(line, sizeof(line), "vt %.4f %.4f\n", (float)i / around, (float)j / across);
+            obj += line;
+        }
+
+    int positions = around * across, uvs = (around + 1) * (across + 1);
+    for (int i = 0; i < around; i++) {
+        if (i == 0 || i == around / 2)
+            obj += i ? "usemtl blue\n" : "usemtl gold\n";
+        for (int j = 0; j < across; j++) {
+            int corner[4][2] = { { i, j }, { i, j + 1 }, { i + 1, j + 1 }, { i + 1, j } };
+            obj += "f";
+            for (auto& c : corner) {
+                int v = (c[0] % around) * across + (c[1] % across), t = c[0] * (across + 1) + c[1];
+                if (i < around / 2)
+                    snprintf(line, sizeof(line), " %d/%d/%d", v + 1, t + 1, v + 1);
+                else
+                    snprintf(line, sizeof(line), " %d/%d/%d", v - positions, t - uvs, v - positions);
+                obj += line;
+            }
+            obj += "\n";
+        }
+    }
+    // a truncated last line with no newline after it, read from a buffer that ends right
+    // there so a read past the end shows up under a sanitizer
+    obj += "vt";
+    std::vector<char> file(obj.begin(), obj.end());
+
+    meshImportStats stats;
+    cpuMesh mesh = importOBJ(file.data(), file.size(), pool, &stats);
+    if (!mesh.ok()) {
+        std::cout << "mesh import: " << mesh.error << "\n";
+        return 1;
+    }
+
+    std::vector<glm::vec3> positionsOut, colors;
+    for (const meshVertex& v : mesh.vertices) {
+        positionsOut.push_back(v.position);
+        colors.push_back(v.normal * 0.5f + 0.5f);
+    }
+    // vertices are shared between the materials, so tint them through the triangles' own copies
+    std::vector<unsigned int> indices;
+    std::vector<glm::vec3> flatPositions, flatColors;
+    for (const subMesh& part : mesh.subMeshes) {
+        glm::vec3 tint = part.name == "gold" ? glm::vec3(1.0f, 0.85f, 0.4f) : glm::vec3(0.5f, 0.7f, 1.0f);
+        for (unsigned int k = part.firstIndex; k < part.firstIndex + part.indexCount; k++) {
+            indices.push_back((unsigned int)flatPositions.size());
+            flatPositions.push_back(positionsOut[mesh.indices[k]]);
+            flatColors.push_back(colors[mesh.indices[k]] * tint);
+        }
+    }
+
+    glm::mat4 proj = glm::perspective(1.0472f, 1.0f, 0.1f, 100.0f);
+    glm::mat4 view = glm::rotate(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -2.2f)), 0.7f, glm::vec3(1.0f, 0.0f, 0.0f));
+
+    memset(imageBuff, 0, sizeof(imageBuff));
+    depthBuffer depth(imageBuffer());
+    depthRasterizer raster(imageBuffer(), depth);
+    raster.drawTriangles(flatPositions.data(), flatColors.data(), indices.data(), (int)indices.size(), proj * view, pool);
+
+    std::cout << "mesh import: " << stats.bytes / 1024 << " KB of OBJ, " << stats.triangles << " triangles, " << stats.vertices
+        << " vertices, " << mesh.subMeshes.size() << " materials in " << stats.seconds * 1000.0 << " ms\n";
+    return 0;
+}
@@ -0,0 +1,288 @@
+//
+// meshlets, building them and culling them (see meshlets.h)
+//
+
+#include "meshlets.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "meshoptimize.h"
+
+namespace {
+
+// the bounding sphere and normal cone of one meshlet's triangles
+void boundMeshlet(meshlet& m, const unsigned int* indices, const meshVertex* vertices)
+{
+    glm::vec3 low(INFINITY), high(-INFINITY);
+    for (unsigned int i = 0; i < m.indexCount; i++) {
+        low = glm::min(low, vertices[indices[i]].position);
+        high = glm::max(high, vertices[indices[i]].position);
+    }
+    m.center = (low + high) * 0.5f;
+    float radius = 0.0f;
+    for (unsigned int i = 0; i < m.indexCount; i++)
+        radius = std::max(radius, glm::length(vertices[indices[i]].position - m.center));
+    m.radius = radius;
+
+    // the cone's axis is the triangles' average facing, its width the one furthest from it
+    auto facing = [&](unsigned int t, float& area) {
+        glm::vec3 a = vertices[indices[t * 3]].position, b = vertices[indices[t * 3 + 1]].position,
+                  c = vertices[indices[t * 3 + 2]].position;
+        glm::vec3 n = glm::cross(b - a, c - a);
+        area = glm::length(n);
+        return area > 0.0f ? n / area : n;
+    };
+    unsigned int triangles = m.indexCount / 3;
+    glm::vec3 axis(0.0f);
+    float area;
+    for (unsigned int t = 0; t < triangles; t++)
+        axis += facing(t, area);
+    float length = glm::length(axis);
+    m.coneApex = m.center;
+    m.coneAxis = length > 0.0f ? axis / length : glm::vec3(0.0f, 0.0f, 1.0f);
+    m.coneCutoff = 2.0f;
+    if (length == 0.0f)
+        return;
+
+    float closest = 1.0f;
+    for (unsigned int t = 0; t < triangles; t++) {
+        glm::vec3 n = facing(t, area);
+        if (area > 0.0f)
+            closest = std::min(closest, glm::dot(n, m.coneAxis));
+    }
+    // wider than about 84 degrees either way it faces away from hardly anywhere
+    if (closest <= 0.1f)
+        return;
+
+    // the apex goes back along the axis until it's behind every triangle's plane, so a
+    // camera anywhere in the cone in front of it sees all of their backs
+    float back = 0.0f;
+    for (unsigned int t = 0; t < triangles; t++) {
+        glm::vec3 n = facing(t, area);
+        if (area > 0.0f)
+            back = std::max(back, glm::dot(m.center - vertices[indices[t * 3]].position, n) / glm::dot(m.coneAxis, n));
+    }
+    m.coneApex = m.center - m.coneAxis * back;
+    m.coneCutoff = std::sqrt(1.0f - closest * closest);
+}
+
+// the ranges to cut up: the subMeshes, or the whole buffer if it has none
+std::vector<subMesh> rangesOf(const cpuMesh& mesh)
+{
+    if (!mesh.subMeshes.empty())
+        return mesh.subMeshes;
+    subMesh all;
+    all.indexCount = (unsigned int)mesh.indices.size();
+    return { all };
+}
+
+} // namespace
+
+void buildMeshlets(cpuMesh& mesh, size_t maxVertices, size_t maxTriangles, threadPool& pool, meshletStats* stats)
+{
+    auto start = std::chrono::steady_clock::now();
+    mesh.meshlets.clear();
+    size_t vertexCount = mesh.vertices.size();
+    size_t triangles = mesh.indices.size() / 3;
+    const unsigned int* indices = mesh.indices.data();
+    const meshVertex* vertices = mesh.vertices.data();
+    maxVertices = std::max(maxVertices, (size_t)3);
+    maxTriangles = std::max(maxTriangles, (size_t)1);
+
+    // the triangles around each vertex
+    std::vector<unsigned int> first(vertexCount + 1, 0), around(triangles * 3);
+    for (size_t i = 0; i < triangles * 3; i++)
+        first[indices[i] + 1]++;
+    for (size_t v = 0; v < vertexCount; v++)
+        first[v + 1] += first[v];
+    std::vector<unsigned int> fill(first.begin(), first.end() - 1);
+    for (size_t i = 0; i < triangles * 3; i++)
+        around[fill[indices[i]]++] = (unsigned int)(i / 3);
+
+    auto middleOf = [&](unsigned int t) {
+        return (vertices[indices[t * 3]].position + vertices[indices[t * 3 + 1]].position + vertices[indices[t * 3 + 2]].position)
+            / 3.0f;
+    };
+
+    meshIndexBuffer reordered(mesh.indices);
+    std::vector<char> used(triangles, 0);
+    std::vector<unsigned int> live(vertexCount); // triangles around each vertex not in a meshlet yet
+    for (size_t v = 0; v < vertexCount; v++)
+        live[v] = first[v + 1] - first[v];
+    std::vector<unsigned int> inMeshlet(vertexCount, ~0u); // which meshlet each vertex was last put in
+    std::vector<unsigned int> members, candidates;
+    for (const subMesh& part : rangesOf(mesh)) {
+        if ((size_t)part.firstIndex + part.indexCount > mesh.indices.size())
+            continue;
+        size_t begin = part.firstIndex / 3, end = begin + part.indexCount / 3;
+        size_t cursor = begin, out = begin;
+        long long seed = -1;
+
+        while (true) {
+            if (seed < 0) {
+                while (cursor < end && used[cursor])
+                    cursor++;
+                if (cursor == end)
+                    break;
+                seed = (long long)cursor;
+            }
+
+            unsigned int id = (unsigned int)mesh.meshlets.size();
+            meshlet m;
+            m.firstIndex = (unsigned int)(out * 3);
+            members.clear();
+            candidates.clear();
+            glm::vec3 sum(0.0f);
+            size_t count = 0;
+            long long next = seed;
+            while (next >= 0) {
+                unsigned int t = (unsigned int)next;
+                used[t] = 1;
+                for (int c = 0; c < 3; c++) {
+                    unsigned int v = indices[t * 3 + c];
+                    live[v]--;
+                    if (inMeshlet[v] != id) {
+                        inMeshlet[v] = id;
+                        members.push_back(v);
+                        for (unsigned int a = first[v]; a < first[v + 1]; a++)
+                            if (!used[around[a]] && around[a] >= begin && around[a] < end)
+                                candidates.push_back(around[a]);
+                    }
+                    reordered[out * 3 + c] = v;
+                }
+                out++;
+                sum += middleOf(t);
+                if (++count == maxTriangles)
+                    break;
+
+                // of the triangles touching it, the one needing the fewest new vertices, the
+                // nearest its middle of those, with the ones few others are left around nearer
+                glm::vec3 middle = sum / (float)count;
+                long long best = -1;
+                int bestNew = 4;
+                float bestScore = INFINITY;
+                size_t kept = 0;
+                for (size_t k = 0; k < candidates.size(); k++) {
+                    unsigned int n = candidates[k];
+                    if (used[n])
+                        continue;
+                    candidates[kept++] = n;
+                    int extra = (inMeshlet[indices[n * 3]] != id) + (inMeshlet[indices[n * 3 + 1]] != id)
+                        + (inMeshlet[indices[n * 3 + 2]] != id);
+                    if (members.size() + extra > maxVertices || extra > bestNew)
+                        continue;
+                    glm::vec3 offset = middleOf(n) - middle;
+                    unsigned int left = live[indices[n * 3]] + live[indices[n * 3 + 1]] + live[indices[n * 3 + 2]];
+                    float score = glm::dot(offset, offset) * (float)(left + 1);
+                    if (extra < bestNew || score < bestScore) {
+                        best = n;
+                        bestNew = extra;
+                        bestScore = score;
+                    }
+                }
+                candidates.resize(kept);
+                next = best;
+            }
+
+            m.indexCount = (unsigned int)(count * 3);
+            m.vertexCount = (unsigned int)members.size();
+            mesh.meshlets.push_back(m);
+
+            // the next one starts beside this one, in the corner with the fewest triangles
+            // left around it, so the meshlets grow into each other and leave no scraps
+            seed = -1;
+            unsigned int fewest = ~0u;
+            for (unsigned int v : members)
+                for (unsigned int a = first[v]; a < first[v + 1]; a++) {
+                    unsigned int n = around[a];
+                    if (used[n] || n < begin || n >= end)
+                        continue;
+                    unsigned int left = live[indices[n * 3]] + live[indices[n * 3 + 1]] + live[indices[n * 3 + 2]];
+                    if (left < fewest) {
+                        fewest = left;
+                        seed = n;
+                    }
+                }
+        }
+    }
+    mesh.indices.swap(reordered);
+
+    // each meshlet's triangles in vertex cache order, and each LOD's (they're drawn whole),
+    // a share of the ranges for each thread (with scratch of its own)
+    size_t meshletCount = mesh.meshlets.size();
+    std::vector<std::pair<unsigned int*, unsigned int>> ranges;
+    for (const meshlet& m : mesh.meshlets)
+        ranges.push_back({ mesh.indices.data() + m.firstIndex, m.indexCount });
+    for (const meshLod& lod : mesh.lods)
+        if ((size_t)lod.firstIndex + lod.indexCount <= mesh.lodIndices.size())
+            ranges.push_back({ mesh.lodIndices.data() + lod.firstIndex, lod.indexCount });
+    int lanes = (int)std::min<size_t>(pool.size(), ranges.size());
+    pool.parallelFor(lanes, [&](int lane) {
+        std::vector<unsigned int> local(vertexCount, ~0u);
+        for (size_t i = lane; i < ranges.size(); i += lanes)
+            optimizeVertexCache(ranges[i].first, ranges[i].second, local);
+    });
+
+    // the triangles have moved, so the vertices go back in the order they're now fetched
+    optimizeVertexFetch(mesh);
+    pool.parallelFor((int)meshletCount, [&](int i) {
+        meshlet& m = mesh.meshlets[i];
+        boundMeshlet(m, mesh.indices.data() + m.firstIndex, mesh.vertices.data());
+    });
+
+    if (stats) {
+        stats->meshlets = mesh.meshlets.size();
+        size_t totalVertices = 0;
+        for (const meshlet& m : mesh.meshlets)
+            totalVertices += m.vertexCount;
+        stats->vertices = stats->meshlets ? (float)totalVertices / stats->meshlets : 0.0f;
+        stats->triangles = stats->meshlets ? (float)triangles / stats->meshlets : 0.0f;
+        stats->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+size_t cullMeshlets(const meshlet* meshlets, size_t count, const glm::mat4& model, const glm::mat4& vMat,
+                    const glm::mat4& pMat, std::vector<meshletDraw>& draws, meshletCullStats* stats)
+{
+    // the frustum's planes in the model's own space (Gribb and Hartmann), scaled so that
+    // a plane and a point give the distance between them
+    glm::mat4 clip = pMat * vMat * model;
+    glm::vec4 rows[4];
+    for (int r = 0; r < 4; r++)
+        rows[r] = glm::vec4(clip[0][r], clip[1][r], clip[2][r], clip[3][r]);
+    glm::vec4 planes[6] = { rows[3] + rows[0], rows[3] - rows[0], rows[3] + rows[1],
+                            rows[3] - rows[1], rows[3] + rows[2], rows[3] - rows[2] };
+    for (glm::vec4& plane : planes)
+        plane /= glm::length(glm::vec3(plane));
+    glm::vec3 eye = glm::vec3(glm::inverse(vMat * model)[3]);
+
+    meshletCullStats counts;
+    draws.clear();
+    for (size_t i = 0; i < count; i++) {
+        const meshlet& m = meshlets[i];
+        bool outside = false;
+        for (const glm::vec4& plane : planes)
+            outside = outside || glm::dot(glm::vec3(plane), m.center) + plane.w < -m.radius;
+        if (outside) {
+            counts.outsideFrustum++;
+            continue;
+        }
+        if (m.coneCutoff <= 1.0f && glm::dot(glm::normalize(m.coneApex - eye), m.coneAxis) >= m.coneCutoff) {
+            counts.backfacing++;
+            continue;
+        }
+
+        counts.visible++;
+        counts.indices += m.indexCount;
+        if (!draws.empty() && draws.back().firstIndex + draws.back().indexCount == m.firstIndex)
+            draws.back().indexCount += m.indexCount;
+        else
+            draws.push_back({ m.firstIndex, m.indexCount });
+    }
+    counts.draws = draws.size();
+    if (stats)
+        *stats = counts;
+    return draws.size();
+}
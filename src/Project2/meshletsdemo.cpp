@@ -0,0 +1,72 @@
+//
+// the meshlet building and culling demo (see meshlets.h)
+//
+
+#include "demos.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "depthraster.h"
+#include "meshlets.h"
+
+int myMeshlets(threadPool& pool)
+{
+    // a fine torus cut into meshlets and culled for a camera close in on one side of it,
+    // then drawn whole from further back so what was thrown away shows: the meshlets left
+    // each in a colour of their own, the ones outside that camera's view grey and the ones
+    // facing away from it dark blue
+    cpuMesh mesh = torusMesh(256, 128);
+    meshletStats stats;
+    buildMeshlets(mesh, 64, 124, pool, &stats);
+
+    glm::mat4 model(1.0f);
+    glm::mat4 closeView = glm::lookAt(glm::vec3(0.9f, 0.45f, 1.3f), glm::vec3(0.25f, 0.0f, 0.5f), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 closeProj = glm::perspective(0.7f, 1.0f, 0.05f, 100.0f);
+    std::vector<meshletDraw> draws;
+    meshletCullStats culled;
+    auto start = std::chrono::steady_clock::now();
+    cullMeshlets(mesh.meshlets.data(), mesh.meshlets.size(), model, closeView, closeProj, draws, &culled);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<char> kept(mesh.indices.size() / 3, 0);
+    for (const meshletDraw& range : draws)
+        for (unsigned int t = range.firstIndex / 3; t < (range.firstIndex + range.indexCount) / 3; t++)
+            kept[t] = 1;
+    glm::vec3 eye = glm::vec3(glm::inverse(closeView)[3]);
+    glm::vec3 light = glm::normalize(glm::vec3(0.3f, 1.0f, 0.6f));
+    std::mt19937 gen(48);
+    std::vector<unsigned int> indices;
+    std::vector<glm::vec3> positions, colors;
+    for (const meshlet& m : mesh.meshlets) {
+        glm::vec3 own(0.3f + 0.7f * nextRandom(gen, 256) / 255.0f, 0.3f + 0.7f * nextRandom(gen, 256) / 255.0f,
+                      0.3f + 0.7f * nextRandom(gen, 256) / 255.0f);
+        bool backfacing = m.coneCutoff <= 1.0f && glm::dot(glm::normalize(m.coneApex - eye), m.coneAxis) >= m.coneCutoff;
+        glm::vec3 tint = kept[m.firstIndex / 3] ? own : backfacing ? glm::vec3(0.15f, 0.2f, 0.45f) : glm::vec3(0.3f);
+        for (unsigned int i = m.firstIndex; i < m.firstIndex + m.indexCount; i++) {
+            const meshVertex& v = mesh.vertices[mesh.indices[i]];
+            indices.push_back((unsigned int)positions.size());
+            positions.push_back(v.position);
+            colors.push_back(tint * (0.35f + 0.65f * std::max(0.0f, glm::dot(v.normal, light))));
+        }
+    }
+
+    glm::mat4 proj = glm::perspective(1.0472f, 1.0f, 0.1f, 100.0f);
+    glm::mat4 view = glm::rotate(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -2.2f)), 0.8f, glm::vec3(1.0f, 0.0f, 0.0f));
+
+    memset(imageBuff, 0, sizeof(imageBuff));
+    depthBuffer depth(imageBuffer());
+    depthRasterizer raster(imageBuffer(), depth);
+    raster.drawTriangles(positions.data(), colors.data(), indices.data(), (int)indices.size(), proj * view, pool);
+
+    std::cout << "meshlets: " << stats.meshlets << " for " << mesh.triangleCount() << " triangles, " << stats.vertices
+        << " vertices and " << stats.triangles << " triangles in each on average, built in " << stats.seconds * 1000.0
+        << " ms\nmeshlets: " << culled.visible << " left, " << culled.outsideFrustum << " outside the view, "
+        << culled.backfacing << " facing away; " << culled.indices / 3 << " triangles in " << culled.draws
+        << " draws, culled in " << seconds * 1e6 << " us\n";
+    return 0;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <glm/glm.hpp>
+
+// Picking a LOD each frame from how big the object is on screen.
+//
+// An object's size on screen is its bounding sphere projected through pMat / vMat: how
+// many pixels one of its units covers at the nearest point of the sphere.  A LOD's error
+// (meshLod::error, in the mesh's units) times that is how many pixels it can be out by,
+// and the coarsest LOD that keeps that under pixelError is the one to draw.  So an object
+// far away, or small, gets few triangles whatever the mesh, and a scene full of distant
+// detailed meshes costs about what it covers.
+//
+// Right at the threshold the LOD would flip every frame as the camera drifts, so there
+// is a band either side of it: the LOD only gets coarser when the coarser one is
+// comfortably inside (pixelError * (1 - hysteresis)) and only gets finer when the current
+// one is comfortably outside (pixelError * (1 + hysteresis)).
+
+// pixels per unit of the mesh at the front of its bounding sphere (center and radius in
+// the mesh's units), for a viewport 'viewportHeight' pixels high.  Infinite when the
+// camera is inside the sphere
+inline float lodPixelsPerUnit(const glm::mat4& model, const glm::mat4& vMat, const glm::mat4& pMat, float viewportHeight,
+                              glm::vec3 center, float radius)
+{
+    glm::mat4 modelView = vMat * model;
+    glm::vec4 middle = modelView * glm::vec4(center, 1.0f);
+    // the model matrix's largest scale (the view matrix shouldn't have any)
+    float scale = std::max(glm::length(glm::vec3(modelView[0])), std::max(glm::length(glm::vec3(modelView[1])),
+                                                                        glm::length(glm::vec3(modelView[2]))));
+    float distance = -middle.z - radius * scale;
+    if (distance <= 1e-4f)
+        return INFINITY;
+    return scale * pMat[1][1] * 0.5f * viewportHeight / distance;
+}
+
+// the LOD to draw: 0 is the full mesh, 1.. are the LODs whose errors are in 'errors' (as
+// many as 'count', coarser and coarser).  'current' is what was drawn last frame
+inline int selectLod(const float* errors, int count, float pixelsPerUnit, int current, float pixelError = 1.0f,
+                     float hysteresis = 0.25f)
+{
+    auto errorAt = [&](int lod) { return lod == 0 ? 0.0f : errors[lod - 1] * pixelsPerUnit; };
+    auto coarsestWithin = [&](float pixels) {
+        int lod = 0;
+        while (lod < count && errorAt(lod + 1) <= pixels)
+            lod++;
+        return lod;
+    };
+
+    current = std::min(std::max(current, 0), count);
+    if (errorAt(current) > pixelError * (1.0f + hysteresis))
+        return coarsestWithin(pixelError);
+    return std::max(current, coarsestWithin(pixelError * (1.0f - hysteresis)));
+}
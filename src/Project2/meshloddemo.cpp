@@ -0,0 +1,92 @@
+//
+// the LOD chain and LOD selection demo (see meshsimplify.h and meshlod.h)
+//
+
+#include "demos.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "depthraster.h"
+#include "meshlod.h"
+#include "meshsimplify.h"
+
+int myMeshLod(threadPool& pool)
+{
+    // a fine torus and its LOD chain, drawn five times going away from the camera, each copy
+    // with the LOD its size on a 512 pixel screen calls for.  Faceted and tinted by LOD
+    // (white is the full mesh, then yellow, orange, red, purple) so the triangles show
+    cpuMesh mesh = torusMesh(128, 64);
+    auto start = std::chrono::steady_clock::now();
+    generateLods(mesh, { 0.5f, 0.25f, 0.125f, 0.0625f }, 0.05f, pool);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::vector<float> errors;
+    for (const meshLod& lod : mesh.lods)
+        errors.push_back(lod.error);
+
+    glm::mat4 proj = glm::perspective(1.0472f, 1.0f, 0.1f, 100.0f);
+    glm::mat4 view = glm::rotate(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -0.2f, -2.2f)), 0.45f, glm::vec3(1.0f, 0.0f, 0.0f));
+    glm::vec3 center = (mesh.boundsMin + mesh.boundsMax) * 0.5f;
+    float radius = glm::length(mesh.boundsMax - mesh.boundsMin) * 0.5f;
+
+    const glm::vec3 tints[5] = { { 1.0f, 1.0f, 1.0f }, { 1.0f, 0.9f, 0.3f }, { 1.0f, 0.55f, 0.15f }, { 0.9f, 0.2f, 0.15f }, { 0.6f, 0.25f, 0.8f } };
+    glm::vec3 light = glm::normalize(glm::vec3(0.3f, 1.0f, 0.6f));
+    std::vector<unsigned int> indices;
+    std::vector<glm::vec3> positions, colors;
+    const glm::vec3 places[5] = { { -0.5f, 0.0f, 0.6f }, { 1.1f, 0.0f, -1.2f }, { -1.5f, 0.0f, -4.0f }, { 2.0f, 0.0f, -9.0f }, { -0.6f, 0.0f, -20.0f } };
+    int chosen[5];
+    for (int k = 0; k < 5; k++) {
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), places[k]);
+        float pixelsPerUnit = lodPixelsPerUnit(model, view, proj, (float)dimy, center, radius);
+        int lod = selectLod(errors.data(), (int)errors.size(), pixelsPerUnit, 0);
+        chosen[k] = lod;
+        const unsigned int* range = lod ? mesh.lodIndices.data() + mesh.lods[lod - 1].firstIndex : mesh.indices.data();
+        size_t count = lod ? mesh.lods[lod - 1].indexCount : mesh.indices.size();
+        for (size_t i = 0; i < count; i += 3) {
+            glm::vec3 corner[3];
+            for (int c = 0; c < 3; c++)
+                corner[c] = mesh.vertices[range[i + c]].position + places[k];
+            glm::vec3 n = glm::normalize(glm::cross(corner[1] - corner[0], corner[2] - corner[0]));
+            glm::vec3 color = tints[std::min(lod, 4)] * (0.25f + 0.75f * std::max(0.0f, glm::dot(n, light)));
+            for (int c = 0; c < 3; c++) {
+                indices.push_back((unsigned int)positions.size());
+                positions.push_back(corner[c]);
+                colors.push_back(color);
+            }
+        }
+    }
+
+    memset(imageBuff, 0, sizeof(imageBuff));
+    depthBuffer depth(imageBuffer());
+    depthRasterizer raster(imageBuffer(), depth);
+    raster.drawTriangles(positions.data(), colors.data(), indices.data(), (int)indices.size(), proj * view, pool);
+
+    // a camera drifting back and forth over a LOD threshold, how often it switches with
+    // and without the hysteresis band
+    int switches[2] = { 0, 0 };
+    for (int band = 0; band < 2; band++) {
+        int lod = 0;
+        std::mt19937 gen(47);
+        for (int frame = 0; frame < 600; frame++) {
+            float z = -3.0f - 6.0f * (0.5f - 0.5f * std::cos(frame * 0.02f)) - 0.2f * nextRandom(gen, 100) / 100.0f;
+            glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, z));
+            float pixelsPerUnit = lodPixelsPerUnit(model, glm::mat4(1.0f), proj, (float)dimy, center, radius);
+            int next = selectLod(errors.data(), (int)errors.size(), pixelsPerUnit, lod, 1.0f, band ? 0.25f : 0.0f);
+            switches[band] += next != lod;
+            lod = next;
+        }
+    }
+
+    std::cout << "mesh lod: " << mesh.triangleCount() << " triangles";
+    for (const meshLod& lod : mesh.lods)
+        std::cout << ", " << lod.indexCount / 3 << " (error " << lod.error << ")";
+    std::cout << " in " << seconds * 1000.0 << " ms\nmesh lod: drawn with LODs " << chosen[0] << " " << chosen[1] << " " << chosen[2] << " "
+        << chosen[3] << " " << chosen[4] << ", " << switches[0] << " switches over 600 frames without hysteresis, " << switches[1]
+        << " with\n";
+    return 0;
+}
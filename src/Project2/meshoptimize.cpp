@@ -0,0 +1,333 @@
+//
+// index and vertex reordering for the vertex cache, overdraw and vertex fetch (see meshoptimize.h)
+//
+
+#include "meshoptimize.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace {
+
+// A FIFO vertex cache, simulated with a time stamp per vertex: a vertex is in the cache if
+// it went in within the last cacheSize misses.  flush() empties it without touching the
+// stamps, so one of these can go through many ranges of a big index buffer cheaply.
+struct fifoCache {
+    std::vector<size_t> stamp;
+    size_t time;
+    size_t size;
+
+    fifoCache(size_t vertexCount, int cacheSize) : stamp(vertexCount, 0), time(cacheSize), size(cacheSize) {}
+
+    void flush() { time += size; }
+
+    // 1 if v had to be shaded
+    int use(unsigned int v)
+    {
+        if (time - stamp[v] < size)
+            return 0;
+        stamp[v] = ++time;
+        return 1;
+    }
+
+    int triangle(const unsigned int* t) { return use(t[0]) + use(t[1]) + use(t[2]); }
+};
+
+// Tipsify on one range of triangles.  'local' is vertexCount long and all ~0u; the range's
+// vertices are numbered from 0 in it while this runs (so a small subMesh of a big mesh only
+// costs its own size) and it's put back as it was afterwards.
+void tipsify(unsigned int* indices, size_t count, std::vector<unsigned int>& local, int cacheSize)
+{
+    size_t triangles = count / 3;
+    if (triangles == 0)
+        return;
+
+    std::vector<unsigned int> global;
+    std::vector<unsigned int> corners(triangles * 3);
+    for (size_t i = 0; i < triangles * 3; i++) {
+        unsigned int& id = local[indices[i]];
+        if (id == ~0u) {
+            id = (unsigned int)global.size();
+            global.push_back(indices[i]);
+        }
+        corners[i] = id;
+    }
+    for (unsigned int v : global)
+        local[v] = ~0u;
+    size_t vertexCount = global.size();
+
+    // the triangles around each vertex, and how many of those are still to be emitted
+    std::vector<unsigned int> live(vertexCount, 0), first(vertexCount + 1, 0), adjacency(triangles * 3);
+    for (unsigned int v : corners)
+        live[v]++;
+    for (size_t v = 0; v < vertexCount; v++)
+        first[v + 1] = first[v] + live[v];
+    std::vector<unsigned int> fill(first.begin(), first.end() - 1);
+    for (size_t i = 0; i < triangles * 3; i++)
+        adjacency[fill[corners[i]]++] = (unsigned int)(i / 3);
+
+    std::vector<size_t> cached(vertexCount, 0);
+    std::vector<char> emitted(triangles, 0);
+    std::vector<unsigned int> deadEnds, candidates, out;
+    out.reserve(triangles * 3);
+    size_t time = cacheSize + 1;
+    size_t k = cacheSize;
+    size_t cursor = 0;
+
+    // where to go when the fan runs out and nothing nearby is worth it: the most recent
+    // vertex with triangles left, else the next one in order.  -1 when every triangle is out
+    auto skipDeadEnd = [&]() -> long long {
+        while (!deadEnds.empty()) {
+            unsigned int d = deadEnds.back();
+            deadEnds.pop_back();
+            if (live[d] > 0)
+                return d;
+        }
+        while (cursor < vertexCount) {
+            if (live[cursor] > 0)
+                return (long long)cursor;
+            cursor++;
+        }
+        return -1;
+    };
+
+    long long fan = skipDeadEnd();
+    while (fan >= 0) {
+        candidates.clear();
+        for (unsigned int a = first[fan]; a < first[fan + 1]; a++) {
+            unsigned int t = adjacency[a];
+            if (emitted[t])
+                continue;
+            emitted[t] = 1;
+            for (int c = 0; c < 3; c++) {
+                unsigned int v = corners[t * 3 + c];
+                out.push_back(v);
+                deadEnds.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+                if (time - cached[v] > k)
+                    cached[v] = time++;
+            }
+        }
+
+        // the candidate that has been in the cache longest and will still be there after
+        // its remaining triangles have gone out (at most two new vertices each)
+        long long best = -1;
+        long long priority = -1;
+        for (unsigned int v : candidates) {
+            if (live[v] == 0)
+                continue;
+            long long p = 0;
+            if (time - cached[v] + 2 * live[v] <= k)
+                p = (long long)(time - cached[v]);
+            if (p > priority) {
+                priority = p;
+                best = v;
+            }
+        }
+        fan = best >= 0 ? best : skipDeadEnd();
+    }
+
+    for (size_t i = 0; i < out.size(); i++)
+        indices[i] = global[out[i]];
+}
+
+// Split a cache ordered range into clusters and draw the ones facing out first.  Returns
+// the number of clusters
+size_t sortClusters(unsigned int* indices, size_t count, const meshVertex* vertices, fifoCache& cache, float threshold)
+{
+    size_t triangles = count / 3;
+    if (triangles == 0)
+        return 0;
+
+    // hard boundaries: triangles that miss on every corner, the cache is no use there anyway
+    std::vector<int> misses(triangles);
+    cache.flush();
+    for (size_t t = 0; t < triangles; t++)
+        misses[t] = cache.triangle(indices + t * 3);
+    std::vector<size_t> hard;
+    for (size_t t = 0; t < triangles; t++)
+        if (t == 0 || misses[t] == 3)
+            hard.push_back(t);
+    hard.push_back(triangles);
+
+    // soft boundaries: within each of those, start a new cluster as soon as the one so far
+    // (from a cold cache, as it will be once the clusters move) does about as well as the whole
+    std::vector<size_t> starts;
+    for (size_t h = 0; h + 1 < hard.size(); h++) {
+        size_t begin = hard[h], end = hard[h + 1];
+        size_t total = 0;
+        for (size_t t = begin; t < end; t++)
+            total += misses[t];
+        float target = threshold * (float)total / (float)(end - begin);
+
+        cache.flush();
+        size_t start = begin, sofar = 0;
+        starts.push_back(begin);
+        for (size_t t = begin; t < end; t++) {
+            sofar += cache.triangle(indices + t * 3);
+            if (t + 1 < end && (float)sofar <= target * (float)(t + 1 - start)) {
+                start = t + 1;
+                starts.push_back(start);
+                sofar = 0;
+                cache.flush();
+            }
+        }
+    }
+    starts.push_back(triangles);
+    size_t clusters = starts.size() - 1;
+
+    // each cluster's centroid and facing, weighted by area, and the range's own centroid
+    std::vector<glm::vec3> centroid(clusters, glm::vec3(0.0f)), facing(clusters, glm::vec3(0.0f));
+    glm::vec3 middle(0.0f);
+    float area = 0.0f;
+    for (size_t c = 0; c < clusters; c++) {
+        float clusterArea = 0.0f;
+        for (size_t t = starts[c]; t < starts[c + 1]; t++) {
+            glm::vec3 a = vertices[indices[t * 3]].position, b = vertices[indices[t * 3 + 1]].position,
+                      d = vertices[indices[t * 3 + 2]].position;
+            glm::vec3 n = glm::cross(b - a, d - a);
+            float w = glm::length(n);
+            centroid[c] += (a + b + d) * (w / 3.0f);
+            facing[c] += n;
+            clusterArea += w;
+        }
+        middle += centroid[c];
+        area += clusterArea;
+        centroid[c] = clusterArea > 0.0f ? centroid[c] / clusterArea : vertices[indices[starts[c] * 3]].position;
+    }
+    middle = area > 0.0f ? middle / area : glm::vec3(0.0f);
+
+    std::vector<float> key(clusters);
+    std::vector<size_t> order(clusters);
+    for (size_t c = 0; c < clusters; c++) {
+        float length = glm::length(facing[c]);
+        key[c] = length > 0.0f ? glm::dot(centroid[c] - middle, facing[c] / length) : 0.0f;
+        order[c] = c;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return key[a] > key[b]; });
+
+    std::vector<unsigned int> sorted;
+    sorted.reserve(triangles * 3);
+    for (size_t c : order)
+        sorted.insert(sorted.end(), indices + starts[c] * 3, indices + starts[c + 1] * 3);
+    std::copy(sorted.begin(), sorted.end(), indices);
+    return clusters;
+}
+
+// the ranges to reorder within: the subMeshes, or the whole buffer if it has none
+std::vector<subMesh> rangesOf(const cpuMesh& mesh)
+{
+    if (!mesh.subMeshes.empty())
+        return mesh.subMeshes;
+    subMesh all;
+    all.indexCount = (unsigned int)mesh.indices.size();
+    return { all };
+}
+
+} // namespace
+
+vertexCacheStats analyzeVertexCache(const unsigned int* indices, size_t count, size_t vertexCount, int cacheSize)
+{
+    vertexCacheStats stats;
+    size_t triangles = count / 3;
+    if (triangles == 0)
+        return stats;
+
+    fifoCache cache(vertexCount, cacheSize);
+    std::vector<char> used(vertexCount, 0);
+    size_t unique = 0;
+    for (size_t i = 0; i < triangles * 3; i++) {
+        stats.misses += cache.use(indices[i]);
+        if (!used[indices[i]]) {
+            used[indices[i]] = 1;
+            unique++;
+        }
+    }
+    stats.acmr = (float)stats.misses / (float)triangles;
+    stats.atvr = (float)stats.misses / (float)unique;
+    return stats;
+}
+
+void optimizeVertexCache(unsigned int* indices, size_t count, size_t vertexCount, int cacheSize)
+{
+    std::vector<unsigned int> local(vertexCount, ~0u);
+    tipsify(indices, count, local, cacheSize);
+}
+
+void optimizeVertexCache(unsigned int* indices, size_t count, std::vector<unsigned int>& local, int cacheSize)
+{
+    tipsify(indices, count, local, cacheSize);
+}
+
+size_t optimizeOverdraw(unsigned int* indices, size_t count, const meshVertex* vertices, size_t vertexCount,
+                        float threshold, int cacheSize)
+{
+    fifoCache cache(vertexCount, cacheSize);
+    return sortClusters(indices, count, vertices, cache, threshold);
+}
+
+void optimizeVertexFetch(cpuMesh& mesh)
+{
+    std::vector<unsigned int> remap(mesh.vertices.size(), ~0u);
+    unsigned int next = 0;
+    for (unsigned int& index : mesh.indices) {
+        if (remap[index] == ~0u)
+            remap[index] = next++;
+        index = remap[index];
+    }
+    for (unsigned int& to : remap)
+        if (to == ~0u)
+            to = next++;
+    // the LODs use the same vertices, in the full mesh's order
+    for (unsigned int& index : mesh.lodIndices)
+        index = remap[index];
+
+    meshVertexBuffer vertices(mesh.vertices.size());
+    for (size_t v = 0; v < remap.size(); v++)
+        vertices[remap[v]] = mesh.vertices[v];
+    mesh.vertices.swap(vertices);
+}
+
+void optimizeMesh(cpuMesh& mesh, float threshold, int cacheSize, threadPool& pool, meshOptimizeStats* stats)
+{
+    auto start = std::chrono::steady_clock::now();
+    size_t vertexCount = mesh.vertices.size();
+    if (stats)
+        stats->before = analyzeVertexCache(mesh.indices.data(), mesh.indices.size(), vertexCount, cacheSize);
+
+    // every subMesh and LOD is a range of its own, done on the pool a few at a time: each
+    // thread has its own scratch, vertexCount long, rather than each range
+    struct range {
+        unsigned int* indices;
+        size_t count;
+    };
+    std::vector<range> ranges;
+    for (const subMesh& part : rangesOf(mesh))
+        if ((size_t)part.firstIndex + part.indexCount <= mesh.indices.size())
+            ranges.push_back({ mesh.indices.data() + part.firstIndex, part.indexCount });
+    for (const meshLod& lod : mesh.lods)
+        if ((size_t)lod.firstIndex + lod.indexCount <= mesh.lodIndices.size())
+            ranges.push_back({ mesh.lodIndices.data() + lod.firstIndex, lod.indexCount });
+
+    std::vector<size_t> clusters(ranges.size(), 0);
+    int lanes = (int)std::min<size_t>(pool.size(), ranges.size());
+    pool.parallelFor(lanes, [&](int lane) {
+        std::vector<unsigned int> local(vertexCount, ~0u);
+        fifoCache cache(vertexCount, cacheSize);
+        for (size_t r = lane; r < ranges.size(); r += lanes) {
+            tipsify(ranges[r].indices, ranges[r].count, local, cacheSize);
+            clusters[r] = sortClusters(ranges[r].indices, ranges[r].count, mesh.vertices.data(), cache, threshold);
+        }
+    });
+    optimizeVertexFetch(mesh);
+
+    if (stats) {
+        stats->after = analyzeVertexCache(mesh.indices.data(), mesh.indices.size(), vertexCount, cacheSize);
+        stats->clusters = 0;
+        for (size_t c : clusters)
+            stats->clusters += c;
+        stats->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+}
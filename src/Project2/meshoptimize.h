@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+
+#include "cpumesh.h"
+#include "threadpool.h"
+
+// how well an index buffer uses the post transform vertex cache, from a FIFO cache of
+// 'cacheSize' entries (what most GPUs have, more or less)
+struct vertexCacheStats {
+    size_t misses = 0;    // vertices shaded
+    float acmr = 0.0f;    // average cache miss ratio: shaded per triangle, 0.5 at best, 3 at worst
+    float atvr = 0.0f;    // average transformed vertex ratio: shaded per vertex used, 1 at best
+};
+
+vertexCacheStats analyzeVertexCache(const unsigned int* indices, size_t count, size_t vertexCount, int cacheSize = 16);
+
+struct meshOptimizeStats {
+    vertexCacheStats before, after;
+    size_t clusters = 0;  // runs of triangles the overdraw pass sorted
+    double seconds = 0.0;
+};
+
+// Reorder the triangles of each subMesh (and each LOD) for the vertex cache, then for less
+// overdraw, then the vertices to the order the triangles first use them.  Nothing else
+// changes: the same triangles, facing the same way, in the same subMeshes.  The subMeshes
+// and LODs are spread over the pool.
+//
+// The vertex cache order is Tipsify (Sander, Nehab and Barczak, "Fast Triangle
+// Reordering for Vertex Locality and Reduced Overdraw", 2007): fan out from a vertex
+// until its triangles are used up, then carry on from whichever vertex just used will
+// still be in the cache, or failing that the most recent dead end.  Everything is linear
+// in the size of the mesh.
+//
+// The overdraw pass from the same paper cuts that order into clusters where the cache
+// starts from scratch anyway (a triangle with three misses), and again where the misses
+// so far are within 'threshold' of the cluster's own, then puts the clusters that face
+// out from the middle of the mesh first so they tend to hide what's drawn after.  That
+// gives up a little of the cache order (1.05 keeps the ACMR within about 5%) for far
+// less shading of hidden pixels from any direction.
+//
+// Last the vertices are put in the order the index buffer first reaches them, so vertex
+// fetch walks through memory instead of jumping about.  Vertices no triangle uses go at
+// the end.
+void optimizeMesh(cpuMesh& mesh, float threshold = 1.05f, int cacheSize = 16, threadPool& pool = threadPool::shared(),
+                  meshOptimizeStats* stats = nullptr);
+
+// the separate passes, for index buffers on their own (QuadRenderer's, say).  Both work on
+// a whole index buffer, three indices to a triangle
+void optimizeVertexCache(unsigned int* indices, size_t count, size_t vertexCount, int cacheSize = 16);
+// the same on one of many small ranges of a big buffer (meshlets, say) without going over
+// all of its vertices each time: 'local' is vertexCount long, all ~0u, and is left that way
+void optimizeVertexCache(unsigned int* indices, size_t count, std::vector<unsigned int>& local, int cacheSize = 16);
+size_t optimizeOverdraw(unsigned int* indices, size_t count, const meshVertex* vertices, size_t vertexCount,
+                        float threshold = 1.05f, int cacheSize = 16);
+void optimizeVertexFetch(cpuMesh& mesh);
@@ -0,0 +1,98 @@
+//
+// the vertex cache and overdraw optimization demo (see meshoptimize.h)
+//
+
+#include "demos.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "depthraster.h"
+#include "meshoptimize.h"
+
+// a torus as a cpuMesh, rows of quads around the ring; uvs go 0..1 both ways
+cpuMesh torusMesh(int around, int across)
+{
+    const float PI = 3.14159265f;
+    cpuMesh mesh;
+    for (int i = 0; i < around; i++)
+        for (int j = 0; j < across; j++) {
+            float a = 2.0f * PI * i / around, b = 2.0f * PI * j / across;
+            glm::vec3 n(std::cos(a) * std::cos(b), std::sin(b), std::sin(a) * std::cos(b));
+            mesh.vertices.push_back({ glm::vec3(std::cos(a), 0.0f, std::sin(a)) * 0.6f + n * 0.25f, n, glm::vec2((float)i / around, (float)j / across) });
+        }
+    for (int i = 0; i < around; i++)
+        for (int j = 0; j < across; j++) {
+            unsigned int a = i * across + j, b = i * across + (j + 1) % across;
+            unsigned int c = (i + 1) % around * across + (j + 1) % across, d = (i + 1) % around * across + j;
+            mesh.indices.insert(mesh.indices.end(), { a, b, c, a, c, d });
+        }
+    mesh.subMeshes.push_back({ "torus", 0, (unsigned int)mesh.indices.size() });
+    mesh.hasNormals = mesh.hasUVs = true;
+    computeBounds(mesh);
+    return mesh;
+}
+
+int myMeshOptimize(threadPool& pool)
+{
+    // a torus with its triangles in no order at all, the worst case for the vertex cache
+    cpuMesh mesh = torusMesh(64, 32);
+    std::vector<glm::uvec3> triangles;
+    for (size_t k = 0; k < mesh.indices.size(); k += 3)
+        triangles.push_back(glm::uvec3(mesh.indices[k], mesh.indices[k + 1], mesh.indices[k + 2]));
+    mesh.indices.clear();
+    std::mt19937 gen(45);
+    for (size_t t = triangles.size() - 1; t > 0; t--)
+        std::swap(triangles[t], triangles[nextRandom(gen, (unsigned int)t + 1)]);
+    for (glm::uvec3 t : triangles)
+        mesh.indices.insert(mesh.indices.end(), { t.x, t.y, t.z });
+
+    cpuMesh optimized = mesh;
+    meshOptimizeStats stats;
+    optimizeMesh(optimized, 1.05f, 16, pool, &stats);
+
+    // each triangle coloured by how many of its corners missed a 16 entry cache, from
+    // green (none) to red (all three); as authored on the left, optimized on the right
+    const glm::vec3 heat[4] = { { 0.1f, 0.6f, 0.2f }, { 0.7f, 0.8f, 0.2f }, { 0.95f, 0.5f, 0.1f }, { 0.9f, 0.1f, 0.1f } };
+    std::vector<unsigned int> indices;
+    std::vector<glm::vec3> positions, colors;
+    auto addMesh = [&](const cpuMesh& m, float x) {
+        std::vector<size_t> inCache(m.vertices.size(), 0);
+        size_t time = 16;
+        for (size_t k = 0; k < m.indices.size(); k += 3) {
+            int misses = 0;
+            for (int c = 0; c < 3; c++) {
+                unsigned int v = m.indices[k + c];
+                if (time - inCache[v] >= 16) {
+                    inCache[v] = ++time;
+                    misses++;
+                }
+            }
+            float shade = 0.55f + 0.45f * std::max(0.0f, glm::dot(m.vertices[m.indices[k]].normal, glm::normalize(glm::vec3(0.3f, 1.0f, 0.6f))));
+            for (int c = 0; c < 3; c++) {
+                indices.push_back((unsigned int)positions.size());
+                positions.push_back(m.vertices[m.indices[k + c]].position + glm::vec3(x, 0.0f, 0.0f));
+                colors.push_back(heat[misses] * shade);
+            }
+        }
+    };
+    addMesh(mesh, -0.9f);
+    addMesh(optimized, 0.9f);
+
+    glm::mat4 proj = glm::perspective(1.0472f, 1.0f, 0.1f, 100.0f);
+    glm::mat4 view = glm::rotate(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -3.0f)), 0.9f, glm::vec3(1.0f, 0.0f, 0.0f));
+
+    memset(imageBuff, 0, sizeof(imageBuff));
+    depthBuffer depth(imageBuffer());
+    depthRasterizer raster(imageBuffer(), depth);
+    raster.drawTriangles(positions.data(), colors.data(), indices.data(), (int)indices.size(), proj * view, pool);
+
+    std::cout << "mesh optimize: " << optimized.triangleCount() << " triangles, ACMR " << stats.before.acmr << " -> " << stats.after.acmr
+        << ", ATVR " << stats.before.atvr << " -> " << stats.after.atvr << ", " << stats.clusters << " overdraw clusters in "
+        << stats.seconds * 1000.0 << " ms\n";
+    return 0;
+}
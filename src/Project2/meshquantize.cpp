@@ -0,0 +1,275 @@
+//
+// quantized vertex layouts (see meshquantize.h)
+//
+
+#include "meshquantize.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <glm/gtc/packing.hpp>
+
+namespace {
+
+std::int16_t snorm16(float f)
+{
+    return (std::int16_t)std::lround(glm::clamp(f, -1.0f, 1.0f) * 32767.0f);
+}
+
+float fromSnorm16(std::int16_t v)
+{
+    return std::max(v / 32767.0f, -1.0f);
+}
+
+// octahedral normals: the unit sphere folded onto the square -1..1, x and y as they are
+// for the top half and the bottom half folded over the diagonals
+glm::vec2 octWrap(glm::vec2 v)
+{
+    return (1.0f - glm::abs(glm::vec2(v.y, v.x))) * glm::vec2(v.x >= 0.0f ? 1.0f : -1.0f, v.y >= 0.0f ? 1.0f : -1.0f);
+}
+
+glm::vec3 octDecode(glm::vec2 e)
+{
+    glm::vec3 n(e.x, e.y, 1.0f - std::abs(e.x) - std::abs(e.y));
+    if (n.z < 0.0f) {
+        glm::vec2 xy = octWrap(glm::vec2(n.x, n.y));
+        n.x = xy.x;
+        n.y = xy.y;
+    }
+    float length = glm::length(n);
+    return length > 0.0f ? n / length : glm::vec3(0.0f, 0.0f, 1.0f);
+}
+
+// angle between two normals in degrees, atan2 keeps it accurate when they're close
+float degreesBetween(glm::vec3 a, glm::vec3 b)
+{
+    return glm::degrees(std::atan2(glm::length(glm::cross(a, b)), glm::dot(a, b)));
+}
+
+// the closest of the four ways of rounding the folded normal to snorm16, not just the nearest
+// on the square, which can be a good way off on the sphere
+void octEncode(glm::vec3 n, std::int16_t out[2])
+{
+    n /= std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+    glm::vec2 e = n.z >= 0.0f ? glm::vec2(n.x, n.y) : octWrap(glm::vec2(n.x, n.y));
+    glm::vec2 scaled = glm::clamp(e, -1.0f, 1.0f) * 32767.0f;
+    float best = 1e30f;
+    for (int i = 0; i < 4; i++) {
+        std::int16_t x = (std::int16_t)(i & 1 ? std::ceil(scaled.x) : std::floor(scaled.x));
+        std::int16_t y = (std::int16_t)(i & 2 ? std::ceil(scaled.y) : std::floor(scaled.y));
+        float error = degreesBetween(n, octDecode(glm::vec2(fromSnorm16(x), fromSnorm16(y))));
+        if (error < best) {
+            best = error;
+            out[0] = x;
+            out[1] = y;
+        }
+    }
+}
+
+glm::vec3 unitNormal(glm::vec3 n)
+{
+    float length = glm::length(n);
+    return length > 0.0f ? n / length : glm::vec3(0.0f, 0.0f, 1.0f);
+}
+
+// what each candidate format would do to every vertex, before choosing
+struct candidateErrors {
+    float snormPosition = 0.0f, halfPosition = 0.0f;
+    float packedNormal = 0.0f, octNormal = 0.0f;
+    float halfUV = 0.0f;
+};
+
+enum class positionFormat { snorm16, float16, float32 };
+enum class normalFormat { packed, octahedral, float32 };
+enum class uvFormat { none, float16, float32 };
+
+} // namespace
+
+packedVertices packVertices(const cpuMesh& mesh, const quantizeSettings& settings, threadPool& pool)
+{
+    packedVertices packed;
+    packed.count = mesh.vertices.size();
+
+    glm::vec3 extent = mesh.boundsMax - mesh.boundsMin;
+    float side = std::max(extent.x, std::max(extent.y, extent.z));
+    float scale = side > 0.0f ? side * 0.5f : 1.0f;
+    glm::vec3 offset = (mesh.boundsMin + mesh.boundsMax) * 0.5f;
+    float unit = side > 0.0f ? side : 1.0f; // positionError is a fraction of this
+
+    // measure every candidate over the whole mesh
+    int jobs = (int)std::min<size_t>(pool.size(), mesh.vertices.size() / 16384 + 1);
+    std::vector<candidateErrors> errors(jobs);
+    size_t count = mesh.vertices.size();
+    pool.parallelFor(jobs, [&](int job) {
+        candidateErrors e;
+        for (size_t i = count * job / jobs; i < count * (job + 1) / jobs; i++) {
+            const meshVertex& v = mesh.vertices[i];
+            glm::vec3 relative = (v.position - offset) / scale;
+            glm::vec3 snorm(fromSnorm16(snorm16(relative.x)), fromSnorm16(snorm16(relative.y)), fromSnorm16(snorm16(relative.z)));
+            e.snormPosition = std::max(e.snormPosition, glm::length(snorm * scale + offset - v.position) / unit);
+            glm::vec3 half(glm::unpackHalf1x16(glm::packHalf1x16(v.position.x)), glm::unpackHalf1x16(glm::packHalf1x16(v.position.y)),
+                           glm::unpackHalf1x16(glm::packHalf1x16(v.position.z)));
+            e.halfPosition = std::max(e.halfPosition, glm::length(half - v.position) / unit);
+
+            glm::vec3 n = unitNormal(v.normal);
+            glm::vec3 packedNormal = glm::vec3(glm::unpackSnorm3x10_1x2(glm::packSnorm3x10_1x2(glm::vec4(n, 0.0f))));
+            e.packedNormal = std::max(e.packedNormal, degreesBetween(n, unitNormal(packedNormal)));
+            std::int16_t oct[2];
+            octEncode(n, oct);
+            e.octNormal = std::max(e.octNormal, degreesBetween(n, octDecode(glm::vec2(fromSnorm16(oct[0]), fromSnorm16(oct[1])))));
+
+            glm::vec2 uv(glm::unpackHalf1x16(glm::packHalf1x16(v.uv.x)), glm::unpackHalf1x16(glm::packHalf1x16(v.uv.y)));
+            glm::vec2 du = glm::abs(uv - v.uv);
+            e.halfUV = std::max(e.halfUV, std::max(du.x, du.y));
+        }
+        errors[job] = e;
+    });
+    candidateErrors worst;
+    for (const candidateErrors& e : errors) {
+        worst.snormPosition = std::max(worst.snormPosition, e.snormPosition);
+        worst.halfPosition = std::max(worst.halfPosition, e.halfPosition);
+        worst.packedNormal = std::max(worst.packedNormal, e.packedNormal);
+        worst.octNormal = std::max(worst.octNormal, e.octNormal);
+        worst.halfUV = std::max(worst.halfUV, e.halfUV);
+    }
+
+    // the smallest of each that's good enough.  The 10 bit normals come before octahedral
+    // ones of the same size because a shader can use them as they are
+    positionFormat positions = positionFormat::float32;
+    if (!settings.halfPositions && worst.snormPosition < settings.positionError)
+        positions = positionFormat::snorm16, packed.positionError = worst.snormPosition;
+    else if (settings.halfPositions && worst.halfPosition < settings.positionError)
+        positions = positionFormat::float16, packed.positionError = worst.halfPosition;
+    normalFormat normals = normalFormat::float32;
+    if (worst.packedNormal < settings.normalError)
+        normals = normalFormat::packed, packed.normalError = worst.packedNormal;
+    else if (worst.octNormal < settings.normalError)
+        normals = normalFormat::octahedral, packed.normalError = worst.octNormal;
+    uvFormat uvs = !mesh.hasUVs ? uvFormat::none : worst.halfUV < settings.uvError ? uvFormat::float16 : uvFormat::float32;
+    if (uvs == uvFormat::float16)
+        packed.uvError = worst.halfUV;
+
+    if (positions == positionFormat::snorm16) {
+        packed.positionOffset = offset;
+        packed.positionScale = scale;
+    }
+
+    vertexLayout& layout = packed.layout;
+    auto add = [&](std::uint8_t location, componentType type, std::uint8_t components, bool normalized) {
+        vertexAttribute a = { location, type, components, (std::uint8_t)normalized, layout.stride };
+        layout.attributes.push_back(a);
+        layout.stride += attributeBytes(a);
+    };
+    switch (positions) {
+    case positionFormat::snorm16: add(positionAttribute, componentType::int16, 4, true); break;
+    case positionFormat::float16: add(positionAttribute, componentType::float16, 4, false); break;
+    case positionFormat::float32: add(positionAttribute, componentType::float32, 3, false); break;
+    }
+    switch (normals) {
+    case normalFormat::packed: add(normalAttribute, componentType::int2_10_10_10, 4, true); break;
+    case normalFormat::octahedral: add(normalAttribute, componentType::int16, 2, true); break;
+    case normalFormat::float32: add(normalAttribute, componentType::float32, 3, false); break;
+    }
+    if (uvs == uvFormat::float16)
+        add(uvAttribute, componentType::float16, 2, false);
+    else if (uvs == uvFormat::float32)
+        add(uvAttribute, componentType::float32, 2, false);
+
+    packed.data.resize(count * layout.stride);
+    const vertexAttribute* pa = layout.find(positionAttribute);
+    const vertexAttribute* na = layout.find(normalAttribute);
+    const vertexAttribute* ua = layout.find(uvAttribute);
+    pool.parallelFor(jobs, [&](int job) {
+        for (size_t i = count * job / jobs; i < count * (job + 1) / jobs; i++) {
+            const meshVertex& v = mesh.vertices[i];
+            unsigned char* out = packed.data.data() + i * layout.stride;
+
+            if (positions == positionFormat::snorm16) {
+                glm::vec3 relative = (v.position - offset) / scale;
+                std::int16_t q[4] = { snorm16(relative.x), snorm16(relative.y), snorm16(relative.z), 32767 };
+                memcpy(out + pa->offset, q, sizeof(q));
+            }
+            else if (positions == positionFormat::float16) {
+                std::uint16_t h[4] = { glm::packHalf1x16(v.position.x), glm::packHalf1x16(v.position.y),
+                                       glm::packHalf1x16(v.position.z), glm::packHalf1x16(1.0f) };
+                memcpy(out + pa->offset, h, sizeof(h));
+            }
+            else
+                memcpy(out + pa->offset, &v.position, sizeof(v.position));
+
+            if (normals == normalFormat::packed) {
+                std::uint32_t p = glm::packSnorm3x10_1x2(glm::vec4(unitNormal(v.normal), 0.0f));
+                memcpy(out + na->offset, &p, sizeof(p));
+            }
+            else if (normals == normalFormat::octahedral) {
+                std::int16_t oct[2];
+                octEncode(unitNormal(v.normal), oct);
+                memcpy(out + na->offset, oct, sizeof(oct));
+            }
+            else
+                memcpy(out + na->offset, &v.normal, sizeof(v.normal));
+
+            if (uvs == uvFormat::float16) {
+                std::uint16_t h[2] = { glm::packHalf1x16(v.uv.x), glm::packHalf1x16(v.uv.y) };
+                memcpy(out + ua->offset, h, sizeof(h));
+            }
+            else if (uvs == uvFormat::float32)
+                memcpy(out + ua->offset, &v.uv, sizeof(v.uv));
+        }
+    });
+    return packed;
+}
+
+bool unpackVertices(const vertexLayout& layout, const unsigned char* data, size_t count, glm::vec3 positionOffset,
+                    float positionScale, meshVertexBuffer& vertices)
+{
+    for (const vertexAttribute& a : layout.attributes)
+        if (attributeBytes(a) == 0 || a.offset + attributeBytes(a) > layout.stride
+            || (a.type == componentType::int2_10_10_10 && !a.normalized))
+            return false;
+
+    // only when there is one, so float positions come back exactly (-0 and all)
+    bool transformed = positionScale != 1.0f || positionOffset != glm::vec3(0.0f);
+    vertices.assign(count, meshVertex{ glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec2(0.0f) });
+    for (size_t i = 0; i < count; i++) {
+        const unsigned char* in = data + i * layout.stride;
+        meshVertex& v = vertices[i];
+        for (const vertexAttribute& a : layout.attributes) {
+            glm::vec4 c(0.0f);
+            const unsigned char* at = in + a.offset;
+            if (a.type == componentType::int2_10_10_10) {
+                std::uint32_t p;
+                memcpy(&p, at, 4);
+                c = glm::unpackSnorm3x10_1x2(p);
+            }
+            else
+                for (int k = 0; k < a.components; k++)
+                    switch (a.type) {
+                    case componentType::float32: memcpy(&c[k], at + k * 4, 4); break;
+                    case componentType::float16: {
+                        std::uint16_t h;
+                        memcpy(&h, at + k * 2, 2);
+                        c[k] = glm::unpackHalf1x16(h);
+                        break;
+                    }
+                    case componentType::int16: {
+                        std::int16_t i16;
+                        memcpy(&i16, at + k * 2, 2);
+                        c[k] = a.normalized ? fromSnorm16(i16) : (float)i16;
+                        break;
+                    }
+                    case componentType::int2_10_10_10: break;
+                    }
+
+            if (a.location == positionAttribute)
+                v.position = transformed ? glm::vec3(c) * positionScale + positionOffset : glm::vec3(c);
+            else if (a.location == normalAttribute)
+                // floats as they are, so a lossless mesh comes back exactly
+                v.normal = a.components == 2 ? octDecode(glm::vec2(c))
+                         : a.type == componentType::float32 ? glm::vec3(c) : unitNormal(glm::vec3(c));
+            else if (a.location == uvAttribute)
+                v.uv = glm::vec2(c);
+        }
+    }
+    return true;
+}
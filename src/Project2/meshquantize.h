@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "cpumesh.h"
+#include "threadpool.h"
+#include "vertexlayout.h"
+
+// How far quantizing a mesh's vertices may move them.  Each attribute gets the smallest
+// format that stays under its bound, measured over every vertex of the mesh rather than
+// guessed, and full floats when nothing smaller does (so all 0 is lossless).
+struct quantizeSettings {
+    float positionError = 1.0f / 10000.0f; // distance, as a fraction of the mesh's largest side
+    float normalError = 0.5f;              // angle, in degrees
+    float uvError = 1.0f / 2048.0f;        // in texture coordinates, 1/2048 is half a texel of a 1024 texture
+    bool halfPositions = false;            // half floats rather than snorm16 for positions
+
+    static quantizeSettings lossless()
+    {
+        quantizeSettings settings;
+        settings.positionError = settings.normalError = settings.uvError = 0.0f;
+        return settings;
+    }
+};
+
+// A cpuMesh's vertices, interleaved in the smallest layout quantizeSettings allows.  What
+// can be picked, smallest first:
+//
+//   position  4 x snorm16 (w is 1) of the position relative to the bounds, which the model
+//             matrix has to undo: the shader's position is stored * positionScale +
+//             positionOffset (see positionTransform()).  Or 4 x half float of the position
+//             as it is, with halfPositions.  Or 3 x float.
+//   normal    4 x 10 bit snorm xyz in one int 2_10_10_10 (w unused), which a shader reads as
+//             a vec3 like any other normal.  Or octahedral in 2 x snorm16, where a normal with
+//             two components is always octahedral and the shader unfolds it:
+//                 vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+//                 if (n.z < 0.0) n.xy = (1.0 - abs(n.yx)) * sign(n.xy);
+//                 n = normalize(n);
+//             Or 3 x float.
+//   uv        2 x half float, or 2 x float.  Left out altogether when the mesh has no UVs,
+//             GL reads a disabled attribute as 0.
+//
+// The usual result is 16 bytes a vertex against meshVertex's 32, 12 without UVs.
+struct packedVertices {
+    vertexLayout layout;
+    std::vector<unsigned char> data;
+    size_t count = 0;
+    glm::vec3 positionOffset = glm::vec3(0.0f);
+    float positionScale = 1.0f;
+    // the largest errors actually made, in quantizeSettings' units
+    float positionError = 0.0f, normalError = 0.0f, uvError = 0.0f;
+
+    glm::mat4 positionTransform() const;
+};
+
+packedVertices packVertices(const cpuMesh& mesh, const quantizeSettings& settings = quantizeSettings(),
+                            threadPool& pool = threadPool::shared());
+
+// back to meshVertex from any layout packVertices makes (and plain meshVertexLayout()).
+// False if the layout has something it doesn't know
+bool unpackVertices(const vertexLayout& layout, const unsigned char* data, size_t count, glm::vec3 positionOffset,
+                    float positionScale, meshVertexBuffer& vertices);
+
+// the model matrix part that takes stored positions back to the mesh's own
+inline glm::mat4 positionTransform(glm::vec3 positionOffset, float positionScale)
+{
+    glm::mat4 m(positionScale);
+    m[3] = glm::vec4(positionOffset, 1.0f);
+    return m;
+}
+
+inline glm::mat4 packedVertices::positionTransform() const
+{
+    return ::positionTransform(positionOffset, positionScale);
+}
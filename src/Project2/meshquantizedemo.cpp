@@ -0,0 +1,62 @@
+//
+// the vertex quantization demo (see meshquantize.h)
+//
+
+#include "demos.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "depthraster.h"
+#include "meshquantize.h"
+
+int myMeshQuantize(threadPool& pool)
+{
+    // the same torus quantized twice and unpacked again: on the left the default bounds
+    // (snorm16 positions, 10 bit normals, half float uvs), on the right tight enough on the
+    // normals to need octahedral ones, and half float positions.  Lit by the normals and
+    // checkered by the uvs, so any of them coming back wrong shows
+    cpuMesh mesh = torusMesh(96, 48);
+    quantizeSettings tight;
+    tight.normalError = 0.05f;
+    tight.halfPositions = true;
+    tight.positionError = 0.001f;
+    packedVertices packed[2] = { packVertices(mesh, quantizeSettings(), pool), packVertices(mesh, tight, pool) };
+
+    std::vector<unsigned int> indices;
+    std::vector<glm::vec3> positions, colors;
+    glm::vec3 light = glm::normalize(glm::vec3(0.3f, 1.0f, 0.6f));
+    for (int side = 0; side < 2; side++) {
+        meshVertexBuffer vertices;
+        if (!unpackVertices(packed[side].layout, packed[side].data.data(), packed[side].count, packed[side].positionOffset,
+                            packed[side].positionScale, vertices)) {
+            std::cout << "mesh quantize: can't unpack\n";
+            return 1;
+        }
+        unsigned int first = (unsigned int)positions.size();
+        for (const meshVertex& v : vertices) {
+            bool checker = ((int)(v.uv.x * 24.0f + 0.5f) + (int)(v.uv.y * 12.0f + 0.5f)) & 1;
+            glm::vec3 tint = checker ? glm::vec3(0.95f, 0.75f, 0.3f) : glm::vec3(0.3f, 0.5f, 0.9f);
+            positions.push_back(v.position + glm::vec3(side ? 0.9f : -0.9f, 0.0f, 0.0f));
+            colors.push_back(tint * (0.3f + 0.7f * std::max(0.0f, glm::dot(v.normal, light))));
+        }
+        for (unsigned int index : mesh.indices)
+            indices.push_back(first + index);
+    }
+
+    glm::mat4 proj = glm::perspective(1.0472f, 1.0f, 0.1f, 100.0f);
+    glm::mat4 view = glm::rotate(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -3.0f)), 0.9f, glm::vec3(1.0f, 0.0f, 0.0f));
+
+    memset(imageBuff, 0, sizeof(imageBuff));
+    depthBuffer depth(imageBuffer());
+    depthRasterizer raster(imageBuffer(), depth);
+    raster.drawTriangles(positions.data(), colors.data(), indices.data(), (int)indices.size(), proj * view, pool);
+
+    for (const packedVertices& p : packed)
+        std::cout << "mesh quantize: " << p.layout.stride << " bytes a vertex against " << sizeof(meshVertex) << ", errors: position "
+            << p.positionError << " of its size, normal " << p.normalError << " degrees, uv " << p.uvError << "\n";
+    return 0;
+}
@@ -0,0 +1,214 @@
+#pragma once
+
+#include <cstddef>
+#include <utility>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "renderer.h"
+#include "cpumesh.h"
+#include "meshfile.h"
+#include "meshlets.h"
+#include "meshlod.h"
+#include "vertexarray.h"
+
+// Any mesh drawn like QuadRenderer draws its quad: one VAO with the interleaved vertices
+// and the index buffer, and renderer::render() issuing a single glDrawElements for the
+// lot.  The attributes are at the locations a shader would ask for them with
+// layout (location = N):
+//   0  vec3 position
+//   1  vec3 normal
+//   2  vec2 uv
+// so data/vertex.lgsl, which only takes location 0, works with it as it is.  The VAO only
+// switches on what the shader reads (see vertexarray.h).
+//
+// It can be made from a cpuMesh (see meshimport.h) or a meshFile, which goes to GL
+// straight from the file's mapping in whatever quantized layout it has (the model matrix
+// takes in the file's position transform).  Either can go away once the renderer has been made,
+// GL has its own copy.
+//
+// The LODs, if the mesh has them, go in the same element buffer after the full mesh.
+// selectLod() once a frame picks the one render() draws (see meshlod.h).  When that's
+// the full mesh and it has meshlets, cullMeshlets() after it leaves render() only the
+// ones that can be seen (see meshlets.h).
+//
+// With separatePositions the positions go in a buffer of their own and everything else
+// in another, rather than all interleaved in one: a pass that only needs positions (a
+// depth pre-pass, shadows) then reads a third or less of the bytes for each vertex, at
+// the cost of a second fetch for passes that need the lot.  renderDepth() is such a pass:
+// it draws from a second VAO that has the position attribute and nothing else, out of
+// the position buffer when it has one of its own and out of the interleaved vertices
+// (the whole stride a vertex) when it hasn't.
+class MeshRenderer : public renderer {
+public:
+    MeshRenderer(Shader* shader, const cpuMesh& mesh, glm::mat4 m, bool separatePositions = false)
+    {
+        meshIndexBuffer indices = mesh.indices;
+        indices.insert(indices.end(), mesh.lodIndices.begin(), mesh.lodIndices.end());
+        setup(shader, m, meshVertexLayout(), mesh.vertices.data(), mesh.vertices.size(), separatePositions, indices.data(),
+              indices.size());
+        setupLods(mesh.indices.size(), mesh.lods, mesh.boundsMin, mesh.boundsMax, glm::mat4(1.0f));
+        setupMeshlets(mesh.meshlets, glm::mat4(1.0f));
+    }
+
+    MeshRenderer(Shader* shader, const meshFile& mesh, glm::mat4 m, bool separatePositions = false)
+    {
+        setup(shader, m * mesh.positionTransform(), mesh.layout(), mesh.vertexData(), mesh.vertexCount(), separatePositions,
+              mesh.indexData(), mesh.indexCount() + mesh.lodIndexCount());
+        setupLods(mesh.indexCount(), mesh.lods(), mesh.boundsMin(), mesh.boundsMax(), mesh.positionTransform());
+        setupMeshlets(mesh.meshlets(), mesh.positionTransform());
+    }
+
+    ~MeshRenderer()
+    {
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteVertexArrays(1, &depthVAO);
+        glDeleteBuffers((GLsizei)vertexBuffers.size(), vertexBuffers.data());
+        glDeleteBuffers(1, &EBO);
+    }
+
+    MeshRenderer(const MeshRenderer&) = delete;
+    MeshRenderer& operator=(const MeshRenderer&) = delete;
+
+    // pick this frame's LOD from the mesh's size on screen, for a viewport 'viewportHeight'
+    // pixels high; 0 is the full mesh.  It stays as it was near the switching points, so
+    // call it every frame rather than now and then
+    int selectLod(const glm::mat4& vMat, const glm::mat4& pMat, float viewportHeight, float pixelError = 1.0f)
+    {
+        float pixelsPerUnit = lodPixelsPerUnit(modelMatrix, vMat, pMat, viewportHeight, sphereCenter, sphereRadius);
+        lod = ::selectLod(lodErrors.data(), (int)lodErrors.size(), pixelsPerUnit, lod, pixelError);
+        firstIndex = lodRanges[lod].firstIndex;
+        indexCount = lodRanges[lod].indexCount;
+        return lod;
+    }
+
+    int lodCount() const { return (int)lodErrors.size(); }
+    int currentLod() const { return lod; }
+
+    // throw away the meshlets this frame's camera can't see, if the full mesh is what's
+    // being drawn (call it after selectLod).  False, with everything drawn as usual, when
+    // it isn't or the mesh has no meshlets
+    bool cullMeshlets(const glm::mat4& vMat, const glm::mat4& pMat, meshletCullStats* stats = nullptr)
+    {
+        multiDraw = lod == 0 && !meshlets.empty();
+        if (!multiDraw)
+            return false;
+        ::cullMeshlets(meshlets.data(), meshlets.size(), modelMatrix, vMat, pMat, visible, stats);
+        drawCounts.clear();
+        drawOffsets.clear();
+        for (const meshletDraw& range : visible) {
+            drawCounts.push_back((GLsizei)range.indexCount);
+            drawOffsets.push_back((const void*)(range.firstIndex * sizeof(unsigned int)));
+        }
+        return true;
+    }
+
+    // a depth pre-pass: the same triangles as render(), with only the positions fetched and
+    // no color written.  The shader should only need positions too (data/vertex.lgsl does);
+    // render() after it with glDepthFunc(GL_LEQUAL) then shades only what is in front
+    void renderDepth(glm::mat4 vMat, glm::mat4 pMat)
+    {
+        std::swap(VAO, depthVAO);
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        render(vMat, pMat, 0.0);
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        std::swap(VAO, depthVAO);
+    }
+
+    size_t meshletCount() const { return meshlets.size(); }
+    int vertexStreamCount() const { return (int)vertexBuffers.size(); }
+
+private:
+    // the LOD ranges (the full mesh first) in the element buffer, and the bounding sphere
+    // and errors in the units the vertices are stored in, which is what modelMatrix takes
+    std::vector<meshLod> lodRanges;
+    std::vector<float> lodErrors;
+    glm::vec3 sphereCenter = glm::vec3(0.0f);
+    float sphereRadius = 0.0f;
+    int lod = 0;
+    // the meshlets, their bounds in the stored units too, and the ranges left this frame
+    std::vector<meshlet> meshlets;
+    std::vector<meshletDraw> visible;
+    // a buffer for each vertex stream, VBO is the first, which has the positions
+    std::vector<unsigned int> vertexBuffers;
+    unsigned int depthVAO = 0; // just the positions, for renderDepth()
+
+    void setupLods(size_t fullCount, const std::vector<meshLod>& lods, glm::vec3 boundsMin, glm::vec3 boundsMax,
+                   const glm::mat4& positionTransform)
+    {
+        glm::mat4 toStored = glm::inverse(positionTransform);
+        float scale = positionTransform[0][0];
+        sphereCenter = glm::vec3(toStored * glm::vec4((boundsMin + boundsMax) * 0.5f, 1.0f));
+        sphereRadius = glm::length(boundsMax - boundsMin) * 0.5f / scale;
+
+        meshLod full;
+        full.indexCount = (unsigned int)fullCount;
+        lodRanges = { full };
+        for (meshLod range : lods) {
+            lodErrors.push_back(range.error / scale);
+            range.firstIndex += (unsigned int)fullCount;
+            lodRanges.push_back(range);
+        }
+        indexCount = (unsigned int)fullCount;
+    }
+
+    void setupMeshlets(const std::vector<meshlet>& clusters, const glm::mat4& positionTransform)
+    {
+        glm::mat4 toStored = glm::inverse(positionTransform);
+        float scale = positionTransform[0][0];
+        meshlets = clusters;
+        for (meshlet& m : meshlets) {
+            m.center = glm::vec3(toStored * glm::vec4(m.center, 1.0f));
+            m.coneApex = glm::vec3(toStored * glm::vec4(m.coneApex, 1.0f));
+            m.radius /= scale;
+        }
+    }
+
+    void setup(Shader* shader, glm::mat4 m, const vertexLayout& layout, const void* vertices, size_t vertexCount,
+               bool separatePositions, const unsigned int* indices, size_t count)
+    {
+        modelMatrix = m;
+        myShader = shader;
+
+        std::vector<vertexStream> streams = layoutStreams(layout, separatePositions ? positionAttribute : -1);
+        vertexBuffers.resize(streams.size());
+        glGenBuffers((GLsizei)vertexBuffers.size(), vertexBuffers.data());
+        VBO = vertexBuffers[0];
+        for (size_t s = 0; s < streams.size(); s++) {
+            glBindBuffer(GL_ARRAY_BUFFER, vertexBuffers[s]);
+            if (streams.size() == 1)
+                glBufferData(GL_ARRAY_BUFFER, vertexCount * layout.stride, vertices, GL_STATIC_DRAW);
+            else {
+                std::vector<unsigned char> data = gatherStream(layout, vertices, vertexCount, streams[s].layout);
+                glBufferData(GL_ARRAY_BUFFER, data.size(), data.data(), GL_STATIC_DRAW);
+            }
+        }
+
+        // filled through GL_ARRAY_BUFFER, there's no VAO to bind it to as elements yet
+        glGenBuffers(1, &EBO);
+        glBindBuffer(GL_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ARRAY_BUFFER, count * sizeof(unsigned int), indices, GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        indexCount = (unsigned int)count;
+
+        VAO = createVertexArray(shader->ID, streams, vertexBuffers.data(), EBO);
+
+        // stream 0 has the positions either way; keep its stride, drop the rest
+        vertexStream positions = streams[0];
+        positions.layout.attributes.clear();
+        if (const vertexAttribute* a = streams[0].layout.find(positionAttribute))
+            positions.layout.attributes.push_back(*a);
+        depthVAO = createVertexArray(0, { positions }, vertexBuffers.data(), EBO);
+    }
+};
+
+// a model matrix that puts a mesh in a box 'size' across, centred on the origin
+inline glm::mat4 fitToBox(glm::vec3 boundsMin, glm::vec3 boundsMax, float size = 1.0f)
+{
+    glm::vec3 extent = boundsMax - boundsMin;
+    float largest = glm::max(extent.x, glm::max(extent.y, extent.z));
+    float s = largest > 0.0f ? size / largest : 1.0f;
+    return glm::translate(glm::scale(glm::mat4(1.0f), glm::vec3(s)), -(boundsMin + boundsMax) * 0.5f);
+}
@@ -0,0 +1,335 @@
+//
+// quadric error mesh simplification and LOD chains (see meshsimplify.h)
+//
+
+#include "meshsimplify.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+
+namespace {
+
+// the sum of the squared distances to some planes, as the symmetric 4x4 matrix of
+// Garland and Heckbert, and the total weight (area) of the planes so the error comes out
+// as a squared distance however many went in
+struct quadric {
+    double a00 = 0, a01 = 0, a02 = 0, a03 = 0, a11 = 0, a12 = 0, a13 = 0, a22 = 0, a23 = 0, a33 = 0;
+    double weight = 0;
+
+    void addPlane(glm::dvec3 n, double d, double w)
+    {
+        a00 += w * n.x * n.x; a01 += w * n.x * n.y; a02 += w * n.x * n.z; a03 += w * n.x * d;
+        a11 += w * n.y * n.y; a12 += w * n.y * n.z; a13 += w * n.y * d;
+        a22 += w * n.z * n.z; a23 += w * n.z * d;
+        a33 += w * d * d;
+        weight += w;
+    }
+
+    quadric& operator+=(const quadric& q)
+    {
+        a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03; a11 += q.a11; a12 += q.a12; a13 += q.a13;
+        a22 += q.a22; a23 += q.a23; a33 += q.a33;
+        weight += q.weight;
+        return *this;
+    }
+
+    // the weighted sum of squared distances
+    double sum(glm::dvec3 p) const
+    {
+        return a00 * p.x * p.x + a11 * p.y * p.y + a22 * p.z * p.z + a33
+             + 2.0 * (a01 * p.x * p.y + a02 * p.x * p.z + a12 * p.y * p.z + a03 * p.x + a13 * p.y + a23 * p.z);
+    }
+};
+
+// the squared distance from the planes of two quadrics together
+double collapseError(const quadric& a, const quadric& b, glm::dvec3 p)
+{
+    double weight = a.weight + b.weight;
+    return weight > 0 ? std::max(a.sum(p) + b.sum(p), 0.0) / weight : 0.0;
+}
+
+enum vertexKind : char { manifoldVertex, borderVertex, lockedVertex };
+
+struct positionKey {
+    std::uint32_t x, y, z;
+    bool operator==(const positionKey& k) const { return x == k.x && y == k.y && z == k.z; }
+};
+
+struct positionHash {
+    size_t operator()(const positionKey& k) const
+    {
+        return (size_t)(k.x * 73856093u ^ k.y * 19349663u ^ k.z * 83492791u);
+    }
+};
+
+struct collapse {
+    unsigned int from, to;  // positions
+    unsigned int toVertex;  // the vertex 'from's corners become
+    double cost;
+    bool border;
+};
+
+} // namespace
+
+std::vector<unsigned int> simplifyMesh(const cpuMesh& mesh, const std::vector<unsigned int>& indices,
+                                       size_t targetIndexCount, float maxError, threadPool& pool, float* error)
+{
+    size_t vertexCount = mesh.vertices.size();
+    size_t targetTriangles = targetIndexCount / 3;
+    double worst = 0.0;
+
+    // vertices at the same place are one position; a position is known by its first vertex
+    std::vector<unsigned int> position(vertexCount);
+    std::vector<char> kind(vertexCount, manifoldVertex);
+    {
+        std::unordered_map<positionKey, unsigned int, positionHash> first;
+        first.reserve(vertexCount);
+        for (unsigned int v = 0; v < vertexCount; v++) {
+            positionKey key;
+            memcpy(&key, &mesh.vertices[v].position, sizeof(key));
+            auto found = first.emplace(key, v);
+            position[v] = found.first->second;
+            if (!found.second)
+                kind[position[v]] = lockedVertex; // a seam
+        }
+    }
+
+    // positions on the border between subMeshes stay where they are
+    {
+        std::vector<int> part(vertexCount, -1);
+        for (size_t p = 0; p < mesh.subMeshes.size(); p++) {
+            const subMesh& range = mesh.subMeshes[p];
+            for (size_t i = range.firstIndex; i < (size_t)range.firstIndex + range.indexCount && i < mesh.indices.size(); i++) {
+                int& seen = part[position[mesh.indices[i]]];
+                if (seen >= 0 && seen != (int)p)
+                    kind[position[mesh.indices[i]]] = lockedVertex;
+                seen = (int)p;
+            }
+        }
+    }
+
+    // the triangles around each position, made again after each pass
+    std::vector<unsigned int> triangles(indices.begin(), indices.begin() + indices.size() / 3 * 3);
+    std::vector<unsigned int> first(vertexCount + 1), around;
+    auto findAround = [&]() {
+        std::fill(first.begin(), first.end(), 0);
+        for (unsigned int v : triangles)
+            first[position[v] + 1]++;
+        for (size_t p = 0; p < vertexCount; p++)
+            first[p + 1] += first[p];
+        around.resize(triangles.size());
+        std::vector<unsigned int> fill(first.begin(), first.end() - 1);
+        for (size_t i = 0; i < triangles.size(); i++)
+            around[fill[position[triangles[i]]]++] = (unsigned int)(i / 3);
+    };
+    // how many triangles use the edge a-b: one on the border, more than two is trouble
+    auto edgeUses = [&](unsigned int a, unsigned int b) {
+        int uses = 0;
+        for (unsigned int k = first[a]; k < first[a + 1]; k++) {
+            const unsigned int* tri = &triangles[around[k] * 3];
+            uses += position[tri[0]] == b || position[tri[1]] == b || position[tri[2]] == b;
+        }
+        return uses;
+    };
+
+    findAround();
+    {
+        std::vector<int> borderEdges(vertexCount, 0);
+        for (size_t t = 0; t < triangles.size(); t += 3)
+            for (int e = 0; e < 3; e++) {
+                unsigned int a = position[triangles[t + e]], b = position[triangles[t + (e + 1) % 3]];
+                int uses = edgeUses(a, b);
+                if (uses > 2)
+                    kind[a] = kind[b] = lockedVertex;
+                else if (uses == 1)
+                    borderEdges[a]++, borderEdges[b]++;
+            }
+        for (size_t p = 0; p < vertexCount; p++)
+            if (borderEdges[p] && kind[p] != lockedVertex)
+                kind[p] = borderEdges[p] == 2 ? borderVertex : lockedVertex;
+    }
+
+    // each position's quadric: the planes of its triangles, and for the border planes
+    // standing up along the open edges so it stays put
+    std::vector<quadric> quadrics(vertexCount);
+    auto at = [&](unsigned int v) { return glm::dvec3(mesh.vertices[v].position); };
+    for (size_t t = 0; t < triangles.size(); t += 3) {
+        glm::dvec3 a = at(triangles[t]), b = at(triangles[t + 1]), c = at(triangles[t + 2]);
+        glm::dvec3 n = glm::cross(b - a, c - a);
+        double area = glm::length(n);
+        if (area == 0.0)
+            continue;
+        n /= area;
+        quadric q;
+        q.addPlane(n, -glm::dot(n, a), area * 0.5);
+        for (int k = 0; k < 3; k++)
+            quadrics[position[triangles[t + k]]] += q;
+
+        for (int e = 0; e < 3; e++) {
+            unsigned int p0 = position[triangles[t + e]], p1 = position[triangles[t + (e + 1) % 3]];
+            if (edgeUses(p0, p1) != 1)
+                continue;
+            glm::dvec3 e0 = at(p0), e1 = at(p1);
+            glm::dvec3 side = glm::cross(e1 - e0, n);
+            double length = glm::length(side);
+            if (length == 0.0)
+                continue;
+            side /= length;
+            quadric border;
+            border.addPlane(side, -glm::dot(side, e0), glm::dot(e1 - e0, e1 - e0) * 10.0);
+            border.weight = 0.0; // stiffer, without diluting the surface's own error
+            quadrics[p0] += border;
+            quadrics[p1] += border;
+        }
+    }
+
+    std::vector<unsigned int> collapsedTo(vertexCount), cornerTarget(vertexCount);
+    for (unsigned int p = 0; p < vertexCount; p++)
+        collapsedTo[p] = p;
+    double limit = (double)maxError * maxError;
+
+    std::vector<collapse> candidates;
+    std::vector<std::vector<collapse>> found;
+    std::vector<char> touched(vertexCount);
+
+    while (triangles.size() / 3 > targetTriangles) {
+        // the cheaper way round of every edge that can go, a band of triangles per job.  The
+        // bands are put back together in order, so the sort sees what one thread would give it
+        size_t triangleCount = triangles.size() / 3;
+        int bands = (int)std::min<size_t>(pool.size() * 4, (triangleCount + 4095) / 4096);
+        found.resize(bands);
+        pool.parallelFor(bands, [&](int band) {
+            std::vector<collapse>& out = found[band];
+            out.clear();
+            for (size_t t = triangleCount * band / bands * 3; t < triangleCount * (band + 1) / bands * 3; t += 3)
+                for (int e = 0; e < 3; e++) {
+                    unsigned int va = triangles[t + e], vb = triangles[t + (e + 1) % 3];
+                    unsigned int a = position[va], b = position[vb];
+                    // inside edges turn up twice, once each way round
+                    bool border = edgeUses(a, b) == 1;
+                    if (a > b && !border)
+                        continue;
+                    auto allowed = [&](unsigned int from, unsigned int to) {
+                        if (kind[from] == manifoldVertex)
+                            return !border;
+                        return kind[from] == borderVertex && border && kind[to] != manifoldVertex;
+                    };
+                    auto cost = [&](unsigned int from, unsigned int to) { return collapseError(quadrics[from], quadrics[to], at(to)); };
+                    collapse best = { 0, 0, 0, -1.0, border };
+                    if (allowed(a, b))
+                        best = { a, b, vb, cost(a, b), border };
+                    if (allowed(b, a)) {
+                        double back = cost(b, a);
+                        if (best.cost < 0.0 || back < best.cost)
+                            best = { b, a, va, back, border };
+                    }
+                    if (best.cost >= 0.0)
+                        out.push_back(best);
+                }
+        });
+        candidates.clear();
+        for (int band = 0; band < bands; band++)
+            candidates.insert(candidates.end(), found[band].begin(), found[band].end());
+        std::sort(candidates.begin(), candidates.end(), [](const collapse& x, const collapse& y) { return x.cost < y.cost; });
+
+        // as many as can be made without any two sharing a triangle, cheapest first
+        std::fill(touched.begin(), touched.end(), 0);
+        size_t remaining = triangles.size() / 3, made = 0;
+        for (const collapse& c : candidates) {
+            if (c.cost > limit || remaining <= targetTriangles)
+                break;
+            if (touched[c.from] || touched[c.to])
+                continue;
+
+            // the triangles around 'from' all have to agree on which vertex of 'to' they'd
+            // use, and none of the ones that stay can turn over
+            bool ok = true;
+            glm::dvec3 target = at(c.to);
+            for (unsigned int k = first[c.from]; k < first[c.from + 1] && ok; k++) {
+                const unsigned int* tri = &triangles[around[k] * 3];
+                glm::dvec3 p[3];
+                bool hasTo = false;
+                for (int j = 0; j < 3; j++) {
+                    unsigned int pj = position[tri[j]];
+                    if (pj == c.to) {
+                        hasTo = true;
+                        ok = ok && tri[j] == c.toVertex;
+                    }
+                    p[j] = pj == c.from ? target : at(pj);
+                }
+                if (hasTo || !ok)
+                    continue;
+                glm::dvec3 before = glm::cross(at(tri[1]) - at(tri[0]), at(tri[2]) - at(tri[0]));
+                glm::dvec3 after = glm::cross(p[1] - p[0], p[2] - p[0]);
+                ok = glm::dot(before, after) > 1e-2 * glm::length(before) * glm::length(after);
+            }
+            if (!ok)
+                continue;
+
+            collapsedTo[c.from] = c.to;
+            cornerTarget[c.from] = c.toVertex;
+            quadrics[c.to] += quadrics[c.from];
+            worst = std::max(worst, c.cost);
+            for (unsigned int k = first[c.from]; k < first[c.from + 1]; k++)
+                for (int j = 0; j < 3; j++)
+                    touched[position[triangles[around[k] * 3 + j]]] = 1;
+            remaining -= c.border ? 1 : 2;
+            made++;
+        }
+        if (made == 0)
+            break;
+
+        // move the corners of the positions that went and drop the triangles that closed up
+        size_t kept = 0;
+        for (size_t t = 0; t < triangles.size(); t += 3) {
+            unsigned int v[3];
+            for (int j = 0; j < 3; j++) {
+                v[j] = triangles[t + j];
+                while (collapsedTo[position[v[j]]] != position[v[j]])
+                    v[j] = cornerTarget[position[v[j]]];
+            }
+            if (position[v[0]] == position[v[1]] || position[v[1]] == position[v[2]] || position[v[0]] == position[v[2]])
+                continue;
+            triangles[kept++] = v[0];
+            triangles[kept++] = v[1];
+            triangles[kept++] = v[2];
+        }
+        triangles.resize(kept);
+        findAround();
+    }
+
+    if (error)
+        *error = (float)std::sqrt(worst);
+    return triangles;
+}
+
+void generateLods(cpuMesh& mesh, const std::vector<float>& ratios, float maxError, threadPool& pool)
+{
+    mesh.lods.clear();
+    mesh.lodIndices.clear();
+    glm::vec3 extent = mesh.boundsMax - mesh.boundsMin;
+    float size = std::max(extent.x, std::max(extent.y, extent.z));
+
+    std::vector<unsigned int> previous(mesh.indices.begin(), mesh.indices.end());
+    float previousError = 0.0f;
+    for (float ratio : ratios) {
+        size_t target = (size_t)(mesh.triangleCount() * ratio) * 3;
+        float error = 0.0f;
+        std::vector<unsigned int> lod = simplifyMesh(mesh, previous, target, maxError * size, pool, &error);
+        if (lod.empty() || lod.size() > previous.size() * 9 / 10)
+            break;
+
+        // each step's error is on top of the one before's
+        meshLod range;
+        range.firstIndex = (unsigned int)mesh.lodIndices.size();
+        range.indexCount = (unsigned int)lod.size();
+        range.error = previousError + error;
+        mesh.lodIndices.insert(mesh.lodIndices.end(), lod.begin(), lod.end());
+        mesh.lods.push_back(range);
+        previous.swap(lod);
+        previousError = range.error;
+    }
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "cpumesh.h"
+#include "threadpool.h"
+
+// Fewer triangles for the same shape: edges are collapsed, cheapest first, by the quadric
+// error metric (Garland and Heckbert, "Surface Simplification Using Quadric Error
+// Metrics", 1997), each vertex remembering the planes of the triangles that have been
+// folded into it and each collapse costing the squared distance from those planes.
+//
+// A collapse moves one vertex onto another rather than somewhere new, so the result is
+// an index buffer into the mesh's own vertices and every LOD shares them with the full
+// mesh.  Open borders only slide along themselves; vertices on a UV or normal seam (the
+// same position in more than one vertex), between subMeshes or on a non-manifold edge
+// don't move at all.  Triangles that would turn over aren't made, and triangles keep the
+// order and subMesh they had.
+//
+// Collapses are made in passes: every edge is costed, the cheapest that don't touch each
+// other are made, and around again until there are targetIndexCount indices or the next
+// collapse would stray further than maxError (in the mesh's units).  'error', if given,
+// is how far the result strays at worst.  Each pass's edges are costed on the pool.
+std::vector<unsigned int> simplifyMesh(const cpuMesh& mesh, const std::vector<unsigned int>& indices,
+                                       size_t targetIndexCount, float maxError, threadPool& pool = threadPool::shared(),
+                                       float* error = nullptr);
+
+// Fill mesh.lods / mesh.lodIndices with a chain of simpler versions, one for each of
+// 'ratios' of the full mesh's triangles, each made from the one before.  The chain stops
+// early when a step can't get within maxError (a fraction of the mesh's size here) or
+// saves less than a tenth of the triangles.
+void generateLods(cpuMesh& mesh, const std::vector<float>& ratios = { 0.5f, 0.25f, 0.125f, 0.0625f }, float maxError = 0.05f,
+                  threadPool& pool = threadPool::shared());
@@ -0,0 +1,483 @@
+//
+// 4x / 8x multisampled triangles and polygons with an edge pixel only resolve (see msaaraster.h)
+//
+
+#include "msaaraster.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include "cpufeatures.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define G4G_MSAA_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// rows per band, both for drawing in parallel and for the per band sample pools
+constexpr int bandHeight = 32;
+
+// the standard D3D sample positions, in 1/16ths of a pixel from the pixel centre
+const float pattern4[4][2] = { { -2, -6 }, { 6, -2 }, { -6, 2 }, { 2, 6 } };
+const float pattern8[8][2] = { { 1, -3 }, { -1, 3 }, { 5, 1 }, { -3, -5 }, { -5, 5 }, { -7, -1 }, { 3, 7 }, { 7, -7 } };
+
+// one edge of a triangle: w = a*x + b*y + c, inside when w > 0 (or == 0 on a top-left edge)
+// 'offset' holds what each sample adds to w at the pixel centre
+struct edgeEq {
+    float a, b, c;
+    bool topLeft;
+    alignas(16) float offset[8];
+};
+
+// coverage masks of 'count' pixels from x0 along the row through py, for a counter
+// clockwise triangle
+void coverageRow(const edgeEq* e, int x0, int count, float py, int samples, unsigned char* masks)
+{
+    for (int i = 0; i < count; i++) {
+        float px = x0 + i + 0.5f;
+#ifdef G4G_MSAA_SSE2
+        unsigned int mask = 0;
+        for (int group = 0; group < samples; group += 4) {
+            __m128 in = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (int k = 0; k < 3; k++) {
+                __m128 w = _mm_add_ps(_mm_set1_ps(e[k].a * px + e[k].b * py + e[k].c), _mm_load_ps(&e[k].offset[group]));
+                __m128 pass = _mm_cmpgt_ps(w, _mm_setzero_ps());
+                if (e[k].topLeft)
+                    pass = _mm_or_ps(pass, _mm_cmpeq_ps(w, _mm_setzero_ps()));
+                in = _mm_and_ps(in, pass);
+            }
+            mask |= (unsigned int)_mm_movemask_ps(in) << group;
+        }
+#else
+        unsigned int mask = (1u << samples) - 1;
+        for (int k = 0; k < 3; k++) {
+            float centre = e[k].a * px + e[k].b * py + e[k].c;
+            for (int i = 0; i < samples; i++) {
+                float w = centre + e[k].offset[i];
+                if (!(w > 0.0f || (w == 0.0f && e[k].topLeft)))
+                    mask &= ~(1u << i);
+            }
+        }
+#endif
+        masks[i] = (unsigned char)mask;
+    }
+}
+
+#ifdef G4G_AVX2
+// the lowest set bit of v (not 0)
+inline int ctz64(std::uint64_t v)
+{
+#ifdef _MSC_VER
+    unsigned long i;
+    if (_BitScanForward(&i, (unsigned long)v))
+        return (int)i;
+    _BitScanForward(&i, (unsigned long)(v >> 32));
+    return (int)i + 32;
+#else
+    return __builtin_ctzll(v);
+#endif
+}
+
+// eight pixels side by side in each compare, a sample at a time, the same sums as above.
+// The test is on the bits of w: w > 0 is bits > 0, and w >= 0 on a top-left edge is
+// bits > -1 (w is never -0, both offset terms would have to be).  masks needs room for
+// count rounded up to eight.  Returns a bit per pixel with any sample covered
+template <int S>
+G4G_AVX2_TARGET std::uint64_t coverageRowAVX2(const edgeEq* e, int x0, int count, float py, unsigned char* masks)
+{
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256 a[3], rowB[3];
+    __m256i limit[3];
+    for (int k = 0; k < 3; k++) {
+        a[k] = _mm256_set1_ps(e[k].a);
+        rowB[k] = _mm256_set1_ps(e[k].b * py);
+        limit[k] = _mm256_set1_epi32(e[k].topLeft ? -1 : 0);
+    }
+    std::uint64_t hit = 0;
+    for (int i = 0; i < count; i += 8) {
+        __m256 px = _mm256_add_ps(_mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_set1_epi32(x0 + i), lanes)), _mm256_set1_ps(0.5f));
+        __m256 centre[3];
+        for (int k = 0; k < 3; k++)
+            centre[k] = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a[k], px), rowB[k]), _mm256_set1_ps(e[k].c));
+
+        __m256i mask = _mm256_setzero_si256();
+        for (int j = 0; j < S; j++) {
+            __m256i in = _mm256_cmpgt_epi32(_mm256_castps_si256(_mm256_add_ps(centre[0], _mm256_set1_ps(e[0].offset[j]))), limit[0]);
+            for (int k = 1; k < 3; k++)
+                in = _mm256_and_si256(in, _mm256_cmpgt_epi32(_mm256_castps_si256(_mm256_add_ps(centre[k], _mm256_set1_ps(e[k].offset[j]))), limit[k]));
+            mask = _mm256_or_si256(mask, _mm256_and_si256(in, _mm256_set1_epi32(1 << j)));
+        }
+        hit |= (std::uint64_t)(unsigned int)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(mask, _mm256_setzero_si256()))) << i;
+        // eight 32 bit masks down to eight bytes (the packs work within 128 bit halves)
+        __m128i words = _mm_packus_epi32(_mm256_castsi256_si128(mask), _mm256_extracti128_si256(mask, 1));
+        _mm_storel_epi64((__m128i*)(masks + i), _mm_packus_epi16(words, words));
+    }
+    return count == 64 ? hit : hit & ((1ull << count) - 1);
+}
+#endif
+
+inline unsigned int packColor(rgb8 c)
+{
+    return c.r | (unsigned int)c.g << 8 | (unsigned int)c.b << 16;
+}
+
+// samples[i] = c where bit i of mask is set, for s samples
+inline void blendSamples(unsigned int* samples, unsigned int mask, unsigned int c, int s)
+{
+#ifdef G4G_MSAA_SSE2
+    const __m128i color = _mm_set1_epi32((int)c), bits = _mm_setr_epi32(1, 2, 4, 8);
+    for (int group = 0; group < s; group += 4) {
+        __m128i m = _mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32((int)(mask >> group)), bits), bits);
+        __m128i* p = (__m128i*)(samples + group);
+        _mm_storeu_si128(p, _mm_or_si128(_mm_and_si128(m, color), _mm_andnot_si128(m, _mm_loadu_si128(p))));
+    }
+#else
+    for (int i = 0; i < s; i++)
+        if (mask & (1u << i))
+            samples[i] = c;
+#endif
+}
+
+// One row of resolve(), returning how many edge pixels it had.  The single colors go
+// straight across (rgb8 has the same layout as the target), then the edge pixels are
+// written over them, found eight flags at a time.  S is a template parameter and
+// everything sits in locals because the byte stores to out could alias anything else
+template <int S>
+size_t resolveRow(const rgb8* single, const unsigned char* isEdge, const unsigned int* block, const unsigned int* pool,
+                  int cols, unsigned char* out)
+{
+    const int shift = S == 8 ? 3 : 2;
+    size_t edges = 0;
+    memcpy(out, single, (size_t)cols * 3);
+    for (int x = 0; x < cols; x += 8) {
+        std::uint64_t flags = 0;
+        if (x + 8 <= cols) {
+            memcpy(&flags, isEdge + x, 8);
+            if (!flags)
+                continue;
+        }
+        for (int i = x; i < std::min(x + 8, cols); i++) {
+            if (!isEdge[i])
+                continue;
+            // red and blue side by side in 16 bit halves, eight samples can't overflow them
+            unsigned int rb = 0, g = 0;
+            const unsigned int* smp = pool + block[i];
+            for (int k = 0; k < S; k++) {
+                rb += smp[k] & 0x00ff00ffu;
+                g += smp[k] & 0x0000ff00u;
+            }
+            out[i * 3 + 0] = (unsigned char)(((rb & 0xffffu) + S / 2) >> shift);
+            out[i * 3 + 1] = (unsigned char)(((g >> 8) + S / 2) >> shift);
+            out[i * 3 + 2] = (unsigned char)(((rb >> 16) + S / 2) >> shift);
+            edges++;
+        }
+    }
+    return edges;
+}
+
+} // namespace
+
+msaaCanvas::msaaCanvas(int width, int height, int samples)
+    : w(width), h(height), s(samples == 8 ? 8 : 4),
+      fullMask((1u << (samples == 8 ? 8 : 4)) - 1),
+      color((size_t)width * height), edge((size_t)width * height), sampleBlock((size_t)width * height),
+      pools((height + bandHeight - 1) / bandHeight)
+{
+    // room for an eighth of the pixels to be edge pixels before a pool has to grow
+    for (samplePool& pool : pools)
+        pool.colors.resize((size_t)w * bandHeight / 8 * s);
+    clear(rgb8{ 0, 0, 0 });
+}
+
+// sampleBlock is only read for edge pixels, so it never needs clearing
+void msaaCanvas::clear(rgb8 c)
+{
+    std::fill(color.begin(), color.end(), c);
+    std::fill(edge.begin(), edge.end(), 0);
+    for (samplePool& pool : pools)
+        pool.used = 0;
+}
+
+void msaaCanvas::load(pixelBuffer source)
+{
+    for (int y = 0; y < h && y < source.height; y++)
+        for (int x = 0; x < w && x < source.width; x++) {
+            const unsigned char* p = source.at(x, y);
+            color[(size_t)y * w + x] = rgb8{ p[0], p[1], p[2] };
+        }
+    std::fill(edge.begin(), edge.end(), 0);
+    for (samplePool& pool : pools)
+        pool.used = 0;
+}
+
+void msaaCanvas::triangle(glm::vec2 a, glm::vec2 b, glm::vec2 c, rgb8 col)
+{
+    glm::vec2 pts[3] = { a, b, c };
+    polygon(pts, 3, col);
+}
+
+void msaaCanvas::polygon(const glm::vec2* pts, int count, rgb8 col)
+{
+    if (count < 3)
+        return;
+
+    glm::vec2 lo = pts[0], hi = pts[0];
+    for (int i = 1; i < count; i++) {
+        lo = glm::min(lo, pts[i]);
+        hi = glm::max(hi, pts[i]);
+    }
+    // a sample can sit up to half a pixel from the centre
+    shapes.push_back({ (int)points.size(), count, col,
+                       (int)std::floor(lo.x - 0.5f), (int)std::floor(lo.y - 0.5f),
+                       (int)std::ceil(hi.x - 0.5f), (int)std::ceil(hi.y - 0.5f) });
+    points.insert(points.end(), pts, pts + count);
+}
+
+// pool is the pixel's band's, which only the thread drawing that band touches
+void msaaCanvas::write(size_t pixel, unsigned int mask, rgb8 c, samplePool& pool)
+{
+    if (mask == fullMask) {
+        color[pixel] = c;
+        edge[pixel] = 0; // its block is dropped, it gets a fresh one if it turns into an edge pixel again
+        return;
+    }
+
+    if (!edge[pixel]) {
+        if (pool.used + s > pool.colors.size())
+            pool.colors.resize(pool.colors.size() * 2 + s);
+        sampleBlock[pixel] = (unsigned int)pool.used;
+        pool.used += s;
+        std::fill_n(&pool.colors[sampleBlock[pixel]], s, packColor(color[pixel]));
+        edge[pixel] = 1;
+    }
+    blendSamples(&pool.colors[sampleBlock[pixel]], mask, packColor(c), s);
+}
+
+// Walk the rows of one triangle inside [x0,x1] x [y0,y1].  For every row it calls
+// edgePixel(x, y, mask) for pixels that are partly covered and interior(x0, x1, y) for
+// runs of pixels that are covered entirely, so those never compute a mask at all.
+template <typename EdgeFn, typename InteriorFn>
+static void walkTriangle(glm::vec2 v0, glm::vec2 v1, glm::vec2 v2, int samples, int x0, int x1, int y0, int y1,
+                         EdgeFn edgePixel, InteriorFn interior)
+{
+    glm::vec2 v[3] = { v0, v1, v2 };
+    float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[2].x - v[0].x) * (v[1].y - v[0].y);
+    if (area == 0.0f)
+        return;
+    if (area < 0.0f)
+        std::swap(v[1], v[2]);
+
+    const float (*pattern)[2] = samples == 8 ? pattern8 : pattern4;
+#ifdef G4G_AVX2
+    bool avx2 = hasAVX2();
+#endif
+
+    edgeEq e[3];
+    float minOffset[3], maxOffset[3], inverseA[3];
+    for (int k = 0; k < 3; k++) {
+        glm::vec2 a = v[(k + 1) % 3], b = v[(k + 2) % 3];
+        e[k].a = -(b.y - a.y);
+        e[k].b = b.x - a.x;
+        e[k].c = (b.y - a.y) * a.x - (b.x - a.x) * a.y;
+        e[k].topLeft = (b.y < a.y) || (b.y == a.y && b.x < a.x);
+        for (int i = 0; i < 8; i++)
+            e[k].offset[i] = i < samples ? e[k].a * pattern[i][0] / 16.0f + e[k].b * pattern[i][1] / 16.0f : 0.0f;
+        minOffset[k] = *std::min_element(e[k].offset, e[k].offset + samples);
+        maxOffset[k] = *std::max_element(e[k].offset, e[k].offset + samples);
+        inverseA[k] = e[k].a != 0.0f ? -1.0f / e[k].a : 0.0f;
+    }
+
+    glm::vec2 lo = glm::min(glm::min(v[0], v[1]), v[2]), hi = glm::max(glm::max(v[0], v[1]), v[2]);
+    int tx0 = std::max(x0, (int)std::floor(lo.x - 0.5f)), tx1 = std::min(x1, (int)std::ceil(hi.x - 0.5f));
+    int ty0 = std::max(y0, (int)std::floor(lo.y - 0.5f)), ty1 = std::min(y1, (int)std::ceil(hi.y - 0.5f));
+
+    // the partly covered pixels a..b of row y
+    auto edgeRun = [&](int a, int b, int y, float py) {
+        unsigned char masks[64];
+        for (int x = a; x <= b; x += 64) {
+            int count = std::min(64, b - x + 1);
+#ifdef G4G_AVX2
+            if (avx2) {
+                std::uint64_t hit = samples == 8 ? coverageRowAVX2<8>(e, x, count, py, masks)
+                                                 : coverageRowAVX2<4>(e, x, count, py, masks);
+                for (; hit; hit &= hit - 1) {
+                    int i = ctz64(hit);
+                    edgePixel(x + i, y, masks[i]);
+                }
+                continue;
+            }
+#endif
+            coverageRow(e, x, count, py, samples, masks);
+            for (int i = 0; i < count; i++)
+                if (masks[i])
+                    edgePixel(x + i, y, masks[i]);
+        }
+    };
+
+    for (int y = ty0; y <= ty1; y++) {
+        float py = y + 0.5f;
+
+        // per edge, narrow [xa, xb] to pixels where some sample may be inside and
+        // [ia, ib] to pixels where every sample is (shrunk a pixel to stay safe from rounding)
+        float xa = (float)tx0, xb = (float)tx1, ia = (float)tx0, ib = (float)tx1;
+        for (int k = 0; k < 3; k++) {
+            float rowC = e[k].b * py + e[k].c + 0.5f * e[k].a;
+            if (e[k].a > 0.0f) {
+                xa = std::max(xa, std::floor((rowC + maxOffset[k]) * inverseA[k]) - 1.0f);
+                ia = std::max(ia, std::ceil((rowC + minOffset[k]) * inverseA[k]) + 1.0f);
+            }
+            else if (e[k].a < 0.0f) {
+                xb = std::min(xb, std::ceil((rowC + maxOffset[k]) * inverseA[k]) + 1.0f);
+                ib = std::min(ib, std::floor((rowC + minOffset[k]) * inverseA[k]) - 1.0f);
+            }
+            else if (rowC + maxOffset[k] < 0.0f)
+                xa = xb + 1.0f; // the whole row is outside this edge
+            else if (rowC + minOffset[k] <= 0.0f)
+                ia = ib + 1.0f; // no pixel on the row is entirely inside
+        }
+        if (xa > xb)
+            continue;
+
+        int first = (int)xa, last = (int)xb;
+        int full0 = (int)std::min(std::max(ia, xa), xb + 1.0f), full1 = (int)std::max(std::min(ib, xb), xa - 1.0f);
+        if (full0 > full1) {
+            full0 = last + 1; // no interior run on this row
+            full1 = last;
+        }
+
+        edgeRun(first, full0 - 1, y, py);
+        if (full0 <= full1)
+            interior(full0, full1, y);
+        edgeRun(full1 + 1, last, y, py);
+    }
+}
+
+void msaaCanvas::drawShape(const shape& sh, int bandY0, int bandY1, samplePool& pool, std::vector<unsigned char>& masks,
+                           std::vector<glm::ivec2>& touched)
+{
+    int x0 = std::max(sh.x0, 0), x1 = std::min(sh.x1, w - 1);
+    int y0 = std::max(sh.y0, bandY0), y1 = std::min(sh.y1, bandY1);
+    if (x0 > x1 || y0 > y1)
+        return;
+
+    const glm::vec2* pts = &points[sh.first];
+
+    // a lone triangle goes straight to the buffers
+    if (sh.count == 3) {
+        walkTriangle(pts[0], pts[1], pts[2], s, x0, x1, y0, y1,
+            [&](int x, int y, unsigned int mask) { write((size_t)y * w + x, mask, sh.color, pool); },
+            [&](int a, int b, int y) {
+                size_t row = (size_t)y * w;
+                std::fill(&color[row + a], &color[row + b] + 1, sh.color);
+                memset(&edge[row + a], 0, b - a + 1);
+            });
+        return;
+    }
+
+    // polygons XOR the coverage of their fan triangles into masks first.  masks covers the
+    // band at full width and is all zero between shapes, touched[] remembers which part of
+    // each row needs writing out and clearing again
+    const unsigned char full = (unsigned char)fullMask; // a local, the byte stores below could alias the member
+    int rows = y1 - y0 + 1;
+    if (masks.size() < (size_t)w * rows)
+        masks.assign((size_t)w * rows, 0);
+    touched.assign(rows, glm::ivec2(w, -1));
+
+    for (int t = 1; t + 1 < sh.count; t++) {
+        walkTriangle(pts[0], pts[t], pts[t + 1], s, x0, x1, y0, y1,
+            [&](int x, int y, unsigned int mask) {
+                masks[(size_t)(y - y0) * w + x] ^= (unsigned char)mask;
+                glm::ivec2& span = touched[y - y0];
+                span = glm::ivec2(std::min(span.x, x), std::max(span.y, x));
+            },
+            [&](int a, int b, int y) {
+                unsigned char* m = &masks[(size_t)(y - y0) * w];
+                for (int x = a; x <= b; x++)
+                    m[x] ^= full;
+                glm::ivec2& span = touched[y - y0];
+                span = glm::ivec2(std::min(span.x, a), std::max(span.y, b));
+            });
+    }
+
+    for (int y = y0; y <= y1; y++) {
+        unsigned char* m = &masks[(size_t)(y - y0) * w];
+        size_t row = (size_t)y * w;
+        int end = touched[y - y0].y;
+        for (int x = touched[y - y0].x; x <= end; x++) {
+            if (!m[x])
+                continue;
+            if (m[x] != full) {
+                write(row + x, m[x], sh.color, pool);
+                m[x] = 0;
+                continue;
+            }
+            // runs of whole pixels the way a lone triangle's interior goes
+            int run = x;
+            while (run < end && m[run + 1] == full)
+                run++;
+            std::fill(&color[row + x], &color[row + run] + 1, sh.color);
+            memset(&edge[row + x], 0, run - x + 1);
+            memset(&m[x], 0, run - x + 1);
+            x = run;
+        }
+    }
+}
+
+msaaStats msaaCanvas::draw(threadPool& pool)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    int bandCount = (h + bandHeight - 1) / bandHeight;
+
+    std::vector<std::vector<int>> bands(bandCount);
+    for (int i = 0; i < (int)shapes.size(); i++) {
+        int lo = std::max(shapes[i].y0, 0), hi = std::min(shapes[i].y1, h - 1);
+        for (int b = lo / bandHeight; lo <= hi && b <= hi / bandHeight; b++)
+            bands[b].push_back(i);
+    }
+
+    pool.parallelFor(bandCount, [&](int b) {
+        std::vector<unsigned char> masks;
+        std::vector<glm::ivec2> touched;
+        int y0 = b * bandHeight, y1 = std::min(y0 + bandHeight, h) - 1;
+        for (int i : bands[b])
+            drawShape(shapes[i], y0, y1, pools[b], masks, touched);
+    });
+
+    msaaStats stats;
+    stats.shapes = shapes.size();
+    shapes.clear();
+    points.clear();
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
+
+msaaStats msaaCanvas::resolve(pixelBuffer target, threadPool& pool) const
+{
+    auto start = std::chrono::steady_clock::now();
+
+    int rows = std::min(h, target.height), cols = std::min(w, target.width);
+    int bandCount = (rows + bandHeight - 1) / bandHeight;
+    std::vector<size_t> edges(bandCount, 0);
+
+    pool.parallelFor(bandCount, [&](int b) {
+        size_t count = 0;
+        for (int y = b * bandHeight; y < std::min((b + 1) * bandHeight, rows); y++) {
+            size_t row = (size_t)y * w;
+            count += s == 8 ? resolveRow<8>(&color[row], &edge[row], &sampleBlock[row], pools[b].colors.data(), cols, target.row(y))
+                            : resolveRow<4>(&color[row], &edge[row], &sampleBlock[row], pools[b].colors.data(), cols, target.row(y));
+        }
+        edges[b] = count;
+    });
+
+    msaaStats stats;
+    for (size_t e : edges)
+        stats.edgePixels += e;
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
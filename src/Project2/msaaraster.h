@@ -0,0 +1,79 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "pixelbuffer.h"
+#include "threadpool.h"
+
+struct msaaStats {
+    size_t shapes = 0;
+    size_t edgePixels = 0; // pixels holding more than one color after drawing (resolve only)
+    double seconds = 0.0;
+};
+
+// Multisampled 2D drawing of triangles and polygons on the CPU, 4x or 8x.
+//
+// Coverage is a bit mask per pixel, computed from the edge functions at the standard
+// D3D sample positions for the pixels along a shape's edges only: eight pixels per compare
+// with AVX2 when the CPU has it (picked at run time, see cpufeatures.h), four samples of one
+// pixel with SSE2.  Pixels that a shape covers completely just store one color; only pixels
+// on an edge keep a color per sample, in a block handed out when the pixel becomes an edge
+// pixel.  The blocks come from a pool per band of rows that is kept from one frame to the
+// next, so memory follows the number of edge pixels rather than the sample count times the
+// area, and drawing doesn't allocate.  resolve() copies the single colors and averages the
+// samples of the edge pixels only.
+//
+// That saves memory and resolve work, not drawing time: on the thin slivers and stars of
+// myAntialiasingBenchmark, 4x costs about as much as drawing at 2x2 the resolution and
+// filtering down, most of it spent walking the rows of the triangles.
+//
+// Polygons use the even-odd rule: the coverage of the fan triangles from the first vertex
+// is XORed together, which works for concave and self intersecting outlines too.
+//
+// Coordinates are in pixels with centres at +0.5, like primitiveBatch.  Shapes are queued
+// and draw() runs them in order, in horizontal bands spread over the thread pool.
+class msaaCanvas {
+public:
+    msaaCanvas(int width, int height, int samples = 4);
+
+    int width() const { return w; }
+    int height() const { return h; }
+    int samples() const { return s; }
+
+    void clear(rgb8 c);
+    void load(pixelBuffer source); // start from an existing picture (same size)
+
+    void triangle(glm::vec2 a, glm::vec2 b, glm::vec2 c, rgb8 color);
+    void polygon(const glm::vec2* points, int count, rgb8 color);
+    void polygon(const std::vector<glm::vec2>& points, rgb8 color) { polygon(points.data(), (int)points.size(), color); }
+
+    msaaStats draw(threadPool& pool = threadPool::shared());
+    msaaStats resolve(pixelBuffer target, threadPool& pool = threadPool::shared()) const;
+
+private:
+    struct shape {
+        int first, count; // into points
+        rgb8 color;
+        int x0, y0, x1, y1; // pixel bounds (inclusive, unclipped)
+    };
+
+    // the sample colors of one band of rows' edge pixels, s to a block, each 0x00BBGGRR
+    struct samplePool {
+        std::vector<unsigned int> colors;
+        size_t used = 0; // colors handed out since the last clear
+    };
+
+    int w, h, s;
+    unsigned int fullMask;
+    std::vector<rgb8> color;               // per pixel, valid when it isn't an edge pixel
+    std::vector<unsigned char> edge;       // per pixel, 1 when the per sample colors are in use
+    std::vector<unsigned int> sampleBlock; // per pixel, where its samples start in its band's pool (edge pixels only)
+    std::vector<samplePool> pools;         // per band of rows
+    std::vector<shape> shapes;
+    std::vector<glm::vec2> points;
+
+    void drawShape(const shape& sh, int y0, int y1, samplePool& pool, std::vector<unsigned char>& masks,
+                   std::vector<glm::ivec2>& touched);
+    void write(size_t pixel, unsigned int mask, rgb8 c, samplePool& pool);
+};
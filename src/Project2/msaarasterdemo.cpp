@@ -0,0 +1,123 @@
+//
+// the multisampled polygon demo and benchmark (see msaaraster.h)
+//
+
+#include "demos.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "msaaraster.h"
+#include "raster2d.h"
+
+// the shapes for the anti-aliasing experiments: spinning slivers, stars and a pinwheel
+static void antialiasedShapes(std::vector<std::vector<glm::vec2>>& shapes, std::vector<rgb8>& colors, float scale)
+{
+    std::mt19937 gen(777);
+    auto rnd = [&](int n) { return (int)nextRandom(gen, n); };
+
+    for (int i = 0; i < 40; i++) { // thin slivers, the worst case for aliasing
+        float a = i * 3.14159265f / 40.0f;
+        glm::vec2 c(128.0f, 384.0f), d(std::cos(a), std::sin(a)), n(-d.y, d.x);
+        shapes.push_back({ (c + d * 10.0f) * scale, (c + d * 120.0f + n * 3.0f) * scale, (c + d * 120.0f - n * 3.0f) * scale });
+        colors.push_back(rgb8{ (unsigned char)(255 - i * 5), (unsigned char)(i * 6), 80 });
+    }
+
+    for (int i = 0; i < 12; i++) { // self intersecting stars (even-odd leaves the centre open)
+        glm::vec2 c(300.0f + rnd(180), 300.0f + rnd(180));
+        float r = 20.0f + rnd(40), spin = rnd(100) / 15.0f;
+        std::vector<glm::vec2> star;
+        for (int k = 0; k < 5; k++) {
+            float a = spin + k * 2.0f * 6.2831853f / 5.0f;
+            star.push_back((c + glm::vec2(std::cos(a), std::sin(a)) * r) * scale);
+        }
+        shapes.push_back(star);
+        colors.push_back(rgb8{ (unsigned char)rnd(256), (unsigned char)rnd(256), (unsigned char)rnd(256) });
+    }
+
+    for (int i = 0; i < 8; i++) { // a concave pinwheel
+        float a = i * 6.2831853f / 8.0f, b = a + 0.5f;
+        glm::vec2 c(360.0f, 120.0f);
+        shapes.push_back({ c * scale, (c + glm::vec2(std::cos(a), std::sin(a)) * 100.0f) * scale, (c + glm::vec2(std::cos(b), std::sin(b)) * 60.0f) * scale,
+            (c + glm::vec2(std::cos(a + 0.2f), std::sin(a + 0.2f)) * 40.0f) * scale });
+        colors.push_back(rgb8{ 40, (unsigned char)(100 + i * 20), 220 });
+    }
+}
+
+// 8x multisampled polygons over the checkerboard
+int myAntialiased(threadPool& pool)
+{
+    myTexture();
+
+    std::vector<std::vector<glm::vec2>> shapes;
+    std::vector<rgb8> colors;
+    antialiasedShapes(shapes, colors, 1.0f);
+
+    msaaCanvas canvas(dimy, dimx, 8);
+    canvas.load(imageBuffer());
+    for (size_t i = 0; i < shapes.size(); i++)
+        canvas.polygon(shapes[i], colors[i]);
+
+    msaaStats drawn = canvas.draw(pool);
+    msaaStats resolved = canvas.resolve(imageBuffer(), pool);
+
+    std::cout << "8x msaa: " << drawn.shapes << " shapes in " << drawn.seconds * 1000.0 << " ms, resolved "
+        << resolved.edgePixels << " edge pixels in " << resolved.seconds * 1000.0 << " ms\n";
+
+    return 0;
+}
+
+// multisampling against rendering the same shapes at 2x2 the resolution and filtering down
+int myAntialiasingBenchmark()
+{
+    threadPool oneThread(1);
+
+    std::vector<std::vector<glm::vec2>> shapes, bigShapes;
+    std::vector<rgb8> colors;
+    antialiasedShapes(shapes, colors, 1.0f);
+    antialiasedShapes(bigShapes, colors, 2.0f);
+
+    auto best = [](auto run) {
+        double t = 1e30;
+        for (int i = 0; i < 5; i++) {
+            auto start = std::chrono::steady_clock::now();
+            run();
+            t = std::min(t, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+        return t;
+    };
+
+    for (int samples : { 4, 8 }) {
+        msaaCanvas canvas(dimy, dimx, samples);
+        double t = best([&] {
+            canvas.clear(rgb8{ 0, 0, 0 });
+            for (size_t i = 0; i < shapes.size(); i++)
+                canvas.polygon(shapes[i], colors[i]);
+            canvas.draw(oneThread);
+            canvas.resolve(imageBuffer(), oneThread);
+        });
+        std::cout << samples << "x msaa: " << t * 1000.0 << " ms\n";
+    }
+
+    std::vector<unsigned char> big((size_t)dimx * dimy * 4 * 3);
+    pixelBuffer bigBuffer{ big.data(), (int)dimy * 2, (int)dimx * 2 };
+    double t = best([&] {
+        memset(big.data(), 0, big.size());
+        primitiveBatch batch;
+        for (size_t i = 0; i < bigShapes.size(); i++)
+            batch.polygon(bigShapes[i], colors[i]);
+        batch.draw(bigBuffer, oneThread);
+        for (unsigned y = 0; y < dimx; y++)
+            for (unsigned x = 0; x < dimy; x++)
+                for (int c = 0; c < 3; c++)
+                    imageBuff[y][x][c] = (unsigned char)((bigBuffer.at(x * 2, y * 2)[c] + bigBuffer.at(x * 2 + 1, y * 2)[c] +
+                        bigBuffer.at(x * 2, y * 2 + 1)[c] + bigBuffer.at(x * 2 + 1, y * 2 + 1)[c] + 2) / 4);
+    });
+    std::cout << "4x supersampled: " << t * 1000.0 << " ms\n";
+
+    return 0;
+}
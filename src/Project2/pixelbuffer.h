@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+
+// 8 bit RGB color, the same layout as a pixel in imageBuff
+struct rgb8 {
+    unsigned char r, g, b;
+};
+static_assert(sizeof(rgb8) == 3, "rgb8 must match the packed pixel layout");
+
+// a view onto a tightly packed, row-major RGB buffer (like imageBuff in basics.cpp)
+// the CPU raster code draws through this so it doesn't care which buffer it writes to
+struct pixelBuffer {
+    unsigned char* pixels = nullptr;
+    int width = 0;
+    int height = 0;
+
+    unsigned char* row(int y) const { return pixels + (size_t)y * width * 3; }
+    unsigned char* at(int x, int y) const { return row(y) + (size_t)x * 3; }
+
+    void put(int x, int y, rgb8 c) const
+    {
+        unsigned char* p = at(x, y);
+        p[0] = c.r; p[1] = c.g; p[2] = c.b;
+    }
+
+    // fill pixels [x0, x1] (inclusive) of row y
+    void span(int x0, int x1, int y, rgb8 c) const
+    {
+        unsigned char* p = at(x0, y);
+        for (int x = x0; x <= x1; x++, p += 3) {
+            p[0] = c.r; p[1] = c.g; p[2] = c.b;
+        }
+    }
+};
+
+// the 512x512 buffer that gets uploaded as our pixel experiment texture (see basics.cpp)
+pixelBuffer imageBuffer();
@@ -0,0 +1,395 @@
+//
+// batched 2D primitive rasterization into a CPU pixel buffer (see raster2d.h)
+//
+// every algorithm here is written so a band can start drawing a primitive part way
+// through (at the first row of the band) and land on exactly the pixels a single
+// full pass would have produced.  That's what lets the bands run on separate threads.
+//
+
+#include "raster2d.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+
+// integer division rounding towards -infinity / +infinity (denominator > 0)
+static long long floorDiv(long long a, long long b) { return a >= 0 ? a / b : -((-a + b - 1) / b); }
+static long long ceilDiv(long long a, long long b) { return -floorDiv(-a, b); }
+
+// Bresenham line from a to b, only drawing the pixels inside [0,w) x [ylo,yhi]
+//
+// step i along the major axis lands on minor offset q(i) = floor((2*i*d + n) / (2*n)),
+// which is exactly what the usual error term walk produces.  Solving that for the clip
+// rectangle gives the first and last step, so clipped lines cost only their visible pixels.
+static void bresenham(pixelBuffer t, glm::ivec2 a, glm::ivec2 b, int ylo, int yhi, rgb8 c)
+{
+    int dx = b.x - a.x, dy = b.y - a.y;
+    bool xMajor = std::abs(dx) >= std::abs(dy);
+
+    long long n = xMajor ? std::abs(dx) : std::abs(dy);
+    long long d = xMajor ? std::abs(dy) : std::abs(dx);
+
+    if (n == 0) {
+        if (a.x >= 0 && a.x < t.width && a.y >= ylo && a.y <= yhi)
+            t.put(a.x, a.y, c);
+        return;
+    }
+
+    int majorStart = xMajor ? a.x : a.y, minorStart = xMajor ? a.y : a.x;
+    int majorStep = (xMajor ? dx : dy) < 0 ? -1 : 1;
+    int minorStep = (xMajor ? dy : dx) < 0 ? -1 : 1;
+    int majorLo = xMajor ? 0 : ylo, majorHi = xMajor ? t.width - 1 : yhi;
+    int minorLo = xMajor ? ylo : 0, minorHi = xMajor ? yhi : t.width - 1;
+
+    // steps allowed by the major axis
+    long long i0 = 0, i1 = n;
+    if (majorStep > 0) {
+        i0 = std::max(i0, (long long)majorLo - majorStart);
+        i1 = std::min(i1, (long long)majorHi - majorStart);
+    }
+    else {
+        i0 = std::max(i0, (long long)majorStart - majorHi);
+        i1 = std::min(i1, (long long)majorStart - majorLo);
+    }
+
+    // minor offsets allowed, then the steps that produce them
+    long long qlo = minorStep > 0 ? minorLo - minorStart : minorStart - minorHi;
+    long long qhi = minorStep > 0 ? minorHi - minorStart : minorStart - minorLo;
+    if (qhi < 0 || qlo > d)
+        return;
+
+    if (d > 0) {
+        if (qlo > 0)
+            i0 = std::max(i0, ceilDiv(2 * n * qlo - n, 2 * d));
+        i1 = std::min(i1, floorDiv(2 * n * (qhi + 1) - n - 1, 2 * d));
+    }
+    if (i0 > i1)
+        return;
+
+    // pick up the error term walk at step i0
+    long long num = 2 * i0 * d + n;
+    long long err = num % (2 * n);
+    int major = majorStart + majorStep * (int)i0;
+    int minor = minorStart + minorStep * (int)(num / (2 * n));
+
+    for (long long i = i0; i <= i1; i++) {
+        if (xMajor)
+            t.put(major, minor, c);
+        else
+            t.put(minor, major, c);
+
+        major += majorStep;
+        err += 2 * d;
+        if (err >= 2 * n) {
+            err -= 2 * n;
+            minor += minorStep;
+        }
+    }
+}
+
+// DDA line with sub pixel end points.  Positions come from a + i * step rather than an
+// accumulated sum so every band computes the same pixels.
+static void dda(pixelBuffer t, glm::vec2 a, glm::vec2 b, int ylo, int yhi, rgb8 c)
+{
+    glm::vec2 delta = b - a;
+    int steps = (int)std::ceil(std::max(std::fabs(delta.x), std::fabs(delta.y)));
+
+    if (steps == 0) {
+        int x = (int)std::floor(a.x + 0.5f), y = (int)std::floor(a.y + 0.5f);
+        if (x >= 0 && x < t.width && y >= ylo && y <= yhi)
+            t.put(x, y, c);
+        return;
+    }
+
+    glm::vec2 step = delta / (float)steps;
+
+    // narrow the step range to the clip rectangle (conservatively, each pixel is still tested)
+    float i0 = 0.0f, i1 = (float)steps;
+    auto narrow = [&](float start, float inc, float lo, float hi) {
+        if (inc == 0.0f)
+            return;
+        float ta = (lo - 0.5f - start) / inc, tb = (hi + 0.5f - start) / inc;
+        if (ta > tb)
+            std::swap(ta, tb);
+        i0 = std::max(i0, std::floor(ta));
+        i1 = std::min(i1, std::ceil(tb));
+    };
+    narrow(a.x, step.x, 0.0f, (float)(t.width - 1));
+    narrow(a.y, step.y, (float)ylo, (float)yhi);
+
+    for (int i = (int)i0; i <= (int)i1; i++) {
+        int x = (int)std::floor(a.x + i * step.x + 0.5f);
+        int y = (int)std::floor(a.y + i * step.y + 0.5f);
+        if (x >= 0 && x < t.width && y >= ylo && y <= yhi)
+            t.put(x, y, c);
+    }
+}
+
+// clipped horizontal span helper shared by the filled shapes
+static void clippedSpan(pixelBuffer t, int x0, int x1, int y, int ylo, int yhi, rgb8 c)
+{
+    if (y < ylo || y > yhi)
+        return;
+    x0 = std::max(x0, 0);
+    x1 = std::min(x1, t.width - 1);
+    if (x0 <= x1)
+        t.span(x0, x1, y, c);
+}
+
+static void clippedPut(pixelBuffer t, int x, int y, int ylo, int yhi, rgb8 c)
+{
+    if (x >= 0 && x < t.width && y >= ylo && y <= yhi)
+        t.put(x, y, c);
+}
+
+// midpoint circle, one octant generated and mirrored eight ways
+static void midpointCircle(pixelBuffer t, glm::ivec2 ctr, int r, bool filled, int ylo, int yhi, rgb8 c)
+{
+    int x = 0, y = r, d = 1 - r;
+
+    while (x <= y) {
+        if (filled) {
+            clippedSpan(t, ctr.x - x, ctr.x + x, ctr.y + y, ylo, yhi, c);
+            clippedSpan(t, ctr.x - x, ctr.x + x, ctr.y - y, ylo, yhi, c);
+            clippedSpan(t, ctr.x - y, ctr.x + y, ctr.y + x, ylo, yhi, c);
+            clippedSpan(t, ctr.x - y, ctr.x + y, ctr.y - x, ylo, yhi, c);
+        }
+        else {
+            clippedPut(t, ctr.x + x, ctr.y + y, ylo, yhi, c);
+            clippedPut(t, ctr.x - x, ctr.y + y, ylo, yhi, c);
+            clippedPut(t, ctr.x + x, ctr.y - y, ylo, yhi, c);
+            clippedPut(t, ctr.x - x, ctr.y - y, ylo, yhi, c);
+            clippedPut(t, ctr.x + y, ctr.y + x, ylo, yhi, c);
+            clippedPut(t, ctr.x - y, ctr.y + x, ylo, yhi, c);
+            clippedPut(t, ctr.x + y, ctr.y - x, ylo, yhi, c);
+            clippedPut(t, ctr.x - y, ctr.y - x, ylo, yhi, c);
+        }
+
+        if (d < 0)
+            d += 2 * x + 3;
+        else {
+            d += 2 * (x - y) + 5;
+            y--;
+        }
+        x++;
+    }
+}
+
+// midpoint ellipse: region 1 steps in x while the slope is shallow, region 2 steps in y
+static void midpointEllipse(pixelBuffer t, glm::ivec2 ctr, int rx, int ry, bool filled, int ylo, int yhi, rgb8 c)
+{
+    auto plot4 = [&](long long x, long long y) {
+        int ix = (int)x, iy = (int)y;
+        if (filled) {
+            clippedSpan(t, ctr.x - ix, ctr.x + ix, ctr.y + iy, ylo, yhi, c);
+            clippedSpan(t, ctr.x - ix, ctr.x + ix, ctr.y - iy, ylo, yhi, c);
+        }
+        else {
+            clippedPut(t, ctr.x + ix, ctr.y + iy, ylo, yhi, c);
+            clippedPut(t, ctr.x - ix, ctr.y + iy, ylo, yhi, c);
+            clippedPut(t, ctr.x + ix, ctr.y - iy, ylo, yhi, c);
+            clippedPut(t, ctr.x - ix, ctr.y - iy, ylo, yhi, c);
+        }
+    };
+
+    if (ry == 0) { // flat, the loops below would stop after the centre
+        plot4(0, 0);
+        for (int x = 1; x <= rx; x++)
+            plot4(x, 0);
+        return;
+    }
+
+    long long rx2 = (long long)rx * rx, ry2 = (long long)ry * ry;
+    long long x = 0, y = ry;
+    long long px = 0, py = 2 * rx2 * y;
+
+    long long p = ry2 - rx2 * ry + (rx2 + 2) / 4;
+    while (px < py) {
+        plot4(x, y);
+        x++;
+        px += 2 * ry2;
+        if (p < 0)
+            p += ry2 + px;
+        else {
+            y--;
+            py -= 2 * rx2;
+            p += ry2 + px - py;
+        }
+    }
+
+    double hx = x + 0.5, hy = (double)(y - 1);
+    p = (long long)std::llround(ry2 * hx * hx + rx2 * hy * hy - (double)rx2 * ry2);
+    while (y >= 0) {
+        plot4(x, y);
+        y--;
+        py -= 2 * rx2;
+        if (p > 0)
+            p += rx2 - py;
+        else {
+            x++;
+            px += 2 * ry2;
+            p += rx2 - py + px;
+        }
+    }
+}
+
+// scanline polygon fill driven by an edge table (sorted by top) and an active edge list
+// pixel centres are sampled, so shared edges between polygons are never drawn twice
+static void scanlineFill(pixelBuffer t, const glm::vec2* pts, int count, int ylo, int yhi, rgb8 c)
+{
+    struct edge {
+        float ytop, ybot; // ytop < ybot
+        float xtop;       // x at ytop
+        float dxdy;
+    };
+
+    // edge table: every non horizontal edge, sorted by where it starts
+    std::vector<edge> table;
+    table.reserve(count);
+    for (int i = 0; i < count; i++) {
+        glm::vec2 a = pts[i], b = pts[(i + 1) % count];
+        if (a.y == b.y)
+            continue;
+        if (a.y > b.y)
+            std::swap(a, b);
+        table.push_back({ a.y, b.y, a.x, (b.x - a.x) / (b.y - a.y) });
+    }
+    std::sort(table.begin(), table.end(), [](const edge& l, const edge& r) { return l.ytop < r.ytop; });
+
+    std::vector<const edge*> active;
+    std::vector<float> xs;
+    size_t nextEdge = 0;
+
+    for (int y = ylo; y <= yhi; y++) {
+        float yc = y + 0.5f;
+
+        // move newly started edges into the active list, drop the finished ones
+        while (nextEdge < table.size() && table[nextEdge].ytop <= yc)
+            active.push_back(&table[nextEdge++]);
+        active.erase(std::remove_if(active.begin(), active.end(), [yc](const edge* e) { return e->ybot <= yc; }), active.end());
+
+        if (active.empty()) {
+            if (nextEdge == table.size())
+                break;
+            continue;
+        }
+
+        xs.clear();
+        for (const edge* e : active)
+            xs.push_back(e->xtop + (yc - e->ytop) * e->dxdy);
+        std::sort(xs.begin(), xs.end());
+
+        for (size_t k = 0; k + 1 < xs.size(); k += 2) {
+            int x0 = (int)std::ceil(xs[k] - 0.5f);
+            int x1 = (int)std::ceil(xs[k + 1] - 0.5f) - 1;
+            clippedSpan(t, x0, x1, y, ylo, yhi, c);
+        }
+    }
+}
+
+void primitiveBatch::line(glm::ivec2 a, glm::ivec2 b, rgb8 color)
+{
+    prims.push_back({ kind::bresenham, color, (int)points.size(), 2, { 0, 0 }, std::min(a.y, b.y), std::max(a.y, b.y) });
+    points.push_back(a);
+    points.push_back(b);
+}
+
+void primitiveBatch::lineDDA(glm::vec2 a, glm::vec2 b, rgb8 color)
+{
+    int ymin = (int)std::floor(std::min(a.y, b.y) + 0.5f), ymax = (int)std::floor(std::max(a.y, b.y) + 0.5f);
+    prims.push_back({ kind::dda, color, (int)points.size(), 2, { 0, 0 }, ymin, ymax });
+    points.push_back(a);
+    points.push_back(b);
+}
+
+void primitiveBatch::circle(glm::ivec2 center, int radius, rgb8 color, bool filled)
+{
+    if (radius < 0)
+        return;
+    prims.push_back({ filled ? kind::circleFilled : kind::circle, color, (int)points.size(), 1, { radius, radius },
+                      center.y - radius, center.y + radius });
+    points.push_back(center);
+}
+
+void primitiveBatch::ellipse(glm::ivec2 center, int rx, int ry, rgb8 color, bool filled)
+{
+    if (rx < 0 || ry < 0)
+        return;
+    prims.push_back({ filled ? kind::ellipseFilled : kind::ellipse, color, (int)points.size(), 1, { rx, ry },
+                      center.y - ry, center.y + ry });
+    points.push_back(center);
+}
+
+void primitiveBatch::polygon(const glm::vec2* pts, int count, rgb8 color)
+{
+    if (count < 3)
+        return;
+
+    float ymin = pts[0].y, ymax = pts[0].y;
+    for (int i = 1; i < count; i++) {
+        ymin = std::min(ymin, pts[i].y);
+        ymax = std::max(ymax, pts[i].y);
+    }
+    prims.push_back({ kind::polygon, color, (int)points.size(), count, { 0, 0 },
+                      (int)std::floor(ymin), (int)std::ceil(ymax) });
+    points.insert(points.end(), pts, pts + count);
+}
+
+void primitiveBatch::clear()
+{
+    prims.clear();
+    points.clear();
+}
+
+void primitiveBatch::drawBand(const primitive& p, pixelBuffer target, int y0, int y1) const
+{
+    const glm::vec2* pts = &points[p.first];
+
+    switch (p.type) {
+    case kind::bresenham:
+        bresenham(target, glm::ivec2(pts[0]), glm::ivec2(pts[1]), y0, y1, p.color);
+        break;
+    case kind::dda:
+        dda(target, pts[0], pts[1], y0, y1, p.color);
+        break;
+    case kind::circle:
+    case kind::circleFilled:
+        midpointCircle(target, glm::ivec2(pts[0]), p.radius[0], p.type == kind::circleFilled, y0, y1, p.color);
+        break;
+    case kind::ellipse:
+    case kind::ellipseFilled:
+        midpointEllipse(target, glm::ivec2(pts[0]), p.radius[0], p.radius[1], p.type == kind::ellipseFilled, y0, y1, p.color);
+        break;
+    case kind::polygon:
+        scanlineFill(target, pts, p.count, std::max(y0, p.ymin), std::min(y1, p.ymax), p.color);
+        break;
+    }
+}
+
+rasterStats primitiveBatch::draw(pixelBuffer target, threadPool& pool, int bandHeight) const
+{
+    auto start = std::chrono::steady_clock::now();
+
+    bandHeight = std::max(1, bandHeight);
+    int bandCount = (target.height + bandHeight - 1) / bandHeight;
+
+    // bin every primitive into the bands it touches, keeping submission order
+    std::vector<std::vector<int>> bands(bandCount);
+    for (int i = 0; i < (int)prims.size(); i++) {
+        int lo = std::max(prims[i].ymin, 0), hi = std::min(prims[i].ymax, target.height - 1);
+        for (int b = lo / bandHeight; lo <= hi && b <= hi / bandHeight; b++)
+            bands[b].push_back(i);
+    }
+
+    pool.parallelFor(bandCount, [&](int b) {
+        int y0 = b * bandHeight, y1 = std::min(y0 + bandHeight, target.height) - 1;
+        for (int i : bands[b])
+            drawBand(prims[i], target, y0, y1);
+    });
+
+    rasterStats stats;
+    stats.primitives = prims.size();
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "pixelbuffer.h"
+#include "threadpool.h"
+
+// how a batch of primitives performed when it was drawn
+struct rasterStats {
+    size_t primitives = 0;
+    double seconds = 0.0;
+
+    double primitivesPerSecond() const { return seconds > 0.0 ? primitives / seconds : 0.0; }
+};
+
+// A batch of 2D primitives drawn with the classic algorithms:
+//   lines     - Bresenham (integer end points) or DDA (sub pixel end points)
+//   circles   - midpoint circle, outline or filled
+//   ellipses  - midpoint ellipse (two regions), outline or filled
+//   polygons  - filled with an active edge table scanline fill (even-odd rule)
+//
+// Queue up as many as you like, then draw() clips them to the target, sorts them into
+// horizontal bands and lets the thread pool draw one band per job.  A band only ever
+// writes its own rows so no locks are needed, and primitives within a band keep their
+// submission order so the result is the same no matter how many threads run.
+class primitiveBatch {
+public:
+    void line(glm::ivec2 a, glm::ivec2 b, rgb8 color);
+    void lineDDA(glm::vec2 a, glm::vec2 b, rgb8 color);
+    void circle(glm::ivec2 center, int radius, rgb8 color, bool filled = false);
+    void ellipse(glm::ivec2 center, int rx, int ry, rgb8 color, bool filled = false);
+    void polygon(const glm::vec2* points, int count, rgb8 color);
+    void polygon(const std::vector<glm::vec2>& points, rgb8 color) { polygon(points.data(), (int)points.size(), color); }
+
+    void clear();
+    size_t size() const { return prims.size(); }
+
+    rasterStats draw(pixelBuffer target, threadPool& pool = threadPool::shared(), int bandHeight = 32) const;
+
+private:
+    enum class kind : unsigned char { bresenham, dda, circle, circleFilled, ellipse, ellipseFilled, polygon };
+
+    struct primitive {
+        kind type;
+        rgb8 color;
+        int first;      // first point in 'points'
+        int count;      // number of points (polygons) or 2 for lines / 1 for circles and ellipses
+        int radius[2];  // circle and ellipse radii
+        int ymin, ymax; // vertical extent, used to bin into bands
+    };
+
+    std::vector<primitive> prims;
+    std::vector<glm::vec2> points;
+
+    void drawBand(const primitive& p, pixelBuffer target, int y0, int y1) const;
+};
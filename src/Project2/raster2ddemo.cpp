@@ -0,0 +1,48 @@
+//
+// the primitive batch demo (see raster2d.h)
+//
+
+#include "demos.h"
+
+#include <iostream>
+
+#include "raster2d.h"
+
+// draw a few thousand lines, circles, ellipses and polygons over the checkerboard
+int myPrimitives(threadPool& pool)
+{
+    primitiveBatch batch;
+
+    std::mt19937 gen(1234); // the same picture every run
+
+    auto rnd = [&](int n) { return (int)nextRandom(gen, n); };
+    auto color = [&]() { return rgb8{ (unsigned char)rnd(256), (unsigned char)rnd(256), (unsigned char)rnd(256) }; };
+
+    for (int i = 0; i < 1000; i++)
+        batch.line(glm::ivec2(rnd(dimy), rnd(dimx)), glm::ivec2(rnd(dimy), rnd(dimx)), color());
+
+    for (int i = 0; i < 500; i++)
+        batch.lineDDA(glm::vec2(rnd(dimy * 4) / 4.0f, rnd(dimx * 4) / 4.0f), glm::vec2(rnd(dimy * 4) / 4.0f, rnd(dimx * 4) / 4.0f), color());
+
+    for (int i = 0; i < 500; i++)
+        batch.circle(glm::ivec2(rnd(dimy), rnd(dimx)), 2 + rnd(40), color(), i % 2 == 0);
+
+    for (int i = 0; i < 500; i++)
+        batch.ellipse(glm::ivec2(rnd(dimy), rnd(dimx)), 2 + rnd(50), 2 + rnd(30), color(), i % 2 == 0);
+
+    for (int i = 0; i < 500; i++)
+    {
+        glm::vec2 centre(rnd(dimy), rnd(dimx));
+        glm::vec2 pts[6];
+        for (int k = 0; k < 6; k++)
+            pts[k] = centre + glm::vec2(rnd(61) - 30, rnd(61) - 30);
+        batch.polygon(pts, 6, color());
+    }
+
+    rasterStats stats = batch.draw(imageBuffer(), pool);
+
+    std::cout << "drew " << stats.primitives << " primitives in " << stats.seconds * 1000.0 << " ms ("
+        << stats.primitivesPerSecond() << " primitives/s)\n";
+
+    return 0;
+}
@@ -1,4 +1,5 @@
 
+#include <vector>
 #include "shader_s.h"
 
 #pragma once
@@ -7,6 +8,12 @@ class renderer {
 protected:
     unsigned int VBO = 0, VAO = 0, EBO = 0;
     unsigned int indexCount;
+    unsigned int firstIndex = 0; // where in the element buffer the drawing starts
+    // when set, render() draws these ranges of the element buffer with one
+    // glMultiDrawElements instead of firstIndex / indexCount
+    bool multiDraw = false;
+    std::vector<GLsizei> drawCounts;
+    std::vector<const void*> drawOffsets;
 
     glm::mat4 modelMatrix;
 
@@ -51,6 +58,9 @@ public: void scale(const float scale[])
 
         glBindVertexArray(VAO);
 
-        glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0);
+        if (multiDraw)
+            glMultiDrawElements(GL_TRIANGLES, drawCounts.data(), GL_UNSIGNED_INT, drawOffsets.data(), (GLsizei)drawCounts.size());
+        else
+            glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, (void*)(firstIndex * sizeof(unsigned int)));
     }
 };
\ No newline at end of file
@@ -0,0 +1,12 @@
+//
+// the one copy of stb_image in the program, its memory coming from decodearena.h
+//
+
+#include "decodearena.h"
+
+#define STBI_MALLOC(size) decodeArenaMalloc(size)
+#define STBI_REALLOC(p, size) decodeArenaRealloc(p, size)
+#define STBI_FREE(p) decodeArenaFree(p)
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
@@ -0,0 +1,177 @@
+//
+// images packed into shared texture pages (see textureatlas.h)
+//
+
+#include "textureatlas.h"
+
+#include <algorithm>
+#include <cstring>
+
+// a private copy of the packer; ImGui compiles its own inside its namespace
+#define STBRP_STATIC
+#define STB_RECT_PACK_IMPLEMENTATION
+#include <imstb_rectpack.h>
+
+struct textureAtlas::page {
+    stbrp_context packer;
+    std::vector<stbrp_node> nodes; // the skyline, one node per column of cells is always enough
+    std::vector<rgba8> pixels;
+    atlasRect changed;
+    size_t covered = 0; // texels taken by images and their borders
+};
+
+namespace {
+
+int roundUp(int n, int multiple)
+{
+    return (n + multiple - 1) / multiple * multiple;
+}
+
+} // namespace
+
+textureAtlas::textureAtlas(int pageSize, int border)
+    : size(pageSize), edge(1)
+{
+    while (edge < border)
+        edge *= 2;
+    if (border <= 0)
+        edge = 0;
+    size = roundUp(std::max(pageSize, 1), std::max(edge, 1));
+}
+
+textureAtlas::~textureAtlas() = default;
+textureAtlas::textureAtlas(textureAtlas&&) noexcept = default;
+textureAtlas& textureAtlas::operator=(textureAtlas&&) noexcept = default;
+
+int textureAtlas::mipLevels() const
+{
+    // level k keeps to its own texels while 2^(k+1) <= border, level 0 always does
+    int levels = 1;
+    while ((2 << levels) <= edge)
+        levels++;
+    return levels;
+}
+
+const rgba8* textureAtlas::pagePixels(int page) const
+{
+    return pages[page]->pixels.data();
+}
+
+float textureAtlas::pageFill(int page) const
+{
+    return (float)pages[page]->covered / ((float)size * size);
+}
+
+atlasRect textureAtlas::dirty(int page) const
+{
+    return pages[page]->changed;
+}
+
+void textureAtlas::clean(int page)
+{
+    pages[page]->changed = atlasRect();
+}
+
+textureAtlas::page& textureAtlas::newPage()
+{
+    // the packer works in cells of border x border texels, which is what keeps every
+    // image on a multiple of the border
+    int cells = size / std::max(edge, 1);
+    pages.push_back(std::make_unique<page>());
+    page& p = *pages.back();
+    p.nodes.resize(cells);
+    stbrp_init_target(&p.packer, cells, cells, p.nodes.data(), cells);
+    p.pixels.assign((size_t)size * size, rgba8{ 0, 0, 0, 0 });
+    return p;
+}
+
+int textureAtlas::add(const rgba8* pixels, int width, int height)
+{
+    return add(std::vector<atlasImage>{ { pixels, width, height } })[0];
+}
+
+std::vector<int> textureAtlas::add(const std::vector<atlasImage>& images)
+{
+    int cell = std::max(edge, 1);
+    int first = (int)regions.size();
+    regions.resize(regions.size() + images.size());
+
+    // each image takes its width and height rounded up to whole cells, plus a cell of
+    // border all round (a ring of edge copies, edge texels wide, and whatever rounding up left)
+    std::vector<stbrp_rect> waiting;
+    for (size_t i = 0; i < images.size(); i++) {
+        const atlasImage& image = images[i];
+        if (image.width <= 0 || image.height <= 0 || !image.pixels)
+            continue;
+        int w = roundUp(image.width, cell) / cell + (edge ? 2 : 0);
+        int h = roundUp(image.height, cell) / cell + (edge ? 2 : 0);
+        if (w * cell > size || h * cell > size)
+            continue; // never going to fit, leave it at page -1
+        stbrp_rect r = {};
+        r.id = (int)i;
+        r.w = (stbrp_coord)w;
+        r.h = (stbrp_coord)h;
+        waiting.push_back(r);
+    }
+
+    // whatever doesn't fit on one page goes on to the next, and a new one when they're all full
+    for (int p = 0; !waiting.empty(); p++) {
+        page& target = p < pageCount() ? *pages[p] : newPage();
+        stbrp_pack_rects(&target.packer, waiting.data(), (int)waiting.size());
+
+        std::vector<stbrp_rect> left;
+        for (const stbrp_rect& r : waiting) {
+            if (r.was_packed)
+                copyIn(target, p, images[r.id], r.x * cell, r.y * cell, regions[first + r.id]);
+            else
+                left.push_back(r);
+        }
+        // a fresh page that took nothing can't take anything: only too big images are left,
+        // and those were filtered out above
+        if (left.size() == waiting.size() && p == pageCount() - 1 && target.covered == 0)
+            break;
+        waiting.swap(left);
+    }
+
+    std::vector<int> ids(images.size());
+    for (size_t i = 0; i < images.size(); i++)
+        ids[i] = first + (int)i;
+    return ids;
+}
+
+// copy an image into its cell, the edge texels repeated out across the border
+void textureAtlas::copyIn(page& p, int pageIndex, const atlasImage& image, int cellX, int cellY, atlasRegion& region)
+{
+    int cell = std::max(edge, 1);
+    int w = image.width, h = image.height;
+    int cellW = roundUp(w, cell) + 2 * edge, cellH = roundUp(h, cell) + 2 * edge;
+    int x = cellX + edge, y = cellY + edge;
+
+    for (int row = 0; row < cellH; row++) {
+        int from = std::min(std::max(row - edge, 0), h - 1);
+        const rgba8* src = image.pixels + (size_t)from * w;
+        rgba8* dst = p.pixels.data() + (size_t)(cellY + row) * size + cellX;
+        for (int i = 0; i < edge; i++)
+            dst[i] = src[0];
+        memcpy(dst + edge, src, (size_t)w * sizeof(rgba8));
+        for (int i = edge + w; i < cellW; i++)
+            dst[i] = src[w - 1];
+    }
+
+    atlasRect& d = p.changed;
+    if (d.empty())
+        d = atlasRect{ cellX, cellY, cellX + cellW, cellY + cellH };
+    else
+        d = atlasRect{ std::min(d.x0, cellX), std::min(d.y0, cellY), std::max(d.x1, cellX + cellW), std::max(d.y1, cellY + cellH) };
+    p.covered += (size_t)cellW * cellH;
+
+    region.page = pageIndex;
+    region.x = x;
+    region.y = y;
+    region.width = w;
+    region.height = h;
+    region.u0 = (float)x / size;
+    region.v0 = (float)y / size;
+    region.u1 = (float)(x + w) / size;
+    region.v1 = (float)(y + h) / size;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "cputexture.h"
+
+// where one image ended up in a textureAtlas
+struct atlasRegion {
+    int page = -1;                          // -1 if it couldn't be packed (bigger than a page)
+    int x = 0, y = 0, width = 0, height = 0; // its texels on the page, the border not included
+    float u0 = 0, v0 = 0, u1 = 0, v1 = 0;   // the outer edges of those texels as texture coordinates
+
+    bool ok() const { return page >= 0; }
+
+    // a texture coordinate of the image on its own (0..1 across it) on the page
+    float u(float s) const { return u0 + s * (u1 - u0); }
+    float v(float t) const { return v0 + t * (v1 - v0); }
+};
+
+// one image to pack: RGBA texels, rows as they are (a flipped image stays flipped)
+struct atlasImage {
+    const rgba8* pixels = nullptr;
+    int width = 0, height = 0;
+};
+
+// the part of a page that changed, x1 and y1 exclusive
+struct atlasRect {
+    int x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+
+    bool empty() const { return x1 <= x0 || y1 <= y0; }
+};
+
+// Many small images packed into a few big square pages, so things drawn with different
+// images can share one texture and go out in one draw call.
+//
+// Packing is stb_rect_pack's skyline bottom-left (imstb_rectpack.h, the copy ImGui uses for
+// its font atlas) and it is incremental: images can be added at any time, each batch going
+// into the pages that already exist before a new page is started.  A batch packs better
+// than the same images one at a time, since it is placed tallest first.
+//
+// Every image gets a border of copies of its edge texels, and the images are placed on
+// multiples of the border size (a power of two), so neither bilinear filtering nor the
+// first log2(border) mip levels blend in texels of a neighbour: with the default border
+// of 8, levels 0 to 2.  mipLevels() says how many levels are safe.
+//
+// Only the CPU side is here; updateAtlasTextures() in textureupload.h keeps one GL texture
+// per page up to date, sending just the part of each page that changed.
+class textureAtlas {
+public:
+    explicit textureAtlas(int pageSize = 2048, int border = 8);
+    ~textureAtlas();
+    textureAtlas(textureAtlas&&) noexcept;
+    textureAtlas& operator=(textureAtlas&&) noexcept;
+
+    // pack a batch, copying the texels in.  One id per image, in order; the ids stay valid
+    // (see region()) for as long as the atlas does
+    std::vector<int> add(const std::vector<atlasImage>& images);
+    int add(const rgba8* pixels, int width, int height);
+
+    const atlasRegion& region(int id) const { return regions[id]; }
+    int imageCount() const { return (int)regions.size(); }
+
+    int pageSize() const { return size; }
+    int border() const { return edge; }
+    int mipLevels() const;
+    int pageCount() const { return (int)pages.size(); }
+    const rgba8* pagePixels(int page) const;
+    float pageFill(int page) const; // how much of it the images and their borders cover, 0..1
+
+    // what changed on a page since clean() was last called for it
+    atlasRect dirty(int page) const;
+    void clean(int page);
+
+private:
+    struct page;
+
+    int size, edge;
+    std::vector<std::unique_ptr<page>> pages;
+    std::vector<atlasRegion> regions;
+
+    page& newPage();
+    void copyIn(page& p, int pageIndex, const atlasImage& image, int cellX, int cellY, atlasRegion& region);
+};
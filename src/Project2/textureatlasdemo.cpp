@@ -0,0 +1,56 @@
+//
+// the texture atlas demo (see textureatlas.h)
+//
+
+#include "demos.h"
+
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include "textureatlas.h"
+
+// packs a few dozen small made up images (stripes and rings in their own colors) into a
+// 512x512 atlas in two batches, the second going in around the first, and shows the page.
+// The grey checks are space no image took
+int myAtlas()
+{
+    std::mt19937 gen(41);
+    textureAtlas atlas(dimx, 4);
+
+    for (int batch = 0; batch < 2; batch++) {
+        std::vector<std::vector<rgba8>> images;
+        std::vector<atlasImage> list;
+        for (int i = 0; i < 24; i++) {
+            int w = 8 + (int)nextRandom(gen, batch ? 40 : 90), h = 8 + (int)nextRandom(gen, batch ? 40 : 90);
+            unsigned char r = (unsigned char)(64 + nextRandom(gen, 192)), g = (unsigned char)(64 + nextRandom(gen, 192)),
+                b = (unsigned char)(64 + nextRandom(gen, 192));
+            bool rings = nextRandom(gen, 2) == 0;
+            std::vector<rgba8> image((size_t)w * h);
+            for (int y = 0; y < h; y++)
+                for (int x = 0; x < w; x++) {
+                    int dx = 2 * x - w, dy = 2 * y - h;
+                    bool on = rings ? ((int)std::sqrt((float)(dx * dx + dy * dy)) / 6) % 2 == 0 : ((x + y) / 5) % 2 == 0;
+                    image[(size_t)y * w + x] = on ? rgba8{ r, g, b, 255 } : rgba8{ (unsigned char)(r / 3), (unsigned char)(g / 3), (unsigned char)(b / 3), 255 };
+                }
+            images.push_back(std::move(image));
+            list.push_back({ images.back().data(), w, h });
+        }
+        atlas.add(list);
+    }
+
+    // the page is dimx texels a row (its pageSize)
+    const rgba8* page = atlas.pagePixels(0);
+    for (unsigned y = 0; y < dimy; y++)
+        for (unsigned x = 0; x < dimx; x++) {
+            const rgba8& t = page[(size_t)y * dimx + x];
+            unsigned char empty = ((x / 8) % 2) == ((y / 8) % 2) ? 48 : 72;
+            imageBuff[y][x][0] = t.a ? t.r : empty;
+            imageBuff[y][x][1] = t.a ? t.g : empty;
+            imageBuff[y][x][2] = t.a ? t.b : empty;
+        }
+
+    std::cout << "atlas: " << atlas.imageCount() << " images on " << atlas.pageCount() << " page(s), first page "
+        << (int)(atlas.pageFill(0) * 100.0f) << "% used, " << atlas.mipLevels() << " clean mip levels\n";
+    return 0;
+}
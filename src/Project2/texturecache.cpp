@@ -0,0 +1,386 @@
+//
+// decoded textures and their mips kept in a memory mapped file between runs (see texturecache.h)
+//
+
+#include "texturecache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <type_traits>
+
+namespace {
+
+const char cacheMagic[8] = { 'G', '4', 'G', 'T', 'E', 'X', 'C', '1' };
+const std::uint32_t cacheVersion = 2;
+const int maxLevels = 16;
+
+struct fileHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t entries;
+    std::uint64_t bytes; // the whole file, a short write shows up as a mismatch
+};
+
+size_t align64(size_t offset)
+{
+    return (offset + 63) & ~(size_t)63;
+}
+
+// a quick 64 bit hash of the source file, 8 bytes per step
+std::uint64_t hashBytes(const unsigned char* p, size_t n)
+{
+    std::uint64_t h = 0x9e3779b97f4a7c15ull ^ n;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        std::uint64_t word;
+        memcpy(&word, p + i, 8);
+        h = (h ^ word) * 0xff51afd7ed558ccdull;
+        h ^= h >> 32;
+    }
+    for (; i < n; i++)
+        h = (h ^ p[i]) * 0x100000001b3ull;
+    return h ^ (h >> 29);
+}
+
+std::uint64_t hashFile(const std::string& path)
+{
+    mappedFile file(path);
+    return file.isOpen() ? hashBytes(file.data(), file.size()) : 0;
+}
+
+// the next mip level, a 2x2 box filter (an odd last row or column is left out, a side of
+// 1 averages its one texel with itself)
+void halve(const unsigned char* src, int w, int h, int channels, unsigned char* dst)
+{
+    int dw = std::max(w / 2, 1), dh = std::max(h / 2, 1);
+    for (int y = 0; y < dh; y++) {
+        const unsigned char* a = src + (size_t)std::min(2 * y, h - 1) * w * channels;
+        const unsigned char* b = src + (size_t)std::min(2 * y + 1, h - 1) * w * channels;
+        for (int x = 0; x < dw; x++) {
+            int x0 = std::min(2 * x, w - 1) * channels, x1 = std::min(2 * x + 1, w - 1) * channels;
+            for (int c = 0; c < channels; c++)
+                *dst++ = (unsigned char)((a[x0 + c] + a[x1 + c] + b[x0 + c] + b[x1 + c] + 2) >> 2);
+        }
+    }
+}
+
+} // namespace
+
+struct textureCache::entry {
+    std::uint64_t sourceSize;
+    std::int64_t sourceTime;
+    std::uint64_t contentHash;
+    std::uint32_t pathOffset, pathLength; // from the start of the file
+    std::int32_t requestedChannels, flip, scale;
+    std::int32_t width, height, channels, levels;
+    std::uint64_t levelOffset[maxLevels];
+};
+static_assert(std::is_trivially_copyable<fileHeader>::value, "the cache header is written as raw bytes");
+
+textureCache::textureCache(std::string file)
+    : filename(std::move(file))
+{
+    open();
+}
+
+void textureCache::open()
+{
+    // anything that doesn't look exactly right is treated as an empty cache
+    if (!mapping.open(filename))
+        return;
+
+    const fileHeader* header = (const fileHeader*)mapping.data();
+    if (mapping.size() < sizeof(fileHeader) || memcmp(header->magic, cacheMagic, 8) != 0 || header->version != cacheVersion ||
+        header->bytes != mapping.size() || header->entries > (mapping.size() - sizeof(fileHeader)) / sizeof(entry)) {
+        mapping.close();
+        return;
+    }
+
+    // and every path and level has to lie inside the file, or none of it is trusted
+    std::uint64_t size = mapping.size();
+    for (int i = 0; i < (int)header->entries; i++) {
+        const entry& e = entries()[i];
+        bool ok = (std::uint64_t)e.pathOffset + e.pathLength <= size && e.levels > 0 && e.levels <= maxLevels &&
+                  e.width > 0 && e.height > 0 && e.channels > 0 && e.channels <= 4;
+        for (int l = 0; ok && l < e.levels; l++) {
+            std::uint64_t texels = (std::uint64_t)std::max(e.width >> l, 1) * std::max(e.height >> l, 1);
+            ok = texels <= size / e.channels && e.levelOffset[l] <= size && texels * e.channels <= size - e.levelOffset[l];
+        }
+        if (!ok) {
+            mapping.close();
+            return;
+        }
+    }
+}
+
+const textureCache::entry* textureCache::entries() const
+{
+    return (const entry*)(mapping.data() + sizeof(fileHeader));
+}
+
+int textureCache::entryCount() const
+{
+    return mapping.isOpen() ? (int)((const fileHeader*)mapping.data())->entries : 0;
+}
+
+// the entry for this request and source size, whose time and hash still need checking
+int textureCache::find(const imageRequest& request, std::uint64_t size) const
+{
+    for (int i = 0; i < entryCount(); i++) {
+        const entry& e = entries()[i];
+        if (e.sourceSize == size && e.requestedChannels == request.channels && e.flip == (request.flip ? 1 : 0) &&
+            e.scale == request.scale && e.pathLength == request.path.size() && memcmp(mapping.data() + e.pathOffset, request.path.data(), e.pathLength) == 0)
+            return i;
+    }
+    return -1;
+}
+
+cachedTexture textureCache::view(int index) const
+{
+    const entry& e = entries()[index];
+    cachedTexture t;
+    t.path.assign((const char*)mapping.data() + e.pathOffset, e.pathLength);
+    t.width = e.width;
+    t.height = e.height;
+    t.channels = e.channels;
+    t.levels = e.levels;
+    for (int i = 0; i < e.levels; i++)
+        t.level[i] = mapping.data() + e.levelOffset[i];
+    return t;
+}
+
+std::vector<cachedTexture> textureCache::load(const std::vector<imageRequest>& requests, threadPool& pool, textureCacheStats* stats)
+{
+    auto start = std::chrono::steady_clock::now();
+    textureCacheStats counts;
+    int count = (int)requests.size();
+
+    // which requests the cache already has.  Only a changed time costs a look at the contents
+    std::vector<int> found(count, -1);
+    std::vector<std::uint64_t> sizes(count, 0), hashes(count, 0);
+    std::vector<std::int64_t> times(count, 0);
+    std::vector<char> absent(count, 0);
+    pool.parallelFor(count, [&](int i) {
+        std::error_code error;
+        sizes[i] = std::filesystem::file_size(requests[i].path, error);
+        if (error) {
+            absent[i] = 1;
+            return;
+        }
+        times[i] = (std::int64_t)std::filesystem::last_write_time(requests[i].path, error).time_since_epoch().count();
+
+        int candidate = find(requests[i], sizes[i]);
+        if (candidate >= 0 && entries()[candidate].sourceTime == times[i])
+            found[i] = candidate;
+        else if (candidate >= 0) {
+            hashes[i] = hashFile(requests[i].path);
+            if (hashes[i] == entries()[candidate].contentHash)
+                found[i] = candidate;
+        }
+    });
+
+    // entries whose file was touched but not changed get the new time when the file is
+    // rewritten below, so the next run doesn't hash them again.  Not in place: the file is
+    // mapped, and the table has to stay what the mapping shows
+    std::vector<int> retimed(entryCount(), -1); // per entry, the request with its new time
+    bool anyRetimed = false;
+    for (int i = 0; i < count; i++)
+        if (found[i] >= 0 && hashes[i]) {
+            retimed[found[i]] = i;
+            anyRetimed = true;
+        }
+
+    std::vector<int> missing;
+    for (int i = 0; i < count; i++) {
+        if (absent[i])
+            counts.failed++;
+        else if (found[i] < 0)
+            missing.push_back(i);
+        else
+            counts.hits++;
+    }
+
+    std::vector<cachedTexture> result(count);
+    if (missing.empty() && !anyRetimed) {
+        for (int i = 0; i < count; i++)
+            if (found[i] >= 0)
+                result[i] = view(found[i]);
+        counts.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (stats)
+            *stats = counts;
+        return result;
+    }
+
+    // decode the misses and build their mip chains
+    auto decodeStart = std::chrono::steady_clock::now();
+    std::vector<imageRequest> decodeRequests;
+    for (int i : missing)
+        decodeRequests.push_back(requests[i]);
+    std::vector<decodedImage> decoded = decodeImages(decodeRequests, pool);
+
+    std::vector<std::vector<std::vector<unsigned char>>> chains(missing.size());
+    pool.parallelFor((int)missing.size(), [&](int m) {
+        const decodedImage& image = decoded[m];
+        if (!image.ok())
+            return;
+        if (!hashes[missing[m]])
+            hashes[missing[m]] = hashFile(requests[missing[m]].path);
+
+        std::vector<std::vector<unsigned char>>& chain = chains[m];
+        chain.emplace_back(image.pixels.get(), image.pixels.get() + image.bytes());
+        int w = image.width, h = image.height;
+        while ((w > 1 || h > 1) && (int)chain.size() < maxLevels) {
+            std::vector<unsigned char> next((size_t)std::max(w / 2, 1) * std::max(h / 2, 1) * image.channels);
+            halve(chain.back().data(), w, h, image.channels, next.data());
+            chain.push_back(std::move(next));
+            w = std::max(w / 2, 1);
+            h = std::max(h / 2, 1);
+        }
+    });
+    counts.decodeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - decodeStart).count();
+
+    // the new table: old entries that nothing replaces, then the new ones
+    std::vector<entry> table;
+    std::vector<const unsigned char*> oldLevels; // per table entry, base of the old mapping or null
+    std::vector<int> newIndex(entryCount(), -1), missIndex(missing.size(), -1);
+    std::string paths;
+
+    for (int i = 0; i < entryCount(); i++) {
+        const entry& e = entries()[i];
+        bool replaced = false;
+        for (int m = 0; m < (int)missing.size() && !replaced; m++) {
+            const imageRequest& r = requests[missing[m]];
+            replaced = r.path.size() == e.pathLength && memcmp(mapping.data() + e.pathOffset, r.path.data(), e.pathLength) == 0 &&
+                       r.channels == e.requestedChannels && (r.flip ? 1 : 0) == e.flip && r.scale == e.scale;
+        }
+        if (replaced)
+            continue;
+        newIndex[i] = (int)table.size();
+        table.push_back(e);
+        if (retimed[i] >= 0)
+            table.back().sourceTime = times[retimed[i]];
+        table.back().pathOffset = (std::uint32_t)paths.size();
+        paths.append((const char*)mapping.data() + e.pathOffset, e.pathLength);
+        oldLevels.push_back(mapping.data());
+    }
+    for (int m = 0; m < (int)missing.size(); m++) {
+        const decodedImage& image = decoded[m];
+        const imageRequest& r = requests[missing[m]];
+        if (!image.ok()) {
+            counts.failed++;
+            continue;
+        }
+        entry e = {};
+        e.sourceSize = sizes[missing[m]];
+        e.sourceTime = times[missing[m]];
+        e.contentHash = hashes[missing[m]];
+        e.pathOffset = (std::uint32_t)paths.size();
+        e.pathLength = (std::uint32_t)r.path.size();
+        e.requestedChannels = r.channels;
+        e.flip = r.flip ? 1 : 0;
+        e.scale = r.scale;
+        e.width = image.width;
+        e.height = image.height;
+        e.channels = image.channels;
+        e.levels = (int)chains[m].size();
+        missIndex[m] = (int)table.size();
+        table.push_back(e);
+        paths += r.path;
+        oldLevels.push_back(nullptr);
+    }
+    counts.misses = missing.size() - (counts.failed - std::count(absent.begin(), absent.end(), 1));
+
+    // offsets: header, table, paths, then the levels on 64 byte boundaries
+    size_t pathsStart = sizeof(fileHeader) + table.size() * sizeof(entry);
+    size_t offset = align64(pathsStart + paths.size());
+    std::vector<std::uint64_t> sourceOffsets(table.size() * maxLevels, 0);
+    for (size_t t = 0; t < table.size(); t++) {
+        entry& e = table[t];
+        e.pathOffset += (std::uint32_t)pathsStart;
+        for (int l = 0; l < e.levels; l++) {
+            sourceOffsets[t * maxLevels + l] = e.levelOffset[l];
+            e.levelOffset[l] = offset;
+            size_t bytes = (size_t)std::max(e.width >> l, 1) * std::max(e.height >> l, 1) * e.channels;
+            offset = align64(offset + bytes);
+        }
+    }
+
+    fileHeader header;
+    memcpy(header.magic, cacheMagic, 8);
+    header.version = cacheVersion;
+    header.entries = (std::uint32_t)table.size();
+    header.bytes = offset;
+
+    std::string temporary = filename + ".tmp";
+    std::error_code error;
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        out.write((const char*)&header, sizeof(header));
+        out.write((const char*)table.data(), table.size() * sizeof(entry));
+        out.write(paths.data(), paths.size());
+
+        static const char zeros[64] = {};
+        size_t written = pathsStart + paths.size();
+        int m = 0;
+        for (size_t t = 0; t < table.size(); t++) {
+            const entry& e = table[t];
+            while (!oldLevels[t] && missIndex[m] != (int)t)
+                m++;
+            for (int l = 0; l < e.levels; l++) {
+                out.write(zeros, e.levelOffset[l] - written);
+                size_t bytes = (size_t)std::max(e.width >> l, 1) * std::max(e.height >> l, 1) * e.channels;
+                const unsigned char* src = oldLevels[t] ? oldLevels[t] + sourceOffsets[t * maxLevels + l] : chains[m][l].data();
+                out.write((const char*)src, bytes);
+                written = e.levelOffset[l] + bytes;
+            }
+        }
+        out.write(zeros, offset - written);
+    }
+
+    // swap the new file in.  If it can't be written or renamed (read only folder, full disk,
+    // the file in use...) the old one stays and the new textures are handed out from memory
+    bool saved = false;
+    if (std::filesystem::file_size(temporary, error) == offset) {
+        mapping.close();
+        std::filesystem::rename(temporary, filename, error);
+        saved = !error;
+        open();
+        saved = saved && mapping.isOpen();
+    }
+    if (!saved) {
+        std::filesystem::remove(temporary, error);
+        if (!mapping.isOpen())
+            open();
+    }
+
+    unsaved.clear();
+    for (int i = 0; i < count; i++)
+        if (found[i] >= 0)
+            result[i] = view(saved ? newIndex[found[i]] : found[i]);
+    for (int m = 0; m < (int)missing.size(); m++) {
+        if (missIndex[m] < 0)
+            continue;
+        if (saved) {
+            result[missing[m]] = view(missIndex[m]);
+            continue;
+        }
+        cachedTexture& t = result[missing[m]];
+        t.path = requests[missing[m]].path;
+        t.width = decoded[m].width;
+        t.height = decoded[m].height;
+        t.channels = decoded[m].channels;
+        t.levels = (int)chains[m].size();
+        for (int l = 0; l < t.levels; l++)
+            t.level[l] = chains[m][l].data();
+        unsaved.push_back(std::move(chains[m])); // the vectors' buffers don't move
+    }
+
+    counts.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (stats)
+        *stats = counts;
+    return result;
+}
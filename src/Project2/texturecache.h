@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "assetloader.h"
+#include "mappedfile.h"
+#include "threadpool.h"
+
+// one texture in the cache: its pixels and mip chain, pointing into the mapped cache file
+struct cachedTexture {
+    std::string path;
+    int width = 0, height = 0;
+    int channels = 0;
+    int levels = 0;
+    const unsigned char* level[16] = {}; // tightly packed rows, row 0 at the bottom if flipped
+
+    bool ok() const { return levels > 0; }
+    int levelWidth(int i) const { return width >> i > 0 ? width >> i : 1; }
+    int levelHeight(int i) const { return height >> i > 0 ? height >> i : 1; }
+    size_t levelBytes(int i) const { return (size_t)levelWidth(i) * levelHeight(i) * channels; }
+};
+
+struct textureCacheStats {
+    size_t hits = 0;
+    size_t misses = 0;      // decoded with stb_image and written to the cache
+    size_t failed = 0;      // couldn't be decoded at all
+    double seconds = 0.0;
+    double decodeSeconds = 0.0; // wall clock spent decoding and building mips for the misses
+};
+
+// Decoded textures kept on disk between runs, so a warm start never goes near stb_image.
+//
+// Entries are keyed by the source path, its size, modification time and a hash of its
+// contents, along with the channel count, flip and scale the request asked for.  When the
+// size and time match the entry is used as is; when only the time changed the file is
+// hashed and still counts as a hit if the contents are the same, and the file is written
+// out again with the new time.
+//
+// The cache is one file: a header, a table of fixed size entries, the paths, then every
+// mip level of every texture, each starting on a 64 byte boundary.  It is memory mapped
+// and the levels go to glTexImage2D straight from the mapping, nothing gets parsed or
+// copied; an entry reaching outside the file makes the whole cache count as empty.  Misses
+// are decoded on the thread pool and the file is rewritten (to a temporary name first,
+// then renamed over the old one), never changed in place under the mapping.  The textures
+// load() hands out stay valid until the next load() or until the cache goes away.
+class textureCache {
+public:
+    explicit textureCache(std::string file);
+
+    // one entry per request, in order; misses are decoded and added to the file
+    std::vector<cachedTexture> load(const std::vector<imageRequest>& requests, threadPool& pool = threadPool::shared(),
+                                    textureCacheStats* stats = nullptr);
+
+    const std::string& file() const { return filename; }
+
+private:
+    struct entry;
+
+    std::string filename;
+    mappedFile mapping;
+    std::vector<std::vector<std::vector<unsigned char>>> unsaved; // levels that couldn't be written out
+
+    void open();
+    const entry* entries() const;
+    int entryCount() const;
+    int find(const imageRequest& request, std::uint64_t size) const;
+    cachedTexture view(int index) const;
+};
@@ -0,0 +1,344 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <glad/glad.h>
+
+#include "assetloader.h"
+#include "texturecache.h"
+#include "textureupload.h"
+#include "threadpool.h"
+
+struct streamStats {
+    size_t requested = 0;      // textures asked for
+    size_t ready = 0;          // swapped in
+    size_t failed = 0;         // left on their placeholder for good
+    size_t bytes = 0;          // pixel bytes uploaded so far
+    size_t frames = 0;         // update() calls that uploaded anything
+    size_t peakFrameBytes = 0; // the most any one frame uploaded
+};
+
+// Textures that load in the background while the render loop is already running.
+//
+// request() returns a handle straight away and id() gives a placeholder texture for it
+// until the real one is in: the one passed in, or a 1x1 grey.  The files are loaded on a
+// thread of the streamer's own, which spreads the decoding over the thread pool (through
+// the texture cache when one is given, so a warm start only maps the file and copies the
+// levels out); nothing runs on the caller's thread, even with a pool of one.  update(), called once a frame on the
+// GL thread, uploads what has arrived a band of rows at a time with glTexSubImage2D.  No
+// frame uploads much more than the budget, so a big texture is spread over several frames
+// instead of stalling one.  The real texture only replaces the placeholder once every row
+// of every level is in.
+//
+// Each request() call is one job for that thread, run in the order they were asked for,
+// so ask for textures that belong together in one call - with a cache that also means one
+// rewrite of the cache file for the lot.  The streamer has the one textureCache, used only
+// on that thread; each job copies what it gets out of the mapping, since the next job's
+// rewrite replaces the file (on Windows that can't happen while anything maps it).
+class textureStreamer {
+public:
+    // cacheFile: a textureCache file to go through, "" decodes every time.  frameBudget is
+    // in bytes; at least one row is uploaded each frame whatever the budget.
+    explicit textureStreamer(std::string cacheFile = "", size_t frameBudget = 4 << 20, threadPool& pool = threadPool::shared())
+        : cacheFile(std::move(cacheFile)), budget(frameBudget), pool(pool), loader([this] { loaderLoop(); })
+    {
+    }
+
+    // finishes the jobs already asked for; the GL textures belong to the context
+    ~textureStreamer()
+    {
+        {
+            std::lock_guard<std::mutex> guard(queueLock);
+            stopping = true;
+        }
+        queueWake.notify_one();
+        loader.join();
+    }
+
+    textureStreamer(const textureStreamer&) = delete;
+    textureStreamer& operator=(const textureStreamer&) = delete;
+
+    // mipmapped, repeating 2D textures, one handle per image
+    std::vector<int> request(const std::vector<imageRequest>& images, GLuint placeholder = 0)
+    {
+        std::shared_future<batchPtr> batch = start(images);
+        std::vector<int> handles;
+        for (size_t i = 0; i < images.size(); i++)
+            handles.push_back(add(batch, (int)i, placeholder ? placeholder : grey()));
+        return handles;
+    }
+
+    int request(const imageRequest& image, GLuint placeholder = 0)
+    {
+        return request(std::vector<imageRequest>{ image }, placeholder)[0];
+    }
+
+    // the texture to bind for a handle this frame
+    GLuint id(int handle) const { return entries[handle].state == ready ? entries[handle].texture : entries[handle].placeholder; }
+    bool isReady(int handle) const { return entries[handle].state == ready; }
+    bool hasFailed(int handle) const { return entries[handle].state == failed; }
+    const std::string& error(int handle) const { return entries[handle].error; }
+
+    // textures still decoding or uploading
+    size_t pending() const { return stat.requested - stat.ready - stat.failed; }
+
+    const streamStats& stats() const { return stat; }
+    size_t frameBudget() const { return budget; }
+    void setFrameBudget(size_t bytes) { budget = bytes; }
+
+    // once a frame on the GL thread: upload up to the budget from whatever has been
+    // decoded, oldest request first.  Returns the bytes uploaded.
+    size_t update()
+    {
+        size_t used = 0;
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // RGB rows aren't padded to 4 bytes
+        for (entry& e : entries) {
+            if (e.state == waiting && !arrived(e))
+                continue;
+            if (e.state == uploading && !upload(e, used))
+                break; // out of budget
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+        if (used > 0) {
+            stat.bytes += used;
+            stat.frames++;
+            stat.peakFrameBytes = std::max(stat.peakFrameBytes, used);
+        }
+        return used;
+    }
+
+    // a 1x1 texture of one color, for placeholders
+    static GLuint solidTexture(unsigned char r, unsigned char g, unsigned char b)
+    {
+        const unsigned char texel[3] = { r, g, b };
+        GLuint id;
+        glGenTextures(1, &id);
+        glBindTexture(GL_TEXTURE_2D, id);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 1, 1, 0, GL_RGB, GL_UNSIGNED_BYTE, texel);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        return id;
+    }
+
+private:
+    // one decoded image, from the cache (every mip level) or from stb_image (just the top)
+    struct source {
+        int width = 0, height = 0;
+        int channels = 0;
+        int levels = 0;
+        const unsigned char* level[16] = {};
+        std::string error;
+
+        int levelWidth(int i) const { return width >> i > 0 ? width >> i : 1; }
+        int levelHeight(int i) const { return height >> i > 0 ? height >> i : 1; }
+    };
+
+    // what one job hands back: the images, and whatever keeps their pixels alive
+    struct batch {
+        std::vector<source> images;
+        std::shared_ptr<void> owner;
+    };
+    using batchPtr = std::shared_ptr<const batch>;
+
+    enum entryState { waiting, uploading, ready, failed };
+
+    struct entry {
+        std::shared_future<batchPtr> batch;
+        int image; // the one it takes from the batch
+        GLuint placeholder;
+        GLuint texture = 0;
+        entryState state = waiting;
+        int level = 0, row = 0; // how far the upload has got
+        std::string error;
+    };
+
+    std::string cacheFile;
+    std::unique_ptr<textureCache> cache; // made by the first job, only the loader thread touches it
+    size_t budget;
+    threadPool& pool;
+    std::vector<entry> entries;
+    streamStats stat;
+    GLuint greyTexture = 0;
+
+    // the loader thread and its jobs, oldest first.  One at a time, so the cache is only
+    // ever used by one of them
+    std::deque<std::packaged_task<batchPtr()>> queue;
+    std::mutex queueLock;
+    std::condition_variable queueWake;
+    bool stopping = false;
+    std::thread loader; // last, it starts running in the constructor
+
+    void loaderLoop()
+    {
+        for (;;) {
+            std::packaged_task<batchPtr()> job;
+            {
+                std::unique_lock<std::mutex> guard(queueLock);
+                queueWake.wait(guard, [this] { return stopping || !queue.empty(); });
+                if (queue.empty())
+                    return;
+                job = std::move(queue.front());
+                queue.pop_front();
+            }
+            job();
+        }
+    }
+
+    GLuint grey()
+    {
+        if (!greyTexture)
+            greyTexture = solidTexture(128, 128, 128);
+        return greyTexture;
+    }
+
+    int add(const std::shared_future<batchPtr>& job, int image, GLuint placeholder)
+    {
+        entry e;
+        e.batch = job;
+        e.image = image;
+        e.placeholder = placeholder;
+        entries.push_back(std::move(e));
+        stat.requested++;
+        return (int)entries.size() - 1;
+    }
+
+    // queue the job for one request() call on the loader thread
+    std::shared_future<batchPtr> start(const std::vector<imageRequest>& requests)
+    {
+        std::packaged_task<batchPtr()> job([this, requests]() -> batchPtr {
+            threadPool* workers = &pool;
+            auto result = std::make_shared<batch>();
+            result->images.resize(requests.size());
+
+            if (!cacheFile.empty()) {
+                if (!cache)
+                    cache = std::make_unique<textureCache>(cacheFile);
+                // the levels only stay put in the mapping until the next load(), and the GL
+                // thread may still be uploading them then
+                std::vector<cachedTexture> textures = cache->load(requests, *workers);
+                auto pixels = std::make_shared<std::vector<std::vector<unsigned char>>>(requests.size());
+                workers->parallelFor((int)requests.size(), [&](int i) {
+                    const cachedTexture& t = textures[i];
+                    size_t bytes = 0;
+                    for (int l = 0; l < t.levels; l++)
+                        bytes += t.levelBytes(l);
+                    (*pixels)[i].resize(bytes);
+                    source& s = result->images[i];
+                    s.width = t.width;
+                    s.height = t.height;
+                    s.channels = t.channels;
+                    s.levels = t.levels;
+                    unsigned char* out = (*pixels)[i].data();
+                    for (int l = 0; l < t.levels; l++) {
+                        memcpy(out, t.level[l], t.levelBytes(l));
+                        s.level[l] = out;
+                        out += t.levelBytes(l);
+                    }
+                    if (!t.ok())
+                        s.error = "couldn't load " + requests[i].path;
+                });
+                result->owner = pixels;
+            }
+            else {
+                auto images = std::make_shared<std::vector<decodedImage>>(decodeImages(requests, *workers));
+                for (size_t i = 0; i < requests.size(); i++) {
+                    const decodedImage& image = (*images)[i];
+                    source& s = result->images[i];
+                    s.width = image.width;
+                    s.height = image.height;
+                    s.channels = image.channels;
+                    s.levels = image.ok() ? 1 : 0;
+                    s.level[0] = image.pixels.get();
+                    s.error = image.error;
+                }
+                result->owner = images;
+            }
+            return result;
+        });
+        std::shared_future<batchPtr> done = job.get_future().share();
+        {
+            std::lock_guard<std::mutex> guard(queueLock);
+            queue.push_back(std::move(job));
+        }
+        queueWake.notify_one();
+        return done;
+    }
+
+    // has the entry's job finished?  If so make the texture to upload into
+    bool arrived(entry& e)
+    {
+        if (e.batch.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            return false;
+
+        const source& s = e.batch.get()->images[e.image];
+        if (s.levels == 0) {
+            e.error = s.error.empty() ? "couldn't load it" : s.error;
+            e.state = failed;
+            e.batch = {}; // lets go of the pixels once every entry is done with them
+            stat.failed++;
+            return false;
+        }
+
+        // storage for the levels the source has; the rest come from glGenerateMipmap at the end
+        glGenTextures(1, &e.texture);
+        glBindTexture(GL_TEXTURE_2D, e.texture);
+        GLenum format = imageFormat(s.channels);
+        for (int i = 0; i < s.levels; i++)
+            glTexImage2D(GL_TEXTURE_2D, i, format, s.levelWidth(i), s.levelHeight(i), 0, format, GL_UNSIGNED_BYTE, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        if (s.levels > 1)
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, s.levels - 1);
+        e.state = uploading;
+        return true;
+    }
+
+    // carry on with the entry's upload until it is done (true) or the frame's budget runs out (false)
+    bool upload(entry& e, size_t& used)
+    {
+        const source& s = e.batch.get()->images[e.image];
+        glBindTexture(GL_TEXTURE_2D, e.texture);
+
+        for (;;) {
+            int width = s.levelWidth(e.level), height = s.levelHeight(e.level);
+            size_t rowBytes = (size_t)width * s.channels;
+
+            if (used >= budget)
+                return false;
+            // whole rows only, but always at least one so a tiny budget still gets somewhere
+            int rows = (int)std::min<size_t>(height - e.row, std::max<size_t>(1, (budget - used) / rowBytes));
+
+            GLenum format = imageFormat(s.channels);
+            glTexSubImage2D(GL_TEXTURE_2D, e.level, 0, e.row, width, rows, format, GL_UNSIGNED_BYTE, s.level[e.level] + e.row * rowBytes);
+            used += rows * rowBytes;
+            e.row += rows;
+            if (e.row < height)
+                continue;
+
+            e.row = 0;
+            if (++e.level == s.levels)
+                break;
+        }
+
+        if (s.levels == 1)
+            glGenerateMipmap(GL_TEXTURE_2D);
+        e.state = ready;
+        e.batch = {};
+        stat.ready++;
+        return true;
+    }
+};
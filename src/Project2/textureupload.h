@@ -0,0 +1,79 @@
+#pragma once
+
+#include <vector>
+#include <glad/glad.h>
+
+#include "assetloader.h"
+#include "textureatlas.h"
+
+// the GL side of assetloader.h: turn decoded images into textures.  Call these from the
+// thread that owns the GL context, after decodeImages() has done the slow part.
+
+inline GLenum imageFormat(int channels)
+{
+    switch (channels) {
+    case 1: return GL_RED;
+    case 2: return GL_RG;
+    case 3: return GL_RGB;
+    default: return GL_RGBA;
+    }
+}
+
+// a mipmapped, repeating GL_TEXTURE_2D
+inline GLuint createTexture2D(int width, int height, int channels, const void* pixels)
+{
+    GLuint id;
+    glGenTextures(1, &id);
+    glBindTexture(GL_TEXTURE_2D, id);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // RGB rows aren't padded to 4 bytes
+    GLenum format = imageFormat(channels);
+    glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, pixels);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    return id;
+}
+
+// 0 when the image didn't decode
+inline GLuint uploadTexture(const decodedImage& image)
+{
+    return image.ok() ? createTexture2D(image.width, image.height, image.channels, image.pixels.get()) : 0;
+}
+
+// Keep one texture per atlas page up to date: new pages get a texture, and only the part
+// of a page that changed since the last call is sent, straight out of the page with
+// GL_UNPACK_ROW_LENGTH.  Mip levels past atlas.mipLevels() would blend neighbours together,
+// so GL_TEXTURE_MAX_LEVEL stops short of them.  'textures' holds the names, one per page
+inline void updateAtlasTextures(textureAtlas& atlas, std::vector<GLuint>& textures)
+{
+    int size = atlas.pageSize();
+    for (int p = 0; p < atlas.pageCount(); p++) {
+        if (p == (int)textures.size()) {
+            GLuint id;
+            glGenTextures(1, &id);
+            glBindTexture(GL_TEXTURE_2D, id);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, atlas.mipLevels() - 1);
+            textures.push_back(id);
+        }
+
+        atlasRect d = atlas.dirty(p);
+        if (d.empty())
+            continue;
+        glBindTexture(GL_TEXTURE_2D, textures[p]);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, size);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, d.x0, d.y0, d.x1 - d.x0, d.y1 - d.y0, GL_RGBA, GL_UNSIGNED_BYTE,
+                        atlas.pagePixels(p) + (size_t)d.y0 * size + d.x0);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        glGenerateMipmap(GL_TEXTURE_2D);
+        atlas.clean(p);
+    }
+}
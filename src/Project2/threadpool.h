@@ -0,0 +1,145 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <functional>
+#include <future>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+
+// a small fixed size pool of worker threads used by the CPU side code
+// (raster bands, image filters, asset decoding, mesh import...)
+//
+// the thread count includes the calling thread, so threadPool(1) has no workers at all
+// and simply runs everything inline.  That makes it easy to measure 1..N thread scaling.
+class threadPool {
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> jobs;
+    std::mutex lock;
+    std::condition_variable wake;
+    bool stopping = false;
+
+    void workerLoop()
+    {
+        for (;;) {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                wake.wait(guard, [this] { return stopping || !jobs.empty(); });
+                if (stopping && jobs.empty())
+                    return;
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+            job();
+        }
+    }
+
+public:
+    explicit threadPool(unsigned threads = 0)
+    {
+        if (threads == 0)
+            threads = std::max(1u, std::thread::hardware_concurrency());
+
+        for (unsigned i = 1; i < threads; i++)
+            workers.emplace_back([this] { workerLoop(); });
+    }
+
+    ~threadPool()
+    {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& t : workers)
+            t.join();
+    }
+
+    threadPool(const threadPool&) = delete;
+    threadPool& operator=(const threadPool&) = delete;
+
+    // number of threads that take part in parallelFor (workers + caller)
+    unsigned size() const { return (unsigned)workers.size() + 1; }
+
+    // queue a job, the future delivers its result.  With no workers the job runs right away.
+    template <typename F>
+    auto submit(F&& fn) -> std::future<decltype(fn())>
+    {
+        using result = decltype(fn());
+        auto task = std::make_shared<std::packaged_task<result()>>(std::forward<F>(fn));
+        std::future<result> done = task->get_future();
+
+        if (workers.empty()) {
+            (*task)();
+            return done;
+        }
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            jobs.emplace_back([task] { (*task)(); });
+        }
+        wake.notify_one();
+        return done;
+    }
+
+    // call fn(i) for every i in [0, count), spread over the pool.  The caller works too
+    // and returns once every index is done, so it is safe to call from inside a job.
+    template <typename F>
+    void parallelFor(int count, F&& fn)
+    {
+        if (count <= 0)
+            return;
+
+        if (workers.empty() || count == 1) {
+            for (int i = 0; i < count; i++)
+                fn(i);
+            return;
+        }
+
+        struct progress {
+            std::atomic<int> next{ 0 };
+            std::atomic<int> done{ 0 };
+            std::mutex m;
+            std::condition_variable finished;
+        };
+        auto state = std::make_shared<progress>();
+
+        // helpers that start after everything is taken never touch fn, only state
+        auto body = [state, count, &fn] {
+            for (;;) {
+                int i = state->next++;
+                if (i >= count)
+                    break;
+                fn(i);
+                if (++state->done == count) {
+                    std::lock_guard<std::mutex> guard(state->m);
+                    state->finished.notify_all();
+                }
+            }
+        };
+
+        int helpers = std::min((int)workers.size(), count - 1);
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            for (int h = 0; h < helpers; h++)
+                jobs.emplace_back(body);
+        }
+        wake.notify_all();
+
+        body();
+
+        std::unique_lock<std::mutex> guard(state->m);
+        state->finished.wait(guard, [&] { return state->done.load() == count; });
+    }
+
+    // one pool shared by everything that doesn't bring its own
+    static threadPool& shared()
+    {
+        static threadPool pool;
+        return pool;
+    }
+};
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <glad/glad.h>
+
+#include "vertexlayout.h"
+
+// VAOs made from vertexStreams (see vertexlayout.h), checked against the shader that
+// draws them.  The shader's inputs are read back from GL (glGetActiveAttrib) rather than
+// taken on trust, so a shader asking for a location the vertices don't have says so when
+// the VAO is made instead of quietly reading zeros, and attributes it never reads aren't
+// switched on.
+
+inline GLenum glComponentType(componentType type)
+{
+    switch (type) {
+    case componentType::float32: return GL_FLOAT;
+    case componentType::float16: return GL_HALF_FLOAT;
+    case componentType::int16: return GL_SHORT;
+    case componentType::int2_10_10_10: return GL_INT_2_10_10_10_REV;
+    }
+    return GL_FLOAT;
+}
+
+// point the bound VAO's attributes at the bound GL_ARRAY_BUFFER, as the layout says.
+// Only the locations in 'used' (a bit each) are switched on
+inline void applyVertexLayout(const vertexLayout& layout, unsigned int divisor = 0, unsigned int used = ~0u)
+{
+    for (const vertexAttribute& a : layout.attributes) {
+        if (a.location >= 32 || !(used & (1u << a.location)))
+            continue;
+        glVertexAttribPointer(a.location, a.components, glComponentType(a.type), a.normalized ? GL_TRUE : GL_FALSE,
+                              (GLsizei)layout.stride, (void*)(size_t)a.offset);
+        glVertexAttribDivisor(a.location, divisor);
+        glEnableVertexAttribArray(a.location);
+    }
+}
+
+// one of a shader's vertex inputs
+struct shaderInput {
+    std::string name;
+    int location;
+};
+
+// the vertex inputs a linked program actually reads; ones the compiler threw away
+// because nothing used them aren't there
+inline std::vector<shaderInput> shaderInputs(GLuint program)
+{
+    std::vector<shaderInput> inputs;
+    GLint count = 0, longest = 0;
+    glGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &count);
+    glGetProgramiv(program, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &longest);
+    std::vector<GLchar> name(longest + 1);
+    for (GLint i = 0; i < count; i++) {
+        GLint size = 0;
+        GLenum type = 0;
+        GLsizei length = 0;
+        glGetActiveAttrib(program, (GLuint)i, (GLsizei)name.size(), &length, &size, &type, name.data());
+        std::string n(name.data(), length);
+        if (n.compare(0, 3, "gl_") == 0) // gl_VertexID and friends come from GL, not a buffer
+            continue;
+        inputs.push_back({ n, glGetAttribLocation(program, n.c_str()) });
+    }
+    return inputs;
+}
+
+// whether the streams give the shader everything it reads, with what's missing in 'error'
+// if not; 'used' gets a bit for each location it reads.  Fewer components than the
+// shader asks for is fine, GL fills in the rest from (0, 0, 0, 1), and so are attributes
+// it doesn't read
+inline bool matchShaderInputs(const std::vector<shaderInput>& inputs, const std::vector<vertexStream>& streams,
+                              unsigned int& used, std::string& error)
+{
+    used = 0;
+    for (const shaderInput& input : inputs) {
+        bool found = false;
+        for (const vertexStream& s : streams)
+            found = found || s.layout.find(input.location) != nullptr;
+        if (!found) {
+            error += (error.empty() ? "" : "\n") + std::string("vertex input ") + input.name + " at location "
+                + std::to_string(input.location) + " isn't in the vertex layout";
+            continue;
+        }
+        if (input.location >= 0 && input.location < 32)
+            used |= 1u << input.location;
+    }
+    return error.empty();
+}
+
+// A VAO drawing 'streams' from buffers[s] for stream s, with 'elementBuffer' bound in it,
+// for 'program' to draw with (0 to switch on every attribute without asking).  Mismatches
+// go to 'error', or the console if that's null; the VAO is made anyway, with what the
+// streams have.  Leaves no VAO bound
+inline unsigned int createVertexArray(GLuint program, const std::vector<vertexStream>& streams, const unsigned int* buffers,
+                                      unsigned int elementBuffer, std::string* error = nullptr)
+{
+    unsigned int used = ~0u;
+    if (program) {
+        std::string mismatch;
+        if (!matchShaderInputs(shaderInputs(program), streams, used, mismatch)) {
+            if (error)
+                *error = mismatch;
+            else
+                std::cout << mismatch << std::endl;
+        }
+    }
+
+    unsigned int vao = 0;
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+    for (size_t s = 0; s < streams.size(); s++) {
+        glBindBuffer(GL_ARRAY_BUFFER, buffers[s]);
+        applyVertexLayout(streams[s].layout, streams[s].divisor, used);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // the element buffer stays bound, it's part of the VAO
+    if (elementBuffer)
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBuffer);
+    glBindVertexArray(0);
+    return vao;
+}
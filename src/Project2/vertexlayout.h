@@ -0,0 +1,250 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+// the attribute locations meshes use, the numbers a shader asks for with layout (location = N)
+enum vertexSemantic : std::uint8_t {
+    positionAttribute = 0,
+    normalAttribute = 1,
+    uvAttribute = 2,
+};
+
+// how an attribute's components are stored
+enum class componentType : std::uint8_t {
+    float32 = 0,
+    float16 = 1,        // half floats
+    int16 = 2,          // normalized, -32767..32767 is -1..1 (snorm16)
+    int2_10_10_10 = 3,  // four signed components in 32 bits, x in the low 10, w in the top 2
+};
+
+// bytes per component, 0 for the packed types (see attributeBytes)
+constexpr int componentBytes(componentType type)
+{
+    switch (type) {
+    case componentType::float32: return 4;
+    case componentType::float16: return 2;
+    case componentType::int16: return 2;
+    case componentType::int2_10_10_10: return 0;
+    }
+    return 0;
+}
+
+// one attribute of an interleaved vertex, stored as is in mesh files (see meshfile.h)
+struct vertexAttribute {
+    std::uint8_t location;   // a vertexSemantic
+    componentType type;
+    std::uint8_t components; // 1 to 4
+    std::uint8_t normalized; // integers read as 0..1 or -1..1 rather than as they are
+    std::uint32_t offset;    // from the start of the vertex
+};
+static_assert(sizeof(vertexAttribute) == 8, "vertex attributes are read and written as raw bytes");
+
+// how much of the vertex an attribute takes, 0 if it doesn't make sense (a packed type
+// that isn't four components, say)
+inline unsigned int attributeBytes(const vertexAttribute& a)
+{
+    if (a.components < 1 || a.components > 4)
+        return 0;
+    if (a.type == componentType::int2_10_10_10)
+        return a.components == 4 ? 4 : 0;
+    return a.components * componentBytes(a.type);
+}
+
+// what's in a vertex and where.  applyVertexLayout() in meshrenderer.h turns it into
+// glVertexAttribPointer calls
+struct vertexLayout {
+    std::vector<vertexAttribute> attributes;
+    unsigned int stride = 0;
+
+    const vertexAttribute* find(int location) const
+    {
+        for (const vertexAttribute& a : attributes)
+            if (a.location == location)
+                return &a;
+        return nullptr;
+    }
+};
+
+// A vertex can come from more than one buffer, a stream each: all of it interleaved in
+// one, or the positions on their own and the rest in another, so a depth only pass
+// reads just the positions and no normals or uvs.  A stream is per vertex, or with a
+// divisor per instance (1 moves on every instance, 2 every other one...)
+const int maxVertexStreams = 4;
+
+struct vertexStream {
+    vertexLayout layout; // offsets from the start of this stream's vertex
+    unsigned int divisor = 0;
+};
+
+// The vertex formats the code knows about when it's compiled are written as types, so a
+// mistake is an error there and then rather than a garbled mesh:
+//
+//   using myVertex = interleavedFormat<vertexAttrib<positionAttribute, componentType::float32, 3>,
+//                                      vertexAttrib<uvAttribute, componentType::float32, 2>>;
+//   myVertex::stride(0) == 20, myVertex::streams() for createVertexArray() (vertexarray.h)
+//
+// Each stream's attributes are packed together in the order they're listed, like
+// packVertices does it (meshquantize.h).
+template <int Location, componentType Type, int Components, bool Normalized = false, int Stream = 0, unsigned int Divisor = 0>
+struct vertexAttrib {
+    static_assert(Location >= 0 && Location < 16, "GL only promises 16 attribute locations");
+    static_assert(Components >= 1 && Components <= 4, "an attribute has 1 to 4 components");
+    static_assert(Type != componentType::int2_10_10_10 || Components == 4, "2_10_10_10 is always four components");
+    static_assert(!Normalized || Type == componentType::int16 || Type == componentType::int2_10_10_10,
+                  "only integers can be normalized");
+    static_assert(Stream >= 0 && Stream < maxVertexStreams, "no such stream");
+
+    static constexpr int location = Location;
+    static constexpr componentType type = Type;
+    static constexpr int components = Components;
+    static constexpr bool normalized = Normalized;
+    static constexpr int stream = Stream;
+    static constexpr unsigned int divisor = Divisor;
+    static constexpr unsigned int bytes = Type == componentType::int2_10_10_10 ? 4 : Components * componentBytes(Type);
+
+    // the same attribute moved to another stream
+    template <int S>
+    using inStream = vertexAttrib<Location, Type, Components, Normalized, S, Divisor>;
+};
+
+template <typename... Attributes>
+struct vertexFormat {
+    static constexpr int count = sizeof...(Attributes);
+    static constexpr int locations[] = { Attributes::location... };
+    static constexpr int streamOf[] = { Attributes::stream... };
+    static constexpr unsigned int bytes[] = { Attributes::bytes... };
+    static constexpr unsigned int divisors[] = { Attributes::divisor... };
+
+    static constexpr int streamCount()
+    {
+        int most = 0;
+        for (int i = 0; i < count; i++)
+            most = streamOf[i] > most ? streamOf[i] : most;
+        return most + 1;
+    }
+
+    // where attribute i is in its stream's vertex
+    static constexpr unsigned int offset(int i)
+    {
+        unsigned int at = 0;
+        for (int k = 0; k < i; k++)
+            if (streamOf[k] == streamOf[i])
+                at += bytes[k];
+        return at;
+    }
+
+    static constexpr unsigned int stride(int stream)
+    {
+        unsigned int total = 0;
+        for (int i = 0; i < count; i++)
+            if (streamOf[i] == stream)
+                total += bytes[i];
+        return total;
+    }
+
+    static constexpr bool uniqueLocations()
+    {
+        for (int i = 0; i < count; i++)
+            for (int k = i + 1; k < count; k++)
+                if (locations[i] == locations[k])
+                    return false;
+        return true;
+    }
+
+    // every stream up to the last has something in it, and one divisor for all of it
+    static constexpr bool streamsFilled()
+    {
+        for (int s = 0; s < streamCount(); s++) {
+            int first = -1;
+            for (int i = 0; i < count; i++)
+                if (streamOf[i] == s) {
+                    if (first < 0)
+                        first = i;
+                    else if (divisors[i] != divisors[first])
+                        return false;
+                }
+            if (first < 0)
+                return false;
+        }
+        return true;
+    }
+
+    static_assert(count > 0, "a vertex with nothing in it");
+    static_assert(uniqueLocations(), "two attributes at the same location");
+    static_assert(streamsFilled(), "streams are numbered from 0 with none skipped, each with one divisor");
+
+    static std::vector<vertexStream> streams()
+    {
+        std::vector<vertexStream> out(streamCount());
+        const componentType types[] = { Attributes::type... };
+        const int components[] = { Attributes::components... };
+        const bool normalized[] = { Attributes::normalized... };
+        for (int i = 0; i < count; i++) {
+            vertexStream& s = out[streamOf[i]];
+            s.layout.attributes.push_back({ (std::uint8_t)locations[i], types[i], (std::uint8_t)components[i],
+                                            (std::uint8_t)normalized[i], offset(i) });
+            s.layout.stride = stride(streamOf[i]);
+            s.divisor = divisors[i];
+        }
+        return out;
+    }
+};
+
+// everything in stream 0, one vertex after another
+template <typename... Attributes>
+using interleavedFormat = vertexFormat<typename Attributes::template inStream<0>...>;
+
+template <typename Indices, typename... Attributes>
+struct splitFormatOf;
+template <std::size_t... I, typename... Attributes>
+struct splitFormatOf<std::index_sequence<I...>, Attributes...> {
+    using type = vertexFormat<typename Attributes::template inStream<(int)I>...>;
+};
+
+// each attribute in a stream of its own, in the order they're listed (structure of arrays)
+template <typename... Attributes>
+using splitFormat = typename splitFormatOf<std::index_sequence_for<Attributes...>, Attributes...>::type;
+
+// A layout that's only known once it's running, a mesh file's say, as streams: the
+// attribute at 'location' on its own in stream 0 and the rest packed together in stream
+// 1, or everything in stream 0 if 'location' is -1 or the only attribute
+inline std::vector<vertexStream> layoutStreams(const vertexLayout& layout, int location = -1)
+{
+    const vertexAttribute* alone = location >= 0 ? layout.find(location) : nullptr;
+    if (!alone || layout.attributes.size() < 2)
+        return { { layout, 0 } };
+    std::vector<vertexStream> out(2);
+    for (const vertexAttribute& a : layout.attributes) {
+        vertexLayout& to = out[a.location == location ? 0 : 1].layout;
+        vertexAttribute moved = a;
+        moved.offset = to.stride;
+        to.attributes.push_back(moved);
+        to.stride += attributeBytes(a);
+    }
+    return out;
+}
+
+// one stream's worth of 'count' vertices stored as 'from' lays them out: each of the
+// stream's attributes copied from the one at the same location.  Empty if 'from' doesn't
+// have one of them, or has it stored differently
+inline std::vector<unsigned char> gatherStream(const vertexLayout& from, const void* vertices, size_t count,
+                                               const vertexLayout& to)
+{
+    for (const vertexAttribute& a : to.attributes) {
+        const vertexAttribute* source = from.find(a.location);
+        if (!source || source->type != a.type || source->components != a.components || attributeBytes(a) == 0)
+            return {};
+    }
+    std::vector<unsigned char> out(count * to.stride);
+    const unsigned char* in = (const unsigned char*)vertices;
+    for (const vertexAttribute& a : to.attributes) {
+        unsigned int size = attributeBytes(a), sourceOffset = from.find(a.location)->offset;
+        for (size_t i = 0; i < count; i++)
+            std::memcpy(out.data() + i * to.stride + a.offset, in + i * from.stride + sourceOffset, size);
+    }
+    return out;
+}
@@ -0,0 +1,383 @@
+//
+// Headless golden image test and throughput benchmark for the CPU raster code in
+// src/Project2.  No window and no GL, so it runs anywhere the sources compile.
+//
+//   rastertest            check every routine against tests/golden, then benchmark
+//   rastertest --test     only the golden image check (what ctest runs)
+//   rastertest --bench    only the benchmark
+//   rastertest --update   rewrite the golden images from the current output
+//
+// Each routine is run on pools of 1, 2, 4 ... N threads; every run must match the
+// golden image, so thread count can never change the picture.
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "basics.h"
+#include "demos.h"
+
+#include <stb_image.h>
+
+#ifndef G4G_GOLDEN_DIR
+#define G4G_GOLDEN_DIR "tests/golden"
+#endif
+
+// a channel may be off by this much (different compilers round float math differently)...
+static const int channelTolerance = 2;
+// ... and this fraction of pixels may be further off than that (edge pixels flipping sides)
+static const double outlierBudget = 0.001;
+
+struct routine {
+    const char* name;
+    std::function<void(threadPool&)> run;
+};
+
+// ---- minimal PNG writer (fixed Huffman deflate with greedy matching), enough for golden images
+
+static unsigned int crc32(const unsigned char* data, size_t len, unsigned int crc = 0)
+{
+    static unsigned int table[256];
+    if (!table[1])
+        for (unsigned int n = 0; n < 256; n++) {
+            unsigned int c = n;
+            for (int k = 0; k < 8; k++)
+                c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            table[n] = c;
+        }
+
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++)
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+struct bitWriter {
+    std::vector<unsigned char>& out;
+    unsigned int bits = 0;
+    int count = 0;
+
+    void put(unsigned int value, int n) // least significant bit first
+    {
+        bits |= value << count;
+        count += n;
+        while (count >= 8) {
+            out.push_back(bits & 0xff);
+            bits >>= 8;
+            count -= 8;
+        }
+    }
+    void putHuffman(unsigned int code, int n) // huffman codes go most significant bit first
+    {
+        unsigned int r = 0;
+        for (int i = 0; i < n; i++)
+            r |= ((code >> i) & 1) << (n - 1 - i);
+        put(r, n);
+    }
+    void flush()
+    {
+        if (count > 0)
+            out.push_back(bits & 0xff);
+        bits = 0;
+        count = 0;
+    }
+};
+
+static void literal(bitWriter& bw, int v)
+{
+    if (v < 144) bw.putHuffman(0x30 + v, 8);
+    else if (v < 256) bw.putHuffman(0x190 + v - 144, 9);
+    else if (v < 280) bw.putHuffman(v - 256, 7);
+    else bw.putHuffman(0xc0 + v - 280, 8);
+}
+
+static void match(bitWriter& bw, int length, int distance)
+{
+    static const int lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+    static const int lengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+    static const int distBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+    static const int distExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+    int l = 28;
+    while (lengthBase[l] > length)
+        l--;
+    literal(bw, 257 + l);
+    bw.put(length - lengthBase[l], lengthExtra[l]);
+
+    int d = 29;
+    while (distBase[d] > distance)
+        d--;
+    bw.putHuffman(d, 5);
+    bw.put(distance - distBase[d], distExtra[d]);
+}
+
+static std::vector<unsigned char> deflate(const std::vector<unsigned char>& raw)
+{
+    std::vector<unsigned char> z = { 0x78, 0x01 };
+    bitWriter bw{ z };
+    bw.put(1, 1); // final block
+    bw.put(1, 2); // fixed huffman
+
+    const int window = 32768, hashSize = 1 << 15;
+    std::vector<int> head(hashSize, -1);
+    auto hash = [&](size_t i) { return ((raw[i] << 10) ^ (raw[i + 1] << 5) ^ raw[i + 2]) & (hashSize - 1); };
+
+    size_t i = 0;
+    while (i < raw.size()) {
+        int best = 0;
+        size_t from = 0;
+        if (i + 3 <= raw.size()) {
+            int h = hash(i);
+            int cand = head[h];
+            head[h] = (int)i;
+            if (cand >= 0 && i - cand <= (size_t)window) {
+                size_t limit = std::min<size_t>(258, raw.size() - i);
+                size_t n = 0;
+                while (n < limit && raw[cand + n] == raw[i + n])
+                    n++;
+                if (n >= 3) {
+                    best = (int)n;
+                    from = cand;
+                }
+            }
+        }
+
+        if (best) {
+            match(bw, best, (int)(i - from));
+            for (size_t k = i + 1; k < i + best && k + 3 <= raw.size(); k++)
+                head[hash(k)] = (int)k;
+            i += best;
+        }
+        else
+            literal(bw, raw[i++]);
+    }
+    literal(bw, 256);
+    bw.flush();
+
+    unsigned int a = 1, b = 0;
+    for (unsigned char c : raw) {
+        a = (a + c) % 65521;
+        b = (b + a) % 65521;
+    }
+    z.push_back(b >> 8); z.push_back(b & 0xff); z.push_back(a >> 8); z.push_back(a & 0xff);
+    return z;
+}
+
+static void put32(std::vector<unsigned char>& out, unsigned int v)
+{
+    out.push_back(v >> 24); out.push_back(v >> 16); out.push_back(v >> 8); out.push_back(v);
+}
+
+static void chunk(std::vector<unsigned char>& out, const char* type, const std::vector<unsigned char>& body)
+{
+    put32(out, (unsigned int)body.size());
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), body.begin(), body.end());
+    put32(out, crc32(&out[start], out.size() - start));
+}
+
+// rows are written top first, which is the last row of imageBuff (row 0 is the bottom of the texture)
+static bool writePNG(const std::string& path, const unsigned char* rgb, int w, int h)
+{
+    std::vector<unsigned char> raw;
+    for (int y = h - 1; y >= 0; y--) {
+        raw.push_back(1); // filter: sub
+        const unsigned char* row = rgb + (size_t)y * w * 3;
+        for (int x = 0; x < w * 3; x++)
+            raw.push_back(row[x] - (x >= 3 ? row[x - 3] : 0));
+    }
+
+    std::vector<unsigned char> header;
+    put32(header, w);
+    put32(header, h);
+    header.insert(header.end(), { 8, 2, 0, 0, 0 }); // 8 bit RGB
+
+    std::vector<unsigned char> png = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    chunk(png, "IHDR", header);
+    chunk(png, "IDAT", deflate(raw));
+    chunk(png, "IEND", {});
+
+    FILE* f = fopen(path.c_str(), "wb");
+    if (!f)
+        return false;
+    bool ok = fwrite(png.data(), 1, png.size(), f) == png.size();
+    fclose(f);
+    return ok;
+}
+
+// ---- running things quietly
+
+// the routines report what they did on cout, which is noise here
+struct quiet {
+    std::ostringstream sink;
+    std::streambuf* saved;
+    quiet() : saved(std::cout.rdbuf(sink.rdbuf())) {}
+    ~quiet() { std::cout.rdbuf(saved); }
+};
+
+static void runQuietly(const routine& r, threadPool& pool)
+{
+    quiet hush;
+    r.run(pool);
+}
+
+static std::string goldenPath(const routine& r)
+{
+    return std::string(G4G_GOLDEN_DIR) + "/" + r.name + ".png";
+}
+
+// compare imageBuff against a golden image, false (with a reason) on mismatch
+static bool matchesGolden(const routine& r, std::string& why)
+{
+    // flipped to match imageBuff, whose row 0 is the bottom; only this thread's setting changes, and it is put back
+    int flipped = stbi_get_flip_vertically_on_load_thread();
+    stbi_set_flip_vertically_on_load_thread(1);
+    int w, h, n;
+    unsigned char* golden = stbi_load(goldenPath(r).c_str(), &w, &h, &n, 3);
+    stbi_set_flip_vertically_on_load_thread(flipped);
+    if (!golden) {
+        why = "can't read " + goldenPath(r) + " (run with --update to create it)";
+        return false;
+    }
+    if (w != 512 || h != 512) {
+        stbi_image_free(golden);
+        why = "golden image is the wrong size";
+        return false;
+    }
+
+    const unsigned char* out = &imageBuff[0][0][0];
+    size_t outliers = 0;
+    int worst = 0;
+    for (size_t i = 0; i < (size_t)w * h; i++) {
+        int diff = 0;
+        for (int c = 0; c < 3; c++)
+            diff = std::max(diff, std::abs(out[i * 3 + c] - golden[i * 3 + c]));
+        worst = std::max(worst, diff);
+        if (diff > channelTolerance)
+            outliers++;
+    }
+    stbi_image_free(golden);
+
+    if (outliers > outlierBudget * w * h) {
+        why = std::to_string(outliers) + " pixels differ by more than " + std::to_string(channelTolerance) +
+              " (worst " + std::to_string(worst) + ")";
+        return false;
+    }
+    return true;
+}
+
+static std::vector<unsigned> threadCounts()
+{
+    unsigned most = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<unsigned> counts;
+    for (unsigned t = 1; t < most; t *= 2)
+        counts.push_back(t);
+    counts.push_back(most);
+    return counts;
+}
+
+int main(int argc, char** argv)
+{
+    bool test = true, bench = true, update = false;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--test"))
+            bench = false;
+        else if (!strcmp(argv[i], "--bench"))
+            test = false;
+        else if (!strcmp(argv[i], "--update"))
+            update = true, test = bench = false;
+        else {
+            std::cout << "usage: rastertest [--test | --bench | --update]\n";
+            return 2;
+        }
+    }
+
+    // every CPU pixel routine (basics.cpp and the demos in demos.h), each starts from a known picture
+    std::vector<routine> routines = {
+        { "checkerboard", [](threadPool&) { myTexture(); } },
+        { "primitives", [](threadPool& pool) { myTexture(); myPrimitives(pool); } },
+        { "depthscene", [](threadPool& pool) { myDepthScene(pool); } },
+        { "shaded", [](threadPool& pool) { myShadedTriangles(pool); } },
+        { "antialiased", [](threadPool& pool) { myAntialiased(pool); } },
+        { "filtered", [](threadPool& pool) { myFiltered(pool); } },
+        { "texturedfloor", [](threadPool& pool) { myTexturedFloor(nullptr, pool); } },
+        { "compressed", [](threadPool& pool) { myCompressed(pool); } },
+        { "atlas", [](threadPool&) { myAtlas(); } },
+        { "meshimport", [](threadPool& pool) { myMeshImport(pool); } },
+        { "meshoptimize", [](threadPool& pool) { myMeshOptimize(pool); } },
+        { "meshquantize", [](threadPool& pool) { myMeshQuantize(pool); } },
+        { "meshlod", [](threadPool& pool) { myMeshLod(pool); } },
+        { "meshlets", [](threadPool& pool) { myMeshlets(pool); } },
+        { "meshcache", [](threadPool& pool) { myMeshCache(pool); } },
+        { "meshgen", [](threadPool& pool) { myMeshGen(pool); } },
+    };
+
+    if (update) {
+        for (const routine& r : routines) {
+            runQuietly(r, threadPool::shared());
+            bool ok = writePNG(goldenPath(r), &imageBuff[0][0][0], 512, 512);
+            std::cout << (ok ? "wrote " : "FAILED to write ") << goldenPath(r) << "\n";
+            if (!ok)
+                return 1;
+        }
+        return 0;
+    }
+
+    int failures = 0;
+    std::vector<unsigned> counts = threadCounts();
+
+    if (test) {
+        for (const routine& r : routines) {
+            for (unsigned t : counts) {
+                threadPool pool(t);
+                memset(imageBuff, 0x55, sizeof(imageBuff)); // stale pixels must not leak through
+                runQuietly(r, pool);
+
+                std::string why;
+                bool ok = matchesGolden(r, why);
+                std::cout << (ok ? "PASS " : "FAIL ") << r.name << " (" << t << " thread" << (t > 1 ? "s" : "") << ")";
+                if (!ok) {
+                    std::cout << ": " << why;
+                    failures++;
+                }
+                std::cout << "\n";
+            }
+        }
+    }
+
+    if (bench) {
+        const double pixels = 512.0 * 512.0;
+        for (const routine& r : routines) {
+            double single = 0.0;
+            for (unsigned t : counts) {
+                threadPool pool(t);
+                runQuietly(r, pool); // warm up
+
+                // repeat for at least a quarter second
+                int reps = 0;
+                auto start = std::chrono::steady_clock::now();
+                double seconds = 0.0;
+                do {
+                    runQuietly(r, pool);
+                    reps++;
+                    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                } while (seconds < 0.25);
+
+                double mpix = pixels * reps / seconds / 1e6;
+                if (t == 1)
+                    single = mpix;
+                printf("%-14s %2u thread%s %9.2f Mpix/s  %5.2fx\n", r.name, t, t > 1 ? "s" : " ", mpix, mpix / single);
+            }
+        }
+    }
+
+    return failures ? 1 : 0;
+}
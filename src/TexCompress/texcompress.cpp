@@ -0,0 +1,131 @@
+//
+// Offline block compression for the images in data/.  No window and no GL.
+//
+//   texcompress [--bc1 | --bc3] [--no-mips] [--no-flip] [--threads N] [-o folder] images...
+//
+// Every image is written as a KTX file next to it (or in the -o folder) with the same
+// name, holding its whole mip chain as BC1 blocks, or BC3 when it has any transparency
+// (--bc1 / --bc3 force one or the other).  Rows are flipped so row 0 is at the bottom, the
+// way the rest of the program loads images; --no-flip for cube map faces.  ktxFile in
+// ktxfile.h reads them back.
+//
+// The images are decoded together on the thread pool, then each one is compressed with
+// its rows of blocks spread over the pool.
+//
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "assetloader.h"
+#include "blockcompress.h"
+#include "ktxfile.h"
+
+// peak signal to noise ratio of the compressed level 0 against the source, in dB (RGB, and alpha for BC3)
+static double psnr(const std::vector<rgba8>& source, const compressedTexture& texture)
+{
+    std::vector<rgba8> decoded(source.size());
+    decompressImage(texture.levels[0].data(), texture.width, texture.height, texture.format, decoded.data());
+
+    int channels = texture.format == blockFormat::bc3 ? 4 : 3;
+    double sum = 0.0;
+    for (size_t i = 0; i < source.size(); i++) {
+        const unsigned char* a = &source[i].r;
+        const unsigned char* b = &decoded[i].r;
+        for (int c = 0; c < channels; c++)
+            sum += (double)(a[c] - b[c]) * (a[c] - b[c]);
+    }
+    double mse = sum / ((double)source.size() * channels);
+    return mse > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / mse) : 99.0;
+}
+
+int main(int argc, char** argv)
+{
+    enum { automatic, bc1, bc3 } choice = automatic;
+    bool mips = true, flip = true;
+    unsigned threads = 0;
+    std::string folder;
+    std::vector<std::string> inputs;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--bc1"))
+            choice = bc1;
+        else if (!strcmp(argv[i], "--bc3"))
+            choice = bc3;
+        else if (!strcmp(argv[i], "--no-mips"))
+            mips = false;
+        else if (!strcmp(argv[i], "--no-flip"))
+            flip = false;
+        else if (!strcmp(argv[i], "--threads") && i + 1 < argc)
+            threads = (unsigned)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-o") && i + 1 < argc)
+            folder = argv[++i];
+        else if (argv[i][0] == '-') {
+            inputs.clear();
+            break;
+        }
+        else
+            inputs.push_back(argv[i]);
+    }
+    if (inputs.empty()) {
+        std::cout << "usage: texcompress [--bc1 | --bc3] [--no-mips] [--no-flip] [--threads N] [-o folder] images...\n";
+        return 2;
+    }
+
+    threadPool pool(threads);
+
+    std::vector<imageRequest> requests;
+    for (const std::string& input : inputs)
+        requests.push_back({ input, 4, flip });
+    decodeStats decoding;
+    std::vector<decodedImage> images = decodeImages(requests, pool, &decoding);
+    std::cout << "decoded " << decoding.images - decoding.failed << " images in " << decoding.seconds * 1000.0 << " ms on "
+        << pool.size() << " threads\n";
+
+    int failures = 0;
+    for (const decodedImage& image : images) {
+        if (!image.ok()) {
+            std::cout << "FAILED " << image.path << ": " << image.error << "\n";
+            failures++;
+            continue;
+        }
+
+        std::vector<rgba8> pixels((size_t)image.width * image.height);
+        memcpy(pixels.data(), image.pixels.get(), image.bytes());
+
+        blockFormat format = choice == bc3 ? blockFormat::bc3 : blockFormat::bc1;
+        if (choice == automatic)
+            for (const rgba8& p : pixels)
+                if (p.a < 255) {
+                    format = blockFormat::bc3;
+                    break;
+                }
+
+        compressStats stats;
+        compressedTexture texture = compressTexture(pixels.data(), image.width, image.height, format, mips, pool, &stats);
+
+        std::filesystem::path out = std::filesystem::path(image.path).replace_extension(".ktx");
+        if (!folder.empty())
+            out = std::filesystem::path(folder) / out.filename();
+        if (!writeKTX(out.string(), texture)) {
+            std::cout << "FAILED to write " << out.string() << "\n";
+            failures++;
+            continue;
+        }
+
+        // what it would have taken as RGB or RGBA with the same mips
+        size_t raw = 0;
+        for (size_t i = 0; i < texture.levels.size(); i++)
+            raw += (size_t)texture.levelWidth((int)i) * texture.levelHeight((int)i) * (format == blockFormat::bc1 ? 3 : 4);
+
+        std::cout << out.string() << ": " << image.width << "x" << image.height << " " << (format == blockFormat::bc1 ? "BC1" : "BC3")
+            << ", " << texture.levels.size() << " levels, " << texture.bytes() / 1024 << " KB (" << (double)raw / texture.bytes()
+            << ":1), " << stats.blocks / stats.seconds / 1e6 << " M blocks/s, " << psnr(pixels, texture) << " dB\n";
+    }
+
+    return failures ? 1 : 0;
+}